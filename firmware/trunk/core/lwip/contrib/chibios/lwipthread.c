@@ -81,6 +81,7 @@
 #include <lwip/stats.h>
 #include <lwip/snmp.h>
 #include <lwip/tcpip.h>
+#include "lwip/ip.h"
 #include "netif/etharp.h"
 #include "netif/ppp_oe.h"
 
@@ -114,6 +115,269 @@ static void low_level_init(struct netif *netif) {
 /*
  * Transmits a frame.
  */
+#if LWIP_EMAC_ZEROCOPY
+
+/*
+ * Zero copy mode.  The EMAC gets its own receive and transmit descriptor
+ * rings, set up here instead of by the MAC driver, which is still used for
+ * everything else (PHY, interrupts, receive events).
+ *
+ * Receive: each 128 byte EMAC buffer of a frame becomes a custom PBUF_REF
+ * pointing straight at the buffer, and the descriptor is handed back to the
+ * EMAC when lwIP frees the pbuf.  Frames are never copied, but while lwIP
+ * holds on to a buffer the EMAC can't use it, so the ring is sized to cover
+ * what's queued in the stack (mailboxes, socket queues, TCP out of sequence
+ * segments) as well as bursts on the wire.
+ *
+ * Transmit: each pbuf in the chain gets a descriptor pointing at its payload,
+ * and the chain is referenced until the EMAC marks the frame sent.  That's
+ * only safe if nothing touches the pbufs in the meantime, so these are copied
+ * into one PBUF_RAM first:
+ * - TCP segments, which TCP rewrites in place to retransmit them
+ * - PBUF_REF and PBUF_ROM payloads, which belong to the application and can
+ *   be reused as soon as the send call returns (our own receive buffers are
+ *   fine - they're ours until the last reference goes)
+ * - chains longer than the free descriptors, or with payloads that don't meet
+ *   EMAC_ZEROCOPY_TX_ALIGN
+ */
+
+#if ETH_PAD_SIZE
+#error "LWIP_EMAC_ZEROCOPY doesn't support ETH_PAD_SIZE"
+#endif
+
+#define RX_W1_OWNERSHIP         0x00000001  /* set by the EMAC when it's filled the buffer */
+#define RX_W1_WRAP              0x00000002
+#define RX_W1_ADDRESS_MASK      0xFFFFFFFC
+#define RX_W2_LENGTH_MASK       0x00000FFF
+#define RX_W2_FRAME_START       0x00004000
+#define RX_W2_FRAME_END         0x00008000
+#define RX_BUFFER_SIZE          128         /* fixed by the EMAC */
+
+#define TX_W2_LENGTH_MASK       0x000007FF
+#define TX_W2_LAST_BUFFER       0x00008000
+#define TX_W2_WRAP              0x40000000
+#define TX_W2_USED              0x80000000  /* set by the EMAC once the frame is sent */
+
+typedef struct {
+  uint32_t w1;
+  uint32_t w2;
+} zc_descriptor_t;
+
+typedef struct {
+  struct pbuf_custom pc;
+  bool_t held;                              /* lwIP still has it */
+} zc_rx_pbuf_t;
+
+static zc_descriptor_t zc_rx_ring[EMAC_ZEROCOPY_RX_BUFFERS] __attribute__((aligned(8)));
+static uint8_t zc_rx_buffers[EMAC_ZEROCOPY_RX_BUFFERS][RX_BUFFER_SIZE] __attribute__((aligned(4)));
+static zc_rx_pbuf_t zc_rx_pbufs[EMAC_ZEROCOPY_RX_BUFFERS];
+static unsigned zc_rx_next;                 /* next descriptor to look at for a new frame */
+
+static zc_descriptor_t zc_tx_ring[EMAC_ZEROCOPY_TX_DESCRIPTORS] __attribute__((aligned(8)));
+static struct pbuf *zc_tx_pbufs[EMAC_ZEROCOPY_TX_DESCRIPTORS]; /* on the first descriptor of each frame */
+static uint8_t zc_tx_count[EMAC_ZEROCOPY_TX_DESCRIPTORS];      /* descriptors in the frame */
+static unsigned zc_tx_head, zc_tx_tail, zc_tx_used;
+
+struct lwip_zerocopy_stats lwip_zerocopy_stats;
+
+#define ZC_RX_NEXT(i) (((i) + 1) % EMAC_ZEROCOPY_RX_BUFFERS)
+#define ZC_TX_NEXT(i) (((i) + 1) % EMAC_ZEROCOPY_TX_DESCRIPTORS)
+
+static void zc_rx_release(unsigned i) {
+  zc_rx_ring[i].w2 = 0;
+  zc_rx_ring[i].w1 &= ~RX_W1_OWNERSHIP;
+}
+
+/*
+ * Called by pbuf_free() from whichever thread drops the last reference.
+ */
+static void zc_rx_free(struct pbuf *p) {
+  unsigned i = (zc_rx_pbuf_t *)p - zc_rx_pbufs;
+
+  chSysLock();
+  zc_rx_pbufs[i].held = FALSE;
+  zc_rx_release(i);
+  chSysUnlock();
+}
+
+static void zc_init(void) {
+  unsigned i;
+
+  for (i = 0; i < EMAC_ZEROCOPY_RX_BUFFERS; i++) {
+    zc_rx_ring[i].w1 = (uint32_t)zc_rx_buffers[i];
+    zc_rx_ring[i].w2 = 0;
+    zc_rx_pbufs[i].pc.custom_free_function = zc_rx_free;
+  }
+  zc_rx_ring[EMAC_ZEROCOPY_RX_BUFFERS - 1].w1 |= RX_W1_WRAP;
+  for (i = 0; i < EMAC_ZEROCOPY_TX_DESCRIPTORS; i++)
+    zc_tx_ring[i].w2 = TX_W2_USED;
+  zc_tx_ring[EMAC_ZEROCOPY_TX_DESCRIPTORS - 1].w2 |= TX_W2_WRAP;
+
+  /* the queue pointers can only be changed with the EMAC stopped */
+  AT91C_BASE_EMAC->EMAC_NCR &= ~(AT91C_EMAC_RE | AT91C_EMAC_TE);
+  AT91C_BASE_EMAC->EMAC_RBQP = (uint32_t)zc_rx_ring;
+  AT91C_BASE_EMAC->EMAC_TBQP = (uint32_t)zc_tx_ring;
+  AT91C_BASE_EMAC->EMAC_NCR |= AT91C_EMAC_RE | AT91C_EMAC_TE;
+}
+
+/*
+ * Free the pbufs of frames the EMAC has finished sending.  It only marks the
+ * first descriptor of a frame as used, so mark the rest too - the EMAC has to
+ * find every free descriptor used or it'll send it again when it comes around.
+ */
+static void zc_tx_reclaim(void) {
+  while (zc_tx_used > 0 && (zc_tx_ring[zc_tx_tail].w2 & TX_W2_USED)) {
+    unsigned i, n = zc_tx_count[zc_tx_tail];
+
+    pbuf_free(zc_tx_pbufs[zc_tx_tail]);
+    zc_tx_pbufs[zc_tx_tail] = NULL;
+    for (i = 0; i < n; i++) {
+      zc_tx_ring[zc_tx_tail].w2 |= TX_W2_USED;
+      zc_tx_tail = ZC_TX_NEXT(zc_tx_tail);
+    }
+    zc_tx_used -= n;
+  }
+}
+
+static bool_t zc_tx_is_tcp(struct pbuf *p) {
+  u8_t *frame = (u8_t *)p->payload;
+
+  return p->len > SIZEOF_ETH_HDR + 9 &&
+         ((frame[12] << 8) | frame[13]) == ETHTYPE_IP &&
+         frame[SIZEOF_ETH_HDR + 9] == IP_PROTO_TCP;
+}
+
+static bool_t zc_tx_direct(struct pbuf *p, unsigned n) {
+  if (n > EMAC_ZEROCOPY_TX_DESCRIPTORS || zc_tx_is_tcp(p))
+    return FALSE;
+  for (; p != NULL; p = p->next) {
+    if (((uint32_t)p->payload & EMAC_ZEROCOPY_TX_ALIGN) != 0)
+      return FALSE;
+    if ((p->type == PBUF_REF || p->type == PBUF_ROM) && !(p->flags & PBUF_FLAG_IS_CUSTOM))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static err_t low_level_output(struct netif *netif, struct pbuf *p) {
+  struct pbuf *q;
+  unsigned i, first, n = pbuf_clen(p);
+  uint32_t first_w2 = 0;
+  systime_t start = chTimeNow();
+
+  (void)netif;
+  if (zc_tx_direct(p, n)) {
+    pbuf_ref(p);
+    lwip_zerocopy_stats.tx++;
+  }
+  else {
+    q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+    if (q == NULL)
+      return ERR_MEM;
+    pbuf_copy(q, p);
+    p = q;
+    n = 1;
+    lwip_zerocopy_stats.txcopied++;
+  }
+
+  zc_tx_reclaim();
+  while (EMAC_ZEROCOPY_TX_DESCRIPTORS - zc_tx_used < n) {
+    if (chTimeNow() - start >= MS2ST(LWIP_SEND_TIMEOUT)) {
+      pbuf_free(p);
+      return ERR_TIMEOUT;
+    }
+    chThdSleepMilliseconds(1);
+    zc_tx_reclaim();
+  }
+
+  /* fill in the descriptors after the first one, then the first, so the
+     EMAC can't start on the frame before it's all there */
+  first = zc_tx_head;
+  for (q = p, i = zc_tx_head; q != NULL; q = q->next, i = ZC_TX_NEXT(i)) {
+    uint32_t w2 = (q->len & TX_W2_LENGTH_MASK) | (zc_tx_ring[i].w2 & TX_W2_WRAP);
+    if (q->next == NULL)
+      w2 |= TX_W2_LAST_BUFFER;
+    zc_tx_ring[i].w1 = (uint32_t)q->payload;
+    if (i != first)
+      zc_tx_ring[i].w2 = w2;
+    else
+      first_w2 = w2; /* hang on to it until the rest are done */
+  }
+  zc_tx_head = i;
+  zc_tx_pbufs[first] = p;
+  zc_tx_count[first] = n;
+  zc_tx_used += n;
+  zc_tx_ring[first].w2 = first_w2;
+  AT91C_BASE_EMAC->EMAC_NCR |= AT91C_EMAC_TSTART;
+
+  LINK_STATS_INC(link.xmit);
+  return ERR_OK;
+}
+
+static struct pbuf *low_level_input(struct netif *netif) {
+  unsigned i, last, n;
+  u16_t len;
+  struct pbuf *head;
+
+  (void)netif;
+  while (TRUE) {
+    i = zc_rx_next;
+    /* nothing new, or we've come all the way around to a buffer lwIP is still using */
+    if (zc_rx_pbufs[i].held || !(zc_rx_ring[i].w1 & RX_W1_OWNERSHIP))
+      return NULL;
+    if (!(zc_rx_ring[i].w2 & RX_W2_FRAME_START)) {
+      /* the tail of a frame we never saw the start of */
+      zc_rx_release(i);
+      zc_rx_next = ZC_RX_NEXT(i);
+      continue;
+    }
+    /* find the end of the frame */
+    for (last = i, n = 1; !(zc_rx_ring[last].w2 & RX_W2_FRAME_END); n++) {
+      last = ZC_RX_NEXT(last);
+      if (n >= EMAC_ZEROCOPY_RX_BUFFERS || zc_rx_pbufs[last].held ||
+          !(zc_rx_ring[last].w1 & RX_W1_OWNERSHIP))
+        return NULL; /* still coming in */
+      if (zc_rx_ring[last].w2 & RX_W2_FRAME_START)
+        break;       /* the EMAC gave up on this one and started another */
+    }
+    if (!(zc_rx_ring[last].w2 & RX_W2_FRAME_END)) {
+      while (zc_rx_next != last) {
+        zc_rx_release(zc_rx_next);
+        zc_rx_next = ZC_RX_NEXT(zc_rx_next);
+      }
+      continue;
+    }
+    break;
+  }
+
+  /* chain up a pbuf for each buffer of the frame */
+  len = (u16_t)(zc_rx_ring[last].w2 & RX_W2_LENGTH_MASK);
+  head = NULL;
+  for (;;) {
+    u16_t chunk = len > RX_BUFFER_SIZE ? RX_BUFFER_SIZE : len;
+    struct pbuf *p = pbuf_alloced_custom(PBUF_RAW, chunk, PBUF_REF, &zc_rx_pbufs[i].pc,
+                                         zc_rx_buffers[i], RX_BUFFER_SIZE);
+    zc_rx_pbufs[i].held = TRUE;
+    if (head == NULL)
+      head = p;
+    else
+      pbuf_cat(head, p);
+    len -= chunk;
+    if (i == last)
+      break;
+    i = ZC_RX_NEXT(i);
+  }
+  zc_rx_next = ZC_RX_NEXT(last);
+
+  lwip_zerocopy_stats.rx++;
+  if (head->next != NULL)
+    lwip_zerocopy_stats.rxchained++;
+  LINK_STATS_INC(link.recv);
+  return head;
+}
+
+#else /* !LWIP_EMAC_ZEROCOPY */
+
 static err_t low_level_output(struct netif *netif, struct pbuf *p) {
   struct pbuf *q;
   MACTransmitDescriptor td;
@@ -191,6 +455,8 @@ static struct pbuf *low_level_input(struct netif *netif) {
 /*
  * Initialization.
  */
+#endif /* LWIP_EMAC_ZEROCOPY */
+
 static err_t ethernetif_init(struct netif *netif) {
 #if 0 // LWIP_NETIF_HOSTNAME
   /* Initialize interface hostname */
@@ -279,6 +545,9 @@ msg_t lwip_thread(void *p) {
 
   netif_set_default(&thisif);
   netif_set_up(&thisif);
+#if LWIP_EMAC_ZEROCOPY
+  zc_init();
+#endif
 
   /* Setup event sources.*/
   evtInit(&evt, S2ST(5));
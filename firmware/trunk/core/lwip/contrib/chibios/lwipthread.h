@@ -109,6 +109,43 @@
 #define LWIP_IFNAME1            's'
 #endif
 
+/** @brief Zero copy EMAC receive and transmit (MakingThings). */
+#if !defined(LWIP_EMAC_ZEROCOPY) || defined(__DOXYGEN__)
+#define LWIP_EMAC_ZEROCOPY      0
+#endif
+
+/** @brief Number of 128 byte receive buffers in zero copy mode. */
+#if !defined(EMAC_ZEROCOPY_RX_BUFFERS) || defined(__DOXYGEN__)
+#define EMAC_ZEROCOPY_RX_BUFFERS 32
+#endif
+
+/** @brief Number of transmit descriptors in zero copy mode - one per pbuf in flight. */
+#if !defined(EMAC_ZEROCOPY_TX_DESCRIPTORS) || defined(__DOXYGEN__)
+#define EMAC_ZEROCOPY_TX_DESCRIPTORS 8
+#endif
+
+/**
+ * @brief Address bits that must be clear for a pbuf to be sent in place.
+ * @details The EMAC takes transmit buffers at any byte address, so this is
+ *          0 - set it to 3 to only send word aligned payloads directly.
+ */
+#if !defined(EMAC_ZEROCOPY_TX_ALIGN) || defined(__DOXYGEN__)
+#define EMAC_ZEROCOPY_TX_ALIGN  0
+#endif
+
+#if LWIP_EMAC_ZEROCOPY
+/**
+ * @brief Zero copy counters.
+ */
+struct lwip_zerocopy_stats {
+  uint32_t      rx;             /**< frames received */
+  uint32_t      rxchained;      /**< received frames spanning more than one buffer */
+  uint32_t      tx;             /**< frames sent straight from their pbufs */
+  uint32_t      txcopied;       /**< frames that had to be copied before sending */
+};
+extern struct lwip_zerocopy_stats lwip_zerocopy_stats;
+#endif
+
 /**
  * @brief Runtime TCP/IP settings.
  */
@@ -489,6 +489,30 @@ dns_lookup(const char *name)
   return INADDR_NONE;
 }
 
+/**
+ * MakingThings addition: look up how much longer a resolved name stays valid.
+ * Lets callers that keep their own cache honour the TTL the server sent.
+ * Only call this from the tcpip thread (e.g. in a dns_found_callback).
+ *
+ * @param name the hostname to look up
+ * @return the longest remaining time to live in seconds (a refreshed name can
+ *         be in the table twice), or 0 if the hostname isn't in the dns_table.
+ */
+u32_t
+dns_lookup_ttl(const char *name)
+{
+  u8_t i;
+  u32_t ttl = 0;
+  for (i = 0; i < DNS_TABLE_SIZE; ++i) {
+    if ((dns_table[i].state == DNS_STATE_DONE) &&
+        (strcmp(name, dns_table[i].name) == 0) &&
+        (dns_table[i].ttl > ttl)) {
+      ttl = dns_table[i].ttl;
+    }
+  }
+  return ttl;
+}
+
 #if DNS_DOES_NAME_CHECK
 /**
  * Compare the "dotted" name "query" with the encoded name "response"
@@ -980,5 +1004,25 @@ dns_gethostbyname(const char *hostname, struct ip_addr *addr, dns_found_callback
   return dns_enqueue(hostname, found, callback_arg);
 }
 
+/**
+ * MakingThings addition: ask the server about a hostname even if it's
+ * already in the dns_table, so a name that's about to expire can be
+ * refreshed before anybody has to wait for it.
+ *
+ * @param hostname the hostname that is to be queried
+ * @param found a callback function to be called on success, failure or timeout
+ * @param callback_arg argument to pass to the callback function
+ * @return ERR_INPROGRESS if the query was queued, or an error.
+ */
+err_t
+dns_refresh(const char *hostname, dns_found_callback found, void *callback_arg)
+{
+  if ((dns_pcb == NULL) || (!hostname) || (!hostname[0]) ||
+      (strlen(hostname) >= DNS_MAX_NAME_LENGTH)) {
+    return ERR_VAL;
+  }
+  return dns_enqueue(hostname, found, callback_arg);
+}
+
 #endif /* LWIP_DNS */
 #endif // MAKE_CTRL_NETWORK
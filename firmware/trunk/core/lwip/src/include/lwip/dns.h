@@ -87,6 +87,11 @@ struct ip_addr dns_getserver(u8_t numdns);
 err_t          dns_gethostbyname(const char *hostname, struct ip_addr *addr,
                                  dns_found_callback found, void *callback_arg);
 
+err_t          dns_refresh(const char *hostname, dns_found_callback found,
+                           void *callback_arg);
+
+u32_t          dns_lookup_ttl(const char *name);
+
 #if DNS_LOCAL_HOSTLIST && DNS_LOCAL_HOSTLIST_IS_DYNAMIC
 int            dns_local_removehost(const char *hostname, const struct ip_addr *addr);
 err_t          dns_local_addhost(const char *hostname, const struct ip_addr *addr);
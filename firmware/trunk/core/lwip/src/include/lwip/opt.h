@@ -884,6 +884,15 @@
    ---------- Pbuf options ----------
    ----------------------------------
 */
+/**
+ * LWIP_SUPPORT_CUSTOM_PBUF==1: Support for custom pbufs, whose owner frees them
+ * (e.g. to hand a driver's DMA buffer back to the hardware).  MakingThings:
+ * backported from lwIP 1.4.
+ */
+#ifndef LWIP_SUPPORT_CUSTOM_PBUF
+#define LWIP_SUPPORT_CUSTOM_PBUF        0
+#endif
+
 /**
  * PBUF_LINK_HLEN: the number of bytes that should be allocated for a
  * link level header. The default is 14, the standard value for
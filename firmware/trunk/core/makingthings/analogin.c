@@ -283,7 +283,7 @@ static uint16_t analoginAutosendChannels;
 
 void analoginAutoSendInit()
 {
-  analoginAutosendChannels = eepromRead(EEPROM_ANALOGIN_AUTOSEND);
+  analoginAutosendChannels = settingsRead(EEPROM_ANALOGIN_AUTOSEND);
   if (((analoginAutosendChannels >> 8) & 0xFF) != AIN_AUTOSEND_SAVED)
     analoginAutosendChannels = AIN_AUTOSEND_SAVED << 8;
 }
@@ -330,7 +330,7 @@ static void analoginAutosendHandler(OscChannel ch, char* address, int idx, OscDa
     else
       analoginAutosendChannels &= ~(1 << idx);
 
-    eepromWrite(EEPROM_ANALOGIN_AUTOSEND, analoginAutosendChannels);
+    settingsWrite(EEPROM_ANALOGIN_AUTOSEND, analoginAutosendChannels);
   }
 }
 
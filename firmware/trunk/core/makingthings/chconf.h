@@ -153,7 +153,7 @@
  * @note    The default is @p TRUE.
  */
 #if !defined(CH_USE_REGISTRY) || defined(__DOXYGEN__)
-#define CH_USE_REGISTRY                 FALSE
+#define CH_USE_REGISTRY                 TRUE
 #endif
 
 /**
@@ -354,7 +354,7 @@
  * @note    The default is @p TRUE.
  */
 #if !defined(CH_USE_MEMPOOLS) || defined(__DOXYGEN__)
-#define CH_USE_MEMPOOLS                 FALSE
+#define CH_USE_MEMPOOLS                 TRUE
 #endif
 
 /**
@@ -431,7 +431,7 @@
  * @note    The default is @p FALSE.
  */
 #if !defined(CH_DBG_FILL_THREADS) || defined(__DOXYGEN__)
-#define CH_DBG_FILL_THREADS             FALSE
+#define CH_DBG_FILL_THREADS             TRUE
 #endif
 
 /**
@@ -444,7 +444,7 @@
  *          some test cases into the test suite.
  */
 #if !defined(CH_DBG_THREADS_PROFILING) || defined(__DOXYGEN__)
-#define CH_DBG_THREADS_PROFILING        FALSE
+#define CH_DBG_THREADS_PROFILING        TRUE
 #endif
 
 /*===========================================================================*/
@@ -461,6 +461,9 @@ struct {                                                                    \
   /* Add threads custom fields here.*/                                      \
   /* Space for the LWIP sys_timeouts structure.*/                           \
   void                  *p_lwipspace[1];                                    \
+  /* When the profiler last looked at this thread, and its p_time then.*/   \
+  systime_t             p_profiledAt;                                       \
+  systime_t             p_profiledTicks;                                    \
 };
 #endif
 
@@ -475,6 +478,8 @@ struct {                                                                    \
 #define THREAD_EXT_INIT_HOOK(tp) {                                          \
   /* Add threads initialization code here.*/                                \
   (tp)->p_lwipspace[0] = NULL;                                              \
+  (tp)->p_profiledAt = 0;                                                   \
+  (tp)->p_profiledTicks = 0;                                                \
 }
 #endif
 
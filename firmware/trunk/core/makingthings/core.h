@@ -109,6 +109,10 @@ void kill(void);
 #include "mtserial.h"
 #include "mtspi.h"
 #include "eeprom.h"
+#include "settings.h"
+#include "profiler.h"
+#include "trace.h"
+#include "pool.h"
 #include "timer.h"
 #include "fasttimer.h"
 #include "led.h"
@@ -118,6 +122,7 @@ void kill(void);
 #include "network.h"
 #include "udpsocket.h"
 #include "tcpsocket.h"
+#include "tcpstream.h"
 #include "tcpserver.h"
 #endif // MAKE_CTRL_NETWORK
 #ifdef MAKE_CTRL_USB
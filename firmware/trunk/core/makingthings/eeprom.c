@@ -122,23 +122,27 @@ void eepromWrite(int address, int value)
 */
 int eepromReadBlock(int address, uint8_t* data, int length)
 {
-  if (address < 0 || address > EEPROM_SIZE)
+  if (address < 0 || (address + length) > EEPROM_SIZE)
     return CONTROLLER_ERROR_BAD_ADDRESS;
 
   spiLock(Spi0);
   eepromReady();
 
-  unsigned char c[length + 4];
-  c[0] = EEPROM_INSTRUCTION_READ;
-  c[1] = (unsigned char)(address >> 8);
-  c[2] = (unsigned char)(address & 0xFF);
-  c[3] = 0;
-  
-  spiReadWriteBlock(Spi0, EEPROM_DEVICE, c, length + 3);
+  // reads can run across pages, but go a page at a time to keep the stack use down
+  unsigned char c[EEPROM_PAGE_SIZE + 3];
+  while (length > 0) {
+    int chunk = MIN(length, EEPROM_PAGE_SIZE);
+    c[0] = EEPROM_INSTRUCTION_READ;
+    c[1] = (unsigned char)(address >> 8);
+    c[2] = (unsigned char)(address & 0xFF);
+
+    spiReadWriteBlock(Spi0, EEPROM_DEVICE, c, chunk + 3);
+    memcpy(data, c + 3, chunk);
 
-  int i;
-  for (i = 0; i < length; i++)
-    data[i] = c[i + 3];
+    address += chunk;
+    data += chunk;
+    length -= chunk;
+  }
 
   spiUnlock();
 
@@ -147,6 +151,9 @@ int eepromReadBlock(int address, uint8_t* data, int length)
 
 /**
   Write a block of data to EEPROM.
+  The EEPROM can only write within one \b EEPROM_PAGE_SIZE (64 byte) page at a time, so
+  blocks that cross a page boundary are split up into one write per page.  Each page
+  takes up to 5 milliseconds to write.
   @param address The address to start writing at
   @param data The data to write
   @param length How many bytes of data to write
@@ -159,24 +166,29 @@ int eepromReadBlock(int address, uint8_t* data, int length)
 */
 int eepromWriteBlock(int address, uint8_t *data, int length)
 {
-  if (address < 0 || address >= EEPROM_SIZE)
+  if (address < 0 || (address + length) > EEPROM_SIZE)
     return CONTROLLER_ERROR_BAD_ADDRESS;
 
   spiLock(Spi0);
-  eepromReady();
-  eepromWriteEnable();    
 
-  uint8_t c[length + 4];
-  c[0] = EEPROM_INSTRUCTION_WRITE;
-  c[1] = (uint8_t)(address >> 8);
-  c[2] = (uint8_t)(address & 0xFF);
-  c[3] = 0;
+  uint8_t c[EEPROM_PAGE_SIZE + 3];
+  while (length > 0) {
+    // the address wraps around within a page rather than moving on to the next one
+    int chunk = MIN(length, EEPROM_PAGE_SIZE - (address % EEPROM_PAGE_SIZE));
+    eepromReady();
+    eepromWriteEnable();
 
-  int i;
-  for (i = 0; i < length; i++)
-    c[i + 3] = data[i];
-  
-  spiReadWriteBlock(Spi0, EEPROM_DEVICE, c, 3 + length);
+    c[0] = EEPROM_INSTRUCTION_WRITE;
+    c[1] = (uint8_t)(address >> 8);
+    c[2] = (uint8_t)(address & 0xFF);
+    memcpy(c + 3, data, chunk);
+
+    spiReadWriteBlock(Spi0, EEPROM_DEVICE, c, 3 + chunk);
+
+    address += chunk;
+    data += chunk;
+    length -= chunk;
+  }
   spiUnlock();
 
   return CONTROLLER_OK;
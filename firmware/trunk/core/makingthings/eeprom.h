@@ -34,6 +34,7 @@ int  eepromWriteBlock(int address, uint8_t *data, int length);
 
 #define EEPROM_RESERVE_SIZE 1024
 #define EEPROM_SIZE (32 * 1024)
+#define EEPROM_PAGE_SIZE 64 // a single write can't cross a page boundary
 #define EEPROM_SYSTEM_BASE          (EEPROM_SIZE - EEPROM_RESERVE_SIZE)
 #define EEPROM_SYSTEM_SERIAL_NUMBER         EEPROM_SYSTEM_BASE + 0
 #define EEPROM_SYSTEM_NOTUSED               EEPROM_SYSTEM_BASE + 4
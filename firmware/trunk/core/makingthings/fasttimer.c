@@ -287,7 +287,9 @@ void fasttimerServeInterrupt()
 {
   // only process if RC compare match has happened
   if (manager.tc->TC_SR & AT91C_TC_CPCS) {
+    int fired = 0;
     manager.servicing = true;
+    traceEventFromIsr(TRACE_FASTTIMER, 0);
 
     //AT91C_BASE_TC2->TC_CCR = AT91C_TC_CLKDIS;
 
@@ -359,6 +361,7 @@ void fasttimerServeInterrupt()
           // so don't assume any of those local variables are good anymore
           (*ftimer->handler)(ftimer->id);
         }
+        fired++;
       }
 
       // note that this has to be better than this ultimately - since
@@ -397,6 +400,7 @@ void fasttimerServeInterrupt()
 #ifdef FASTIRQ_MONITOR_IO
     pinOff(FASTIRQ_MONITOR_IO);
 #endif
+    traceEventFromIsr(TRACE_FASTTIMER | TRACE_END, fired);
 
     // AT91C_BASE_TC2->TC_CCR = AT91C_TC_CLKEN | AT91C_TC_SWTRG;
     manager.servicing = false;
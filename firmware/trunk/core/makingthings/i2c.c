@@ -19,6 +19,9 @@
 #include "hal.h"
 #include "board.h"
 #include "config.h"
+#include "error.h"
+#include "types.h"
+#include <string.h>
 
 #if SAM7_PLATFORM == SAM7S256
 #define I2C_PINS            (AT91C_PA3_TWD | AT91C_PA4_TWCK)
@@ -30,17 +33,33 @@
 #define I2C_DEFAULT_RATE 200000
 #endif
 
+#ifndef I2C_DEFAULT_TIMEOUT
+#define I2C_DEFAULT_TIMEOUT 100
+#endif
+
+#define I2C_PHASE_WRITE 0
+#define I2C_PHASE_READ  1
+#define I2C_ALL_INTERRUPTS (AT91C_TWI_TXCOMP | AT91C_TWI_RXRDY | AT91C_TWI_TXRDY | AT91C_TWI_NACK)
+
 typedef struct I2CDriver_t {
-  uint16_t length;
+  I2CTransaction* current;  // the transaction on the bus
+  I2CTransaction* last;     // the end of the queue that follows it
   uint16_t transferred;
-  uint8_t *data;
-  unsigned int state;
-  Semaphore sem; // for internal ISR sync
+  uint8_t phase;
+  int pending;
+  int bitrate;
+  uint32_t cwgr;
+  uint32_t bits;            // bits clocked on the bus, for utilization
+  systime_t statsStart;
+  I2CStats stats;
+  VirtualTimer timer;
   Mutex mutex; // for externally locking access to the I2C bus
 } I2CDriver;
 
 static I2CDriver i2cDriver;
 
+static void i2cStartI(I2CTransaction* t);
+
 /**
   \defgroup I2C I2C
   Interface with I2C (TWI / two-wire) devices.
@@ -51,9 +70,8 @@ static I2CDriver i2cDriver;
   use i2cSetBitrate() if you need to change it on the fly.
 
   Once you're configured, use i2cRead() and i2cWrite() to send and receive data with your
-  devices.  The driver is interrupt driven, but not thread safe - if you're going to
-  be communicating with devices from different threads, be sure to surround your I2C
-  activities with calls to i2cAcquireBus() and i2cReleaseBus().
+  devices.  These are safe to use from different threads - each transfer is queued, and the
+  calling thread waits until its turn on the bus is over.
 
   \b Example
   \code
@@ -61,20 +79,50 @@ static I2CDriver i2cDriver;
   i2cInit();
 
   uint8_t mydata[24];
-  i2cAcquireBus(); // first get access to the I2C system
   int status = i2cRead(MY_DEVICE_ADDRESS, mydata, 24, 0, 0);
-  i2cReleaseBus();
   if (status != 0) {
     // then there was a problem
   }
   \endcode
+
+  \section queue Queued Transactions
+  If you're polling several devices, you don't need to wait for each transfer to finish before
+  starting the next.  Fill in an I2CTransaction and hand it to i2cSubmit() - it returns right away,
+  and the transaction runs as soon as the ones ahead of it are done.  The next transaction is started
+  from the interrupt as soon as the previous one finishes, so the bus doesn't sit idle waiting on threads.
+  When it's finished, the transaction's \b onComplete handler is called and its \b done semaphore is signalled.
+
+  A transaction can write, read, or write and then read.  Each attempt times out after \b timeout
+  milliseconds (\b I2C_DEFAULT_TIMEOUT - 100 by default - if it's 0), and if the device doesn't respond
+  it's tried again up to \b retries times.
+
+  \code
+  uint8_t reg = 0x03, reading[6];
+  I2CTransaction t = { .device = 0x1E, .txData = &reg, .txLength = 1,
+                       .rxData = reading, .rxLength = 6, .retries = 2 };
+  Semaphore done;
+  chSemInit(&done, 0);
+  t.done = &done;
+  i2cSubmit(&t);
+  // ...do other things, then
+  chSemWait(&done);
+  if (t.status == I2C_OK) {
+    // reading is ready
+  }
+  \endcode
+  The transaction must stay around until it's finished - don't submit one from the stack and return.
+  i2cTransfer() does the waiting for you.
+
+  i2cGetStats() reports how busy the bus has been.
   \ingroup interfacing
   @{
 */
 
 /**
   Acquire exclusive access to the I2C system.
-  Call this before reading or writing, and be sure to call i2cReleaseBus() once you're done.
+  Individual reads and writes no longer need this, since transactions are queued,
+  but it's still handy if you need several of them to happen back to back without anyone else
+  getting in between.  Be sure to call i2cReleaseBus() once you're done.
 */
 void i2cAcquireBus()
 {
@@ -89,49 +137,138 @@ void i2cReleaseBus()
   chMtxUnlock();
 }
 
+static void i2cFinishI(int status)
+{
+  I2CTransaction* t = i2cDriver.current;
+  if (chVTIsArmedI(&i2cDriver.timer))
+    chVTResetI(&i2cDriver.timer);
+  t->status = status;
+  i2cDriver.pending--;
+  i2cDriver.stats.transactions++;
+  if (status != I2C_OK)
+    i2cDriver.stats.errors++;
+
+  // get the next one going before dealing with this one
+  i2cDriver.current = t->next;
+  if (i2cDriver.current)
+    i2cStartI(i2cDriver.current);
+  else
+    i2cDriver.last = 0;
+
+  if (t->onComplete)
+    t->onComplete(t, t->context);
+  if (t->done)
+    chSemSignalI(t->done);
+}
+
+static void i2cTimeout(void* arg)
+{
+  (void)arg;
+  // the TWI can wedge if a device holds the bus, so start it over
+  AT91C_BASE_TWI->TWI_IDR = 0xFFFFFFFF;
+  AT91C_BASE_TWI->TWI_CR = AT91C_TWI_SWRST;
+  AT91C_BASE_TWI->TWI_CR = AT91C_TWI_MSEN;
+  AT91C_BASE_TWI->TWI_CWGR = i2cDriver.cwgr;
+  i2cDriver.stats.timeouts++;
+  i2cFinishI(I2C_TIMED_OUT);
+}
+
+static void i2cStartReadI(I2CTransaction* t)
+{
+  // after a write, the internal address has already been sent
+  uint32_t iadrsz = (t->txLength > 0) ? 0 : t->intAddrLen;
+  i2cDriver.phase = I2C_PHASE_READ;
+  i2cDriver.transferred = 0;
+  i2cDriver.bits += 9 * (1 + iadrsz) + 2;
+  AT91C_BASE_TWI->TWI_MMR = ((t->device << 16) & AT91C_TWI_DADR)
+      | ((iadrsz << 8) & AT91C_TWI_IADRSZ) | AT91C_TWI_MREAD;
+  AT91C_BASE_TWI->TWI_IADR = t->internalAddr;
+  AT91C_BASE_TWI->TWI_IER = (AT91C_TWI_RXRDY | AT91C_TWI_NACK);
+  // send start condition.  If the length is 1 or less, set the STOP bit simultaneously
+  AT91C_BASE_TWI->TWI_CR = (t->rxLength > 1) ? AT91C_TWI_START : AT91C_TWI_START
+      | AT91C_TWI_STOP;
+}
+
+static void i2cStartI(I2CTransaction* t)
+{
+  int timeout = (t->timeout > 0) ? t->timeout : I2C_DEFAULT_TIMEOUT;
+  if (chVTIsArmedI(&i2cDriver.timer))
+    chVTResetI(&i2cDriver.timer);
+  chVTSetI(&i2cDriver.timer, MS2ST(timeout), i2cTimeout, 0);
+
+  if (t->txLength > 0) {
+    i2cDriver.phase = I2C_PHASE_WRITE;
+    i2cDriver.bits += 9 * (1 + t->intAddrLen) + 2;
+    AT91C_BASE_TWI->TWI_MMR = ((t->device << 16) & AT91C_TWI_DADR)
+        | ((t->intAddrLen << 8) & AT91C_TWI_IADRSZ);
+    AT91C_BASE_TWI->TWI_IADR = t->internalAddr;
+    // Write first byte to send - this generates a START event when in write mode
+    i2cDriver.transferred = 1;
+    AT91C_BASE_TWI->TWI_THR = t->txData[0];
+    AT91C_BASE_TWI->TWI_IER = (AT91C_TWI_TXRDY | AT91C_TWI_NACK);
+  }
+  else
+    i2cStartReadI(t);
+}
+
 /*
  * I2C ISR handler.
- * Update the driver object with information about the current transfer.
- * Once a transfer is complete, signal the reader/writer.  Enable/disable
- * interrupts as appropriate to move to the next state.
+ * Move the current transaction along.  Once it's complete, let the submitter
+ * know and start the next one in the queue right away.
  */
 static void serveI2cISR(void)
 {
+  I2CTransaction* t = i2cDriver.current;
   uint32_t status = AT91C_BASE_TWI->TWI_SR & AT91C_BASE_TWI->TWI_IMR;
+  if (!t)
+    return;
+
   if (status & AT91C_TWI_NACK) {
-    // no ACK from the device - set the error state, and finish the transaction
-    AT91C_BASE_TWI->TWI_IDR = (AT91C_TWI_TXCOMP | AT91C_TWI_RXRDY
-        | AT91C_TWI_TXRDY | AT91C_TWI_NACK);
-    i2cDriver.state = I2C_ERROR_NODEV;
-    chSemSignalI(&i2cDriver.sem);
+    // no ACK from the device - try again, or set the error state and finish the transaction
+    AT91C_BASE_TWI->TWI_IDR = I2C_ALL_INTERRUPTS;
+    chSysLockFromIsr();
+    if (t->attempts < t->retries) {
+      t->attempts++;
+      i2cDriver.stats.retries++;
+      i2cStartI(t);
+    }
+    else
+      i2cFinishI(I2C_ERROR_NODEV);
+    chSysUnlockFromIsr();
   }
   else if (status & AT91C_TWI_RXRDY) {
     // read is ready - load from the holding register and send a STOP if we're done
-    i2cDriver.data[i2cDriver.transferred++] = AT91C_BASE_TWI->TWI_RHR;
-    if (i2cDriver.transferred == i2cDriver.length) {
+    t->rxData[i2cDriver.transferred++] = AT91C_BASE_TWI->TWI_RHR;
+    i2cDriver.bits += 9;
+    if (i2cDriver.transferred == t->rxLength) {
       AT91C_BASE_TWI->TWI_IDR = AT91C_TWI_RXRDY;
       AT91C_BASE_TWI->TWI_IER = AT91C_TWI_TXCOMP;
     }
-    else if (i2cDriver.transferred == (i2cDriver.length - 1)) {
+    else if (i2cDriver.transferred == (t->rxLength - 1)) {
       AT91C_BASE_TWI->TWI_CR = AT91C_TWI_STOP;
     }
   }
   else if (status & AT91C_TWI_TXRDY) {
     // byte was written - send the next one if we're not finished yet
-    if (i2cDriver.transferred == i2cDriver.length) {
+    i2cDriver.bits += 9;
+    if (i2cDriver.transferred == t->txLength) {
       // STOP event (and thus TXCOMP ISR) automatically generated when TXRDY == 1 and we get an ACK
       AT91C_BASE_TWI->TWI_IDR = AT91C_TWI_TXRDY;
       AT91C_BASE_TWI->TWI_IER = AT91C_TWI_TXCOMP;
     }
     else {
-      AT91C_BASE_TWI->TWI_THR = i2cDriver.data[i2cDriver.transferred++];
+      AT91C_BASE_TWI->TWI_THR = t->txData[i2cDriver.transferred++];
     }
   }
   else if (status & AT91C_TWI_TXCOMP) {
-    // transaction complete - signal to the waiting writer/reader
     AT91C_BASE_TWI->TWI_IDR = (AT91C_TWI_TXCOMP | AT91C_TWI_NACK);
-    i2cDriver.state = I2C_OK;
-    chSemSignalI(&i2cDriver.sem);
+    i2cDriver.stats.bytes += i2cDriver.transferred;
+    chSysLockFromIsr();
+    if (i2cDriver.phase == I2C_PHASE_WRITE && t->rxLength > 0)
+      i2cStartReadI(t); // write's done - on to the read
+    else
+      i2cFinishI(I2C_OK);
+    chSysUnlockFromIsr();
   }
 }
 
@@ -149,7 +286,9 @@ static CH_IRQ_HANDLER( i2cISR ) {
 void i2cInit(void)
 {
   chMtxInit(&i2cDriver.mutex);
-  chSemInit(&i2cDriver.sem, 0);
+  i2cDriver.current = i2cDriver.last = 0;
+  i2cDriver.pending = 0;
+  i2cDriver.statsStart = chTimeNow();
   // set for open-drain with pull-up resistor, as periph A
   palSetGroupMode(IOPORT1, I2C_PINS, PAL_MODE_OUTPUT_OPENDRAIN);
   AT91C_BASE_PIOA->PIO_PDR = I2C_PINS;
@@ -166,14 +305,99 @@ void i2cInit(void)
   AIC_EnableIT(AT91C_ID_TWI);
 }
 
+/**
+  Queue up an I2C transaction.
+  This returns right away - the transaction is started as soon as the bus is free.
+  Check its \b status once its \b onComplete handler has been called or its \b done
+  semaphore has been signalled.  Don't touch the transaction until then.
+  @param t The transaction to run.
+  @return 0 on success, non-zero if the transaction is not valid.
+*/
+int i2cSubmit(I2CTransaction* t)
+{
+  if ((t->txLength == 0 && t->rxLength == 0) || t->intAddrLen > 3)
+    return CONTROLLER_ERROR_ILLEGAL_PARAMETER_VALUE;
+  t->status = I2C_IN_PROGRESS;
+  t->attempts = 0;
+  t->next = 0;
+
+  chSysLock();
+  i2cDriver.pending++;
+  if (i2cDriver.current)
+    i2cDriver.last->next = t;
+  else {
+    i2cDriver.current = t;
+    i2cStartI(t);
+  }
+  i2cDriver.last = t;
+  chSysUnlock();
+  return CONTROLLER_OK;
+}
+
+/**
+  Run an I2C transaction, and wait until it's finished.
+  @param t The transaction to run - its \b done semaphore is used by this function.
+  @return 0 on success, non-zero on error.
+*/
+int i2cTransfer(I2CTransaction* t)
+{
+  Semaphore done;
+  int rv;
+  chSemInit(&done, 0);
+  t->done = &done;
+  if ((rv = i2cSubmit(t)) != CONTROLLER_OK)
+    return rv;
+  chSemWait(&done);
+  return t->status;
+}
+
+/**
+  The number of transactions waiting for, or on, the bus.
+  @return The number of transactions that haven't finished yet.
+*/
+int i2cPending()
+{
+  return i2cDriver.pending;
+}
+
+/**
+  Read the I2C bus counters.
+  Utilization is worked out from the number of bits clocked at the current bit rate,
+  since the counters were last reset.
+  @param stats The I2CStats to fill in.
+  @param reset Whether to reset the counters afterwards.
+
+  \b Example
+  \code
+  I2CStats stats;
+  i2cGetStats(&stats, true);
+  if (stats.utilization > 80) {
+    // maybe time to turn the bitrate up
+  }
+  \endcode
+*/
+void i2cGetStats(I2CStats* stats, bool reset)
+{
+  chSysLock();
+  systime_t elapsed = chTimeNow() - i2cDriver.statsStart;
+  *stats = i2cDriver.stats;
+  if (elapsed > 0)
+    stats->utilization = ((uint64_t)i2cDriver.bits * 100 * CH_FREQUENCY) / ((uint64_t)i2cDriver.bitrate * elapsed);
+  if (reset) {
+    memset(&i2cDriver.stats, 0, sizeof(I2CStats));
+    i2cDriver.bits = 0;
+    i2cDriver.statsStart = chTimeNow();
+  }
+  chSysUnlock();
+}
+
 /**
   Write data to an I2C device.
   If the device that you're communicating with has an internal register map,
   you can specify the device's internal address to write to in the
   \b internalAddr parameter.  Otherwise, this can be left as 0.
 
-  This is not threadsafe - if you need exclusive access
-  to the I2C system, see i2cAcquireBus() and i2cReleaseBus()
+  This waits for any transactions queued ahead of it, and then for the write to finish.
 
   @param deviceAddr The address of the device to communicate with.
   @param data The data to send.
@@ -185,21 +409,14 @@ void i2cInit(void)
 int i2cWrite(uint8_t deviceAddr, const uint8_t *data, uint8_t length,
               uint16_t internalAddr, uint16_t intAddrLen)
 {
-  // Configure device & internal address
-  AT91C_BASE_TWI->TWI_MMR = ((deviceAddr << 16) & AT91C_TWI_DADR)
-      | ((intAddrLen << 8) & AT91C_TWI_IADRSZ);
-  AT91C_BASE_TWI->TWI_IADR = internalAddr;
-
-  // set up the transfer info
-  i2cDriver.state = I2C_IN_PROGRESS;
-  i2cDriver.data = (uint8_t*) data;
-  i2cDriver.length = length;
-  i2cDriver.transferred = 1;
-
-  // Write first byte to send - this generates a START event when in write mode
-  AT91C_BASE_TWI->TWI_THR = data[0];
-  AT91C_BASE_TWI->TWI_IER = (AT91C_TWI_TXRDY | AT91C_TWI_NACK); // turn on interrupts
-  return (chSemWait(&i2cDriver.sem) == RDY_OK) ? i2cDriver.state : I2C_TIMED_OUT;
+  I2CTransaction t = {
+    .device = deviceAddr,
+    .intAddrLen = intAddrLen,
+    .internalAddr = internalAddr,
+    .txData = data,
+    .txLength = length
+  };
+  return i2cTransfer(&t);
 }
 
 /**
@@ -210,11 +427,10 @@ int i2cWrite(uint8_t deviceAddr, const uint8_t *data, uint8_t length,
   you can specify the device's internal address to read from in the
   \b internalAddr parameter.  Otherwise, this can be left as 0.
 
-  This is not threadsafe - if you need exclusive access
-  to the i2c bus, see i2cAcquireBus() and i2cReleaseBus()
+  This waits for any transactions queued ahead of it, and then for the read to finish.
   @param deviceAddr The address of the device to communicate with.
-  @param data The data to send.
-  @param length The amount of data to send.
+  @param data Where to store the data read.
+  @param length The amount of data to read.
   @param internalAddr (optional) The device's internal address to read from.
   @param intAddrLen (optional) The size of the internal address (0-3 bytes)
   @return 0 on success, non-zero on error.
@@ -222,22 +438,14 @@ int i2cWrite(uint8_t deviceAddr, const uint8_t *data, uint8_t length,
 int i2cRead(uint8_t deviceAddr, uint8_t *data, uint8_t length,
             uint16_t internalAddr, uint16_t intAddrLen)
 {
-  // set up the transfer info
-  i2cDriver.state = I2C_IN_PROGRESS;
-  i2cDriver.data = data;
-  i2cDriver.length = length;
-  i2cDriver.transferred = 0;
-
-  // Enable read interrupt and start the transfer
-  AT91C_BASE_TWI->TWI_IER = (AT91C_TWI_RXRDY | AT91C_TWI_NACK);
-  AT91C_BASE_TWI->TWI_MMR = ((deviceAddr << 16) & AT91C_TWI_DADR)
-      | ((intAddrLen << 8) & AT91C_TWI_IADRSZ) | AT91C_TWI_MREAD;
-  AT91C_BASE_TWI->TWI_IADR = internalAddr;
-  // send start condition.  If the length is 1 or less, set the STOP bit simultaneously
-  AT91C_BASE_TWI->TWI_CR = (length > 1) ? AT91C_TWI_START : AT91C_TWI_START
-      | AT91C_TWI_STOP;
-  // wait for the isr handler to take care of business
-  return (chSemWait(&i2cDriver.sem) == RDY_OK) ? i2cDriver.state : I2C_TIMED_OUT;
+  I2CTransaction t = {
+    .device = deviceAddr,
+    .intAddrLen = intAddrLen,
+    .internalAddr = internalAddr,
+    .rxData = data,
+    .rxLength = length
+  };
+  return i2cTransfer(&t);
 }
 
 static uint32_t power(unsigned int x, unsigned int y)
@@ -267,7 +475,9 @@ void i2cSetBitrate(int rate)
       ckdiv++;
   }
   chDbgCheck(ckdiv < 8, "i2cSetBitrate - can't find good clock");
-  AT91C_BASE_TWI->TWI_CWGR = (ckdiv << 16) | (cldiv << 8) | cldiv;
+  i2cDriver.bitrate = rate;
+  i2cDriver.cwgr = (ckdiv << 16) | (cldiv << 8) | cldiv;
+  AT91C_BASE_TWI->TWI_CWGR = i2cDriver.cwgr;
 }
 
 /** @}
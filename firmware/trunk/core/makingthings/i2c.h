@@ -18,6 +18,7 @@
 #ifndef _I2C_H
 #define _I2C_H
 
+#include "types.h"
 #include "ch.h"
 
 // return values
@@ -27,6 +28,54 @@
 #define I2C_TIMED_OUT       0x08
 #define I2C_IN_PROGRESS     0x09
 
+typedef struct I2CTransaction_t I2CTransaction;
+
+/**
+  Called once a queued I2C transaction has finished.
+  This is called from the I2C interrupt, so keep it short and only use I-class
+  ChibiOS functions (chSemSignalI(), for example).
+  \ingroup I2C
+*/
+typedef void (*I2CHandler)(I2CTransaction* t, void* context);
+
+/**
+  An I2C transaction to be run by i2cSubmit() or i2cTransfer().
+  Fill in the device address, and the data to write and/or read.  If both are given,
+  the write is done first, followed by the read.  The fields after \b context
+  are used by the driver.
+  \ingroup I2C
+*/
+struct I2CTransaction_t {
+  uint8_t device;           /**< address of the device to talk to. */
+  uint8_t intAddrLen;       /**< size of the device's internal address (0-3 bytes). */
+  uint32_t internalAddr;    /**< the device's internal address to start at. */
+  const uint8_t* txData;    /**< data to write. */
+  uint16_t txLength;        /**< how much data to write - 0 to only read. */
+  uint8_t* rxData;          /**< where to read data into. */
+  uint16_t rxLength;        /**< how much data to read - 0 to only write. */
+  uint16_t timeout;         /**< milliseconds to wait for each attempt - 0 for \b I2C_DEFAULT_TIMEOUT. */
+  uint8_t retries;          /**< how many times to try again if the device doesn't respond. */
+  I2CHandler onComplete;    /**< (optional) called when the transaction has finished. */
+  void* context;            /**< passed to onComplete. */
+  Semaphore* done;          /**< (optional) signalled when the transaction has finished. */
+  int status;               /**< \b I2C_OK on success - only valid once the transaction has finished. */
+  uint8_t attempts;
+  I2CTransaction* next;
+};
+
+/**
+  Counters for the I2C bus, from i2cGetStats().
+  \ingroup I2C
+*/
+typedef struct {
+  uint32_t transactions;    /**< transactions completed, successfully or not. */
+  uint32_t errors;          /**< transactions that failed. */
+  uint32_t retries;         /**< attempts repeated because the device didn't respond. */
+  uint32_t timeouts;        /**< attempts that timed out. */
+  uint32_t bytes;           /**< data bytes transferred. */
+  uint32_t utilization;     /**< percentage of the time the bus was busy. */
+} I2CStats;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,6 +85,10 @@ void i2cAcquireBus(void);
 void i2cReleaseBus(void);
 int i2cRead(uint8_t deviceAddr, uint8_t *data, uint8_t length, uint16_t internalAddr, uint16_t intAddrLen);
 int i2cWrite(uint8_t deviceAddr, const uint8_t *data, uint8_t length, uint16_t internalAddr, uint16_t intAddrLen);
+int i2cSubmit(I2CTransaction* t);
+int i2cTransfer(I2CTransaction* t);
+int i2cPending(void);
+void i2cGetStats(I2CStats* stats, bool reset);
 #ifdef __cplusplus
 }
 #endif
@@ -34,6 +34,69 @@
 
 #include "config.h"
 
+/*
+   ------------------------------------------------
+   ---------- Profiles (MakingThings) -------------
+   ------------------------------------------------
+   Define one of these in config.h to size the pools for a particular kind
+   of traffic.  Anything a profile sets can still be overridden in config.h.
+   Send /network/stats with the real traffic running to see which pools run
+   out (err goes up) and which never get near their size (max stays low).
+
+   LWIP_PROFILE_OSC  - bursts of small UDP packets, answered quickly.  More
+                       room to queue incoming frames and datagrams, less for TCP.
+   LWIP_PROFILE_HTTP - bulk TCP.  Bigger send buffer and window, with the heap
+                       and segments to back them, fewer spare packet buffers.
+*/
+#if defined(LWIP_PROFILE_OSC)
+#ifndef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE                  24
+#endif
+#ifndef TCPIP_MBOX_SIZE
+#define TCPIP_MBOX_SIZE                 16
+#endif
+#ifndef MEMP_NUM_TCPIP_MSG_INPKT
+#define MEMP_NUM_TCPIP_MSG_INPKT        16
+#endif
+#ifndef MEMP_NUM_TCPIP_MSG_API
+#define MEMP_NUM_TCPIP_MSG_API          12
+#endif
+#ifndef DEFAULT_UDP_RECVMBOX_SIZE
+#define DEFAULT_UDP_RECVMBOX_SIZE       8
+#endif
+#ifndef MEMP_NUM_NETBUF
+#define MEMP_NUM_NETBUF                 8
+#endif
+#ifndef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                3
+#endif
+#ifndef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG                8
+#endif
+#ifndef TCP_WND
+#define TCP_WND                         (2 * TCP_MSS)
+#endif
+#elif defined(LWIP_PROFILE_HTTP)
+#ifndef MEM_SIZE
+#define MEM_SIZE                        6000
+#endif
+#ifndef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE                  12
+#endif
+#ifndef TCP_SND_BUF
+#define TCP_SND_BUF                     (4 * TCP_MSS)
+#endif
+#ifndef TCP_WND
+#define TCP_WND                         (4 * TCP_MSS)
+#endif
+#ifndef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG                24
+#endif
+#ifndef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                6
+#endif
+#endif
+
 /*
    -----------------------------------------------
    ---------- Platform specific locking ----------
@@ -272,7 +335,7 @@
  * (requires NO_SYS==0)
  */
 #ifndef MEMP_NUM_SYS_TIMEOUT
-#define MEMP_NUM_SYS_TIMEOUT            (4 + LWIP_DHCP + LWIP_DNS)
+#define MEMP_NUM_SYS_TIMEOUT            (4 + LWIP_DHCP + (2 * LWIP_DNS)) // lwIP's DNS timer plus the network DNS cache timer
 #endif
 
 /**
@@ -288,7 +351,7 @@
  * (only needed if you use the sequential API, like api_lib.c)
  */
 #ifndef MEMP_NUM_NETCONN
-#define MEMP_NUM_NETCONN                4
+#define MEMP_NUM_NETCONN                6
 #endif
 
 /**
@@ -856,6 +919,18 @@
    ---------- Pbuf options ----------
    ----------------------------------
 */
+/**
+ * LWIP_SUPPORT_CUSTOM_PBUF==1: Support for custom pbufs, which LWIP_EMAC_ZEROCOPY
+ * uses to hand receive buffers back to the EMAC when lwIP is done with them.
+ */
+#ifndef LWIP_SUPPORT_CUSTOM_PBUF
+#if defined(LWIP_EMAC_ZEROCOPY) && LWIP_EMAC_ZEROCOPY
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
+#else
+#define LWIP_SUPPORT_CUSTOM_PBUF        0
+#endif
+#endif
+
 /**
  * PBUF_LINK_HLEN: the number of bytes that should be allocated for a
  * link level header. The default is 14, the standard value for
@@ -1203,7 +1278,7 @@
  * LWIP_SO_RCVTIMEO==1: Enable SO_RCVTIMEO processing.
  */
 #ifndef LWIP_SO_RCVTIMEO
-#define LWIP_SO_RCVTIMEO                0
+#define LWIP_SO_RCVTIMEO                1
 #endif
 
 /**
@@ -1236,7 +1311,7 @@
  * LWIP_STATS==1: Enable statistics collection in lwip_stats.
  */
 #ifndef LWIP_STATS
-#define LWIP_STATS                      0
+#define LWIP_STATS                      1
 #endif
 
 #if LWIP_STATS
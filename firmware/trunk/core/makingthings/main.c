@@ -43,6 +43,11 @@ int main(int argc, char **argv)
 
   chSysInit(); // ChibiOS/RT initialization.
 
+  // needs the RTOS too, and should be loaded before anybody asks for their settings
+  #ifndef NO_SETTINGS_INIT
+  settingsInit();
+  #endif
+
   // would rather not put this below chSysInit() but it relies on the RTOS being setup
   #ifndef NO_AIN_INIT
   analoginInit();
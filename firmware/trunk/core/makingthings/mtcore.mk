@@ -12,11 +12,16 @@ MTCORESRC = ${MT}/board.c \
 						${MT}/usbmouse.c \
 						${MT}/mtspi.c \
 						${MT}/eeprom.c \
+						${MT}/settings.c \
+						${MT}/profiler.c \
+						${MT}/trace.c \
+						${MT}/pool.c \
 						${MT}/i2c.c \
 						${MT}/main.c \
 						${MT}/network.c \
 						${MT}/udpsocket.c \
 						${MT}/tcpsocket.c \
+						${MT}/tcpstream.c \
 						${MT}/tcpserver.c \
 						${MT}/osc.c \
 						${MT}/osc_data.c \
@@ -17,6 +17,7 @@
 
 #include "mtserial.h"
 #include "core.h"
+#include <string.h>
 
 #ifndef SERIAL_DEFAULT_PARITY
 #define SERIAL_DEFAULT_PARITY 0
@@ -34,6 +35,59 @@
 #define SERIAL_DEFAULT_HANDSHAKE NO
 #endif
 
+#ifndef SERIAL_DEFAULT_MODE
+#define SERIAL_DEFAULT_MODE SERIAL_MODE_IRQ
+#endif
+
+#ifndef SERIAL_DMA_BUFFER_SIZE
+#define SERIAL_DMA_BUFFER_SIZE 64
+#endif
+
+#ifndef SERIAL_DMA_RX_TIMEOUT
+#define SERIAL_DMA_RX_TIMEOUT 20 // bit periods of idle line before handing partial buffers up
+#endif
+
+#define SERIAL_PORTS 3
+
+/*
+  State for a port running in SERIAL_MODE_DMA.  The PDC fills one receive buffer
+  while the other is queued behind it - we only get an interrupt when a buffer fills
+  up or the line goes idle, at which point the bytes are handed to the SerialDriver's
+  input queue so serialRead() and friends keep working as usual.  Writes go straight
+  from the caller's buffer via the PDC.
+*/
+typedef struct {
+  AT91PS_USART usart;
+  int baud;
+  int rxcur;                                  // which rxbuf the PDC is currently filling
+  uint8_t rxbuf[2][SERIAL_DMA_BUFFER_SIZE];
+  Semaphore txdone;
+  Mutex txlock;
+} SerialDma;
+
+typedef struct {
+  bool dma;
+  SerialStats stats;
+} SerialPortInfo;
+
+static SerialPortInfo serialPorts[SERIAL_PORTS];
+#if USE_SAM7_USART0
+static SerialDma serialDma0;
+CH_IRQ_HANDLER(USART0IrqHandler);
+#endif
+#if USE_SAM7_USART1
+static SerialDma serialDma1;
+CH_IRQ_HANDLER(USART1IrqHandler);
+#endif
+
+static int serialIndex(Serial port);
+static SerialDma* serialDmaFor(Serial port);
+static void serialDmaStart(Serial port, SerialDma* d, int baud, uint32_t mode);
+static void serialIrqStart(Serial port);
+static void serialIrqOverruns(Serial port, SerialPortInfo* info);
+static void serialDmaStop(Serial port, SerialDma* d);
+static int serialDmaWrite(Serial port, SerialDma* d, char const* buf, int len, int timeout);
+
 /**
   \defgroup serial Serial
   Read and write bytes over the serial port.
@@ -83,6 +137,22 @@
   Normally, support for the debug serial port (SerialDbg) on the Make Controller is not built in, but you
   can include it by adding the line \code #define USE_SAM7_DBGU_UART 1 \endcode to your config.h file.
 
+  \section DMA DMA Mode
+  By default each received and transmitted character costs an interrupt.  That's fine at low speeds, but
+  at 230400 baud and up - or with several busy ports - the interrupt load starts to add up.  Serial0 and
+  Serial1 can instead be run in \b SERIAL_MODE_DMA, selected by the last argument to serialEnableAll().
+  In this mode the USART's PDC channels move the data: received bytes land in one of two
+  \b SERIAL_DMA_BUFFER_SIZE byte buffers (64 by default), and are handed up when a buffer fills or when the
+  line has been quiet for \b SERIAL_DMA_RX_TIMEOUT bit periods (20 by default).  Writes are sent straight
+  out of your buffer, so serialWrite() returns once the data is on its way out.
+  serialRead(), serialAvailable() and the rest work exactly the same in either mode.
+
+  \code
+  serialEnableAll(Serial0, 460800, 0, 8, 1, NO, SERIAL_MODE_DMA);
+  \endcode
+
+  Use serialGetStats() to see how much data has moved through a port and whether any was lost.
+
   \ingroup interfacing
   @{
 */
@@ -96,6 +166,7 @@
   - SERIAL_DEFAULT_CHARBITS 8
   - SERIAL_DEFAULT_STOPBITS 1
   - SERIAL_DEFAULT_HANDSHAKE NO
+  - SERIAL_DEFAULT_MODE SERIAL_MODE_IRQ
 
   @param port Which serial port - valid options are Serial0, Serial1, or SerialDbg.
   @param baud The rate of this serial port - common options are 9600, 34800, 57600, 115200.
@@ -103,7 +174,7 @@
 void serialEnable(Serial port, int baud)
 {
   serialEnableAll(port, baud, SERIAL_DEFAULT_PARITY, SERIAL_DEFAULT_CHARBITS,
-                SERIAL_DEFAULT_STOPBITS, SERIAL_DEFAULT_HANDSHAKE);
+                SERIAL_DEFAULT_STOPBITS, SERIAL_DEFAULT_HANDSHAKE, SERIAL_DEFAULT_MODE);
 }
 
 /**
@@ -114,43 +185,53 @@ void serialEnable(Serial port, int baud)
   @param charbits The number of bits in a character - valid options are 5-8, default is 8.
   @param stopbits The stop bits per character - valid options are 1 or 2, 1 is the default.
   @param handshake Whether hardware handshake is enabled.
+  @param mode SERIAL_MODE_IRQ (the default) or SERIAL_MODE_DMA - see \ref DMA.  SerialDbg only supports SERIAL_MODE_IRQ.
 
   \b Example
   \code
   // set up port 0 for 9600 baud
-  serialEnable(Serial0, 9600, 0, 8, 1, NO);
+  serialEnableAll(Serial0, 9600, 0, 8, 1, NO, SERIAL_MODE_IRQ);
   \endcode
 */
-void serialEnableAll(Serial port, int baud, int parity, int charbits, int stopbits, bool handshake)
+void serialEnableAll(Serial port, int baud, int parity, int charbits, int stopbits, bool handshake, int mode)
 {
-  SerialConfig config = {
-    baud,
-    AT91C_US_CLKS_CLOCK |
+  uint32_t mr = AT91C_US_CLKS_CLOCK |
     (handshake ? AT91C_US_USMODE_HWHSH : AT91C_US_USMODE_NORMAL) |
     (((charbits - 5) << 6) & AT91C_US_CHRL) |
     (stopbits == 2 ? AT91C_US_NBSTOP_2_BIT : AT91C_US_NBSTOP_1_BIT) |
-    (parity == 0 ? AT91C_US_PAR_NONE : (parity == -1 ? AT91C_US_PAR_ODD : AT91C_US_PAR_EVEN))
-  };
+    (parity == 0 ? AT91C_US_PAR_NONE : (parity == -1 ? AT91C_US_PAR_ODD : AT91C_US_PAR_EVEN));
+  SerialConfig config = { baud, mr };
+  SerialDma* dma = (mode == SERIAL_MODE_DMA) ? serialDmaFor(port) : 0;
 
 #if USE_SAM7_USART0
-  if (port == Serial0 && Serial0->state < SD_READY) {
+  if (port == Serial0 && Serial0->state < SD_READY && !serialPorts[0].dma) {
     if (handshake == YES) {
       AT91C_BASE_PIOA->PIO_PDR   = AT91C_PA3_RTS0 | AT91C_PA4_CTS0;
       AT91C_BASE_PIOA->PIO_ASR   = AT91C_PA3_RTS0 | AT91C_PA4_CTS0;
       AT91C_BASE_PIOA->PIO_PPUDR = AT91C_PA3_RTS0 | AT91C_PA4_CTS0;
     }
-    sdStart(Serial0, &config);
+    if (dma)
+      serialDmaStart(Serial0, dma, baud, mr);
+    else {
+      serialIrqStart(Serial0);
+      sdStart(Serial0, &config);
+    }
   }
 #endif
 #if USE_SAM7_USART1
-  if (port == Serial1 && Serial1->state < SD_READY) {
+  if (port == Serial1 && Serial1->state < SD_READY && !serialPorts[1].dma) {
     // careful - PA8/PA9 are SPI/EEPROM CS lines, but include these if you need them
     if (handshake == YES) {
       AT91C_BASE_PIOA->PIO_PDR   = AT91C_PA8_RTS1 | AT91C_PA9_CTS1;
       AT91C_BASE_PIOA->PIO_ASR   = AT91C_PA8_RTS1 | AT91C_PA9_CTS1;
       AT91C_BASE_PIOA->PIO_PPUDR = AT91C_PA8_RTS1 | AT91C_PA9_CTS1;
     }
-    sdStart(Serial1, &config);
+    if (dma)
+      serialDmaStart(Serial1, dma, baud, mr);
+    else {
+      serialIrqStart(Serial1);
+      sdStart(Serial1, &config);
+    }
   }
 #endif
 #if USE_SAM7_DBGU_UART
@@ -167,7 +248,13 @@ void serialEnableAll(Serial port, int baud, int parity, int charbits, int stopbi
 */
 void serialDisable(Serial port)
 {
-  sdStop(port);
+  int idx = serialIndex(port);
+  if (serialPorts[idx].dma) {
+    serialDmaStop(port, serialDmaFor(port));
+    serialPorts[idx].dma = false;
+  }
+  else
+    sdStop(port);
 }
 
 /**
@@ -208,7 +295,11 @@ int serialAvailable(Serial port)
 */
 int serialRead(Serial port, char* buf, int len, int timeout)
 {
-  return sdReadTimeout(port, (uint8_t*)buf, (size_t)len, (systime_t)timeout);
+  SerialPortInfo* info = &serialPorts[serialIndex(port)];
+  int got = sdReadTimeout(port, (uint8_t*)buf, (size_t)len, (systime_t)timeout);
+  info->stats.rxBytes += got;
+  serialIrqOverruns(port, info);
+  return got;
 }
 
 /**
@@ -220,7 +311,12 @@ int serialRead(Serial port, char* buf, int len, int timeout)
 */
 char serialGet(Serial port, int timeout)
 {
-  return sdGetTimeout(port, (systime_t)timeout);
+  SerialPortInfo* info = &serialPorts[serialIndex(port)];
+  msg_t c = sdGetTimeout(port, (systime_t)timeout);
+  if (c >= 0)
+    info->stats.rxBytes++;
+  serialIrqOverruns(port, info);
+  return c;
 }
 
 /**
@@ -243,7 +339,14 @@ char serialGet(Serial port, int timeout)
 */
 int serialWrite(Serial port, char const* buf, int len, int timeout)
 {
-  return sdWriteTimeout(port, (uint8_t*)buf, (size_t)len, (systime_t)timeout);
+  SerialPortInfo* info = &serialPorts[serialIndex(port)];
+  int wrote;
+  if (info->dma)
+    wrote = serialDmaWrite(port, serialDmaFor(port), buf, len, timeout);
+  else
+    wrote = sdWriteTimeout(port, (uint8_t*)buf, (size_t)len, (systime_t)timeout);
+  info->stats.txBytes += wrote;
+  return wrote;
 }
 
 /**
@@ -255,7 +358,262 @@ int serialWrite(Serial port, char const* buf, int len, int timeout)
 */
 int serialPut(Serial port, char c, int timeout)
 {
-  return sdPutTimeout(port, (uint8_t)c, (systime_t)timeout);
+  SerialPortInfo* info = &serialPorts[serialIndex(port)];
+  if (info->dma)
+    return (serialWrite(port, &c, 1, timeout) == 1) ? Q_OK : Q_TIMEOUT;
+  msg_t rv = sdPutTimeout(port, (uint8_t)c, (systime_t)timeout);
+  if (rv == Q_OK)
+    info->stats.txBytes++;
+  return rv;
+}
+
+/**
+  Read the traffic counters for a serial port.
+  Byte counts include everything that has gone through serialRead(), serialGet(), serialWrite() and
+  serialPut() since the port was enabled or the counters were last reset.  \b overruns counts the times
+  the USART lost characters because they weren't collected in time - in \b SERIAL_MODE_IRQ, overruns between two
+  reads only count once.  \b dropped counts characters that arrived while the receive queue was full - if either
+  is climbing, read more often or grow \b SERIAL_BUFFERS_SIZE.
+  @param port Which serial port - valid options are Serial0, Serial1, or SerialDbg.
+  @param stats The SerialStats to fill in.
+  @param reset Whether to zero the counters once they've been read.
+
+  \b Example
+  \code
+  SerialStats stats;
+  serialGetStats(Serial0, &stats, NO);
+  if (stats.overruns > 0) {
+    // we're losing data
+  }
+  \endcode
+*/
+void serialGetStats(Serial port, SerialStats* stats, bool reset)
+{
+  SerialPortInfo* info = &serialPorts[serialIndex(port)];
+  serialIrqOverruns(port, info);
+  chSysLock();
+  *stats = info->stats;
+  if (reset)
+    memset(&info->stats, 0, sizeof(SerialStats));
+  chSysUnlock();
 }
 
 /** @} */
+
+static int serialIndex(Serial port)
+{
+  if (port == Serial0)
+    return 0;
+  if (port == Serial1)
+    return 1;
+  return 2;
+}
+
+static SerialDma* serialDmaFor(Serial port)
+{
+#if USE_SAM7_USART0
+  if (port == Serial0)
+    return &serialDma0;
+#endif
+#if USE_SAM7_USART1
+  if (port == Serial1)
+    return &serialDma1;
+#endif
+  return 0;
+}
+
+/*
+  Move count bytes from a finished DMA buffer into the driver's input queue.
+  Called from the ISR with the system locked.
+*/
+static void serialDmaPushI(Serial port, const uint8_t* data, int count)
+{
+  SerialStats* stats = &serialPorts[serialIndex(port)].stats;
+  while (count--) {
+    if (chIQPutI(&port->iqueue, *data++) == Q_FULL)
+      stats->dropped++;
+  }
+}
+
+static void serialDmaServe(Serial port, SerialDma* d)
+{
+  AT91PS_USART u = d->usart;
+  uint32_t csr = u->US_CSR & u->US_IMR;
+
+  chSysLockFromIsr();
+  if (csr & AT91C_US_OVRE) {
+    serialPorts[serialIndex(port)].stats.overruns++;
+    u->US_CR = AT91C_US_RSTSTA;
+  }
+  if (csr & AT91C_US_ENDRX) {
+    // the current buffer filled and the PDC has already moved on to the next one -
+    // hand this one up and queue it behind the other
+    serialDmaPushI(port, d->rxbuf[d->rxcur], SERIAL_DMA_BUFFER_SIZE);
+    u->US_RNPR = (uint32_t)d->rxbuf[d->rxcur];
+    u->US_RNCR = SERIAL_DMA_BUFFER_SIZE;
+    d->rxcur ^= 1;
+  }
+  if (csr & AT91C_US_TIMEOUT) {
+    // the line went quiet partway through a buffer - hand up what we have and restart it
+    u->US_PTCR = AT91C_PDC_RXTDIS;
+    int count = SERIAL_DMA_BUFFER_SIZE - u->US_RCR;
+    if (count > 0)
+      serialDmaPushI(port, d->rxbuf[d->rxcur], count);
+    u->US_RPR = (uint32_t)d->rxbuf[d->rxcur];
+    u->US_RCR = SERIAL_DMA_BUFFER_SIZE;
+    u->US_PTCR = AT91C_PDC_RXTEN;
+    u->US_CR = AT91C_US_STTTO; // don't time out again until the next character arrives
+  }
+  if (csr & AT91C_US_ENDTX) {
+    u->US_IDR = AT91C_US_ENDTX;
+    chSemSignalI(&d->txdone);
+  }
+  chSysUnlockFromIsr();
+}
+
+#if USE_SAM7_USART0
+static CH_IRQ_HANDLER(serialDma0ISR) {
+  CH_IRQ_PROLOGUE();
+  serialDmaServe(Serial0, &serialDma0);
+  AT91C_BASE_AIC->AIC_EOICR = 0;
+  CH_IRQ_EPILOGUE();
+}
+#endif
+
+#if USE_SAM7_USART1
+static CH_IRQ_HANDLER(serialDma1ISR) {
+  CH_IRQ_PROLOGUE();
+  serialDmaServe(Serial1, &serialDma1);
+  AT91C_BASE_AIC->AIC_EOICR = 0;
+  CH_IRQ_EPILOGUE();
+}
+#endif
+
+/*
+  In SERIAL_MODE_IRQ, the ChibiOS driver just raises SD_OVERRUN_ERROR when characters are
+  lost, so all we can tell is that some were lost since we last looked.  Look on every read
+  as well as in serialGetStats(), so a port that's read regularly gets a useful count.
+*/
+static void serialIrqOverruns(Serial port, SerialPortInfo* info)
+{
+  if (!info->dma && (sdGetAndClearFlags(port) & SD_OVERRUN_ERROR))
+    info->stats.overruns++;
+}
+
+static void serialIrqStart(Serial port)
+{
+  memset(&serialPorts[serialIndex(port)].stats, 0, sizeof(SerialStats));
+}
+
+/*
+  Take the USART over from the ChibiOS driver and run it from the PDC.
+  The SerialDriver's input queue is still used, so reads don't need to know the difference.
+*/
+static void serialDmaStart(Serial port, SerialDma* d, int baud, uint32_t mode)
+{
+  uint32_t id = 0;
+  uint32_t pins = 0;
+  void (*isr)(void) = 0;
+#if USE_SAM7_USART0
+  if (port == Serial0) {
+    d->usart = AT91C_BASE_US0;
+    id = AT91C_ID_US0;
+    pins = AT91C_PA0_RXD0 | AT91C_PA1_TXD0;
+    isr = serialDma0ISR;
+  }
+#endif
+#if USE_SAM7_USART1
+  if (port == Serial1) {
+    d->usart = AT91C_BASE_US1;
+    id = AT91C_ID_US1;
+    pins = AT91C_PA5_RXD1 | AT91C_PA6_TXD1;
+    isr = serialDma1ISR;
+  }
+#endif
+  AT91PS_USART u = d->usart;
+  chSemInit(&d->txdone, 0);
+  chMtxInit(&d->txlock);
+  d->baud = baud;
+  d->rxcur = 0;
+  chSysLock();
+  chIQResetI(&port->iqueue);
+  chSysUnlock();
+
+  AT91C_BASE_PIOA->PIO_PDR   = pins;
+  AT91C_BASE_PIOA->PIO_ASR   = pins;
+  AT91C_BASE_PIOA->PIO_PPUDR = pins;
+  AT91C_BASE_PMC->PMC_PCER = (1 << id);
+
+  u->US_CR = AT91C_US_RSTRX | AT91C_US_RSTTX | AT91C_US_RSTSTA;
+  u->US_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+  u->US_MR = mode;
+  u->US_BRGR = ((MCK / baud) >> 4);
+  u->US_RTOR = SERIAL_DMA_RX_TIMEOUT;
+  u->US_IDR = 0xFFFFFFFF;
+
+  u->US_RPR = (uint32_t)d->rxbuf[0];
+  u->US_RCR = SERIAL_DMA_BUFFER_SIZE;
+  u->US_RNPR = (uint32_t)d->rxbuf[1];
+  u->US_RNCR = SERIAL_DMA_BUFFER_SIZE;
+  u->US_PTCR = AT91C_PDC_RXTEN;
+
+  AIC_ConfigureIT(id, AT91C_AIC_SRCTYPE_HIGH_LEVEL | (AT91C_AIC_PRIOR_HIGHEST - 2), isr);
+  AIC_EnableIT(id);
+  u->US_IER = AT91C_US_ENDRX | AT91C_US_TIMEOUT | AT91C_US_OVRE;
+  u->US_CR = AT91C_US_RXEN | AT91C_US_TXEN | AT91C_US_STTTO;
+
+  memset(&serialPorts[serialIndex(port)].stats, 0, sizeof(SerialStats));
+  serialPorts[serialIndex(port)].dma = true;
+}
+
+/*
+  Shut the PDC down and give the USART back to the ChibiOS driver, so a later
+  sdStart() on this port works as normal.
+*/
+static void serialDmaStop(Serial port, SerialDma* d)
+{
+  AT91PS_USART u = d->usart;
+  uint32_t id = (u == AT91C_BASE_US0) ? AT91C_ID_US0 : AT91C_ID_US1;
+  u->US_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+  u->US_IDR = 0xFFFFFFFF;
+  u->US_CR = AT91C_US_RSTRX | AT91C_US_RSTTX | AT91C_US_RXDIS | AT91C_US_TXDIS;
+  AIC_DisableIT(id);
+  AT91C_BASE_PMC->PMC_PCDR = (1 << id);
+#if USE_SAM7_USART0
+  if (port == Serial0)
+    AIC_ConfigureIT(id, AT91C_AIC_SRCTYPE_HIGH_LEVEL | SAM7_USART0_PRIORITY, USART0IrqHandler);
+#endif
+#if USE_SAM7_USART1
+  if (port == Serial1)
+    AIC_ConfigureIT(id, AT91C_AIC_SRCTYPE_HIGH_LEVEL | SAM7_USART1_PRIORITY, USART1IrqHandler);
+#endif
+}
+
+/*
+  Send straight out of the caller's buffer and wait for the PDC to finish.
+  IMMEDIATE can't mean "don't wait" here since we don't copy the data, so it
+  waits as long as the transfer should take at the current baud rate.
+*/
+static int serialDmaWrite(Serial port, SerialDma* d, char const* buf, int len, int timeout)
+{
+  UNUSED(port);
+  AT91PS_USART u = d->usart;
+  if (len <= 0)
+    return 0;
+  if (timeout == IMMEDIATE)
+    timeout = ((len * 10 * 1000) / d->baud) + 2;
+
+  chMtxLock(&d->txlock);
+  chSemReset(&d->txdone, 0);
+  u->US_TPR = (uint32_t)buf;
+  u->US_TCR = len;
+  u->US_PTCR = AT91C_PDC_TXTEN;
+  u->US_IER = AT91C_US_ENDTX;
+  if (chSemWaitTimeout(&d->txdone, (timeout == FOREVER) ? TIME_INFINITE : MS2ST(timeout)) != RDY_OK) {
+    u->US_PTCR = AT91C_PDC_TXTDIS;
+    u->US_IDR = AT91C_US_ENDTX;
+  }
+  int sent = len - u->US_TCR;
+  chMtxUnlock();
+  return sent;
+}
@@ -28,17 +28,32 @@ typedef SerialDriver* Serial;
 #define Serial1    (&SD2) /**< symbol for serial port 1 */
 #define SerialDbg  (&SD3) /**< symbol for the debug serial port */
 
+#define SERIAL_MODE_IRQ 0 /**< an interrupt per character - the default */
+#define SERIAL_MODE_DMA 1 /**< move data with the PDC, interrupting only per buffer */
+
+/**
+  Traffic counters for a serial port, from serialGetStats().
+  \ingroup serial
+*/
+typedef struct {
+  uint32_t rxBytes;   /**< bytes read from the port. */
+  uint32_t txBytes;   /**< bytes written to the port. */
+  uint32_t overruns;  /**< times the USART lost characters before they could be collected. */
+  uint32_t dropped;   /**< characters lost because the receive queue was full. */
+} SerialStats;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 void serialEnable(Serial port, int baud);
-void serialEnableAll(Serial port, int baud, int parity, int charbits, int stopbits, bool handshake);
+void serialEnableAll(Serial port, int baud, int parity, int charbits, int stopbits, bool handshake, int mode);
 void serialDisable(Serial port);
 int  serialAvailable(Serial port);
 int  serialRead(Serial port, char* buf, int len, int timeout);
 char serialGet(Serial port, int timeout);
 int  serialWrite(Serial port, char const* buf, int len, int timeout);
 int  serialPut(Serial port, char c, int timeout);
+void serialGetStats(Serial port, SerialStats* stats, bool reset);
 #ifdef __cplusplus
 }
 #endif
@@ -35,6 +35,18 @@
 #define SPI_SEL2_MODE PERIPHERAL_B
 #define SPI_SEL3_MODE PERIPHERAL_B
 
+#ifndef SPI_DMA_THRESHOLD
+#define SPI_DMA_THRESHOLD 8 // transfers shorter than this use the byte loop
+#endif
+
+#define SPI_CHANNELS 4
+
+// variable peripheral select - the chip select is given with each byte written to TDR
+#define SPI_MR_VARIABLE (AT91C_SPI_MSTR | AT91C_SPI_PS_VARIABLE | AT91C_SPI_PCS | AT91C_SPI_MODFDIS)
+// fixed peripheral select - used while the PDC is running so it can move plain bytes
+#define SPI_MR_FIXED(csn) (AT91C_SPI_MSTR | AT91C_SPI_PS_FIXED | AT91C_SPI_MODFDIS | \
+                          ((~(1 << (csn)) << 16) & AT91C_SPI_PCS))
+
 /** 
   \defgroup SPI
   Communicate with peripheral devices via SPI.
@@ -44,15 +56,70 @@
   
   \b Note - the SPI routines are not thread-safe.  If you're going to be using them from different
   threads, use the spiLock() and spiUnlock() routines to get exclusive access.
+
+  \section DMA DMA Transfers
+  Transfers of \b SPI_DMA_THRESHOLD bytes or more (8 by default) are handed to the SPI's PDC, and the
+  calling thread sleeps until they're done rather than spinning on the status register.  For a 64 byte
+  EEPROM read at the default clock that's the difference between the CPU being tied up for the whole
+  transfer and being tied up only long enough to start it and collect the result - other threads run
+  in between.  Shorter transfers aren't worth the setup, so they still use the byte loop.
+
+  If you don't want to wait at all, use spiReadWriteBlockAsync() to queue an SpiTransaction.  Each chip select
+  has its own queue, and the queues are served in turn, so a long stream to one device doesn't starve another.
   \ingroup interfacing
   @{
 */
 
+/*
+  Transactions waiting on a Spi device, one FIFO per chip select.
+  current is the transaction the PDC is running right now, if any.
+*/
+typedef struct {
+  Spi spi;
+  SpiTransaction* head[SPI_CHANNELS];
+  SpiTransaction* tail[SPI_CHANNELS];
+  SpiTransaction* current;
+  int nextcsn;
+} SpiQueue;
+
 static Mutex spi0Mutex;
+static SpiQueue spi0Queue;
 #if USE_SPI1
 static Mutex spi1Mutex;
+static SpiQueue spi1Queue;
 #endif
 
+static void spiServeInterrupt(SpiQueue* q);
+static void spiStartTransaction(SpiQueue* q, SpiTransaction* t);
+static void spiSignalComplete(SpiTransaction* t, void* context);
+
+static CH_IRQ_HANDLER(spi0ISR) {
+  CH_IRQ_PROLOGUE();
+  spiServeInterrupt(&spi0Queue);
+  AT91C_BASE_AIC->AIC_EOICR = 0;
+  CH_IRQ_EPILOGUE();
+}
+
+#if USE_SPI1
+static CH_IRQ_HANDLER(spi1ISR) {
+  CH_IRQ_PROLOGUE();
+  spiServeInterrupt(&spi1Queue);
+  AT91C_BASE_AIC->AIC_EOICR = 0;
+  CH_IRQ_EPILOGUE();
+}
+#endif
+
+static SpiQueue* spiGetQueue(Spi spi)
+{
+  if (spi == Spi0)
+    return &spi0Queue;
+  #if USE_SPI1
+  else if (spi == Spi1)
+    return &spi1Queue;
+  #endif
+  return 0;
+}
+
 static int spiGetPin(int channel)
 {
   switch (channel) {
@@ -91,7 +158,12 @@ void spiInit()
   AT91C_BASE_SPI0->SPI_CR = AT91C_SPI_SWRST;      // two resets to account for errata
   AT91C_BASE_SPI0->SPI_CR = AT91C_SPI_SWRST;
   AT91C_BASE_SPI0->SPI_IDR = 0x3FF;               // All interrupts are off
+  AT91C_BASE_SPI0->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+  AT91C_BASE_SPI0->SPI_MR = SPI_MR_VARIABLE;
   AT91C_BASE_SPI0->SPI_CR = AT91C_SPI_SPIEN;      // enable the device
+  spi0Queue.spi = Spi0;
+  AIC_ConfigureIT(AT91C_ID_SPI0, AT91C_AIC_SRCTYPE_INT_HIGH_LEVEL | (AT91C_AIC_PRIOR_HIGHEST - 4), spi0ISR);
+  AIC_EnableIT(AT91C_ID_SPI0);
 
   #if USE_SPI1
   chMtxInit(&spi1Mutex);
@@ -99,7 +171,12 @@ void spiInit()
   AT91C_BASE_SPI1->SPI_CR = AT91C_SPI_SWRST;
   AT91C_BASE_SPI1->SPI_CR = AT91C_SPI_SWRST;
   AT91C_BASE_SPI1->SPI_IDR = 0x3FF;
+  AT91C_BASE_SPI1->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+  AT91C_BASE_SPI1->SPI_MR = SPI_MR_VARIABLE;
   AT91C_BASE_SPI1->SPI_CR = AT91C_SPI_SPIEN;
+  spi1Queue.spi = Spi1;
+  AIC_ConfigureIT(AT91C_ID_SPI1, AT91C_AIC_SRCTYPE_INT_HIGH_LEVEL | (AT91C_AIC_PRIOR_HIGHEST - 4), spi1ISR);
+  AIC_EnableIT(AT91C_ID_SPI1);
   #endif
 }
 
@@ -149,10 +226,11 @@ int spiConfigure(Spi spi, int csn, int bits, int clockDivider, int delayBeforeSP
     pinSetMode(spiGetPin(csn), spiGetMode(csn));
 
   // DON'T USE FDIV FLAG - it makes the SPI unit fail!!
-  spi->SPI_MR = AT91C_SPI_MSTR |         // Select the master
-                AT91C_SPI_PS_VARIABLE |
-                AT91C_SPI_PCS |         // Variable Addressing - can address different chip select each transfer
-                AT91C_SPI_MODFDIS;      // Disable fault detect
+  // Variable Addressing - can address different chip select each transfer.
+  // Leave it alone if the PDC is mid-transfer, it'll be restored once it's done.
+  SpiQueue* q = spiGetQueue(spi);
+  if (q && !q->current)
+    spi->SPI_MR = SPI_MR_VARIABLE;
 
   spi->SPI_CSR[csn] =
         AT91C_SPI_NCPHA | // Clock Phase TRUE
@@ -170,6 +248,9 @@ int spiConfigure(Spi spi, int csn, int bits, int clockDivider, int delayBeforeSP
   Spi always involves a two-way transfer, so this writes the data originally
   contained in \b buffer and reads the response data back into \b buffer.
 
+  Transfers of \b SPI_DMA_THRESHOLD bytes or more are run by the PDC, and the calling
+  thread sleeps until they're done - see \ref DMA.
+
   The chip select is specified in spiConfigure() - if you need to communicate
   with another device on the same device, you need to reconfigure it via spiConfigure().
   @param spi Which SPI device - options are \b Spi0 or \b Spi1
@@ -189,6 +270,22 @@ int spiConfigure(Spi spi, int csn, int bits, int clockDivider, int delayBeforeSP
 */
 int spiReadWriteBlock(Spi spi, int csn, unsigned char* buffer, int count)
 {
+  SpiQueue* q = spiGetQueue(spi);
+  if (q && (count >= SPI_DMA_THRESHOLD || q->current)) {
+    Semaphore done;
+    SpiTransaction t;
+    chSemInit(&done, 0);
+    t.csn = csn;
+    t.buffer = buffer;
+    t.count = count;
+    t.onComplete = spiSignalComplete;
+    t.context = &done;
+    int rv = spiReadWriteBlockAsync(spi, &t);
+    if (rv == CONTROLLER_OK)
+      chSemWait(&done);
+    return rv;
+  }
+
   while (count--) {
     // write byte of data, if last one set AT91C_SPI_LASTXFER
     spi->SPI_TDR = (*buffer & 0xFF) |
@@ -206,6 +303,135 @@ int spiReadWriteBlock(Spi spi, int csn, unsigned char* buffer, int count)
   return 0;
 }
 
+/**
+  Queue a block transfer to be run by the PDC, and return right away.
+  The transaction is added to the queue for its chip select, and started as soon as the
+  Spi device is free.  Once it's done, its \b onComplete handler is called.  The handler runs
+  from the SPI interrupt, so keep it short and only use the I-class ChibiOS calls in it
+  (chSemSignalI(), for example).
+
+  The SpiTransaction and its buffer need to stick around until the handler has been called,
+  so don't use local variables unless you wait for the result.  Like the rest of the SPI
+  routines, call this while holding spiLock() if other threads use this Spi device.
+  @param spi Which SPI device - options are \b Spi0 or \b Spi1
+  @param t The transaction to queue - set its csn, buffer, count, and optionally onComplete and context.
+  @return 0 on success, non-zero on failure.
+
+  \b Example
+  \code
+  static unsigned char adcbuf[32];
+  static SpiTransaction adcread;
+
+  void onAdcRead(SpiTransaction* t, void* context)
+  {
+    // adcbuf now holds the response
+  }
+
+  adcread.csn = 2;
+  adcread.buffer = adcbuf;
+  adcread.count = sizeof(adcbuf);
+  adcread.onComplete = onAdcRead;
+  adcread.context = 0;
+  spiLock(Spi0);
+  spiReadWriteBlockAsync(Spi0, &adcread);
+  spiUnlock();
+  \endcode
+*/
+int spiReadWriteBlockAsync(Spi spi, SpiTransaction* t)
+{
+  SpiQueue* q = spiGetQueue(spi);
+  if (!q || t->csn < 0 || t->csn >= SPI_CHANNELS || t->count <= 0)
+    return CONTROLLER_ERROR_ILLEGAL_PARAMETER_VALUE;
+
+  t->next = 0;
+  chSysLock();
+  if (!q->current)
+    spiStartTransaction(q, t);
+  else {
+    if (q->tail[t->csn])
+      q->tail[t->csn]->next = t;
+    else
+      q->head[t->csn] = t;
+    q->tail[t->csn] = t;
+  }
+  chSysUnlock();
+  return CONTROLLER_OK;
+}
+
+/*
+  Wake up a thread waiting in spiReadWriteBlock().
+*/
+static void spiSignalComplete(SpiTransaction* t, void* context)
+{
+  UNUSED(t);
+  chSemSignalI((Semaphore*)context);
+}
+
+/*
+  Hand a transaction to the PDC.  Called with the system locked.
+  The SPI is switched to fixed peripheral select for the duration, so the
+  PDC can move plain bytes rather than words tagged with a chip select.
+*/
+static void spiStartTransaction(SpiQueue* q, SpiTransaction* t)
+{
+  Spi spi = q->spi;
+  q->current = t;
+  spi->SPI_MR = SPI_MR_FIXED(t->csn);
+  (void)spi->SPI_RDR; // make sure nothing stale is waiting to be picked up
+  spi->SPI_RPR = (uint32_t)t->buffer;
+  spi->SPI_RCR = t->count;
+  spi->SPI_TPR = (uint32_t)t->buffer; // safe in place - each byte is sent before its reply lands
+  spi->SPI_TCR = t->count;
+  spi->SPI_IER = AT91C_SPI_ENDRX;
+  spi->SPI_PTCR = AT91C_PDC_RXTEN | AT91C_PDC_TXTEN;
+}
+
+/*
+  Pick the next transaction, taking each chip select's queue in turn.
+*/
+static SpiTransaction* spiNextTransaction(SpiQueue* q)
+{
+  int i;
+  for (i = 0; i < SPI_CHANNELS; i++) {
+    int csn = (q->nextcsn + i) % SPI_CHANNELS;
+    SpiTransaction* t = q->head[csn];
+    if (t) {
+      q->head[csn] = t->next;
+      if (!q->head[csn])
+        q->tail[csn] = 0;
+      q->nextcsn = (csn + 1) % SPI_CHANNELS;
+      return t;
+    }
+  }
+  return 0;
+}
+
+/*
+  The last byte of the current transaction has arrived - release the chip select,
+  start the next transaction, and let whoever queued this one know it's done.
+*/
+static void spiServeInterrupt(SpiQueue* q)
+{
+  Spi spi = q->spi;
+  if (!(spi->SPI_SR & spi->SPI_IMR & AT91C_SPI_ENDRX))
+    return;
+
+  spi->SPI_IDR = AT91C_SPI_ENDRX;
+  spi->SPI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+  spi->SPI_CR = AT91C_SPI_LASTXFER; // CSAAT holds the chip select low until we say we're done
+  spi->SPI_MR = SPI_MR_VARIABLE;
+
+  chSysLockFromIsr();
+  SpiTransaction* done = q->current;
+  q->current = 0;
+  SpiTransaction* next = spiNextTransaction(q);
+  if (next)
+    spiStartTransaction(q, next);
+  if (done && done->onComplete)
+    done->onComplete(done, done->context);
+  chSysUnlockFromIsr();
+}
+
 /**
   Get exclusive access to the Spi system.
   @param spi Which SPI device - options are \b Spi0 or \b Spi1
@@ -24,6 +24,22 @@ typedef AT91S_SPI* Spi;
 #define Spi0 AT91C_BASE_SPI0
 #define Spi1 AT91C_BASE_SPI1
 
+typedef struct SpiTransaction_t SpiTransaction;
+typedef void (*SpiHandler)(SpiTransaction* t, void* context);
+
+/**
+  A block transfer to be run by the PDC - see spiReadWriteBlockAsync().
+  \ingroup SPI
+*/
+struct SpiTransaction_t {
+  int csn;                /**< Which chip select line - 0-3. */
+  unsigned char* buffer;  /**< The data to write, which is replaced by the data read back. */
+  int count;              /**< The number of bytes to exchange. */
+  SpiHandler onComplete;  /**< Called from the SPI interrupt once the transfer is done, or 0. */
+  void* context;          /**< Passed to \b onComplete. */
+  SpiTransaction* next;   /**< Used internally to queue transactions. */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +47,7 @@ void spiInit(void);
 void spiDisable(Spi spi);
 int  spiConfigure(Spi spi, int csn, int bits, int clockDivider, int delayBeforeSPCK, int delayBetweenTransfers);
 int  spiReadWriteBlock(Spi spi, int csn, unsigned char* buffer, int count);
+int  spiReadWriteBlockAsync(Spi spi, SpiTransaction* t);
 
 void spiLock(Spi spi);
 void spiUnlock(void);
@@ -9,9 +9,11 @@
 #include "lwipthread.h"
 #include "lwip/dhcp.h"
 #include "lwip/dns.h"
+#include "lwip/tcpip.h"
 #include "lwip/sockets.h"
 #include "lwip/netif.h"
 #include "lwip/netifapi.h"
+#include "lwip/stats.h"
 #include "lwipopts.h"
 
 #include "stdio.h"
@@ -30,12 +32,57 @@
 static uint8_t macAddress[6] = {0xAC, 0xDE, 0x48, 0x00, 0x00, 0x00};
 
 #if LWIP_DNS
+#ifndef NETWORK_DNS_CACHE_SIZE
+#define NETWORK_DNS_CACHE_SIZE 8
+#endif
+#ifndef NETWORK_DNS_QUERIES
+#define NETWORK_DNS_QUERIES 4
+#endif
+#ifndef NETWORK_DNS_TIMEOUT
+#define NETWORK_DNS_TIMEOUT 5000
+#endif
+#ifndef NETWORK_DNS_PREFETCH
+#define NETWORK_DNS_PREFETCH 10 // seconds before expiry to refresh a name that's in use
+#endif
+#ifndef NETWORK_DNS_MIN_TTL
+#define NETWORK_DNS_MIN_TTL 30
+#endif
+#ifndef NETWORK_DNS_MAX_TTL
+#define NETWORK_DNS_MAX_TTL 86400
+#endif
+#define NETWORK_DNS_NAME_MAX 48
+#define NETWORK_DNS_TIMER 1000
+
+typedef struct DnsEntry_t {
+  char name[NETWORK_DNS_NAME_MAX]; // empty when the entry is unused
+  int address;
+  systime_t expires;
+  bool used;        // looked up since it was last refreshed - only these get prefetched
+  bool refreshing;
+} DnsEntry;
+
+typedef struct DnsQuery_t {
+  char name[NETWORK_DNS_NAME_MAX];
+  NetworkResolveHandler handler;
+  void* context;
+  systime_t deadline;
+  uint8_t serial;   // tells a late answer from lwIP apart from the slot's current query
+  bool active;
+  bool refresh;     // ask the server even if lwIP still has the name
+} DnsQuery;
+
 struct Dns {
-  Semaphore semaphore;
-  int resolvedAddress;
+  Mutex lock;
+  DnsEntry cache[NETWORK_DNS_CACHE_SIZE];
+  DnsQuery queries[NETWORK_DNS_QUERIES];
+  bool timerRunning; // queries only ever time out once dnsTimer() is going
 };
 static struct Dns dns;
-static void dnsCallback(const char *name, struct ip_addr *addr, void *arg);
+static int  dnsLookup(const char* name, NetworkResolveHandler handler, void* context, int* address);
+static int  dnsQueue(const char* name, NetworkResolveHandler handler, void* context);
+static void dnsStart(void* arg);
+static void dnsTimer(void* arg);
+static bool dnsTimerStart(void);
 #endif // LWIP_DNS
 
 static struct netif* mcnetif; // our network interface
@@ -68,7 +115,15 @@ static bool networkDhcpStop(int timeout);
   \section DNS
   DNS is a mechanism that resolves a domain name, like www.makingthings.com, into the IP address
   of the MakingThings web site.  This is the same thing that happens in your browser when you type
-  an address in.  The Make Controller can do this as well - check getHostByName().
+  an address in.  The Make Controller can do this as well - check networkGetHostByName().
+
+  Lookups don't have to block.  networkResolve() fires off a query and calls you back with the
+  answer, and several of these can be outstanding at once, from any number of threads.  Each
+  query gives up after \b NETWORK_DNS_TIMEOUT milliseconds (5000 by default).  Answers are kept
+  in a cache of \b NETWORK_DNS_CACHE_SIZE names (8 by default) for as long as the DNS server
+  said they're good for, and names that are being used get looked up again in the background
+  shortly before they expire, so a busy connection never has to wait on DNS.
+  If you just want the address whenever it's at hand, networkLookupHost() never waits at all.
 
   For a general overview of the network capabilities, check out the \ref networking page.
 
@@ -116,6 +171,11 @@ void networkInit()
   chThdCreateStatic(wa_lwip_thread, LWIP_THREAD_STACK_SIZE, NORMALPRIO + 1, lwip_thread, &opts);
   chSemWait(&initSemaphore); // wait until lwip is set up
 
+#if LWIP_DNS
+  chMtxInit(&dns.lock);
+  dnsTimerStart(); // if this fails, networkResolve() tries again
+#endif
+
   mcnetif->hostname = "tester";
 #if LWIP_DHCP
   mcnetif->status_callback = lwipStatusCallback;
@@ -158,12 +218,12 @@ bool networkSetAddress(int address, int mask, int gateway)
 
   // but write the addresses to memory regardless,
   // so we can use them next time DHCP is disabled
-  eepromWrite(EEPROM_SYSTEM_NET_ADDRESS, address);
-  eepromWrite(EEPROM_SYSTEM_NET_MASK, mask);
-  eepromWrite(EEPROM_SYSTEM_NET_GATEWAY, gateway);
+  settingsWrite(EEPROM_SYSTEM_NET_ADDRESS, address);
+  settingsWrite(EEPROM_SYSTEM_NET_MASK, mask);
+  settingsWrite(EEPROM_SYSTEM_NET_GATEWAY, gateway);
 
   int total = address + mask + gateway;
-  eepromWrite(EEPROM_SYSTEM_NET_CHECK, total);
+  settingsWrite(EEPROM_SYSTEM_NET_CHECK, total);
 
   return rv;
 }
@@ -248,11 +308,11 @@ void networkSetDhcp(bool enabled, int timeout)
 {
   if (enabled && !networkDhcp()) {
     networkDhcpStart(timeout);
-    eepromWrite(EEPROM_DHCP_ENABLED, enabled);
+    settingsWrite(EEPROM_DHCP_ENABLED, enabled);
   }
   else if(!enabled && networkDhcp()) {
     networkDhcpStop(timeout);
-    eepromWrite(EEPROM_DHCP_ENABLED, enabled);
+    settingsWrite(EEPROM_DHCP_ENABLED, enabled);
     int a, m, g;
     networkLastValidAddress(&a, &m, &g);
     networkSetAddress(a, m, g);
@@ -275,7 +335,7 @@ void networkSetDhcp(bool enabled, int timeout)
 */
 bool networkDhcp()
 {
-  return eepromRead(EEPROM_DHCP_ENABLED);
+  return settingsRead(EEPROM_DHCP_ENABLED);
 }
 
 bool networkDhcpStart(int timeout)
@@ -297,14 +357,88 @@ bool networkDhcpStop(int timeout)
 
 #endif // LWIP_DHCP
 
+#if LWIP_DNS
+
+/**
+  Resolve the IP address for a domain name via DNS, without waiting for the answer.
+  The handler is called once with the result - right away if the name is an address
+  like "192.168.0.100" or is already in the cache, otherwise from the network thread
+  when the DNS server answers or after \b NETWORK_DNS_TIMEOUT milliseconds.  Don't
+  block in the handler - hand the address off to your own thread if there's work to do.
+
+  Up to \b NETWORK_DNS_QUERIES lookups (4 by default) can be in progress at once.
+  @param name The domain to look up.
+  @param handler The function to call with the result - it gets the name, the address
+  (or -1 if the lookup failed) and \b context.
+  @param context Anything you'd like passed to the handler.
+  @return 0 if the handler will be called, or an error if the lookup couldn't be started.
+
+  \b Example
+  \code
+  void onResolved(const char* name, int address, void* context)
+  {
+    if (address != -1)
+      chMBPostI(&connectRequests, address); // let another thread make the connection
+  }
+
+  networkResolve("www.makingthings.com", onResolved, 0);
+  \endcode
+*/
+int networkResolve(const char *name, NetworkResolveHandler handler, void* context)
+{
+  int address;
+  int rv = dnsLookup(name, handler, context, &address);
+  if (rv < 0)
+    return rv;
+  if (rv == CONTROLLER_OK && handler)
+    handler(name, address, context);
+  return CONTROLLER_OK;
+}
+
+/**
+  Look up a domain name without waiting for an answer.
+  If the name is an address already, or is in the cache, you get the answer straight away.  If not,
+  a lookup is started in the background and -1 returned, so the answer is in the cache
+  when you ask again.  Either way the name counts as in use, so it's refreshed before it expires.
+  Handy for code that looks the same name up over and over and can't afford to wait.
+  @param name The domain to look up.
+  @return The IP address of the host, or -1 if it isn't known yet.
+
+  \b Example
+  \code
+  int address = networkLookupHost("www.makingthings.com");
+  if (address != -1)
+    sock = tcpOpen(address, 80);
+  // otherwise try again next time around
+  \endcode
+*/
+int networkLookupHost(const char *name)
+{
+  int address;
+  return (dnsLookup(name, 0, 0, &address) == CONTROLLER_OK) ? address : -1;
+}
+
+struct DnsWait {
+  Semaphore done;
+  int address;
+};
+
+static void dnsWake(const char* name, int address, void* context)
+{
+  UNUSED(name);
+  struct DnsWait* w = context;
+  w->address = address;
+  chSemSignal(&w->done);
+}
+
 /**
   Resolve the IP address for a domain name via DNS.
-  Up to 4 DNS entries are cached, so if you make successive calls to this function, 
-  you won't incur a whole lookup roundtrip - you'll just get the cached value.
-  The cached values are maintained internally, so if one of them becomes invalid, a
-  new lookup will be fired off the next time it's asked for.
+  This waits for the answer - at most \b NETWORK_DNS_TIMEOUT milliseconds.  Answers are
+  cached, so if you make successive calls to this function, you won't incur a whole
+  lookup roundtrip - you'll just get the cached value.  Names that keep getting asked for
+  are refreshed in the background before they expire.  Use networkResolve() if you
+  can't afford to wait at all.
   @param name The domain to look up.
-  @param timeout The number of seconds to wait for this operation to complete.
   @return The IP address of the host, or -1 on error.
 
   \b Example
@@ -318,44 +452,264 @@ bool networkDhcpStop(int timeout)
   }
   \endcode
 */
-#if LWIP_DNS
 int networkGetHostByName(const char *name)
 {
-  struct ip_addr address;
-  err_t result = dns_gethostbyname(name, &address, dnsCallback, &dns);
-  if (result == ERR_OK) { // the result was cached, just return it
-    return address.addr;
+  struct DnsWait w;
+  chSemInit(&w.done, 0);
+  if (networkResolve(name, dnsWake, &w) != CONTROLLER_OK)
+    return -1;
+  chSemWait(&w.done); // every query is answered or times out, so this is bounded
+  return w.address;
+}
+
+/** @} */
+
+/*
+  Make sure dnsTimer() is running, since it's what times out queries that never
+  get an answer.  Posting it to the tcpip thread can fail when lwIP is short on
+  messages, so this gets another go on each lookup until it works.
+*/
+static bool dnsTimerStart()
+{
+  bool start;
+  chMtxLock(&dns.lock);
+  start = !dns.timerRunning;
+  dns.timerRunning = true;
+  chMtxUnlock();
+  if (start && tcpip_callback(dnsTimer, 0) != ERR_OK) {
+    chMtxLock(&dns.lock);
+    dns.timerRunning = false;
+    chMtxUnlock();
+    return false;
   }
-  else if (result == ERR_INPROGRESS) {
-    // a lookup is in progress - wait for the callback to signal that we've gotten a response
-    return (chSemWait(&dns.semaphore) == RDY_OK) ? dns.resolvedAddress : -1;
+  return true;
+}
+
+/*
+  Sort out the address for a name if it's at hand, marking cached names as used.  Otherwise
+  start a lookup that calls handler once it's done - without a handler, a lookup already
+  underway for the name is left to it.  Returns CONTROLLER_OK with address set, 1 if the
+  answer is on its way, or an error if the lookup couldn't be started.
+*/
+static int dnsLookup(const char* name, NetworkResolveHandler handler, void* context, int* address)
+{
+  int i, token = -1;
+  *address = (int)inet_addr(name);
+  if (*address != (int)INADDR_NONE)
+    return CONTROLLER_OK;
+  if (strlen(name) >= NETWORK_DNS_NAME_MAX)
+    return CONTROLLER_ERROR_STRING_TOO_LONG;
+  if (!dnsTimerStart())
+    return CONTROLLER_ERROR_SUBSYSTEM_INACTIVE;
+
+  chMtxLock(&dns.lock);
+  for (i = 0; i < NETWORK_DNS_CACHE_SIZE; i++) {
+    DnsEntry* e = &dns.cache[i];
+    if (*e->name && !strcmp(e->name, name) && (int32_t)(e->expires - chTimeNow()) > 0) {
+      e->used = true;
+      *address = e->address;
+      chMtxUnlock();
+      return CONTROLLER_OK;
+    }
+  }
+  if (!handler) {
+    for (i = 0; i < NETWORK_DNS_QUERIES; i++) {
+      if (dns.queries[i].active && !strcmp(dns.queries[i].name, name)) {
+        chMtxUnlock();
+        return 1;
+      }
+    }
+  }
+  token = dnsQueue(name, handler, context);
+  chMtxUnlock();
+
+  if (token < 0)
+    return CONTROLLER_ERROR_INSUFFICIENT_RESOURCES;
+  if (tcpip_callback(dnsStart, (void*)token) != ERR_OK) {
+    chMtxLock(&dns.lock);
+    dns.queries[token & 0xFF].active = false;
+    chMtxUnlock();
+    return CONTROLLER_ERROR_INSUFFICIENT_RESOURCES;
+  }
+  return 1;
+}
+
+/*
+  Grab a query slot for a name - the returned token combines the slot index
+  with its serial number, and is what gets handed to lwIP as the callback arg.
+  Call with dns.lock held.
+*/
+static int dnsQueue(const char* name, NetworkResolveHandler handler, void* context)
+{
+  int i;
+  for (i = 0; i < NETWORK_DNS_QUERIES; i++) {
+    DnsQuery* q = &dns.queries[i];
+    if (!q->active) {
+      strcpy(q->name, name);
+      q->handler = handler;
+      q->context = context;
+      q->deadline = chTimeNow() + MS2ST(NETWORK_DNS_TIMEOUT);
+      q->serial++;
+      q->active = true;
+      q->refresh = false;
+      return (q->serial << 8) | i;
+    }
+  }
+  return -1;
+}
+
+/*
+  Remember an answer, replacing the same name, an empty entry,
+  or whichever entry is closest to expiring.  Call with dns.lock held.
+*/
+static void dnsCacheStore(const char* name, int address, u32_t ttl)
+{
+  int i;
+  DnsEntry* e = 0;
+  systime_t now = chTimeNow();
+  for (i = 0; i < NETWORK_DNS_CACHE_SIZE; i++) {
+    DnsEntry* c = &dns.cache[i];
+    if (!strcmp(c->name, name)) {
+      e = c;
+      break;
+    }
+    if (!e || !*c->name || (*e->name && (int32_t)(c->expires - now) < (int32_t)(e->expires - now)))
+      e = c;
+  }
+  strcpy(e->name, name);
+  e->address = address;
+  e->expires = now + MIN(MAX(ttl, NETWORK_DNS_MIN_TTL), NETWORK_DNS_MAX_TTL) * CH_FREQUENCY;
+  e->used = false;
+  e->refreshing = false;
+}
+
+/*
+  A query has been answered, failed or timed out.  Cache good answers even if
+  the query has already timed out, then let whoever asked know.
+*/
+static void dnsFinish(int token, const char* name, int address, u32_t ttl)
+{
+  DnsQuery* q = &dns.queries[token & 0xFF];
+  NetworkResolveHandler handler = 0;
+  void* context = 0;
+  char qname[NETWORK_DNS_NAME_MAX];
+
+  chMtxLock(&dns.lock);
+  if (address != -1)
+    dnsCacheStore(name, address, ttl);
+  if (q->active && q->serial == (uint8_t)(token >> 8)) {
+    q->active = false;
+    handler = q->handler;
+    context = q->context;
+    strcpy(qname, q->name);
   }
+  chMtxUnlock();
+  if (handler)
+    handler(qname, address, context);
+}
+
+/*
+  The callback for a DNS look up - runs in the tcpip thread.
+*/
+static void dnsFound(const char *name, struct ip_addr *addr, void *arg)
+{
+  if (addr)
+    dnsFinish((int)arg, name, addr->addr, dns_lookup_ttl(name));
   else
-    return -1;
+    dnsFinish((int)arg, name, -1, 0);
 }
 
-/** @} */
+/*
+  Hand a queued query to lwIP - runs in the tcpip thread.
+*/
+static void dnsStart(void* arg)
+{
+  int token = (int)arg;
+  DnsQuery* q = &dns.queries[token & 0xFF];
+  char name[NETWORK_DNS_NAME_MAX];
+  struct ip_addr addr;
+
+  chMtxLock(&dns.lock);
+  bool current = q->active && q->serial == (uint8_t)(token >> 8);
+  bool refresh = q->refresh;
+  if (current)
+    strcpy(name, q->name);
+  chMtxUnlock();
+  if (!current)
+    return;
+
+  err_t err = refresh ? dns_refresh(name, dnsFound, arg) : dns_gethostbyname(name, &addr, dnsFound, arg);
+  switch (err) {
+    case ERR_OK: // lwIP still had it
+      dnsFinish(token, name, addr.addr, dns_lookup_ttl(name));
+      break;
+    case ERR_INPROGRESS:
+      break;
+    default:
+      dnsFinish(token, name, -1, 0);
+      break;
+  }
+}
 
 /*
-  The callback for a DNS look up.  The original request is waiting (via semaphore) on
-  this to pop the looked up address in the right spot.
+  Once a second, in the tcpip thread: give up on queries that have run out of time,
+  drop expired names, and start refreshing names in use that are about to expire.
 */
-void dnsCallback(const char *name, struct ip_addr *addr, void *arg)
+static void dnsTimer(void* arg)
 {
-  UNUSED(name);
-  struct Dns* dns = arg;
-  dns->resolvedAddress = addr ? (int)addr->addr : -1;
-  chSemSignal(&dns->semaphore);
+  UNUSED(arg);
+  int i, token;
+  systime_t now = chTimeNow();
+
+  do {
+    token = -1;
+    chMtxLock(&dns.lock);
+    for (i = 0; i < NETWORK_DNS_QUERIES; i++) {
+      DnsQuery* q = &dns.queries[i];
+      if (q->active && (int32_t)(now - q->deadline) >= 0) {
+        token = (q->serial << 8) | i;
+        break;
+      }
+    }
+    chMtxUnlock();
+    if (token >= 0)
+      dnsFinish(token, dns.queries[token & 0xFF].name, -1, 0);
+  } while (token >= 0);
+
+  do {
+    token = -1;
+    chMtxLock(&dns.lock);
+    for (i = 0; i < NETWORK_DNS_CACHE_SIZE && token < 0; i++) {
+      DnsEntry* e = &dns.cache[i];
+      int32_t remaining = (int32_t)(e->expires - now);
+      if (!*e->name)
+        continue;
+      if (remaining <= 0)
+        *e->name = 0;
+      else if (e->used && !e->refreshing && remaining < NETWORK_DNS_PREFETCH * CH_FREQUENCY) {
+        token = dnsQueue(e->name, 0, 0);
+        if (token < 0)
+          break; // all the query slots are busy - try again next time around
+        dns.queries[token & 0xFF].refresh = true;
+        e->refreshing = true;
+      }
+    }
+    chMtxUnlock();
+    if (token >= 0)
+      dnsStart((void*)token);
+  } while (token >= 0);
+
+  sys_timeout(NETWORK_DNS_TIMER, dnsTimer, 0);
 }
 
 #endif // LWIP_DNS
 
 bool networkLastValidAddress(int* address, int *mask, int* gateway)
 {
-  int total = eepromRead(EEPROM_SYSTEM_NET_CHECK);
-  *address  = eepromRead(EEPROM_SYSTEM_NET_ADDRESS);
-  *mask     = eepromRead(EEPROM_SYSTEM_NET_MASK);
-  *gateway  = eepromRead(EEPROM_SYSTEM_NET_GATEWAY);
+  int total = settingsRead(EEPROM_SYSTEM_NET_CHECK);
+  *address  = settingsRead(EEPROM_SYSTEM_NET_ADDRESS);
+  *mask     = settingsRead(EEPROM_SYSTEM_NET_MASK);
+  *gateway  = settingsRead(EEPROM_SYSTEM_NET_GATEWAY);
   if (total == *address + *mask + *gateway) {
     return true;
   }
@@ -463,6 +817,145 @@ static void networkOscUdpListenPortHandler(OscChannel ch, char* address, int idx
   }
 }
 
+#if LWIP_STATS
+
+/** \defgroup NetworkStatsOSC Network Statistics - OSC
+  Check on the network stack via OSC.
+  \ingroup OSC
+
+  Send \b /network/stats with no arguments and the board replies with everything it
+  knows about where packets and memory are going, as a series of messages in one bundle.
+  The default \b OSC_MAX_MSG_OUT of 512 is too small to hold them all, so they arrive in
+  two or three bundles - define \b OSC_MAX_MSG_OUT as 1400 in config.h to get them in one.
+
+  Counters are 16 bits, and wrap around.
+
+  \par Protocols
+  \verbatim /network/stats/link xmit recv drop memerr err \endverbatim
+  One message each for \b link, \b etharp, \b ip, \b icmp, \b udp and \b tcp.  \b memerr counts
+  packets lost because there was no memory for them, and \b err everything else that went
+  wrong (checksum, length, routing, protocol and option errors).
+
+  \par Heap
+  \verbatim /network/stats/mem avail used max err \endverbatim
+  Bytes in the lwIP heap (\b MEM_SIZE) - its size, how much is in use now, the most that's ever been
+  in use, and how many allocations have failed.
+
+  \par Pools
+  \verbatim /network/stats/memp name avail used max err \endverbatim
+  One message for each lwIP memory pool, like \b pbuf_pool, \b pbuf or \b tcpip_msg_inpkt -
+  the number of entries, in use now, most ever in use, and failed allocations.  A pool
+  with errors needs to be bigger, and one whose max stays well under its size can shrink.
+
+  \par Mailboxes
+  \verbatim /network/stats/mbox used max err \endverbatim
+  \b err counts posts to a full mailbox - when the tcpip thread's mailbox is full, incoming
+  packets are dropped.
+
+  \par EMAC
+  \verbatim /network/stats/emac overruns resource fcs \endverbatim
+  Frames the Ethernet MAC itself dropped - because it couldn't write to memory fast enough,
+  because there was no free receive buffer, or because they arrived damaged.
+
+  \par Zero copy
+  \verbatim /network/stats/zerocopy rx rxchained tx txcopied \endverbatim
+  Only with \b LWIP_EMAC_ZEROCOPY defined as 1 in config.h.  Frames received, and how many
+  of those spanned more than one 128 byte EMAC buffer.  Frames sent straight from lwIP's
+  buffers, and how many had to be copied first.
+*/
+
+static const char* const networkMempNames[] = {
+#define LWIP_MEMPOOL(name, num, size, desc) #name,
+#include "lwip/memp_std.h"
+};
+
+static uint32_t emacOverruns, emacResourceErrors, emacFcsErrors;
+
+static void networkOscStatsProto(OscChannel ch, const char* name, struct stats_proto* s)
+{
+  char address[24];
+  siprintf(address, "/network/stats/%s", name);
+  OscData d[5] = {
+    { .type = INT, .value.i = s->xmit },
+    { .type = INT, .value.i = s->recv },
+    { .type = INT, .value.i = s->drop },
+    { .type = INT, .value.i = s->memerr },
+    { .type = INT, .value.i = s->chkerr + s->lenerr + s->rterr + s->proterr + s->opterr + s->err }
+  };
+  oscCreateMessage(ch, address, d, 5);
+}
+
+static void networkOscStatsHandler(OscChannel ch, char* address, int idx, OscData data[], int datalen)
+{
+  UNUSED(address); UNUSED(idx); UNUSED(data);
+  if (datalen != 0)
+    return;
+  int i;
+  char name[20];
+  // start a fresh bundle, so as much as possible arrives together
+  oscSendPendingMessages(ch);
+
+  networkOscStatsProto(ch, "link", &lwip_stats.link);
+  networkOscStatsProto(ch, "etharp", &lwip_stats.etharp);
+  networkOscStatsProto(ch, "ip", &lwip_stats.ip);
+  networkOscStatsProto(ch, "icmp", &lwip_stats.icmp);
+  networkOscStatsProto(ch, "udp", &lwip_stats.udp);
+  networkOscStatsProto(ch, "tcp", &lwip_stats.tcp);
+
+  OscData d[5];
+  d[0].type = d[1].type = d[2].type = d[3].type = INT;
+  d[0].value.i = lwip_stats.mem.avail;
+  d[1].value.i = lwip_stats.mem.used;
+  d[2].value.i = lwip_stats.mem.max;
+  d[3].value.i = lwip_stats.mem.err;
+  oscCreateMessage(ch, "/network/stats/mem", d, 4);
+
+  for (i = 0; i < MEMP_MAX; i++) {
+    char* n = name;
+    const char* c = networkMempNames[i];
+    while (*c && n < name + sizeof(name) - 1)
+      *n++ = (*c >= 'A' && *c <= 'Z') ? *c++ + ('a' - 'A') : *c++;
+    *n = 0;
+    d[0].type = STRING;
+    d[0].value.s = name;
+    d[1].type = d[2].type = d[3].type = d[4].type = INT;
+    d[1].value.i = lwip_stats.memp[i].avail;
+    d[2].value.i = lwip_stats.memp[i].used;
+    d[3].value.i = lwip_stats.memp[i].max;
+    d[4].value.i = lwip_stats.memp[i].err;
+    oscCreateMessage(ch, "/network/stats/memp", d, 5);
+  }
+
+  d[0].type = INT;
+  d[0].value.i = lwip_stats.sys.mbox.used;
+  d[1].value.i = lwip_stats.sys.mbox.max;
+  d[2].value.i = lwip_stats.sys.mbox.err;
+  oscCreateMessage(ch, "/network/stats/mbox", d, 3);
+
+  // the EMAC's statistics registers clear when they're read, so keep a running total
+  chSysLock();
+  emacOverruns += AT91C_BASE_EMAC->EMAC_ROV;
+  emacResourceErrors += AT91C_BASE_EMAC->EMAC_RRE;
+  emacFcsErrors += AT91C_BASE_EMAC->EMAC_FCSE;
+  d[0].value.i = emacOverruns;
+  d[1].value.i = emacResourceErrors;
+  d[2].value.i = emacFcsErrors;
+  chSysUnlock();
+  oscCreateMessage(ch, "/network/stats/emac", d, 3);
+
+#if LWIP_EMAC_ZEROCOPY
+  d[0].value.i = lwip_zerocopy_stats.rx;
+  d[1].value.i = lwip_zerocopy_stats.rxchained;
+  d[2].value.i = lwip_zerocopy_stats.tx;
+  d[3].value.i = lwip_zerocopy_stats.txcopied;
+  oscCreateMessage(ch, "/network/stats/zerocopy", d, 4);
+#endif
+}
+
+static const OscNode networkOscStats = { .name = "stats", .handler = networkOscStatsHandler };
+
+#endif // LWIP_STATS
+
 static const OscNode networkOscFind = { .name = "find", .handler = networkOscFindHandler };
 static const OscNode networkOscDhcp = { .name = "dhcp", .handler = networkOscDhcpHandler };
 static const OscNode networkOscAddress = { .name = "address", .handler = networkOscAddressHandler };
@@ -478,7 +971,11 @@ const OscNode networkOsc = {
     &networkOscAddress,
     &networkOscMac,
     &networkOscUdpSendPort,
-    &networkOscUdpListenPort, 0
+    &networkOscUdpListenPort,
+#if LWIP_STATS
+    &networkOscStats,
+#endif
+    0
   }
 };
 
@@ -21,6 +21,14 @@
 #define IP_ADDRESS_BROADCAST 0xffffffffUL
 #define IP_ADDRESS_ANY       0x00000000UL
 
+/**
+  A function to be called with the result of networkResolve().
+  @param name The name that was looked up.
+  @param address Its IP address, or -1 if the lookup failed.
+  @param context The context passed to networkResolve().
+*/
+typedef void (*NetworkResolveHandler)(const char* name, int address, void* context);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -28,6 +36,8 @@ void networkInit(void);
 bool networkSetAddress(int address, int mask, int gateway);
 void networkAddress(int* address, int* mask, int* gateway);
 int  networkGetHostByName(const char *name);
+int  networkResolve(const char *name, NetworkResolveHandler handler, void* context);
+int  networkLookupHost(const char *name);
 void networkSetDhcp(bool enabled, int timeout);
 bool networkDhcp(void);
 int  networkAddressToString(char* data, int address);
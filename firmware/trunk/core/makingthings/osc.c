@@ -10,6 +10,11 @@
 #include <string.h>
 #include <stdio.h>
 
+#if defined(MAKE_CTRL_NETWORK) && defined(OSC_UDP_RAW)
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#endif
+
 #ifndef OSC_MAX_MSG_IN
 #define OSC_MAX_MSG_IN 512
 #endif
@@ -18,6 +23,14 @@
 #define OSC_MAX_MSG_OUT 512
 #endif
 
+#ifndef OSC_IN_BUFFERS
+#define OSC_IN_BUFFERS 2 // one for each channel's thread
+#endif
+
+#ifndef OSC_OUT_BUFFERS
+#define OSC_OUT_BUFFERS 2 // only held while replies are being put together
+#endif
+
 #ifndef OSC_MAX_DATA_ITEMS
 #define OSC_MAX_DATA_ITEMS 20
 #endif
@@ -38,6 +51,14 @@
 #define OSC_AUTOSEND_DEFAULT_INTERVAL 10
 #endif
 
+#ifndef OSC_UDP_QUEUE
+#define OSC_UDP_QUEUE 4
+#endif
+
+#ifndef OSC_MAX_ADDRESS
+#define OSC_MAX_ADDRESS 64
+#endif
+
 typedef int (*OscSendMsg)(const char* data, int len);
 
 typedef struct OscChannelData_t {
@@ -45,8 +66,8 @@ typedef struct OscChannelData_t {
   uint8_t outMsgCount;
   uint32_t outBufRemaining;
   char* outBufPtr;
-  char outBuf[OSC_MAX_MSG_OUT];
-  char inBuf[OSC_MAX_MSG_IN];
+  char* outBuf;     // from oscOutPool, or 0 if nothing's waiting to go out
+  char* inBuf;      // from oscInPool
   OscSendMsg sendMessage;
 } OscChannelData;
 
@@ -62,13 +83,24 @@ typedef struct Osc_t {
   int udpReplyPort;
   int udpReplyAddress;
   int udpListenPort;
+#ifdef OSC_UDP_RAW
+  struct udp_pcb* udpPcb;
+  Mailbox udpFull;   // received packets waiting for the OSC thread
+  Mailbox udpFree;   // packet slots the receive callback can use
+  msg_t udpFullBuf[OSC_UDP_QUEUE];
+  msg_t udpFreeBuf[OSC_UDP_QUEUE];
+#endif
 #endif
   Thread* autosendThd;
   OscChannel autosendDestination;
   uint32_t autosendPeriod;
+  OscAutosendListener autosendListener;
+  Thread* queryThd;           // replies on NONE from this thread go to the query handler
+  OscReplyHandler queryHandler;
+  void* queryContext;
+  int queryReplies;
 } Osc;
 
-static void oscReceivePacket(OscChannel ch, char* data, uint32_t len);
 static void oscReceiveMessage(OscChannel ch, char* data, uint32_t len);
 static void oscResetChannel(OscChannelData* ch);
 static OscChannelData* oscGetChannelByType(OscChannel ct);
@@ -78,6 +110,9 @@ static bool oscDispatchNode(OscChannel ch, char* addr, char* fulladdr,
 static bool oscNameSpaceQuery(OscChannel ch, char* addr, char *fulladdr, const OscNode* node);
 
 static Osc osc;
+static MUTEX_DECL(oscQueryLock);
+POOL_DECL(oscInPool, "osc-in", OSC_MAX_MSG_IN, OSC_IN_BUFFERS);
+POOL_DECL(oscOutPool, "osc-out", OSC_MAX_MSG_OUT, OSC_OUT_BUFFERS);
 extern const OscNode oscRoot; // must be defined by the user
 
 #ifdef MAKE_CTRL_USB
@@ -93,9 +128,11 @@ static msg_t OscUsbSerialThread(void *arg)
 
   while (!usbserialIsActive())
     chThdSleepMilliseconds(50);
+  while ((osc.usb.inBuf = poolAlloc(&oscInPool)) == 0)
+    chThdSleepMilliseconds(500);
 
   while (!chThdShouldTerminate()) {
-    int justGot = usbserialReadSlip(osc.usb.inBuf, sizeof(osc.usb.inBuf));
+    int justGot = usbserialReadSlip(osc.usb.inBuf, OSC_MAX_MSG_IN);
     if (justGot > 0) {
       chMtxLock(&osc.usb.lock);
       oscReceivePacket(USB, osc.usb.inBuf, justGot);
@@ -103,6 +140,8 @@ static msg_t OscUsbSerialThread(void *arg)
       chMtxUnlock();
     }
   }
+  poolFree(&oscInPool, osc.usb.inBuf);
+  osc.usb.inBuf = 0;
   return 0;
 }
 
@@ -131,6 +170,160 @@ bool oscUsbEnable(bool on)
 #endif
 
 static WORKING_AREA(waUdpThd, OSC_UDP_STACK_SIZE);
+
+#ifdef OSC_UDP_RAW
+
+/*
+  With OSC_UDP_RAW defined, OSC over UDP skips the sockets layer.  A raw lwIP
+  callback on the listen port hands each packet's pbuf to the OSC thread by
+  reference, and it's dispatched straight out of the pbuf.  Replies are copied
+  once into a pbuf that already has room for the UDP/IP headers and passed to
+  the tcpip thread without waiting for the send.  The sockets path instead
+  copies each packet out of its pbuf and blocks on a round trip through the
+  tcpip thread for every read and write.
+*/
+
+typedef struct OscUdpPacket_t {
+  struct pbuf* p;
+  int address;
+} OscUdpPacket;
+
+typedef struct OscUdpDest_t {
+  int address;
+  int port;
+} OscUdpDest;
+
+static OscUdpPacket oscUdpPackets[OSC_UDP_QUEUE];
+
+// runs in the tcpip thread
+static void oscUdpRawRecv(void* arg, struct udp_pcb* pcb, struct pbuf* p, struct ip_addr* addr, u16_t port)
+{
+  UNUSED(arg); UNUSED(pcb); UNUSED(port);
+  OscUdpPacket* pkt;
+  if (chMBFetch(&osc.udpFree, (msg_t*)&pkt, TIME_IMMEDIATE) != RDY_OK) {
+    pbuf_free(p); // the OSC thread is behind - drop it, like a full socket would
+    return;
+  }
+  pkt->p = p;
+  pkt->address = addr->addr;
+  chMBPost(&osc.udpFull, (msg_t)pkt, TIME_IMMEDIATE);
+}
+
+// runs in the tcpip thread
+static void oscUdpRawOpen(void* arg)
+{
+  struct udp_pcb* pcb = udp_new();
+  if (pcb != NULL) {
+    if (udp_bind(pcb, IP_ADDR_ANY, osc.udpListenPort) == ERR_OK) {
+      udp_recv(pcb, oscUdpRawRecv, NULL);
+      osc.udpPcb = pcb;
+    }
+    else
+      udp_remove(pcb);
+  }
+  chSemSignal((Semaphore*)arg);
+}
+
+// runs in the tcpip thread
+static void oscUdpRawClose(void* arg)
+{
+  UNUSED(arg);
+  if (osc.udpPcb != NULL) {
+    udp_remove(osc.udpPcb);
+    osc.udpPcb = NULL;
+  }
+}
+
+// runs in the tcpip thread
+static void oscUdpRawFree(void* arg)
+{
+  pbuf_free((struct pbuf*)arg);
+}
+
+// runs in the tcpip thread
+static void oscUdpRawSend(void* arg)
+{
+  struct pbuf* p = arg;
+  OscUdpDest* dest = p->payload;
+  struct ip_addr address = { dest->address };
+  u16_t port = dest->port;
+  pbuf_header(p, -(s16_t)sizeof(OscUdpDest));
+  if (osc.udpPcb != NULL)
+    udp_sendto(osc.udpPcb, p, &address, port);
+  pbuf_free(p);
+}
+
+static msg_t OscUdpThread(void *arg)
+{
+  UNUSED(arg);
+  int i;
+  Semaphore opened;
+  chSemInit(&opened, 0);
+  chMBInit(&osc.udpFull, osc.udpFullBuf, OSC_UDP_QUEUE);
+  chMBInit(&osc.udpFree, osc.udpFreeBuf, OSC_UDP_QUEUE);
+  for (i = 0; i < OSC_UDP_QUEUE; i++)
+    chMBPost(&osc.udpFree, (msg_t)&oscUdpPackets[i], TIME_IMMEDIATE);
+
+  while (osc.udpPcb == NULL) {
+    tcpip_callback(oscUdpRawOpen, &opened);
+    chSemWait(&opened);
+    if (osc.udpPcb == NULL)
+      chThdSleepMilliseconds(500);
+  }
+
+  while (!chThdShouldTerminate()) {
+    OscUdpPacket* pkt;
+    if (chMBFetch(&osc.udpFull, (msg_t*)&pkt, MS2ST(500)) != RDY_OK)
+      continue;
+    struct pbuf* p = pkt->p;
+    char* data = p->payload;
+    int len = p->tot_len;
+    if (p->len != p->tot_len) { // spread across a chain of pbufs - gather it up
+      if ((osc.udp.inBuf = poolAlloc(&oscInPool)) != 0)
+        len = pbuf_copy_partial(p, data = osc.udp.inBuf, OSC_MAX_MSG_IN, 0);
+      else
+        len = 0; // nowhere to put it - drop it
+    }
+    if (len > 0) {
+      chMtxLock(&osc.udp.lock);
+      osc.udpReplyAddress = pkt->address;
+      oscReceivePacket(UDP, data, len);
+      oscSendPendingMessages(UDP);
+      chMtxUnlock();
+    }
+    if (osc.udp.inBuf != 0) {
+      poolFree(&oscInPool, osc.udp.inBuf);
+      osc.udp.inBuf = 0;
+    }
+    tcpip_callback(oscUdpRawFree, p);
+    chMBPost(&osc.udpFree, (msg_t)pkt, TIME_IMMEDIATE);
+  }
+  tcpip_callback(oscUdpRawClose, 0);
+  OscUdpPacket* pkt;
+  while (chMBFetch(&osc.udpFull, (msg_t*)&pkt, TIME_IMMEDIATE) == RDY_OK)
+    tcpip_callback(oscUdpRawFree, pkt->p);
+  return 0;
+}
+
+static int oscSendMessageUDP(const char* data, int len)
+{
+  // the destination rides in front of the message, and gets stripped off in the tcpip thread
+  struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len + sizeof(OscUdpDest), PBUF_RAM);
+  if (p == NULL)
+    return CONTROLLER_ERROR_INSUFFICIENT_RESOURCES;
+  OscUdpDest* dest = p->payload;
+  dest->address = osc.udpReplyAddress;
+  dest->port = osc.udpReplyPort;
+  memcpy(dest + 1, data, len);
+  if (tcpip_callback(oscUdpRawSend, p) != ERR_OK) {
+    pbuf_free(p);
+    return CONTROLLER_ERROR_WRITE_FAILED;
+  }
+  return len;
+}
+
+#else
+
 static msg_t OscUdpThread(void *arg)
 {
   UNUSED(arg);
@@ -139,9 +332,11 @@ static msg_t OscUdpThread(void *arg)
     chThdSleepMilliseconds(500);
 
   udpBind(osc.udpsock, osc.udpListenPort);
+  while ((osc.udp.inBuf = poolAlloc(&oscInPool)) == 0)
+    chThdSleepMilliseconds(500);
 
   while (!chThdShouldTerminate()) {
-    int justGot = udpRead(osc.udpsock, osc.udp.inBuf, sizeof(osc.udp.inBuf), &osc.udpReplyAddress, 0);
+    int justGot = udpRead(osc.udpsock, osc.udp.inBuf, OSC_MAX_MSG_IN, &osc.udpReplyAddress, 0);
     if (justGot > 0) {
       chMtxLock(&osc.udp.lock);
       oscReceivePacket(UDP, osc.udp.inBuf, justGot);
@@ -149,6 +344,8 @@ static msg_t OscUdpThread(void *arg)
       chMtxUnlock();
     }
   }
+  poolFree(&oscInPool, osc.udp.inBuf);
+  osc.udp.inBuf = 0;
   return 0;
 }
 
@@ -157,6 +354,8 @@ static int oscSendMessageUDP(const char* data, int len)
   return udpWrite(osc.udpsock, data, len, osc.udpReplyAddress, osc.udpReplyPort);
 }
 
+#endif // OSC_UDP_RAW
+
 bool oscUdpEnable(bool on)
 {
   if (on && osc.udpThd == 0) {
@@ -179,14 +378,14 @@ void oscUdpSetReplyPort(int port)
 {
   if (osc.udpReplyPort != port) {
     osc.udpReplyPort = port;
-    eepromWrite(EEPROM_OSC_UDP_SEND_PORT, port);
+    settingsWrite(EEPROM_OSC_UDP_SEND_PORT, port);
   }
 }
 
 int oscUdpReplyPort()
 {
   if (osc.udpReplyPort == 0) { // uninitialized
-    osc.udpReplyPort = eepromRead(EEPROM_OSC_UDP_SEND_PORT);
+    osc.udpReplyPort = settingsRead(EEPROM_OSC_UDP_SEND_PORT);
     if (osc.udpReplyPort < 0 || osc.udpReplyPort > 65536)
       osc.udpReplyPort = OSC_UDP_DEFAULT_PORT;
   }
@@ -197,14 +396,14 @@ void oscUdpSetListenPort(int port)
 {
   if (osc.udpListenPort != port) {
     osc.udpListenPort = port;
-    eepromWrite(EEPROM_OSC_UDP_LISTEN_PORT, port);
+    settingsWrite(EEPROM_OSC_UDP_LISTEN_PORT, port);
   }
 }
 
 int oscUdpListenPort()
 {
   if (osc.udpListenPort == 0) { // uninitialized
-    osc.udpListenPort = eepromRead(EEPROM_OSC_UDP_LISTEN_PORT);
+    osc.udpListenPort = settingsRead(EEPROM_OSC_UDP_LISTEN_PORT);
     if (osc.udpListenPort < 0 || osc.udpListenPort > 65536)
       osc.udpListenPort = OSC_UDP_DEFAULT_PORT;
   }
@@ -222,21 +421,25 @@ static msg_t OscAutosendThread(void *arg)
   OscChannelData* chd;
 
   while (!chThdShouldTerminate()) {
-    if (osc.autosendDestination == NONE) {
+    if (osc.autosendDestination == NONE && osc.autosendListener == 0) {
       sleep(250);
     }
     else {
+      // with no destination, the autosenders still run for the listener's sake
       chd = oscGetChannelByType(osc.autosendDestination);
       i = 0;
       node = oscRoot.children[i++];
-      chMtxLock(&chd->lock);
+      if (chd)
+        chMtxLock(&chd->lock);
       while (node != 0) {
         if (node->autosender != 0)
           node->autosender(osc.autosendDestination);
         node = oscRoot.children[i++];
       }
-      oscSendPendingMessages(osc.autosendDestination);
-      chMtxUnlock();
+      if (chd) {
+        oscSendPendingMessages(osc.autosendDestination);
+        chMtxUnlock();
+      }
       sleep(osc.autosendPeriod);
     }
   }
@@ -260,7 +463,7 @@ void oscAutosendEnable(bool enabled)
 OscChannel oscAutosendDestination()
 {
   if (osc.autosendDestination == 0) { // uninitialized
-    osc.autosendDestination = eepromRead(EEPROM_OSC_ASYNC_DEST);
+    osc.autosendDestination = settingsRead(EEPROM_OSC_ASYNC_DEST);
     bool valid = false;
     #ifdef MAKE_CTRL_USB
     if (osc.autosendDestination == USB)
@@ -280,14 +483,14 @@ void oscSetAutosendDestination(OscChannel oc)
 {
   if (osc.autosendDestination != oc) {
     osc.autosendDestination = oc;
-    eepromWrite(EEPROM_OSC_ASYNC_DEST, oc);
+    settingsWrite(EEPROM_OSC_ASYNC_DEST, oc);
   }
 }
 
 uint32_t oscAutosendInterval()
 {
   if (osc.autosendPeriod == 0) { // uninitialized
-    osc.autosendPeriod = eepromRead(EEPROM_OSC_ASYNC_INTERVAL);
+    osc.autosendPeriod = settingsRead(EEPROM_OSC_ASYNC_INTERVAL);
     if (osc.autosendPeriod < 1 || osc.autosendPeriod > OSC_AUTOSEND_MAX_INTERVAL)
       osc.autosendPeriod = OSC_AUTOSEND_DEFAULT_INTERVAL;
   }
@@ -298,10 +501,20 @@ void oscSetAutosendInterval(uint32_t interval)
 {
   if (interval != osc.autosendPeriod && interval > 1 && interval < OSC_AUTOSEND_MAX_INTERVAL) {
     osc.autosendPeriod = interval;
-    eepromWrite(EEPROM_OSC_ASYNC_INTERVAL, interval);
+    settingsWrite(EEPROM_OSC_ASYNC_INTERVAL, interval);
   }
 }
 
+/*
+  Get a copy of every message the autosenders create, in addition to the autosend destination.
+  The listener is called from the autosend thread, so it should be quick about it.
+  Only one listener at a time - pass 0 to remove it.
+*/
+void oscSetAutosendListener(OscAutosendListener listener)
+{
+  osc.autosendListener = listener;
+}
+
 OscChannelData* oscGetChannelByType(OscChannel ct)
 {
 #ifdef MAKE_CTRL_USB
@@ -329,17 +542,26 @@ void oscUnlockChannel(OscChannel ct)
   chMtxUnlock();
 }
 
+/*
+  Empty a channel's outgoing buffer, and give it back to the pool -
+  the next message will get a fresh one.
+*/
 void oscResetChannel(OscChannelData* channel)
 {
-  channel->outBufRemaining = sizeof(channel->outBuf);
-  channel->outBufPtr = channel->outBuf;
+  if (channel->outBuf != 0) {
+    poolFree(&oscOutPool, channel->outBuf);
+    channel->outBuf = 0;
+  }
+  channel->outBufRemaining = 0;
+  channel->outBufPtr = 0;
   channel->outMsgCount = 0;
 }
 
 /*
   A new packet has arrived.  Check if it's a single message or a
-  bundle and process accordingly. If any response messages were
-  generated during processing, send them off.
+  bundle and process accordingly.  Any replies are left in the channel's
+  buffer - call oscSendPendingMessages() to send them off.
+  The packet is modified in place as it's parsed.
 */
 void oscReceivePacket(OscChannel ch, char* data, uint32_t len)
 {
@@ -396,17 +618,21 @@ void oscReceiveMessage(OscChannel ch, char* data, uint32_t len)
  */
 bool oscDispatchNode(OscChannel ch, char* addr, char* fulladdr, const OscNode* node, OscData data[], int datalen)
 {
-  char* nextPattern = strchr(addr, '/');
-  if (nextPattern != 0)
-    *nextPattern++ = 0;
-
   if (node->handler != NULL) {
+    traceEvent(TRACE_OSC_DISPATCH, datalen);
     node->handler(ch, fulladdr, 0, data, datalen);
+    traceEvent(TRACE_OSC_DISPATCH | TRACE_END, datalen);
     return true;
   }
+  if (addr == 0) // the address ran out before we got to a handler
+    return false;
+
+  char* nextPattern = strchr(addr, '/');
+  if (nextPattern != 0)
+    *nextPattern++ = 0;
 
   uint8_t i;
-  if (node->range > 0) {
+  if (node->range > 0 && nextPattern != 0) {
     // as part of our cheat, ranges can only be the second to last node.
     // we jump down a level here since we are planning on getting to the handler
     // without traversing the tree any further
@@ -421,7 +647,9 @@ bool oscDispatchNode(OscChannel ch, char* addr, char* fulladdr, const OscNode* n
             // recreate an address specific to this index, in the case that we got here
             // through a pattern match
             siprintf(endofaddr, "/%d/%s", idx, node->children[i]->name);
+            traceEvent(TRACE_OSC_DISPATCH, datalen);
             node->children[i]->handler(ch, fulladdr, idx, data, datalen);
+            traceEvent(TRACE_OSC_DISPATCH | TRACE_END, datalen);
           }
           return true;
         }
@@ -434,14 +662,118 @@ bool oscDispatchNode(OscChannel ch, char* addr, char* fulladdr, const OscNode* n
   // otherwise, go down to the next level and try some more
   for (i = 0; node->children[i] != 0; ++i) {
     if (oscPatternMatch(addr, node->children[i]->name)) {
-      *(nextPattern - 1) = '/'; // replace this - we nulled it earlier
+      if (nextPattern != 0)
+        *(nextPattern - 1) = '/'; // replace this - we nulled it earlier
       if (oscDispatchNode(ch, nextPattern, fulladdr, node->children[i], data, datalen))
         return true;
+      if (nextPattern != 0)
+        *(nextPattern - 1) = 0; // nothing down there - split it again to try the rest
     }
   }
+  // leave the address the way we found it, for whoever tries next
+  if (nextPattern != 0)
+    *(nextPattern - 1) = '/';
   return false;
 }
 
+/*
+  Send a message to the OSC tree as if it had just arrived, but on no channel - any replies
+  are dropped, unless this is part of an oscQuery().
+  Returns true if a handler took it.
+*/
+bool oscDispatch(const char* address, OscData data[], int datalen)
+{
+  char fulladdr[OSC_MAX_ADDRESS];
+  // leave room to rewrite range addresses, as oscDispatchNode() does
+  if (address[0] != '/' || strlen(address) > sizeof(fulladdr) - 8)
+    return false;
+  strcpy(fulladdr, address);
+  return oscDispatchNode(NONE, fulladdr + 1, fulladdr, &oscRoot, data, datalen);
+}
+
+/*
+  Whether the node at path could be at or below the address being queried -
+  one of them has to start with the other, and split at a /
+*/
+static bool oscQueryWanted(const char* path, const char* prefix, int prefixlen)
+{
+  int i;
+  for (i = 0; path[i] != 0 && i < prefixlen; i++) {
+    if (path[i] != prefix[i])
+      return false;
+  }
+  if (path[i] == 0)
+    return i == prefixlen || prefix[i] == '/';
+  return path[i] == '/';
+}
+
+/*
+  Read each property below node.  fulladdr holds the address of node, and has room
+  for OSC_MAX_ADDRESS characters.  Like oscDispatchNode(), the children of a range node
+  are expected to have handlers.
+*/
+static void oscQueryNode(char* fulladdr, const OscNode* node, const char* prefix, int prefixlen)
+{
+  uint8_t i;
+  char* end = fulladdr + strlen(fulladdr);
+  // keep a little room, since some handlers add to the address for their replies
+  int room = OSC_MAX_ADDRESS - (end - fulladdr) - 8;
+
+  if (node->range > 0) {
+    OscRange r;
+    oscNumberMatch("*", node->rangeOffset, node->range, &r);
+    while (oscRangeHasNext(&r)) {
+      int idx = oscRangeNext(&r);
+      for (i = 0; node->children[i] != 0; i++) {
+        const OscNode* child = node->children[i];
+        if (child->handler == 0 || sniprintf(end, room, "/%d/%s", idx, child->name) >= room)
+          continue;
+        if (oscQueryWanted(fulladdr, prefix, prefixlen))
+          child->handler(NONE, fulladdr, idx, 0, 0);
+      }
+    }
+  }
+  else {
+    for (i = 0; node->children[i] != 0; i++) {
+      const OscNode* child = node->children[i];
+      if (sniprintf(end, room, "/%s", child->name) >= room || !oscQueryWanted(fulladdr, prefix, prefixlen))
+        continue;
+      if (child->handler != 0)
+        child->handler(NONE, fulladdr, 0, 0, 0);
+      else
+        oscQueryNode(fulladdr, child, prefix, prefixlen);
+    }
+  }
+  *end = 0;
+}
+
+/*
+  Read every property at or below an address, all in one go - "/" for the whole tree,
+  "/appled" for just the LEDs, and so on.  Each handler is called as if it had been sent a
+  message with no arguments, and each reply is passed to handler rather than being sent anywhere.
+  Handlers are called from this thread.  Only one query runs at a time.
+  Returns the number of replies.
+*/
+int oscQuery(const char* address, OscReplyHandler handler, void* context)
+{
+  char fulladdr[OSC_MAX_ADDRESS];
+  int replies, len = strlen(address);
+  if (len > 0 && address[len - 1] == '/') // "/system/" is the same as "/system"
+    len--;
+
+  chMtxLock(&oscQueryLock);
+  osc.queryHandler = handler;
+  osc.queryContext = context;
+  osc.queryReplies = 0;
+  osc.queryThd = chThdSelf();
+  fulladdr[0] = 0;
+  oscQueryNode(fulladdr, &oscRoot, address, len);
+  osc.queryThd = 0;
+  replies = osc.queryReplies;
+  chMtxUnlock();
+  return replies;
+}
+
 static void oscNameSpaceQueryEndpoint(OscChannel ch, char *fulladdr, const OscNode* node)
 {
   uint8_t i;
@@ -556,8 +888,8 @@ uint32_t oscExtractData(char* buf, uint32_t len, OscData data[], int datacount)
         uint32_t bloblen;
         if ((buf = oscDecodeBlob(buf, &len, &b, &bloblen)) != NULL) {
           data[items].type = BLOB;
+          data[items].bloblen = bloblen;
           data[items++].value.b = b;
-          // TODO - need some way to represent the blob len
         }
         break;
       }
@@ -568,6 +900,13 @@ uint32_t oscExtractData(char* buf, uint32_t len, OscData data[], int datacount)
 
 static char* oscDoCreateMessage(OscChannelData* chd, const char* address, OscData* data, int datacount)
 {
+  if (chd->outBuf == 0) {
+    if ((chd->outBuf = poolAlloc(&oscOutPool)) == 0)
+      return 0;
+    chd->outBufPtr = chd->outBuf;
+    chd->outBufRemaining = OSC_MAX_MSG_OUT;
+    chd->outMsgCount = 0;
+  }
   // temporary vals for these guys, since we might fail
   // and don't want to affect the real pointers in that case
   char* buf = chd->outBufPtr;
@@ -617,7 +956,7 @@ static char* oscDoCreateMessage(OscChannelData* chd, const char* address, OscDat
         buf = oscEncodeString(buf, &len, data[i].value.s);
         break;
       case BLOB:
-        buf = oscEncodeBlob(buf, &len, data[i].value.b, 100); // TODO: don't be lame with length
+        buf = oscEncodeBlob(buf, &len, data[i].value.b, data[i].bloblen);
         break;
     }
   }
@@ -639,6 +978,15 @@ bool oscCreateMessage(OscChannel ch, const char* address, OscData* data, int dat
 {
   OscChannelData* chd = oscGetChannelByType(ch);
   bool rv = true;
+  if (osc.autosendListener != 0 && osc.autosendThd != 0 && chThdSelf() == osc.autosendThd)
+    osc.autosendListener(address, data, datacount);
+  if (ch == NONE && osc.queryThd != 0 && chThdSelf() == osc.queryThd) {
+    osc.queryReplies++;
+    osc.queryHandler(osc.queryContext, address, data, datacount);
+    return true;
+  }
+  if (chd == 0)
+    return false;
   // Try to create the message. If it fails, send any messages
   // in the buffer and try again.
   if (oscDoCreateMessage(chd, address, data, datacount) == NULL) {
@@ -656,11 +1004,15 @@ bool oscCreateMessage(OscChannel ch, const char* address, OscData* data, int dat
 int oscSendPendingMessages(OscChannel ch)
 {
   OscChannelData* chd = oscGetChannelByType(ch);
-  if (chd->outMsgCount == 0)
+  if (chd == 0)
     return 0;
+  if (chd->outMsgCount == 0) {
+    oscResetChannel(chd); // hand back a buffer nothing fit into
+    return 0;
+  }
   // set the buffer and length up
   char* data = chd->outBuf;
-  int len = sizeof(chd->outBuf) - chd->outBufRemaining;
+  int len = OSC_MAX_MSG_OUT - chd->outBufRemaining;
   // if we only have 1 message, skip past the bundle preamble
   // which has already been written to the buffer
   if (chd->outMsgCount == 1) {
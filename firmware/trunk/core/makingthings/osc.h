@@ -27,12 +27,17 @@ typedef struct OscData_t {
     char* s;
     char* b;
   } value;
+  uint32_t bloblen; // number of bytes at value.b, for BLOB data
 } OscData;
 
 typedef void (*OscHandler)(OscChannel ch, char* address, int idx, OscData data[], int datalen);
 
 typedef void (*OscAutosender)(OscChannel ch);
 
+typedef void (*OscAutosendListener)(const char* address, OscData* data, int datacount);
+
+typedef void (*OscReplyHandler)(void* context, const char* address, OscData* data, int datacount);
+
 // should typically be declared const so they're located in read-only storage.
 typedef struct OscNode_t {
   const char* name;
@@ -61,6 +66,10 @@ OscChannel oscAutosendDestination(void);
 void oscSetAutosendDestination(OscChannel oc);
 uint32_t oscAutosendInterval(void);
 void oscSetAutosendInterval(uint32_t interval);
+void oscSetAutosendListener(OscAutosendListener listener);
+void oscReceivePacket(OscChannel ch, char* data, uint32_t len);
+bool oscDispatch(const char* address, OscData data[], int datalen);
+int  oscQuery(const char* address, OscReplyHandler handler, void* context);
 #ifdef __cplusplus
 }
 #endif
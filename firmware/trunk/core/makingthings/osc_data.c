@@ -20,7 +20,7 @@
 
 static char* oscNullPad(char* buf, uint32_t* remaining, int elementsize)
 {
-  uint32_t padding = elementsize % OSC_BYTE_ALIGN;
+  uint32_t padding = (OSC_BYTE_ALIGN - (elementsize % OSC_BYTE_ALIGN)) % OSC_BYTE_ALIGN;
   if (*remaining < padding || buf == 0)
     return 0;
   while (padding--) {
@@ -73,12 +73,12 @@ char* oscEncodeFloat32(char* buf, uint32_t* remaining, float f)
 
 char* oscEncodeBlob(char* buf, uint32_t* remaining, const char* b, uint32_t len)
 {
-  if (*remaining < len || buf == 0)
+  if (*remaining < len + sizeof(int) || buf == 0)
     return 0;
   buf = oscEncodeInt32(buf, remaining, len);
-  *remaining -= (len + 4); // account for 4 bytes of len itself 
-  while (len--)
-    *buf++ = *b++;
+  memcpy(buf, b, len);
+  buf += len;
+  *remaining -= len;
   return oscNullPad(buf, remaining, len);
 }
 
@@ -137,11 +137,12 @@ char* oscDecodeBlob(char* buf, uint32_t* remaining, char** blob, uint32_t* len)
   if (buf == 0)
     return 0;
   buf = oscDecodeInt32(buf, remaining, (int*)len);
-  if (*remaining < *len)
+  uint32_t padded = (*len + OSC_BYTE_ALIGN - 1) & ~(OSC_BYTE_ALIGN - 1);
+  if (buf == 0 || *remaining < padded)
     return 0;
   *blob = buf;
-  *remaining -= *len;
-  buf += *len;
+  *remaining -= padded;
+  buf += padded;
   return buf;
 }
 
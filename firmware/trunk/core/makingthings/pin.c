@@ -398,6 +398,8 @@ void pinEnableHandler(PinInterrupt* pi)
 static void pinServeInterrupt(Group group)
 {
   unsigned int status = group->PIO_ISR & group->PIO_IMR;
+  int served = 0;
+  traceEventFromIsr(TRACE_PIN_INTERRUPT, (group == AT91C_BASE_PIOA) ? 0 : 1);
   // Check pending events
   PinInterrupt* pi = interrupts;
   while (pi != 0 && status != 0) {
@@ -405,9 +407,11 @@ static void pinServeInterrupt(Group group)
     if ((IOPORT(pi->pin) == group) && ((status & pinMask) != 0)) {
       pi->handler();          // callback the handler
       status &= ~(pinMask);   // mark this channel as serviced
+      served++;
     }
     pi = pi->next;
   }
+  traceEventFromIsr(TRACE_PIN_INTERRUPT | TRACE_END, served);
 }
 
 static CH_IRQ_HANDLER(pinIsrA) {
@@ -0,0 +1,138 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "core.h"
+#include "pool.h"
+
+static Pool* pools; // every pool that's been used, newest first
+
+/**
+  \defgroup pool Pool
+  Fixed size blocks of memory, with a record of how close each pool came to running out.
+
+  Buffers that are only needed some of the time - while a message is being put together, or a
+  connection is being served - can come from a pool rather than being set aside for good.  Each
+  pool is a fixed number of blocks of one size, so getting and returning a block is quick and
+  never fragments memory, and the blocks are set aside when your program is built, so you'll know
+  right away if there isn't room for them.
+
+  Each pool keeps track of the most blocks that were ever in use at once, and how many times a
+  block was asked for when there weren't any left.  Check these under load with \b /system/memory
+  (see \ref SystemOSC) - if the peak never reaches the count, the pool is bigger than it needs to
+  be, and if there are failures, it's too small.
+  \code
+  POOL_DECL(myPool, "mine", 128, 4); // 4 blocks of 128 bytes
+
+  void doSomething()
+  {
+    char* buf = poolAlloc(&myPool);
+    if (buf != 0) {
+      // ...use it...
+      poolFree(&myPool, buf);
+    }
+  }
+  \endcode
+
+  The core keeps the OSC message buffers in pools, and the web server keeps its request buffers in one.
+  \ingroup Core
+  @{
+*/
+
+/*
+  Pools are loaded the first time a block is asked for, so they can be declared statically
+  anywhere without an init call.  Call with the system locked.
+*/
+static void poolLoadI(Pool* pool)
+{
+  int i;
+  chPoolInit(&pool->mp, pool->size, NULL);
+  for (i = 0; i < pool->count; i++)
+    chPoolFreeI(&pool->mp, (uint8_t*)pool->blocks + (i * pool->size));
+  pool->next = pools;
+  pools = pool;
+  pool->loaded = true;
+}
+
+/**
+  Get a block from a pool.
+  This doesn't wait for one to be returned if they're all in use.
+  @param pool The pool.
+  @return The block, or 0 if there aren't any left.
+*/
+void* poolAlloc(Pool* pool)
+{
+  chSysLock();
+  if (!pool->loaded)
+    poolLoadI(pool);
+  void* block = chPoolAllocI(&pool->mp);
+  if (block != 0) {
+    if (++pool->used > pool->peak)
+      pool->peak = pool->used;
+  }
+  else
+    pool->failures++;
+  chSysUnlock();
+  return block;
+}
+
+/**
+  Return a block to its pool.
+  @param pool The pool it came from.
+  @param block The block.
+*/
+void poolFree(Pool* pool, void* block)
+{
+  chSysLock();
+  chPoolFreeI(&pool->mp, block);
+  pool->used--;
+  chSysUnlock();
+}
+
+/**
+  Step through the pools that have been used so far.
+  @param previous The pool returned by the last call, or 0 to start with the first one.
+  @return The next pool, or 0 once they've all been seen.
+
+  \b Example
+  \code
+  Pool* pool = 0;
+  while ((pool = poolNext(pool)) != 0) {
+    // look at pool->peak and pool->failures
+  }
+  \endcode
+*/
+Pool* poolNext(Pool* previous)
+{
+  return (previous == 0) ? pools : previous->next;
+}
+
+/**
+  Start the peak and failure counts of every pool over again.
+  Handy before a test, so you only see what happened during it.
+*/
+void poolResetStats()
+{
+  Pool* pool;
+  chSysLock();
+  for (pool = pools; pool != 0; pool = pool->next) {
+    pool->peak = pool->used;
+    pool->failures = 0;
+  }
+  chSysUnlock();
+}
+
+/** @} */
@@ -0,0 +1,66 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "types.h"
+#include "ch.h"
+
+/**
+  A pool of fixed size blocks - declare one with POOL_DECL.
+  \ingroup pool
+*/
+typedef struct Pool_t {
+  MemoryPool mp;
+  const char* name;   /**< The name it's reported under. */
+  void* blocks;
+  uint16_t size;      /**< Bytes in each block. */
+  uint16_t count;     /**< Number of blocks. */
+  uint16_t used;      /**< Blocks handed out right now. */
+  uint16_t peak;      /**< The most blocks that have been handed out at once. */
+  uint32_t failures;  /**< Number of times a block was asked for when there weren't any left. */
+  bool loaded;
+  struct Pool_t* next;
+} Pool;
+
+#define POOL_BLOCK_SIZE(size) (((size) + 3) & ~3)
+
+/**
+  Declare a pool.  It's static, so blocks are only handed out by the file that declares it.
+  @param pool The name of the Pool variable.
+  @param label The name it's reported under.
+  @param blocksize Bytes in each block.
+  @param blockcount Number of blocks.
+  \ingroup pool
+*/
+#define POOL_DECL(pool, label, blocksize, blockcount) \
+  static uint32_t pool##Blocks[(blockcount) * POOL_BLOCK_SIZE(blocksize) / 4]; \
+  static Pool pool = { .name = label, .blocks = pool##Blocks, .size = POOL_BLOCK_SIZE(blocksize), .count = blockcount }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void* poolAlloc(Pool* pool);
+void  poolFree(Pool* pool, void* block);
+Pool* poolNext(Pool* previous);
+void  poolResetStats(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POOL_H
@@ -0,0 +1,116 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "core.h"
+#include "profiler.h"
+
+#if CH_USE_REGISTRY && CH_DBG_THREADS_PROFILING
+
+#ifndef STACK_FILL_VALUE
+#define STACK_FILL_VALUE 0x55
+#endif
+
+/**
+  \defgroup profiler Profiler
+  See which threads are using the processor, and how close each is to running out of stack.
+
+  When a program gets big enough, it's hard to tell where the time is going, or whether a thread
+  is about to run off the end of its working area - that usually shows up as a crash somewhere else entirely.
+  The profiler looks at every thread in the system, and tells you:
+  - how much of the processor it's been using.  ChibiOS counts the system ticks each thread is
+  running for (every millisecond), so threads that only run for a moment at a time are estimated, but
+  over a second or so it adds up to a good picture.
+  - how much of its stack has never been used.  Each working area is filled with a known value when
+  its thread is created, so anything that still holds that value has never been touched.  If that's getting
+  close to 0, give the thread a bigger working area.
+
+  \code
+  ProfilerThread info;
+  Thread* tp = 0;
+  while ((tp = profilerNextThread(tp, &info)) != 0) {
+    // look at info.cpu and info.stackFree
+  }
+  \endcode
+
+  The first thread is main(), which runs loop() on the processor's system stack rather than in a
+  working area, so its stack can't be measured.  The idle thread runs whenever nothing else needs
+  to - its share of the processor is how much is left over.
+
+  The same report is available over OSC - see \ref SystemOSC.
+
+  The profiler needs \b CH_USE_REGISTRY, \b CH_DBG_FILL_THREADS and \b CH_DBG_THREADS_PROFILING, which
+  are all on in chconf.h.
+  \ingroup Core
+  @{
+*/
+
+/**
+  Get the profile of the next thread.
+  @param previous The thread returned by the last call, or 0 to start with the first thread.
+  @param info The ProfilerThread to fill in.
+  @return The next thread, or 0 once they've all been seen.
+*/
+Thread* profilerNextThread(Thread* previous, ProfilerThread* info)
+{
+  Thread* tp = (previous == 0) ? chRegFirstThread() : chRegNextThread(previous);
+  if (tp == 0)
+    return 0;
+
+  chSysLock();
+  systime_t now = chTimeNow();
+  systime_t ticks = tp->p_time;
+  systime_t elapsed = now - tp->p_profiledAt;
+  systime_t ran = ticks - tp->p_profiledTicks;
+  tp->p_profiledAt = now;
+  tp->p_profiledTicks = ticks;
+  info->priority = tp->p_prio;
+  info->state = tp->p_state;
+  chSysUnlock();
+
+  info->thread = tp;
+  info->ticks = ticks;
+  info->cpu = (elapsed > 0) ? (int)(((uint64_t)ran * 100) / elapsed) : 0;
+  // main() is the first thread, and has no working area
+  info->stackFree = (previous == 0) ? -1 : profilerStackFree(tp);
+  return tp;
+}
+
+/**
+  How much of a thread's working area has never been used.
+  The stack starts at the top of the working area and grows down towards the
+  Thread structure at the bottom, so count up from there.
+  @param tp The thread to check.  Don't use this on the main() thread.
+  @return The number of bytes.
+*/
+int profilerStackFree(Thread* tp)
+{
+#if CH_DBG_FILL_THREADS
+  const uint8_t* p = (const uint8_t*)(tp + 1);
+  int unused = 0;
+  // the top of the stack always holds the thread's saved context, so this will stop
+  while (*p++ == STACK_FILL_VALUE)
+    unused++;
+  return unused;
+#else
+  UNUSED(tp);
+  return -1;
+#endif
+}
+
+/** @} */
+
+#endif // CH_USE_REGISTRY && CH_DBG_THREADS_PROFILING
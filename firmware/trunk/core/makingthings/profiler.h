@@ -0,0 +1,46 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "types.h"
+#include "ch.h"
+
+/**
+  What the profiler knows about a thread, from profilerNextThread().
+  \ingroup profiler
+*/
+typedef struct ProfilerThread_t {
+  Thread* thread;     /**< The thread - its working area starts here. */
+  int priority;       /**< Its current priority. */
+  int state;          /**< Its ChibiOS state - running, sleeping, waiting on a semaphore and so on. */
+  int stackFree;      /**< Bytes of its working area that have never been used, or -1 if it can't be measured. */
+  uint32_t ticks;     /**< System ticks it has spent running since it started. */
+  int cpu;            /**< The percentage of time it's been running since the last time it was profiled. */
+} ProfilerThread;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+Thread* profilerNextThread(Thread* previous, ProfilerThread* info);
+int  profilerStackFree(Thread* tp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,290 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "core.h"
+#include "settings.h"
+
+#ifndef SETTINGS_CACHE_SIZE
+#define SETTINGS_CACHE_SIZE 256 // must be a multiple of EEPROM_PAGE_SIZE
+#endif
+
+#ifndef SETTINGS_FLUSH_DELAY
+#define SETTINGS_FLUSH_DELAY 2000
+#endif
+
+#ifndef SETTINGS_STACK_SIZE
+#define SETTINGS_STACK_SIZE 384
+#endif
+
+#ifndef SETTINGS_THREAD_PRIORITY
+#define SETTINGS_THREAD_PRIORITY LOWPRIO
+#endif
+
+#define SETTINGS_PAGES (SETTINGS_CACHE_SIZE / EEPROM_PAGE_SIZE)
+
+typedef struct Settings_t {
+  Mutex lock;                         // the cache and dirty ranges - only held briefly
+  Mutex saving;                       // held while writing to EEPROM, so writes land in order
+  Semaphore changed;
+  bool loaded;
+  uint8_t dirtyStart[SETTINGS_PAGES]; // dirty byte range within each page -
+  uint8_t dirtyEnd[SETTINGS_PAGES];   // the page is clean when start > end
+  uint8_t cache[SETTINGS_CACHE_SIZE];
+} Settings;
+
+static Settings settings;
+
+/**
+  \defgroup settings Settings
+  A RAM copy of the board's settings in EEPROM.
+  The Make Controller keeps its configuration - network address, OSC ports, board name, autosend
+  settings and so on - in the reserved system area at the top of the \ref eeprom.  Rather than
+  hitting the EEPROM every time one of these is read or changed, the first \b SETTINGS_CACHE_SIZE
+  bytes of the system area (256 by default) are loaded into RAM at startup.
+
+  Reads come straight from RAM.  Writes only update RAM and note which bytes changed - once
+  there have been no changes for \b SETTINGS_FLUSH_DELAY milliseconds (2000 by default), a low
+  priority thread writes the changed bytes back, one page-aligned block write per EEPROM page.  Writing a
+  value that's already stored doesn't touch the EEPROM at all.  Call settingsSave() (or send
+  \b /system/save 1) to write any changes out right away.
+
+  Addresses are the same \b EEPROM_ addresses from eeprom.h.  Anything outside the cached area
+  goes straight to the EEPROM - if a block is only partly in it, that part of the RAM copy is kept
+  up to date as well.
+
+  settingsInit() is called during system startup, but you can prevent it by defining
+  \b NO_SETTINGS_INIT in your config.h file - settings will then be read and written directly
+  from EEPROM.
+  \ingroup Core
+  @{
+*/
+
+/*
+  How much of a block is in the cache - *from is set to where that part starts in the
+  block, and *offset to where it starts in the cache.
+*/
+static int settingsCached(int address, int length, int* from, int* offset)
+{
+  int start = MAX(address, EEPROM_SYSTEM_BASE);
+  int end = MIN(address + length, EEPROM_SYSTEM_BASE + SETTINGS_CACHE_SIZE);
+  if (!settings.loaded || start >= end)
+    return 0;
+  *from = start - address;
+  *offset = start - EEPROM_SYSTEM_BASE;
+  return end - start;
+}
+
+static void settingsMarkDirty(int offset, int length)
+{
+  int page = offset / EEPROM_PAGE_SIZE;
+  uint8_t pos = offset % EEPROM_PAGE_SIZE;
+  settings.dirtyStart[page] = MIN(settings.dirtyStart[page], pos);
+  settings.dirtyEnd[page] = MAX(settings.dirtyEnd[page], pos + length - 1);
+}
+
+static WORKING_AREA(waSettingsThd, SETTINGS_STACK_SIZE);
+static msg_t SettingsThread(void *arg)
+{
+  UNUSED(arg);
+  while (!chThdShouldTerminate()) {
+    chSemWait(&settings.changed);
+    // keep putting it off until the changes stop coming
+    while (chSemWaitTimeout(&settings.changed, MS2ST(SETTINGS_FLUSH_DELAY)) == RDY_OK)
+      ;
+    settingsSave();
+  }
+  return 0;
+}
+
+/**
+  Load the settings from EEPROM and start the thread that writes changes back.
+  This is done automatically during system startup, unless \b NO_SETTINGS_INIT is defined.
+*/
+void settingsInit()
+{
+  int i;
+  chMtxInit(&settings.lock);
+  chMtxInit(&settings.saving);
+  chSemInit(&settings.changed, 0);
+  for (i = 0; i < SETTINGS_PAGES; i++) {
+    settings.dirtyStart[i] = EEPROM_PAGE_SIZE;
+    settings.dirtyEnd[i] = 0;
+  }
+  if (eepromReadBlock(EEPROM_SYSTEM_BASE, settings.cache, SETTINGS_CACHE_SIZE) == CONTROLLER_OK) {
+    settings.loaded = true;
+    chThdCreateStatic(waSettingsThd, sizeof(waSettingsThd), SETTINGS_THREAD_PRIORITY, SettingsThread, NULL);
+  }
+}
+
+/**
+  Read an int setting.
+  @param address The address to read from - one of the \b EEPROM_ addresses.
+  @return The value stored at that address.
+
+  \b Example
+  \code
+  int port = settingsRead(EEPROM_OSC_UDP_LISTEN_PORT);
+  \endcode
+*/
+int settingsRead(int address)
+{
+  int val;
+  settingsReadBlock(address, (uint8_t*)&val, 4);
+  return val;
+}
+
+/**
+  Write an int setting.
+  The new value is readable right away, and written to EEPROM a little later.
+  @param address The address to write to - one of the \b EEPROM_ addresses.
+  @param value The value to store.
+
+  \b Example
+  \code
+  settingsWrite(EEPROM_OSC_UDP_LISTEN_PORT, 10000);
+  \endcode
+*/
+void settingsWrite(int address, int value)
+{
+  settingsWriteBlock(address, (uint8_t*)&value, 4);
+}
+
+/**
+  Read a block of settings.
+  @param address The address to start reading from.
+  @param data Where to read the data into.
+  @param length How many bytes to read.
+  @return 0 on success.
+*/
+int settingsReadBlock(int address, uint8_t* data, int length)
+{
+  int from, offset, rv;
+  int cached = settingsCached(address, length, &from, &offset);
+  if (cached < length && (rv = eepromReadBlock(address, data, length)) != CONTROLLER_OK)
+    return rv;
+  if (cached > 0) { // the cache has any changes that haven't been saved yet
+    chMtxLock(&settings.lock);
+    memcpy(data + from, settings.cache + offset, cached);
+    chMtxUnlock();
+  }
+  return CONTROLLER_OK;
+}
+
+/**
+  Write a block of settings.
+  Only the bytes that actually change are marked to be written back to EEPROM.
+  @param address The address to start writing at.
+  @param data The data to write.
+  @param length How many bytes to write.
+  @return 0 on success.
+*/
+int settingsWriteBlock(int address, const uint8_t* data, int length)
+{
+  int i, from, offset, rv;
+  int cached = settingsCached(address, length, &from, &offset);
+  if (cached < length) {
+    if (cached == 0)
+      return eepromWriteBlock(address, (uint8_t*)data, length);
+    // it's going straight to EEPROM, so keep the part that's in the cache in step -
+    // hold off saves, so one can't write older values over it afterwards
+    chMtxLock(&settings.saving);
+    chMtxLock(&settings.lock);
+    memcpy(settings.cache + offset, data + from, cached);
+    chMtxUnlock();
+    rv = eepromWriteBlock(address, (uint8_t*)data, length);
+    chMtxUnlock();
+    return rv;
+  }
+
+  bool changed = false;
+  chMtxLock(&settings.lock);
+  for (i = 0; i < length; i++, offset++) {
+    if (settings.cache[offset] != data[i]) {
+      settings.cache[offset] = data[i];
+      settingsMarkDirty(offset, 1);
+      changed = true;
+    }
+  }
+  chMtxUnlock();
+  if (changed)
+    chSemSignal(&settings.changed);
+  return CONTROLLER_OK;
+}
+
+/**
+  Write any changed settings to EEPROM right away.
+  Changes are written automatically once things have been quiet for a bit, so you
+  only need this if you're about to reset or power down.
+  @return 0 on success.
+
+  \b Example
+  \code
+  networkSetAddress(IP_ADDRESS(192, 168, 0, 100), IP_ADDRESS(255, 255, 255, 0), IP_ADDRESS(192, 168, 0, 1));
+  settingsSave();
+  systemReset(YES);
+  \endcode
+*/
+int settingsSave()
+{
+  int page, rv = CONTROLLER_OK;
+  uint8_t block[EEPROM_PAGE_SIZE];
+  if (!settings.loaded)
+    return rv;
+
+  chMtxLock(&settings.saving);
+  for (page = 0; page < SETTINGS_PAGES; page++) {
+    // take a copy of what's changed, so reads and writes don't wait on the EEPROM
+    chMtxLock(&settings.lock);
+    if (settings.dirtyStart[page] > settings.dirtyEnd[page]) {
+      chMtxUnlock();
+      continue;
+    }
+    int start = (page * EEPROM_PAGE_SIZE) + settings.dirtyStart[page];
+    int length = settings.dirtyEnd[page] - settings.dirtyStart[page] + 1;
+    memcpy(block, settings.cache + start, length);
+    settings.dirtyStart[page] = EEPROM_PAGE_SIZE;
+    settings.dirtyEnd[page] = 0;
+    chMtxUnlock();
+
+    // the dirty range never crosses a page, so this is a single EEPROM write cycle
+    rv = eepromWriteBlock(EEPROM_SYSTEM_BASE + start, block, length);
+    if (rv != CONTROLLER_OK) {
+      chMtxLock(&settings.lock);
+      settingsMarkDirty(start, length); // try again next time
+      chMtxUnlock();
+      break;
+    }
+  }
+  chMtxUnlock();
+  return rv;
+}
+
+/**
+  Check whether there are changes that haven't been written to EEPROM yet.
+  @return True if there are unsaved changes.
+*/
+bool settingsUnsaved()
+{
+  int page;
+  for (page = 0; page < SETTINGS_PAGES; page++) {
+    if (settings.dirtyStart[page] <= settings.dirtyEnd[page])
+      return true;
+  }
+  return false;
+}
+
+/** @} */
@@ -0,0 +1,37 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void settingsInit(void);
+int  settingsRead(int address);
+void settingsWrite(int address, int value);
+int  settingsReadBlock(int address, uint8_t* data, int length);
+int  settingsWriteBlock(int address, const uint8_t* data, int length);
+int  settingsSave(void);
+bool settingsUnsaved(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SETTINGS_H
@@ -77,7 +77,7 @@ int systemFreeMemory()
 */
 int systemSerialNumber()
 {
-  return eepromRead(EEPROM_SYSTEM_SERIAL_NUMBER) & 0xFFFF;
+  return settingsRead(EEPROM_SYSTEM_SERIAL_NUMBER) & 0xFFFF;
 }
 
 /**
@@ -96,7 +96,7 @@ int systemSerialNumber()
 */
 int systemSetSerialNumber(int serial)
 {
-  eepromWrite(EEPROM_SYSTEM_SERIAL_NUMBER, serial & 0xFFFF);
+  settingsWrite(EEPROM_SYSTEM_SERIAL_NUMBER, serial & 0xFFFF);
   return CONTROLLER_OK;
 }
 
@@ -208,11 +208,10 @@ void systemSamba(bool sure)
 */
 int systemSetName(const char* name)
 {
-  int i, length = MIN(strlen(name) + 1, SYSTEM_MAX_NAME);
+  int length = MIN(strlen(name), SYSTEM_MAX_NAME);
   strncpy(sysName, name, length); // update the name in our buffer
-  for (i = 0; i <= length; i++) // have to do this because Eeprom_Write can only go 32 at a time.
-    eepromWriteBlock(EEPROM_SYSTEM_NAME + i, (uint8_t*)name++, 1);
-  return CONTROLLER_OK;
+  sysName[length] = 0;
+  return settingsWriteBlock(EEPROM_SYSTEM_NAME, (uint8_t*)sysName, length + 1);
 }
 
 /**
@@ -230,8 +229,8 @@ const char* systemName()
     const char* ptr = sysName;
     bool legal = false;
     int i;
+    settingsReadBlock(EEPROM_SYSTEM_NAME, (uint8_t*)sysName, SYSTEM_MAX_NAME + 1);
     for (i = 0; i <= SYSTEM_MAX_NAME; i++ ) {
-      eepromReadBlock(EEPROM_SYSTEM_NAME + i, (uint8_t*)ptr, 1);
       if (*ptr == 0)
         break;
       if (!isalnum((int)*ptr) && !isspace((int)*ptr)) {
@@ -289,6 +288,11 @@ void systemReset(bool sure)
     - reset
     - serialnumber
     - version
+    - save
+    - threads
+    - threads-autosend
+    - memory
+    - trace
 
     \par Name
     The \b name property allows you to give a board its own name.  The name can only contain
@@ -334,8 +338,68 @@ void systemReset(bool sure)
     \par
     To read the board's version, send the message
     \verbatim /system/version \endverbatim
+
+    \par Save
+    Settings like the board's name and network address are written to EEPROM a couple of seconds
+    after they stop changing - see \ref settings.  To write any changes right away, send
+    \verbatim /system/save 1 \endverbatim
+    To check whether there are any changes that haven't been written yet, send
+    \verbatim /system/save \endverbatim
+    and the board will respond with 1 if there are, or 0 if not.
+
+    \par Threads
+    The \b threads property is a report from the \ref profiler on every thread running on the board.
+    It's read-only.  To read it, send
+    \verbatim /system/threads \endverbatim
+    and the board responds with a message for each thread, containing
+    - the thread's address in memory, which you can look up in your program's map file
+    - its priority
+    - its state
+    - the number of bytes of stack it has never used, or -1 for the main thread
+    - the number of milliseconds it has spent running
+    - the percentage of time it has been running since the last report
+    \par
+    To have the board send this report every \b SYSTEM_THREADS_PERIOD milliseconds (1000 by default)
+    to the autosend destination, send
+    \verbatim /system/threads-autosend 1 \endverbatim
+
+    \par Memory
+    The \b memory property reports on each \ref pool of memory blocks that's been used - the OSC message
+    buffers and the web server's request buffers, for example.  To read it, send
+    \verbatim /system/memory \endverbatim
+    and the board responds with a message for each pool, containing
+    - the pool's name
+    - the number of bytes in each of its blocks
+    - the number of blocks it has
+    - the number of blocks in use right now
+    - the most blocks that have been in use at once
+    - the number of times a block was needed and there weren't any left
+    \par
+    If the most in use never gets near the number of blocks, there's memory to spare - if blocks ran out,
+    the pool should be bigger.  To start counting those last two over, send
+    \verbatim /system/memory 0 \endverbatim
+
+    \par Trace
+    The \b trace property sends the contents of the \ref trace, if \b MAKE_CTRL_TRACE is defined in
+    your config.h.  Send
+    \verbatim /system/trace \endverbatim
+    and the board responds with a series of messages, each containing
+    - the sequence number of the first event in the message
+    - the number of trace time ticks in a second
+    - a blob of TraceEntry structures
+    \par
+    The \b tracedump tool in \b tools/tracedump does this for you, and writes out a file for Chrome's trace viewer.
+    To clear the trace, send
+    \verbatim /system/trace 0 \endverbatim
 */
 
+#ifndef SYSTEM_THREADS_PERIOD
+#define SYSTEM_THREADS_PERIOD 1000
+#endif
+
+static bool systemThreadsAutosend;
+static systime_t systemThreadsLastSent;
+
 static void systemNameOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
 {
   UNUSED(idx);
@@ -480,6 +544,111 @@ static void systemSerialNumOsc(OscChannel ch, char* address, int idx, OscData d[
   }
 }
 
+static void systemSaveOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx);
+  if (datalen == 0) {
+    OscData oscd = { .type = INT, .value.i = settingsUnsaved() };
+    oscCreateMessage(ch, address, &oscd, 1);
+  }
+  else if (datalen == 1 && d[0].value.i == 1)
+    settingsSave();
+}
+
+static void systemThreadsSend(OscChannel ch, const char* address)
+{
+  ProfilerThread info;
+  Thread* tp = 0;
+  while ((tp = profilerNextThread(tp, &info)) != 0) {
+    OscData d[6] = {
+      { .type = INT, .value.i = (int)info.thread },
+      { .type = INT, .value.i = info.priority },
+      { .type = INT, .value.i = info.state },
+      { .type = INT, .value.i = info.stackFree },
+      { .type = INT, .value.i = ((uint64_t)info.ticks * 1000) / CH_FREQUENCY },
+      { .type = INT, .value.i = info.cpu }
+    };
+    oscCreateMessage(ch, address, d, 6);
+  }
+}
+
+static void systemThreadsOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  if (datalen == 0)
+    systemThreadsSend(ch, address);
+}
+
+static void systemThreadsAutosendOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx);
+  if (datalen == 0) {
+    OscData oscd = { .type = INT, .value.i = systemThreadsAutosend };
+    oscCreateMessage(ch, address, &oscd, 1);
+  }
+  else if (d[0].type == INT)
+    systemThreadsAutosend = (d[0].value.i != 0);
+}
+
+static void systemOscAutosender(OscChannel ch)
+{
+  if (systemThreadsAutosend && chTimeNow() - systemThreadsLastSent >= MS2ST(SYSTEM_THREADS_PERIOD)) {
+    systemThreadsLastSent = chTimeNow();
+    systemThreadsSend(ch, "/system/threads");
+  }
+}
+
+static void systemMemoryOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx);
+  if (datalen == 0) {
+    Pool* pool = 0;
+    while ((pool = poolNext(pool)) != 0) {
+      OscData oscd[6] = {
+        { .type = STRING, .value.s = (char*)pool->name },
+        { .type = INT, .value.i = pool->size },
+        { .type = INT, .value.i = pool->count },
+        { .type = INT, .value.i = pool->used },
+        { .type = INT, .value.i = pool->peak },
+        { .type = INT, .value.i = pool->failures }
+      };
+      oscCreateMessage(ch, address, oscd, 6);
+    }
+  }
+  else if (d[0].type == INT && d[0].value.i == 0)
+    poolResetStats();
+}
+
+#ifdef MAKE_CTRL_TRACE
+
+#ifndef SYSTEM_TRACE_CHUNK
+#define SYSTEM_TRACE_CHUNK 16 // entries per message
+#endif
+
+static void systemTraceOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx);
+  if (datalen == 0) {
+    TraceEntry entries[SYSTEM_TRACE_CHUNK];
+    uint32_t seq = 0, end = traceHead(); // don't chase the events our own replies cause
+    int n;
+    while ((int32_t)(end - seq) > 0 && (n = traceRead(&seq, entries, MIN(SYSTEM_TRACE_CHUNK, (int)(end - seq)))) > 0) {
+      OscData oscd[3] = {
+        { .type = INT, .value.i = seq },
+        { .type = INT, .value.i = traceClock() },
+        { .type = BLOB, .value.b = (char*)entries, .bloblen = n * sizeof(TraceEntry) }
+      };
+      if (!oscCreateMessage(ch, address, oscd, 3))
+        break;
+      seq += n;
+    }
+  }
+  else if (d[0].type == INT && d[0].value.i == 0)
+    traceClear();
+}
+
+#endif // MAKE_CTRL_TRACE
+
 static const OscNode systemNameNode = { .name = "name", .handler = systemNameOsc };
 static const OscNode systemFreememNode = { .name = "freememory", .handler = systemFreememOsc };
 static const OscNode systemResetNode = { .name = "reset", .handler = systemResetOsc };
@@ -490,6 +659,13 @@ static const OscNode systemAutosendIntervalNode = { .name = "autosend-interval",
 static const OscNode systemInfoNode = { .name = "info", .handler = systemInfoOsc };
 static const OscNode systemInfoInternalNode = { .name = "info-internal", .handler = systemInfoOsc };
 static const OscNode systemSerialNumNode = { .name = "serialnumber", .handler = systemSerialNumOsc };
+static const OscNode systemSaveNode = { .name = "save", .handler = systemSaveOsc };
+static const OscNode systemThreadsNode = { .name = "threads", .handler = systemThreadsOsc };
+static const OscNode systemThreadsAutosendNode = { .name = "threads-autosend", .handler = systemThreadsAutosendOsc };
+static const OscNode systemMemoryNode = { .name = "memory", .handler = systemMemoryOsc };
+#ifdef MAKE_CTRL_TRACE
+static const OscNode systemTraceNode = { .name = "trace", .handler = systemTraceOsc };
+#endif
 
 const OscNode systemOsc = {
   .name = "system",
@@ -502,8 +678,17 @@ const OscNode systemOsc = {
     &systemAutosendNode,
     &systemAutosendIntervalNode,
     &systemInfoNode, &systemInfoInternalNode,
-    &systemSerialNumNode, 0
-  }
+    &systemSerialNumNode,
+    &systemSaveNode,
+    &systemThreadsNode,
+    &systemThreadsAutosendNode,
+    &systemMemoryNode,
+    #ifdef MAKE_CTRL_TRACE
+    &systemTraceNode,
+    #endif
+    0
+  },
+  .autosender = systemOscAutosender
 };
 
 #endif // OSC
@@ -112,6 +112,22 @@ int tcpSetReadTimeout(int socket, int timeout)
   return lwip_setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
 }
 
+/**
+  Check whether there's room to write without waiting.
+  A write could still block if it's bigger than the space available, but
+  this is handy for not getting stuck on a client that's stopped reading.
+  @param socket The socket to check.
+  @return True if the socket can take more data right away.
+*/
+bool tcpWriteReady(int socket)
+{
+  fd_set fds;
+  struct timeval timeout = { 0, 0 };
+  FD_ZERO(&fds);
+  FD_SET(socket, &fds);
+  return lwip_select(socket + 1, NULL, &fds, NULL, &timeout) > 0;
+}
+
 /**
   The number of bytes available to be read.
   @return The number of bytes ready to be read.
@@ -185,6 +201,7 @@ int tcpRead(int socket, char* data, int length)
   @param length The maximum number of bytes to read.
   @return The number of bytes of data successfully read.
   @see tcpRead() for a similar example
+  @see tcpStreamReadLine(), which is much faster if you're reading more than a line or two.
 */
 int tcpReadLine(int socket, char* data, int length)
 {
@@ -30,6 +30,7 @@ int  tcpRead(int socket, char* data, int length);
 int  tcpReadLine(int socket, char* data, int length);
 int  tcpWrite(int socket, const char* data, int length);
 int  tcpSetReadTimeout(int socket, int timeout);
+bool tcpWriteReady(int socket);
 #ifdef __cplusplus
 }
 #endif
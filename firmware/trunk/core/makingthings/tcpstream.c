@@ -0,0 +1,196 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "config.h"
+#include "lwipopts.h"
+#if defined(MAKE_CTRL_NETWORK) && LWIP_TCP
+#include "tcpstream.h"
+#include "tcpsocket.h"
+#include <string.h>
+
+/**
+  \defgroup tcpstream TCP Stream
+  Read text-based protocols from a TCP socket efficiently.
+  tcpRead() goes all the way through the network stack each time it's called, so reading a line
+  a byte at a time with tcpReadLine() is slow.  A TcpStream reads from the socket as much as it can
+  in one go, up to \b TCP_STREAM_BUFFER_SIZE bytes (128 by default), and hands it out from there.
+
+  \section Usage
+  Set up a stream for a socket with tcpStreamInit(), then read from the stream instead of the socket.
+  Once you've started reading from a stream, keep reading from the stream - anything it has
+  buffered isn't available from the socket any more.  Writing still goes straight to the socket.
+
+  \code
+  TcpStream stream;
+  char line[64];
+  int sock = tcpOpen(IP_ADDRESS(192, 168, 0, 210), 80);
+  if (sock > -1) {
+    tcpStreamInit(&stream, sock);
+    tcpWrite(sock, "GET / HTTP/1.0\r\n\r\n", 18);
+    while (tcpStreamReadLine(&stream, line, sizeof(line)) > 2) {
+      // a header line - the blank line at the end is just \r\n
+    }
+    tcpClose(sock);
+  }
+  \endcode
+  \ingroup networking
+  @{
+*/
+
+/*
+  Make sure there's something in the buffer, reading from the socket if it's empty.
+  Returns the number of bytes buffered, or <= 0 if the socket has nothing more for us.
+*/
+static int tcpStreamFill(TcpStream* s)
+{
+  if (s->start < s->end)
+    return s->end - s->start;
+  int len = tcpRead(s->socket, s->buf, TCP_STREAM_BUFFER_SIZE);
+  s->start = 0;
+  s->end = (len > 0) ? len : 0;
+  return len;
+}
+
+/**
+  Set up a stream to read from a socket.
+  @param s The stream to set up.
+  @param socket The socket to read from.
+*/
+void tcpStreamInit(TcpStream* s, int socket)
+{
+  s->socket = socket;
+  s->start = s->end = 0;
+}
+
+/**
+  The number of bytes that can be read without waiting.
+  @param s The stream.
+  @return The number of bytes ready to be read.
+*/
+int tcpStreamAvailable(TcpStream* s)
+{
+  int available = tcpAvailable(s->socket);
+  return (s->end - s->start) + ((available > 0) ? available : 0);
+}
+
+/**
+  Read data.
+  Like tcpRead(), this returns what's available, which is not necessarily as much as you asked for.
+  Large reads go straight from the socket into your buffer once the stream's buffer is empty.
+  @param s The stream.
+  @param data Where to store the incoming data.
+  @param length How many bytes of data to read.
+  @return The number of bytes read.
+*/
+int tcpStreamRead(TcpStream* s, char* data, int length)
+{
+  if (s->start == s->end) {
+    if (length >= TCP_STREAM_BUFFER_SIZE)
+      return tcpRead(s->socket, data, length);
+    if (tcpStreamFill(s) <= 0)
+      return 0;
+  }
+  int len = s->end - s->start;
+  if (len > length)
+    len = length;
+  memcpy(data, s->buf + s->start, len);
+  s->start += len;
+  return len;
+}
+
+/**
+  Read exactly the number of bytes asked for.
+  This keeps reading until it has them all, unless the connection closes or times out first.
+  @param s The stream.
+  @param data Where to store the incoming data.
+  @param length How many bytes of data to read.
+  @return The number of bytes read - less than \b length only if the connection ended.
+*/
+int tcpStreamReadExactly(TcpStream* s, char* data, int length)
+{
+  int len, total = 0;
+  while (total < length) {
+    if ((len = tcpStreamRead(s, data + total, length - total)) <= 0)
+      break;
+    total += len;
+  }
+  return total;
+}
+
+/**
+  Read up to and including a particular character.
+  Reading stops after the delimiter, once \b length bytes have been read, or if the connection ends.
+  The data is not null-terminated.
+  @param s The stream.
+  @param data Where to store the incoming data.
+  @param length The maximum number of bytes to read.
+  @param delimiter The character to stop after.
+  @return The number of bytes read, including the delimiter.
+*/
+int tcpStreamReadUntil(TcpStream* s, char* data, int length, char delimiter)
+{
+  int total = 0;
+  while (total < length) {
+    if (tcpStreamFill(s) <= 0)
+      break;
+    char* p = s->buf + s->start;
+    int len = s->end - s->start;
+    if (len > length - total)
+      len = length - total;
+    char* found = memchr(p, delimiter, len);
+    if (found)
+      len = (found - p) + 1;
+    memcpy(data + total, p, len);
+    s->start += len;
+    total += len;
+    if (found)
+      break;
+  }
+  return total;
+}
+
+/**
+  Read a line, as terminated by a newline.
+  The same as tcpReadLine(), the line ending (usually CR LF) is included in the data returned,
+  so an empty line has a length of 2.  The data is not null-terminated.
+  @param s The stream.
+  @param data Where to store the incoming data.
+  @param length The maximum number of bytes to read.
+  @return The number of bytes read.
+*/
+int tcpStreamReadLine(TcpStream* s, char* data, int length)
+{
+  return tcpStreamReadUntil(s, data, length, '\n');
+}
+
+/**
+  Look at the next byte without reading it.
+  This waits for data if none is buffered.
+  @param s The stream.
+  @return The next byte, or -1 if the connection has ended.
+*/
+int tcpStreamPeek(TcpStream* s)
+{
+  if (tcpStreamFill(s) <= 0)
+    return -1;
+  return (uint8_t)s->buf[s->start];
+}
+
+/** @}
+*/
+
+#endif // MAKE_CTRL_NETWORK
@@ -0,0 +1,53 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef TCP_STREAM_H
+#define TCP_STREAM_H
+
+#include "types.h"
+
+#ifndef TCP_STREAM_BUFFER_SIZE
+#define TCP_STREAM_BUFFER_SIZE 128
+#endif
+
+/**
+  A buffered reader for a TCP socket.
+  Set one up with tcpStreamInit().
+  \ingroup tcpstream
+*/
+typedef struct TcpStream_t {
+  int socket;       /**< the socket being read. */
+  uint16_t start;   /**< the next unread byte in buf. */
+  uint16_t end;     /**< the end of the data in buf. */
+  char buf[TCP_STREAM_BUFFER_SIZE];
+} TcpStream;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void tcpStreamInit(TcpStream* s, int socket);
+int  tcpStreamAvailable(TcpStream* s);
+int  tcpStreamRead(TcpStream* s, char* data, int length);
+int  tcpStreamReadExactly(TcpStream* s, char* data, int length);
+int  tcpStreamReadLine(TcpStream* s, char* data, int length);
+int  tcpStreamReadUntil(TcpStream* s, char* data, int length, char delimiter);
+int  tcpStreamPeek(TcpStream* s);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TCP_STREAM_H
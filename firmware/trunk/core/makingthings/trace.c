@@ -0,0 +1,211 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "core.h"
+#include "trace.h"
+
+#ifdef MAKE_CTRL_TRACE
+
+#if (TRACE_SIZE & (TRACE_SIZE - 1)) != 0
+#error "TRACE_SIZE must be a power of 2"
+#endif
+
+#ifdef THUMB
+#error "MAKE_CTRL_TRACE needs the core built in ARM mode (USE_THUMB = no)"
+#endif
+
+typedef struct Trace_t {
+  volatile uint32_t head;  // the sequence number of the next entry to be written
+  uint32_t tail;           // the oldest entry that hasn't been cleared
+  TraceEntry ring[TRACE_SIZE];
+} Trace;
+
+static Trace trace;
+
+/**
+  \defgroup trace Trace
+  A record of what happened, and exactly when.
+
+  When something takes longer than it should every once in a while, it's hard to find out why
+  by looking at averages.  The trace keeps the last \b TRACE_SIZE events (128 by default) in a ring in RAM,
+  each stamped with the time to a fraction of a microsecond, and the thread it happened in.  The core traces
+  OSC handlers being called, writes to USB, the fast timer and pin interrupts, and you can add your own:
+  \code
+  #define MY_EVENT (TRACE_USER + 1)
+
+  void doSomething(int count)
+  {
+    traceEvent(MY_EVENT, count);
+    // ...
+    traceEvent(MY_EVENT | TRACE_END, 0);
+  }
+  \endcode
+  Use traceEventFromIsr() in interrupt handlers.
+
+  Recording an event just fills in the next slot in the ring, so it's quick enough to use anywhere - interrupts
+  are only held off for the few instructions that takes.  Once the ring is full, the oldest events are
+  overwritten.
+
+  Tracing is compiled in only if \b MAKE_CTRL_TRACE is defined in your config.h - otherwise traceEvent() and
+  traceEventFromIsr() compile to nothing, so the trace points cost nothing.
+
+  To get the trace off the board, send \b /system/trace over OSC (see \ref SystemOSC), or run the
+  \b tracedump tool in \b tools/tracedump, which writes it out as a file you can load into Chrome's
+  \b about:tracing viewer.
+  \ingroup Core
+  @{
+*/
+
+/*
+  The PIT is the system tick - count its periods, plus how far it is through the current one.
+  Call with interrupts off, so the tick can't be serviced halfway through.
+*/
+static uint32_t traceTime(void)
+{
+  uint32_t piir = AT91C_BASE_PITC->PITC_PIIR;
+  uint32_t period = (AT91C_BASE_PITC->PITC_PIMR & AT91C_PITC_PIV) + 1;
+  // PICNT has any ticks that have happened but not been counted yet
+  return (chTimeNow() + (piir >> 20)) * period + (piir & AT91C_PITC_CPIV);
+}
+
+/*
+  The fast timer runs on the FIQ, which chSysLock() leaves on, so it can land in the middle of any
+  other event being recorded - from a thread or an IRQ handler.  Hold off both the IRQ and the FIQ
+  while an entry is claimed and filled in, and put them back the way they were afterwards.
+*/
+static inline uint32_t traceLock(void)
+{
+  uint32_t cpsr, masked;
+  asm volatile ("mrs %0, cpsr\n\t"
+                "orr %1, %0, #0xC0\n\t" // the I and F bits
+                "msr cpsr_c, %1"
+                : "=r" (cpsr), "=r" (masked) : : "memory");
+  return cpsr;
+}
+
+static inline void traceUnlock(uint32_t cpsr)
+{
+  asm volatile ("msr cpsr_c, %0" : : "r" (cpsr) : "memory");
+}
+
+static void traceWrite(uint32_t seq, uint32_t time, uint16_t event, uint16_t arg, Thread* thread)
+{
+  TraceEntry* e = &trace.ring[seq & (TRACE_SIZE - 1)];
+  e->time = time;
+  e->event = event;
+  e->arg = arg;
+  e->thread = (uint32_t)thread;
+}
+
+/**
+  Record an event.
+  Call this from a thread - use traceEventFromIsr() in an interrupt handler.
+  @param event The event - one of the \b TRACE_ events, or your own.  Add \b TRACE_END to the
+  event at the end of a span, or \b TRACE_INSTANT if it doesn't have one.
+  @param arg Anything you'd like to record along with it.
+*/
+void traceEvent(uint16_t event, uint16_t arg)
+{
+  uint32_t cpsr = traceLock();
+  traceWrite(trace.head++, traceTime(), event, arg, chThdSelf());
+  traceUnlock(cpsr);
+}
+
+/**
+  Record an event from an interrupt handler.
+  IRQ handlers don't interrupt each other, but the fast timer's FIQ can interrupt them,
+  so this holds it off just like traceEvent() does.
+  @param event The event.
+  @param arg Anything you'd like to record along with it.
+*/
+void traceEventFromIsr(uint16_t event, uint16_t arg)
+{
+  uint32_t cpsr = traceLock();
+  traceWrite(trace.head++, traceTime(), event, arg, 0);
+  traceUnlock(cpsr);
+}
+
+/**
+  The sequence number the next event will get.
+  Each event gets the next number, so this is also the number of events recorded since startup.
+  @return The sequence number.
+*/
+uint32_t traceHead()
+{
+  return trace.head;
+}
+
+/**
+  Copy events out of the ring.
+  If the events you ask for have already been overwritten or cleared, you get the oldest ones
+  still around instead.
+  @param seq The sequence number of the first event you'd like - set to the number of the first one you got.
+  @param entries Where to copy them.
+  @param count The most to copy.
+  @return The number copied.
+
+  \b Example
+  \code
+  TraceEntry entries[16];
+  uint32_t seq = 0;
+  int n;
+  while ((n = traceRead(&seq, entries, 16)) > 0) {
+    // do something with them...
+    seq += n;
+  }
+  \endcode
+*/
+int traceRead(uint32_t* seq, TraceEntry* entries, int count)
+{
+  int i;
+  uint32_t head = trace.head;
+  uint32_t oldest = head - TRACE_SIZE;
+  if ((int32_t)(trace.tail - oldest) > 0)
+    oldest = trace.tail;
+  if ((int32_t)(*seq - oldest) < 0)
+    *seq = oldest;
+  if ((int32_t)(head - *seq) < count)
+    count = head - *seq;
+  // entries can still be written while we copy, so take each one whole
+  for (i = 0; i < count; i++) {
+    uint32_t cpsr = traceLock();
+    entries[i] = trace.ring[(*seq + i) & (TRACE_SIZE - 1)];
+    traceUnlock(cpsr);
+  }
+  return (count > 0) ? count : 0;
+}
+
+/**
+  Forget everything recorded so far.
+*/
+void traceClear()
+{
+  trace.tail = trace.head;
+}
+
+/**
+  How many trace time ticks there are in a second.
+  @return The rate, in Hz.
+*/
+uint32_t traceClock()
+{
+  return MCK / 16; // the PIT runs from the master clock / 16
+}
+
+/** @} */
+
+#endif // MAKE_CTRL_TRACE
@@ -0,0 +1,75 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 128 // entries in the ring - must be a power of 2
+#endif
+
+#define TRACE_END     0x8000 /**< Add to an event to mark the end of a span that started with the plain event. */
+#define TRACE_INSTANT 0x4000 /**< Add to an event that's a single point in time, rather than the start of a span. */
+
+/**
+  The events traced by the core.  Use \b TRACE_USER and up for your own.
+  \ingroup trace
+*/
+enum {
+  TRACE_OSC_DISPATCH = 1, /**< An OSC handler being called - the arg is the number of data items. */
+  TRACE_USB_WRITE,        /**< usbserialWrite() - the arg is the length, and the number written at the end. */
+  TRACE_USB_WAKEUP,       /**< The USB interrupt waking up the thread waiting in usbserialWrite(). */
+  TRACE_FASTTIMER,        /**< The fast timer interrupt - the arg at the end is the number of timers that fired. */
+  TRACE_PIN_INTERRUPT,    /**< A pin interrupt - the arg is 0 for port A or 1 for port B, and the number of handlers at the end. */
+  TRACE_USER = 0x100      /**< The first event for your own use. */
+};
+
+/**
+  One entry in the trace.  These are sent over OSC as they are, little-endian.
+  \ingroup trace
+*/
+typedef struct TraceEntry_t {
+  uint32_t time;    /**< When it happened, in traceClock() ticks since startup.  Wraps around every 20 minutes or so. */
+  uint16_t event;   /**< What happened - a \b TRACE_ event, maybe with \b TRACE_END or \b TRACE_INSTANT. */
+  uint16_t arg;     /**< Something about it - see the event. */
+  uint32_t thread;  /**< The thread it happened in, or 0 for an interrupt. */
+} TraceEntry;
+
+#ifdef MAKE_CTRL_TRACE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void traceEvent(uint16_t event, uint16_t arg);
+void traceEventFromIsr(uint16_t event, uint16_t arg);
+uint32_t traceHead(void);
+int  traceRead(uint32_t* seq, TraceEntry* entries, int count);
+void traceClear(void);
+uint32_t traceClock(void);
+#ifdef __cplusplus
+}
+#endif
+
+#else
+// tracing is compiled out - arg is still evaluated so counters kept just for it are "used"
+#define traceEvent(event, arg) ((void)(arg))
+#define traceEventFromIsr(event, arg) ((void)(arg))
+#endif // MAKE_CTRL_TRACE
+
+#endif // TRACE_H
@@ -170,7 +170,7 @@ int udpRead(int socket, char* data, int length, int* from_address, int* from_por
   if (from_address)
     *from_address = from.sin_addr.s_addr;
   if (from_port)
-    *from_port = from.sin_port;
+    *from_port = ntohs(from.sin_port); // host order, the same as udpWrite() takes
   return recvd;
 }
 
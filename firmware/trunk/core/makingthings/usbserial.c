@@ -227,6 +227,7 @@ int usbserialPut(char c)
 int usbserialWrite(const char *buffer, int length)
 {
   int rv = -1;
+  traceEvent(TRACE_USB_WRITE, length);
   if (usbserialIsActive()) {
     chSysLock();
     chMtxLockS(&usbSerial.txMutex);
@@ -242,6 +243,7 @@ int usbserialWrite(const char *buffer, int length)
     chMtxUnlockS();
     chSysUnlock();
   }
+  traceEvent(TRACE_USB_WRITE | TRACE_END, rv);
   return rv;
 }
 
@@ -253,6 +255,7 @@ void usbserialOnTx(void *pArg, unsigned char status, unsigned int received, unsi
     usbSerial.thd->p_u.rdymsg += received;
   if (remaining == 0 && usbSerial.thd != 0) {
     // reschedule the thread waiting on the TX event
+    traceEventFromIsr(TRACE_USB_WAKEUP | TRACE_INSTANT, 0);
     chSchReadyI(usbSerial.thd);
     usbSerial.thd = 0;
   }
@@ -48,10 +48,35 @@ typedef unsigned char u8;
   - the way they chain blocks
   - the way they pad data
 
-  This library uses ECB (Electronic Code Book) chaining, and pads data with a character 
+  aesEncrypt() and aesDecrypt() use ECB (Electronic Code Book) chaining, and pad data with a character 
   that corresponds to the number of bytes needed to pad to 16.  Check the Wikipedia article
   for an explanation - http://en.wikipedia.org/wiki/Advanced_Encryption_Standard
 
+  \section aescontext Reusing a key
+  aesEncrypt() and aesDecrypt() expand the password into round keys every time they're called.
+  If you're encrypting a steady stream of packets with the same key, set up an AesContext once
+  with aesInit() and keep it around instead - the key schedule only runs once.  A context also
+  gives you two better chaining modes, both of which work on your buffer in place:
+  - CBC (Cipher Block Chaining) - aesCbcEncrypt() and aesCbcDecrypt().  The data has to be a
+    multiple of 16 bytes - padding is up to you.
+  - CTR (Counter) - aesCtr().  Turns AES into a stream cipher, so any length works and there's
+    no padding.  Encrypting and decrypting are the same operation.
+
+  The context remembers where it left off, so a long message can be fed through in pieces.
+  Both modes start from an IV set with aesSetIV() - never reuse an IV with the same key in CTR mode.
+
+  \code
+  AesContext aes;
+  unsigned char key[16] = "A SECRET PASSWOR";
+  unsigned char iv[16];
+  aesInit(&aes, key, 128, AES_ENCRYPT); // once, at startup
+
+  // then, for each packet...
+  makeIV(iv);                // however you come up with a fresh IV - send it along with the packet
+  aesSetIV(&aes, iv);
+  aesCtr(&aes, packet, packetLength);
+  \endcode
+
   The lookup tables used in this library will use somewhere between 8 and 13 kB of program space, 
   depending on the compiler optimization you use.  Memory usage is pretty minimal.
 
@@ -1271,7 +1296,180 @@ void aesDoDecrypt(const u32 *rk, int nrounds, const u8 ciphertext[16],
 #define NROUNDS(keybits)   ((keybits)/32+6)
 
 #define KEYBITS 128
-#define BLOCK_SIZE 16
+#define BLOCK_SIZE AES_BLOCK_SIZE
+
+/**
+  Set up an AES context with a key.
+  The key is expanded into round keys once, here, rather than on every call.
+  CTR mode and aesCbcEncrypt() need a context set up with \b AES_ENCRYPT.  aesCbcDecrypt()
+  needs one set up with \b AES_DECRYPT.  The IV starts out as all zeros.
+
+  @param ctx The context to set up.
+  @param key The key - 16, 24 or 32 bytes long depending on \b keybits.
+  @param keybits The key size - 128, 192 or 256.
+  @param direction \b AES_ENCRYPT or \b AES_DECRYPT.
+  @return 0 on success, or -1 if the key size isn't valid.
+
+  \par Example
+  \code
+  AesContext aes;
+  unsigned char secret[] = "A SECRET PASSWORD"; // only the first 16 bytes are used
+  aesInit(&aes, secret, 128, AES_ENCRYPT);
+  \endcode
+*/
+int aesInit(AesContext* ctx, const unsigned char* key, int keybits, int direction)
+{
+  if (keybits != 128 && keybits != 192 && keybits != 256)
+    return -1;
+  if (direction == AES_DECRYPT)
+    ctx->nrounds = aesSetupDecrypt(ctx->rk, key, keybits);
+  else
+    ctx->nrounds = aesSetupEncrypt(ctx->rk, key, keybits);
+  ctx->direction = direction;
+  memset(ctx->iv, 0, BLOCK_SIZE);
+  ctx->streamPos = BLOCK_SIZE;
+  return 0;
+}
+
+/**
+  Set the IV (initialization vector) for CBC or CTR mode.
+  Call this at the start of each message.  In CTR mode the IV is the initial counter block.
+  @param ctx The context.
+  @param iv The 16 byte IV.
+*/
+void aesSetIV(AesContext* ctx, const unsigned char* iv)
+{
+  memcpy(ctx->iv, iv, BLOCK_SIZE);
+  ctx->streamPos = BLOCK_SIZE;
+}
+
+/**
+  Encrypt a single 16 byte block.
+  The context must have been set up with \b AES_ENCRYPT.  \b input and \b output can be the same buffer.
+  @param ctx The context.
+  @param input The 16 bytes to encrypt.
+  @param output Where to write the 16 encrypted bytes.
+*/
+void aesEncryptBlock(const AesContext* ctx, const unsigned char* input, unsigned char* output)
+{
+  aesDoEncrypt(ctx->rk, ctx->nrounds, input, output);
+}
+
+/**
+  Decrypt a single 16 byte block.
+  The context must have been set up with \b AES_DECRYPT.  \b input and \b output can be the same buffer.
+  @param ctx The context.
+  @param input The 16 bytes to decrypt.
+  @param output Where to write the 16 decrypted bytes.
+*/
+void aesDecryptBlock(const AesContext* ctx, const unsigned char* input, unsigned char* output)
+{
+  aesDoDecrypt(ctx->rk, ctx->nrounds, input, output);
+}
+
+static void aesXorBlock(unsigned char* dst, const unsigned char* src)
+{
+  int i;
+  for (i = 0; i < BLOCK_SIZE; i++)
+    dst[i] ^= src[i];
+}
+
+/**
+  Encrypt data in place with CBC chaining.
+  The last ciphertext block is kept as the IV for the next call, so a message can be
+  encrypted a piece at a time as long as each piece is a multiple of 16 bytes.
+  @param ctx A context set up with \b AES_ENCRYPT.
+  @param data The data to encrypt - it's replaced with the ciphertext.
+  @param length How many bytes to encrypt - must be a multiple of 16.
+  @return The number of bytes encrypted, or -1 on failure.
+
+  \par Example
+  \code
+  unsigned char packet[64];
+  // ... fill in the packet, padded out to 64 bytes ...
+  aesSetIV(&aes, iv);
+  aesCbcEncrypt(&aes, packet, sizeof(packet));
+  \endcode
+*/
+int aesCbcEncrypt(AesContext* ctx, unsigned char* data, int length)
+{
+  int i;
+  if (ctx->direction != AES_ENCRYPT || (length % BLOCK_SIZE) != 0)
+    return -1;
+  for (i = 0; i < length; i += BLOCK_SIZE) {
+    aesXorBlock(data + i, ctx->iv);
+    aesDoEncrypt(ctx->rk, ctx->nrounds, data + i, data + i);
+    memcpy(ctx->iv, data + i, BLOCK_SIZE);
+  }
+  return length;
+}
+
+/**
+  Decrypt CBC encrypted data in place.
+  Like aesCbcEncrypt(), a message can be decrypted a piece at a time.
+  @param ctx A context set up with \b AES_DECRYPT.
+  @param data The ciphertext - it's replaced with the plaintext.
+  @param length How many bytes to decrypt - must be a multiple of 16.
+  @return The number of bytes decrypted, or -1 on failure.
+*/
+int aesCbcDecrypt(AesContext* ctx, unsigned char* data, int length)
+{
+  int i;
+  unsigned char next[BLOCK_SIZE];
+  if (ctx->direction != AES_DECRYPT || (length % BLOCK_SIZE) != 0)
+    return -1;
+  for (i = 0; i < length; i += BLOCK_SIZE) {
+    memcpy(next, data + i, BLOCK_SIZE);
+    aesDoDecrypt(ctx->rk, ctx->nrounds, data + i, data + i);
+    aesXorBlock(data + i, ctx->iv);
+    memcpy(ctx->iv, next, BLOCK_SIZE);
+  }
+  return length;
+}
+
+/**
+  Encrypt or decrypt data in place with CTR (counter) mode.
+  The counter is the whole 16 byte IV, incremented as a big-endian number for each block.
+  Any length works - leftover keystream is saved for the next call, so a message can be
+  fed through in pieces of any size.
+  @param ctx A context set up with \b AES_ENCRYPT - CTR mode uses it in both directions.
+  @param data The data to encrypt or decrypt - it's replaced with the result.
+  @param length How many bytes to process.
+  @return The number of bytes processed, or -1 on failure.
+
+  \par Example
+  \code
+  aesSetIV(&aes, iv);
+  aesCtr(&aes, packet, packetLength); // encrypted
+  aesSetIV(&aes, iv);
+  aesCtr(&aes, packet, packetLength); // and back again
+  \endcode
+*/
+int aesCtr(AesContext* ctx, unsigned char* data, int length)
+{
+  int i, j;
+  if (ctx->direction != AES_ENCRYPT || length < 0)
+    return -1;
+  i = 0;
+  while (i < length) {
+    if (ctx->streamPos == BLOCK_SIZE) {
+      aesDoEncrypt(ctx->rk, ctx->nrounds, ctx->iv, ctx->stream);
+      for (j = BLOCK_SIZE - 1; j >= 0; j--) { // bump the counter
+        if (++ctx->iv[j] != 0)
+          break;
+      }
+      ctx->streamPos = 0;
+    }
+    if (ctx->streamPos == 0 && length - i >= BLOCK_SIZE) { // a whole block at once
+      aesXorBlock(data + i, ctx->stream);
+      ctx->streamPos = BLOCK_SIZE;
+      i += BLOCK_SIZE;
+    }
+    else
+      data[i++] ^= ctx->stream[ctx->streamPos++];
+  }
+  return length;
+}
 
 /**
   Ecrypt a block of data using AES.
@@ -18,9 +18,37 @@
 #ifndef AES_H
 #define AES_H
 
+#define AES_BLOCK_SIZE 16
+#define AES_MAX_ROUND_KEYS 60 // enough for a 256 bit key
+
+#define AES_ENCRYPT 0
+#define AES_DECRYPT 1
+
+/**
+  An AES key, expanded once and ready to use.
+  Set one up with aesInit() - the fields are private.
+  \ingroup AES
+*/
+typedef struct AesContext_t {
+  unsigned long rk[AES_MAX_ROUND_KEYS]; // round keys, in the order the direction needs them
+  int nrounds;
+  int direction;                        // AES_ENCRYPT or AES_DECRYPT
+  unsigned char iv[AES_BLOCK_SIZE];     // the CBC chaining block, or the CTR counter
+  unsigned char stream[AES_BLOCK_SIZE]; // CTR keystream for the current counter
+  int streamPos;                        // how much of the keystream has been used
+} AesContext;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
+int  aesInit(AesContext* ctx, const unsigned char* key, int keybits, int direction);
+void aesSetIV(AesContext* ctx, const unsigned char* iv);
+void aesEncryptBlock(const AesContext* ctx, const unsigned char* input, unsigned char* output);
+void aesDecryptBlock(const AesContext* ctx, const unsigned char* input, unsigned char* output);
+int  aesCbcEncrypt(AesContext* ctx, unsigned char* data, int length);
+int  aesCbcDecrypt(AesContext* ctx, unsigned char* data, int length);
+int  aesCtr(AesContext* ctx, unsigned char* data, int length);
+
 int aesEncrypt(unsigned char* output, int outlen, unsigned char* input, int inlen, unsigned char* key);
 int aesDecrypt(unsigned char* output, int outlen, unsigned char* input, int inlen, unsigned char* password);
 #ifdef __cplusplus
@@ -32,11 +32,31 @@ static bool isbase64 (char ch);
   This is often handy when you need to send raw/binary data (as opposed to text) through a 
   text based format, like XML or JSON.
 
+  base64Encode() and base64Decode() need the whole input up front.  To encode or decode
+  something as it streams through a small buffer - a web request or response body, say - use
+  a \ref Base64Encoder or \ref Base64Decoder instead.  Feed it chunks of any size, and it
+  keeps track of the partial groups in between.
+
+  \code
+  char in[48], out[BASE64_ENCODED_SIZE(48)];
+  Base64Encoder enc;
+  base64EncoderInit(&enc);
+  int n;
+  while ((n = readSomeData(in, sizeof(in))) > 0) {
+    int len = base64EncoderWrite(&enc, out, in, n);
+    tcpWrite(socket, out, len);
+  }
+  tcpWrite(socket, out, base64EncoderFinish(&enc, out));
+  \endcode
+
   Most code lifted from gnulib - http://savannah.gnu.org/projects/gnulib - and written by Simon Josefsson.
   \ingroup dataformats
   @{
 */
 
+// our library of valid b64 chars
+static const unsigned char b64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
 /* C89 compliant way to cast 'char' to 'unsigned char'. */
 static inline unsigned char to_uchar (char ch)
 {
@@ -64,8 +84,7 @@ static inline unsigned char to_uchar (char ch)
 */
 int base64Encode(char* dest, int dest_size, const char* src, int src_size)
 {
-  // our library of valid b64 chars
-  static const unsigned char b64str[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const unsigned char* b64str = b64chars;
   int orig_size = dest_size;
 
   while(dest_size && src_size)
@@ -99,156 +118,42 @@ int base64Encode(char* dest, int dest_size, const char* src, int src_size)
   return orig_size - dest_size;
 }
 
-/* With this approach this file works independent of the charset used
-   (think EBCDIC).  However, it does assume that the characters in the
-   Base64 alphabet (A-Za-z0-9+/) are encoded in 0..255.  POSIX
-   1003.1-2001 require that char and unsigned char are 8-bit
-   quantities, though, taking care of that problem.  But this may be a
-   potential problem on non-POSIX C99 platforms.
-
-   IBM C V6 for AIX mishandles "#define B64(x) ...'x'...", so use "_"
-   as the formal parameter rather than "x".  */
-#define B64(_)          \
-  ((_) == 'A' ? 0       \
-   : (_) == 'B' ? 1       \
-   : (_) == 'C' ? 2       \
-   : (_) == 'D' ? 3       \
-   : (_) == 'E' ? 4       \
-   : (_) == 'F' ? 5       \
-   : (_) == 'G' ? 6       \
-   : (_) == 'H' ? 7       \
-   : (_) == 'I' ? 8       \
-   : (_) == 'J' ? 9       \
-   : (_) == 'K' ? 10        \
-   : (_) == 'L' ? 11        \
-   : (_) == 'M' ? 12        \
-   : (_) == 'N' ? 13        \
-   : (_) == 'O' ? 14        \
-   : (_) == 'P' ? 15        \
-   : (_) == 'Q' ? 16        \
-   : (_) == 'R' ? 17        \
-   : (_) == 'S' ? 18        \
-   : (_) == 'T' ? 19        \
-   : (_) == 'U' ? 20        \
-   : (_) == 'V' ? 21        \
-   : (_) == 'W' ? 22        \
-   : (_) == 'X' ? 23        \
-   : (_) == 'Y' ? 24        \
-   : (_) == 'Z' ? 25        \
-   : (_) == 'a' ? 26        \
-   : (_) == 'b' ? 27        \
-   : (_) == 'c' ? 28        \
-   : (_) == 'd' ? 29        \
-   : (_) == 'e' ? 30        \
-   : (_) == 'f' ? 31        \
-   : (_) == 'g' ? 32        \
-   : (_) == 'h' ? 33        \
-   : (_) == 'i' ? 34        \
-   : (_) == 'j' ? 35        \
-   : (_) == 'k' ? 36        \
-   : (_) == 'l' ? 37        \
-   : (_) == 'm' ? 38        \
-   : (_) == 'n' ? 39        \
-   : (_) == 'o' ? 40        \
-   : (_) == 'p' ? 41        \
-   : (_) == 'q' ? 42        \
-   : (_) == 'r' ? 43        \
-   : (_) == 's' ? 44        \
-   : (_) == 't' ? 45        \
-   : (_) == 'u' ? 46        \
-   : (_) == 'v' ? 47        \
-   : (_) == 'w' ? 48        \
-   : (_) == 'x' ? 49        \
-   : (_) == 'y' ? 50        \
-   : (_) == 'z' ? 51        \
-   : (_) == '0' ? 52        \
-   : (_) == '1' ? 53        \
-   : (_) == '2' ? 54        \
-   : (_) == '3' ? 55        \
-   : (_) == '4' ? 56        \
-   : (_) == '5' ? 57        \
-   : (_) == '6' ? 58        \
-   : (_) == '7' ? 59        \
-   : (_) == '8' ? 60        \
-   : (_) == '9' ? 61        \
-   : (_) == '+' ? 62        \
-   : (_) == '/' ? 63        \
-   : -1)
-
-static const signed char b64[0x100] = {
-  B64 (0), B64 (1), B64 (2), B64 (3),
-  B64 (4), B64 (5), B64 (6), B64 (7),
-  B64 (8), B64 (9), B64 (10), B64 (11),
-  B64 (12), B64 (13), B64 (14), B64 (15),
-  B64 (16), B64 (17), B64 (18), B64 (19),
-  B64 (20), B64 (21), B64 (22), B64 (23),
-  B64 (24), B64 (25), B64 (26), B64 (27),
-  B64 (28), B64 (29), B64 (30), B64 (31),
-  B64 (32), B64 (33), B64 (34), B64 (35),
-  B64 (36), B64 (37), B64 (38), B64 (39),
-  B64 (40), B64 (41), B64 (42), B64 (43),
-  B64 (44), B64 (45), B64 (46), B64 (47),
-  B64 (48), B64 (49), B64 (50), B64 (51),
-  B64 (52), B64 (53), B64 (54), B64 (55),
-  B64 (56), B64 (57), B64 (58), B64 (59),
-  B64 (60), B64 (61), B64 (62), B64 (63),
-  B64 (64), B64 (65), B64 (66), B64 (67),
-  B64 (68), B64 (69), B64 (70), B64 (71),
-  B64 (72), B64 (73), B64 (74), B64 (75),
-  B64 (76), B64 (77), B64 (78), B64 (79),
-  B64 (80), B64 (81), B64 (82), B64 (83),
-  B64 (84), B64 (85), B64 (86), B64 (87),
-  B64 (88), B64 (89), B64 (90), B64 (91),
-  B64 (92), B64 (93), B64 (94), B64 (95),
-  B64 (96), B64 (97), B64 (98), B64 (99),
-  B64 (100), B64 (101), B64 (102), B64 (103),
-  B64 (104), B64 (105), B64 (106), B64 (107),
-  B64 (108), B64 (109), B64 (110), B64 (111),
-  B64 (112), B64 (113), B64 (114), B64 (115),
-  B64 (116), B64 (117), B64 (118), B64 (119),
-  B64 (120), B64 (121), B64 (122), B64 (123),
-  B64 (124), B64 (125), B64 (126), B64 (127),
-  B64 (128), B64 (129), B64 (130), B64 (131),
-  B64 (132), B64 (133), B64 (134), B64 (135),
-  B64 (136), B64 (137), B64 (138), B64 (139),
-  B64 (140), B64 (141), B64 (142), B64 (143),
-  B64 (144), B64 (145), B64 (146), B64 (147),
-  B64 (148), B64 (149), B64 (150), B64 (151),
-  B64 (152), B64 (153), B64 (154), B64 (155),
-  B64 (156), B64 (157), B64 (158), B64 (159),
-  B64 (160), B64 (161), B64 (162), B64 (163),
-  B64 (164), B64 (165), B64 (166), B64 (167),
-  B64 (168), B64 (169), B64 (170), B64 (171),
-  B64 (172), B64 (173), B64 (174), B64 (175),
-  B64 (176), B64 (177), B64 (178), B64 (179),
-  B64 (180), B64 (181), B64 (182), B64 (183),
-  B64 (184), B64 (185), B64 (186), B64 (187),
-  B64 (188), B64 (189), B64 (190), B64 (191),
-  B64 (192), B64 (193), B64 (194), B64 (195),
-  B64 (196), B64 (197), B64 (198), B64 (199),
-  B64 (200), B64 (201), B64 (202), B64 (203),
-  B64 (204), B64 (205), B64 (206), B64 (207),
-  B64 (208), B64 (209), B64 (210), B64 (211),
-  B64 (212), B64 (213), B64 (214), B64 (215),
-  B64 (216), B64 (217), B64 (218), B64 (219),
-  B64 (220), B64 (221), B64 (222), B64 (223),
-  B64 (224), B64 (225), B64 (226), B64 (227),
-  B64 (228), B64 (229), B64 (230), B64 (231),
-  B64 (232), B64 (233), B64 (234), B64 (235),
-  B64 (236), B64 (237), B64 (238), B64 (239),
-  B64 (240), B64 (241), B64 (242), B64 (243),
-  B64 (244), B64 (245), B64 (246), B64 (247),
-  B64 (248), B64 (249), B64 (250), B64 (251),
-  B64 (252), B64 (253), B64 (254), B64 (255)
+/*
+  Decode table - the 6 bit value of each character in the Base64 alphabet (A-Za-z0-9+/),
+  PD for the '=' padding, WS for whitespace the streaming decoder skips, and XX for
+  anything else.  Assumes ASCII.
+*/
+#define XX 0xFF
+#define PD 64
+#define WS 65
+
+static const unsigned char b64[0x100] = {
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, WS, WS, XX, XX, WS, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  WS, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, 62, XX, XX, XX, 63,
+  52, 53, 54, 55, 56, 57, 58, 59, 60, 61, XX, XX, XX, PD, XX, XX,
+  XX,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, XX, XX, XX, XX, XX,
+  XX, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+  41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+  XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX
 };
 
+#undef XX
+
 /* Return true if CH is a character from the Base64 alphabet, and
    false otherwise.  Note that '=' is padding and not considered to be
    part of the alphabet.  */
 bool isbase64 (char ch)
 {
-  //return uchar_in_range(to_uchar (ch)); && (0 <= b64[to_uchar(ch)]); -- uchar_in_range is always true for a uchar
-  return (0 <= b64[to_uchar(ch)]);
+  return b64[to_uchar(ch)] < 64;
 }
 
 /**
@@ -329,6 +234,200 @@ bool base64Decode(char* dest, int* dest_size, const char* src, int src_size)
   return true;
 }
 
+/**
+  Set up an encoder at the start of a new stream.
+  @param enc The encoder.
+*/
+void base64EncoderInit(Base64Encoder* enc)
+{
+  enc->count = 0;
+}
+
+static inline void base64EncodeGroup(char* dest, unsigned char a, unsigned char b, unsigned char c)
+{
+  dest[0] = b64chars[a >> 2];
+  dest[1] = b64chars[((a << 4) | (b >> 4)) & 0x3f];
+  dest[2] = b64chars[((b << 2) | (c >> 6)) & 0x3f];
+  dest[3] = b64chars[c & 0x3f];
+}
+
+/**
+  Encode the next chunk of a stream.
+  Every 3 bytes in becomes 4 characters out.  Any bytes left over are held until the next
+  call, or base64EncoderFinish().
+  @param enc The encoder.
+  @param dest Where to write the encoded characters - it needs room for at least
+  BASE64_ENCODED_SIZE(src_size).  It's not null terminated.
+  @param src The next chunk of data to encode.
+  @param src_size The number of bytes in src.
+  @return The number of characters written to dest.
+*/
+int base64EncoderWrite(Base64Encoder* enc, char* dest, const char* src, int src_size)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  char* out = dest;
+  if (enc->count) { // top up the group left over from last time
+    while (enc->count < 3 && src_size) {
+      enc->pending[enc->count++] = *in++;
+      src_size--;
+    }
+    if (enc->count < 3)
+      return 0;
+    base64EncodeGroup(out, enc->pending[0], enc->pending[1], enc->pending[2]);
+    out += 4;
+    enc->count = 0;
+  }
+  while (src_size >= 3) {
+    base64EncodeGroup(out, in[0], in[1], in[2]);
+    out += 4;
+    in += 3;
+    src_size -= 3;
+  }
+  while (src_size--)
+    enc->pending[enc->count++] = *in++;
+  return out - dest;
+}
+
+/**
+  Finish encoding a stream.
+  Writes the last group, padded out with '=' characters.
+  @param enc The encoder.
+  @param dest Where to write the last characters - it needs room for 4.
+  @return The number of characters written to dest - 0 or 4.
+*/
+int base64EncoderFinish(Base64Encoder* enc, char* dest)
+{
+  if (!enc->count)
+    return 0;
+  unsigned char b = (enc->count > 1) ? enc->pending[1] : 0;
+  base64EncodeGroup(dest, enc->pending[0], b, 0);
+  if (enc->count < 2)
+    dest[2] = '=';
+  dest[3] = '=';
+  enc->count = 0;
+  return 4;
+}
+
+/**
+  Set up a decoder at the start of a new stream.
+  @param dec The decoder.
+*/
+void base64DecoderInit(Base64Decoder* dec)
+{
+  dec->bits = 0;
+  dec->count = 0;
+  dec->pad = 0;
+  dec->error = false;
+}
+
+/**
+  Decode the next chunk of a stream.
+  Whitespace (spaces, tabs and line breaks) is skipped, and groups can be split across
+  chunks anywhere.
+  @param dec The decoder.
+  @param dest Where to write the decoded data - it needs room for at least
+  BASE64_DECODED_SIZE(src_size) bytes.
+  @param src The next chunk of base 64 text.
+  @param src_size The number of characters in src.
+  @return The number of bytes written to dest, or -1 if the text isn't valid base 64 -
+  once that happens, the rest of the stream is rejected too.
+*/
+int base64DecoderWrite(Base64Decoder* dec, char* dest, const char* src, int src_size)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  const unsigned char* end = in + src_size;
+  unsigned char* out = (unsigned char*)dest;
+  unsigned long bits = dec->bits;
+  int count = dec->count;
+
+  if (dec->error)
+    return -1;
+  while (in < end) {
+    if (count == 0 && !dec->pad) { // whole groups at a time while the input is clean
+      while (end - in >= 4) {
+        unsigned char a = b64[in[0]], b = b64[in[1]], c = b64[in[2]], d = b64[in[3]];
+        if ((a | b | c | d) & 0xC0)
+          break;
+        unsigned long group = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = group >> 16;
+        out[1] = group >> 8;
+        out[2] = group;
+        out += 3;
+        in += 4;
+      }
+      if (in == end)
+        break;
+    }
+    unsigned char v = b64[*in++];
+    if (v == WS)
+      continue;
+    if (v == PD) {
+      if (dec->pad == 0) { // the first '=' - the group it finishes off has to be at least half there
+        if (count < 2)
+          goto bad;
+        if (count == 3) {
+          *out++ = bits >> 10;
+          *out++ = bits >> 2;
+        }
+        else
+          *out++ = bits >> 4;
+        dec->pad = 3 - count; // how many more '=' to expect
+        count = 0;
+      }
+      else if (dec->pad > 0)
+        dec->pad--;
+      else
+        goto bad;
+      if (dec->pad == 0)
+        dec->pad = -1; // all done - only whitespace from here on
+      continue;
+    }
+    if (v > 63 || dec->pad)
+      goto bad;
+    bits = (bits << 6) | v;
+    if (++count == 4) {
+      out[0] = bits >> 16;
+      out[1] = bits >> 8;
+      out[2] = bits;
+      out += 3;
+      count = 0;
+    }
+  }
+  dec->bits = bits;
+  dec->count = count;
+  return out - (unsigned char*)dest;
+
+bad:
+  dec->error = true;
+  return -1;
+}
+
+/**
+  Finish decoding a stream.
+  Writes out the last group if the text wasn't padded.
+  @param dec The decoder.
+  @param dest Where to write the last bytes - it needs room for 2.
+  @return The number of bytes written to dest, or -1 if the stream was invalid or ended in
+  the middle of a group.
+*/
+int base64DecoderFinish(Base64Decoder* dec, char* dest)
+{
+  int n = 0;
+  if (dec->error || dec->count == 1 || dec->pad > 0)
+    n = -1;
+  else if (dec->count == 3) {
+    dest[0] = dec->bits >> 10;
+    dest[1] = dec->bits >> 2;
+    n = 2;
+  }
+  else if (dec->count == 2) {
+    dest[0] = dec->bits >> 4;
+    n = 1;
+  }
+  base64DecoderInit(dec);
+  return n;
+}
+
 /** @}
 */
 
@@ -20,11 +20,43 @@
 
 #include "types.h"
 
+#define BASE64_ENCODED_SIZE(n) ((((n) + 2) / 3) * 4) /**< room needed to encode n bytes */
+#define BASE64_DECODED_SIZE(n) ((((n) + 3) / 4) * 3) /**< room needed to decode n characters */
+
+/**
+  Base 64 encodes a stream a chunk at a time.
+  Set one up with base64EncoderInit() - the fields are private.
+  \ingroup base64
+*/
+typedef struct Base64Encoder_t {
+  unsigned char pending[3]; // a partial group left over from the last chunk
+  int count;
+} Base64Encoder;
+
+/**
+  Decodes a base 64 stream a chunk at a time.
+  Set one up with base64DecoderInit() - the fields are private.
+  \ingroup base64
+*/
+typedef struct Base64Decoder_t {
+  unsigned long bits; // the partial group left over from the last chunk
+  int count;          // how many characters of it there are
+  int pad;            // '=' still to come, or -1 once the padding is done
+  bool error;
+} Base64Decoder;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 bool base64Decode(char* dest, int* dest_size, const char* src, int src_size);
 int  base64Encode(char* dest, int dest_size, const char* src, int src_size);
+
+void base64EncoderInit(Base64Encoder* enc);
+int  base64EncoderWrite(Base64Encoder* enc, char* dest, const char* src, int src_size);
+int  base64EncoderFinish(Base64Encoder* enc, char* dest);
+void base64DecoderInit(Base64Decoder* dec);
+int  base64DecoderWrite(Base64Decoder* dec, char* dest, const char* src, int src_size);
+int  base64DecoderFinish(Base64Decoder* dec, char* dest);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,485 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "datalog.h"
+#include "core.h"
+
+#ifndef DATALOG_BASE
+#define DATALOG_BASE 0 // must be a multiple of EEPROM_PAGE_SIZE
+#endif
+
+#ifndef DATALOG_SIZE
+#define DATALOG_SIZE (EEPROM_SYSTEM_BASE - DATALOG_BASE)
+#endif
+
+#ifndef DATALOG_FLUSH_DELAY
+#define DATALOG_FLUSH_DELAY 5000
+#endif
+
+#ifndef DATALOG_STACK_SIZE
+#define DATALOG_STACK_SIZE 512
+#endif
+
+#define DATALOG_PAGES (DATALOG_SIZE / EEPROM_PAGE_SIZE)
+#define DATALOG_ERASED 0xFFFFFFFF
+
+/*
+  Each EEPROM page holds a header and as many whole records as will fit.
+  Records are a length byte followed by that many bytes of data.
+*/
+typedef struct {
+  uint32_t seq;   // one more than the page logged before it - DATALOG_ERASED if it's never been used
+  uint8_t used;   // bytes of record data in this page
+  uint8_t check;  // inverted sum of the header and record data
+  uint8_t data[DATALOG_PAGE_DATA];
+} __attribute__((packed)) DatalogPage;
+
+typedef struct {
+  Mutex lock;
+  Semaphore full;         // signalled when a page is waiting in outgoing
+  Semaphore free;         // signalled once the writer is done with it
+  int head;               // the page being filled in staging
+  int oldest;             // the oldest page in the log
+  bool dirty;             // staging has changes that aren't in EEPROM yet
+  bool outgoingPending;
+  int outgoingPage;
+  DatalogPage staging;
+  DatalogPage outgoing;
+} Datalog;
+
+static Datalog datalog;
+
+/**
+  \defgroup datalog Data Logger
+  Log data to EEPROM, and read it back later.
+  If you want to record sensor readings while nobody's connected, and download them later on, the
+  data logger can fill up the EEPROM space below \b EEPROM_SYSTEM_BASE - about 31k - with your records.
+
+  \section Usage
+  Call datalogInit() once at startup - it finds where the log left off last time, so you can keep
+  appending across resets.  Then log records of up to \b DATALOG_MAX_RECORD (57) bytes with datalogAppend().
+  Records are collected in RAM and written out a whole EEPROM page at a time from a background thread,
+  so appending doesn't wait on the EEPROM.  Anything left in a partly filled page is written once nothing has been
+  logged for \b DATALOG_FLUSH_DELAY milliseconds (5 seconds by default), or when you call datalogFlush().
+
+  Once the log is full, the oldest page is replaced by the newest.  Each page carries a sequence number,
+  so you can tell where you are in the log even after it has wrapped around.
+
+  \code
+  datalogInit();
+
+  // ...then, in the thread that reads your sensors
+  uint8_t sample[4];
+  sample[0] = ...;
+  datalogAppend(sample, sizeof(sample));
+  \endcode
+
+  \section Reading
+  Read the log back one page at a time with datalogReadPage(), and pick the records out of each page
+  with datalogNextRecord().  Over OSC, \b /datalog/dump sends each page as a blob - see \ref DatalogOSC.
+
+  If you'd like to use a different part of the EEPROM, define \b DATALOG_BASE and \b DATALOG_SIZE in your config.h.
+  Both need to be multiples of \b EEPROM_PAGE_SIZE.
+  \ingroup io
+  @{
+*/
+
+static uint8_t datalogChecksum(const DatalogPage* page)
+{
+  const uint8_t* p = (const uint8_t*)page;
+  uint8_t sum = 0;
+  int i;
+  for (i = 0; i < DATALOG_PAGE_HEADER - 1; i++) // everything up to the check byte
+    sum += p[i];
+  for (i = 0; i < page->used; i++)
+    sum += page->data[i];
+  return ~sum;
+}
+
+static int datalogWritePage(int index, DatalogPage* page)
+{
+  page->check = datalogChecksum(page);
+  return eepromWriteBlock(DATALOG_BASE + (index * EEPROM_PAGE_SIZE), (uint8_t*)page, DATALOG_PAGE_HEADER + page->used);
+}
+
+static bool datalogLoadPage(int index, DatalogPage* page)
+{
+  if (eepromReadBlock(DATALOG_BASE + (index * EEPROM_PAGE_SIZE), (uint8_t*)page, EEPROM_PAGE_SIZE) != CONTROLLER_OK)
+    return false;
+  if (page->seq == DATALOG_ERASED || page->used > DATALOG_PAGE_DATA)
+    return false;
+  return page->check == datalogChecksum(page);
+}
+
+static WORKING_AREA(waDatalogThd, DATALOG_STACK_SIZE);
+static msg_t DatalogThread(void *arg)
+{
+  UNUSED(arg);
+  while (!chThdShouldTerminate()) {
+    if (chSemWaitTimeout(&datalog.full, MS2ST(DATALOG_FLUSH_DELAY)) == RDY_OK) {
+      datalogWritePage(datalog.outgoingPage, &datalog.outgoing);
+      datalog.outgoingPending = false;
+      chSemSignal(&datalog.free);
+    }
+    else
+      datalogFlush(); // things have gone quiet - get the partial page down too
+  }
+  return 0;
+}
+
+/**
+  Find the end of the log, and start the thread that writes it to EEPROM.
+  Each page in the log area is checked, so this takes a moment.
+*/
+void datalogInit()
+{
+  int i;
+  uint32_t newest = 0, oldest = DATALOG_ERASED;
+  DatalogPage page;
+
+  chMtxInit(&datalog.lock);
+  chSemInit(&datalog.full, 0);
+  chSemInit(&datalog.free, 1);
+  datalog.head = 0;
+  datalog.oldest = 0;
+  datalog.dirty = false;
+  datalog.outgoingPending = false;
+  memset(&datalog.staging, 0, sizeof(DatalogPage));
+  datalog.staging.seq = 1;
+
+  // the newest page is where we pick up again, the oldest is where reading starts
+  for (i = 0; i < DATALOG_PAGES; i++) {
+    if (!datalogLoadPage(i, &page))
+      continue;
+    if (page.seq >= newest) {
+      newest = page.seq;
+      datalog.head = i;
+      datalog.staging = page;
+    }
+    if (page.seq < oldest) {
+      oldest = page.seq;
+      datalog.oldest = i;
+    }
+  }
+  memset(datalog.staging.data + datalog.staging.used, 0, DATALOG_PAGE_DATA - datalog.staging.used);
+
+  chThdCreateStatic(waDatalogThd, sizeof(waDatalogThd), NORMALPRIO - 1, DatalogThread, NULL);
+}
+
+/*
+  Take the writer once it's done with the last page.  Called with the lock held.  The writer
+  takes the lock itself to flush a quiet log, so if it's busy the lock is let go while waiting
+  for it - returns true when that happened, since things may have changed in the meantime.
+*/
+static bool datalogTakeWriter(void)
+{
+  if (chSemWaitTimeout(&datalog.free, TIME_IMMEDIATE) == RDY_OK)
+    return false;
+  chMtxUnlock();
+  chSemWait(&datalog.free); // only waits if we're logging faster than the EEPROM can keep up
+  chMtxLock(&datalog.lock);
+  return true;
+}
+
+/*
+  The page in staging is full - hand it to the writer and move on to the next one,
+  pushing out the oldest if we've come all the way around.  Called with the lock held,
+  and the writer taken with datalogTakeWriter().
+*/
+static void datalogNextPage(void)
+{
+  if (datalog.dirty) {
+    datalog.outgoing = datalog.staging;
+    datalog.outgoingPage = datalog.head;
+    datalog.outgoingPending = true;
+    chSemSignal(&datalog.full);
+  }
+  else
+    chSemSignal(&datalog.free); // nothing to hand over
+  datalog.head = (datalog.head + 1) % DATALOG_PAGES;
+  if (datalog.head == datalog.oldest)
+    datalog.oldest = (datalog.oldest + 1) % DATALOG_PAGES;
+  datalog.staging.seq++;
+  datalog.staging.used = 0;
+  memset(datalog.staging.data, 0, DATALOG_PAGE_DATA);
+  datalog.dirty = false;
+}
+
+/**
+  Add a record to the log.
+  The record is copied into RAM right away, so you're free to reuse your buffer.
+  @param data The record to log.
+  @param length The size of the record - up to \b DATALOG_MAX_RECORD bytes.
+  @return 0 on success.
+
+  \b Example
+  \code
+  int reading = analoginValue(0);
+  datalogAppend((uint8_t*)&reading, sizeof(reading));
+  \endcode
+*/
+int datalogAppend(const uint8_t* data, int length)
+{
+  if (length <= 0 || length > DATALOG_MAX_RECORD)
+    return CONTROLLER_ERROR_ILLEGAL_PARAMETER_VALUE;
+
+  chMtxLock(&datalog.lock);
+  while (datalog.staging.used + length + 1 > DATALOG_PAGE_DATA) {
+    if (!datalogTakeWriter()) {
+      datalogNextPage();
+      break;
+    }
+    chSemSignal(&datalog.free); // the lock was let go, so look again
+  }
+  uint8_t* p = datalog.staging.data + datalog.staging.used;
+  *p++ = length;
+  memcpy(p, data, length);
+  datalog.staging.used += length + 1;
+  datalog.dirty = true;
+  chMtxUnlock();
+  return CONTROLLER_OK;
+}
+
+/**
+  Write any records still waiting in RAM to EEPROM.
+  This happens automatically once logging goes quiet, so you'll normally only need it
+  right before a reset.
+  @return 0 on success.
+*/
+int datalogFlush()
+{
+  int rv = CONTROLLER_OK;
+  chMtxLock(&datalog.lock);
+  if (datalog.dirty) {
+    rv = datalogWritePage(datalog.head, &datalog.staging);
+    if (rv == CONTROLLER_OK)
+      datalog.dirty = false;
+  }
+  chMtxUnlock();
+  return rv;
+}
+
+/**
+  The number of pages in the log.
+  @return The number of pages, including the one currently being filled.
+*/
+int datalogPages()
+{
+  chMtxLock(&datalog.lock);
+  int pages = ((datalog.head - datalog.oldest + DATALOG_PAGES) % DATALOG_PAGES) + 1;
+  if (datalog.staging.used == 0)
+    pages--;
+  chMtxUnlock();
+  return pages;
+}
+
+/**
+  Read a page of the log.
+  Page 0 is the oldest, and datalogPages() - 1 the newest.  Use datalogNextRecord() to
+  step through the records in the page.
+  @param index Which page to read.
+  @param data Where to read the page's records into - must be at least \b DATALOG_PAGE_DATA bytes.
+  @param seq (optional) Set to the page's sequence number.
+  @return The number of bytes of records read, or less than 0 on failure.
+*/
+int datalogReadPage(int index, uint8_t* data, uint32_t* seq)
+{
+  DatalogPage page;
+  if (index < 0 || index >= datalogPages())
+    return CONTROLLER_ERROR_ILLEGAL_INDEX;
+
+  chMtxLock(&datalog.lock);
+  int p = (datalog.oldest + index) % DATALOG_PAGES;
+  if (p == datalog.head)
+    page = datalog.staging;
+  else if (datalog.outgoingPending && p == datalog.outgoingPage)
+    page = datalog.outgoing;
+  else if (!datalogLoadPage(p, &page)) {
+    page.seq = 0;
+    page.used = 0; // damaged - skip it, but keep going
+  }
+  chMtxUnlock();
+
+  memcpy(data, page.data, page.used);
+  if (seq)
+    *seq = page.seq;
+  return page.used;
+}
+
+/**
+  Step through the records in a page read with datalogReadPage().
+  @param page The page data.
+  @param pagelen The number of bytes in the page, as returned by datalogReadPage().
+  @param pos The position in the page - start at 0.  It's moved on to the next record.
+  @param record Set to the start of the record.
+  @return The length of the record, or 0 if there are no more.
+
+  \b Example
+  \code
+  uint8_t page[DATALOG_PAGE_DATA];
+  int i, pages = datalogPages();
+  for (i = 0; i < pages; i++) {
+    int pos = 0, len, pagelen = datalogReadPage(i, page, 0);
+    const uint8_t* record;
+    while ((len = datalogNextRecord(page, pagelen, &pos, &record)) > 0) {
+      // process the record
+    }
+  }
+  \endcode
+*/
+int datalogNextRecord(const uint8_t* page, int pagelen, int* pos, const uint8_t** record)
+{
+  if (*pos >= pagelen)
+    return 0;
+  int len = page[*pos];
+  if (len == 0 || *pos + 1 + len > pagelen)
+    return 0;
+  *record = page + *pos + 1;
+  *pos += len + 1;
+  return len;
+}
+
+/**
+  Erase the log.
+  Each page that's been used is marked as empty, which takes up to 5 milliseconds per page.
+*/
+void datalogClear()
+{
+  int i;
+  uint32_t erased = DATALOG_ERASED;
+  chMtxLock(&datalog.lock);
+  datalogTakeWriter(); // make sure the writer isn't in the middle of anything
+  int pages = ((datalog.head - datalog.oldest + DATALOG_PAGES) % DATALOG_PAGES) + 1;
+  for (i = 0; i < pages; i++) {
+    int p = (datalog.oldest + i) % DATALOG_PAGES;
+    eepromWriteBlock(DATALOG_BASE + (p * EEPROM_PAGE_SIZE), (uint8_t*)&erased, sizeof(erased));
+  }
+  datalog.head = datalog.oldest = 0;
+  datalog.staging.used = 0;
+  memset(datalog.staging.data, 0, DATALOG_PAGE_DATA);
+  datalog.dirty = false;
+  chSemSignal(&datalog.free);
+  chMtxUnlock();
+}
+
+/** @} */
+
+#ifdef OSC
+
+/** \defgroup DatalogOSC Data Logger - OSC
+  Download and manage the data log via OSC.
+  \ingroup OSC
+
+  \section devices Devices
+  There's only one data log, so a device index is not used in OSC messages to it.
+
+  \section properties Properties
+  The data log has the following properties:
+  - pages
+  - dump
+  - flush
+  - clear
+
+  \par Pages
+  The \b pages property is the number of pages in the log.  It's read-only - to read it, send
+  \verbatim /datalog/pages \endverbatim
+
+  \par Dump
+  The \b dump property sends the log back, one message per page.  Send
+  \verbatim /datalog/dump \endverbatim
+  to get the whole thing, or
+  \verbatim /datalog/dump 10 5 \endverbatim
+  to get 5 pages starting at page 10 (page 0 is the oldest).  Each page comes back as
+  \verbatim /datalog/dump 1234 [blob] \endverbatim
+  where 1234 is the page's sequence number and the blob is its records - each one a length byte followed by the data.
+  Messages are packed into bundles, so a full log comes down in a few hundred packets.
+
+  \par Flush
+  Write any records waiting in RAM to the EEPROM by sending
+  \verbatim /datalog/flush 1 \endverbatim
+
+  \par Clear
+  Erase the log by sending
+  \verbatim /datalog/clear 1 \endverbatim
+*/
+
+static void datalogPagesOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  if (datalen == 0) {
+    OscData oscd = { .type = INT, .value.i = datalogPages() };
+    oscCreateMessage(ch, address, &oscd, 1);
+  }
+}
+
+static void datalogDumpOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx);
+  // no channel means it's being read along with everything else, by oscQuery() - it leaves
+  // blobs out anyway, so don't read the whole EEPROM for nothing
+  if (ch == NONE)
+    return;
+  uint8_t page[DATALOG_PAGE_DATA];
+  uint32_t seq;
+  int pages = datalogPages();
+  int first = (datalen > 0 && d[0].type == INT) ? d[0].value.i : 0;
+  int count = (datalen > 1 && d[1].type == INT) ? d[1].value.i : pages;
+  int last = MIN(first + count, pages);
+
+  for ( ; first < last; first++) {
+    int len = datalogReadPage(first, page, &seq);
+    if (len < 0)
+      break;
+    OscData oscd[2] = {
+      { .type = INT, .value.i = seq },
+      { .type = BLOB, .value.b = (char*)page, .bloblen = len }
+    };
+    if (!oscCreateMessage(ch, address, oscd, 2))
+      break;
+  }
+}
+
+static void datalogFlushOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(ch); UNUSED(address);
+  if (datalen == 1 && d[0].value.i == 1)
+    datalogFlush();
+}
+
+static void datalogClearOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(ch); UNUSED(address);
+  if (datalen == 1 && d[0].value.i == 1)
+    datalogClear();
+}
+
+static const OscNode datalogPagesNode = { .name = "pages", .handler = datalogPagesOsc };
+static const OscNode datalogDumpNode = { .name = "dump", .handler = datalogDumpOsc };
+static const OscNode datalogFlushNode = { .name = "flush", .handler = datalogFlushOsc };
+static const OscNode datalogClearNode = { .name = "clear", .handler = datalogClearOsc };
+
+const OscNode datalogOsc = {
+  .name = "datalog",
+  .children = {
+    &datalogPagesNode,
+    &datalogDumpNode,
+    &datalogFlushNode,
+    &datalogClearNode, 0
+  }
+};
+
+#endif // OSC
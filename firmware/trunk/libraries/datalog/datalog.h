@@ -0,0 +1,47 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef DATALOG_H
+#define DATALOG_H
+
+#include "types.h"
+#include "eeprom.h"
+
+#define DATALOG_PAGE_HEADER 6
+#define DATALOG_PAGE_DATA (EEPROM_PAGE_SIZE - DATALOG_PAGE_HEADER) /**< bytes of records in each page */
+#define DATALOG_MAX_RECORD (DATALOG_PAGE_DATA - 1) /**< the largest record that can be logged */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void datalogInit(void);
+int  datalogAppend(const uint8_t* data, int length);
+int  datalogFlush(void);
+int  datalogPages(void);
+int  datalogReadPage(int index, uint8_t* data, uint32_t* seq);
+int  datalogNextRecord(const uint8_t* page, int pagelen, int* pos, const uint8_t** record);
+void datalogClear(void);
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef OSC
+#include "osc.h"
+extern const OscNode datalogOsc;
+#endif
+
+#endif // DATALOG_H
@@ -142,7 +142,7 @@ static uint16_t digitalinAutosendChannels;
 
 void digitalinAutoSendInit()
 {
-  digitalinAutosendChannels = eepromRead(EEPROM_DIGITALIN_AUTOSEND);
+  digitalinAutosendChannels = settingsRead(EEPROM_DIGITALIN_AUTOSEND);
   if (((digitalinAutosendChannels >> 8) & 0xFF) != DIN_AUTOSEND_SAVED)
     digitalinAutosendChannels = DIN_AUTOSEND_SAVED << 8;
 }
@@ -180,7 +180,7 @@ static void digitalinAutosendHandler(OscChannel ch, char* address, int idx, OscD
     else
       digitalinAutosendChannels &= ~(1 << idx);
 
-    eepromWrite(EEPROM_DIGITALIN_AUTOSEND, digitalinAutosendChannels);
+    settingsWrite(EEPROM_DIGITALIN_AUTOSEND, digitalinAutosendChannels);
   }
 }
 
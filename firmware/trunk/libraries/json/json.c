@@ -17,9 +17,6 @@
 
 #include "json.h"
 #include "string.h"
-#include "stdio.h"
-#include <stdlib.h>
-#include <ctype.h>
 
 /** \defgroup json JSON
 	A very small and very fast library for parsing and generating json.
@@ -29,10 +26,9 @@
   environments, so it's not a bad option for a communication format when you need to talk to other
   devices from the Make Controller.
 
-  \b Disclaimer - in an attempt to keep it as small and as simple as possible, this library is not
-  completely full featured at the moment.  It doesn't process escaped strings for you, and doesn't deal
-  with some of the more exotic numeric representations outlined in the JSON specification.
-  It does, however, work quite well for most other JSON tasks.
+  Both the reader and the writer handle the whole JSON specification - escapes, \\u sequences
+  and all the numeric representations.  Neither one uses printf or double math, so they're fast
+  and small on the Make Controller.
 
   \section Generating
   Generating JSON is pretty simple - just make successive calls to the API to add the desired
@@ -44,6 +40,10 @@
    - a count of how many bytes are left in that buffer
    The API will update the count, so it's not too much trouble.
 
+  If the document might not fit in the buffer, give the writer a flush handler with
+  jsonwriterSetFlush() - it's called each time the buffer fills up, so you can send the
+  JSON on its way (to a TcpSocket, say) and keep going.
+
   \code
   #define MAX_JSON_LEN 256
   char jsonbuf[MAX_JSON_LEN];
@@ -51,7 +51,7 @@
   JsonWriter jw;
 
   char *p = jsonbuf; // keep a pointer to the current location
-  jsonwriterInit(&jw);
+  jsonwriterInit(&jw, jsonbuf, MAX_JSON_LEN);
   p = jsonwriterObjectOpen(&jw);
   p = jsonwriterString(&jw, "hello");
   p = jsonwriterInt(&jw, 234);
@@ -70,6 +70,10 @@
 
   In each callback, return true to continue parsing, or return false and parsing will stop.
 
+  The document doesn't need to be all in one buffer - feed it to jsonreaderFeed() in pieces as
+  they arrive, and call jsonreaderFinish() at the end.  Strings are passed to the callbacks as a
+  pointer and a length, without copying them if possible, so copy anything you want to keep.
+
   If you need to pass around some context that you would like available in each of the callbacks,
   you can pass it to jsonreaderInit() and it will be passed to each of the callbacks you've registered.
   Otherwise, just pass 0 if you don't need it.
@@ -89,7 +93,7 @@
     return true; // keep parsing
   }
 
-  bool on_string(void *ctx, char *string, int len)
+  bool on_string(void *ctx, const char *string, int len)
   {
     // called when a string is encountered...
     return true; // keep parsing
@@ -100,7 +104,7 @@
   
   // Now, register these callbacks with the JSON reader.
   JsonReader jr;
-  jsonreaderInit(&jr, 0);
+  jsonreaderInit(&jr, 0, true);
   jr.start_obj_handler = on_obj_opened;
   jr.int_handler = on_int;
   jr.string_handler = on_string;
@@ -118,7 +122,7 @@ static void jsonwriterAppendedAtom(JsonWriter* jw);
 
 /**
   Initialize or reset the state of a JsonWriter.
-  Be sure to do this each time before you start a new parse.
+  Be sure to do this each time before you start a new document.
   @param jw The JsonWriter to initialize.
   @param buffer The buffer it will be writing to.
   @param len The maximum size of \b buffer
@@ -129,50 +133,182 @@ void jsonwriterInit(JsonWriter* jw, char* buffer, int len)
   jw->steps[0] = JSON_START;
   jw->p = buffer;
   jw->remaining = len;
+  jw->buffer = buffer;
+  jw->size = len;
+  jw->flush = 0;
+  jw->flushContext = 0;
 }
 
 /**
-  Open up a new JSON object.
-  This adds an opening '{' to the json string.
-  @param jw The JsonWriter being used.
-  @return A pointer to the location in the JSON buffer after this element has been added, or NULL if there was no room.
+  Stream the JSON out through a handler as it's written.
+  Normally the whole document has to fit in the JsonWriter's buffer.  With a flush handler,
+  whenever the buffer fills up its contents are passed to the handler and it starts over
+  from the beginning, so a document of any size can be written through a small buffer.
+  Call jsonwriterFlush() once the document is finished to send the last of it.
+
+  The handler should return true if it dealt with the data, or false to stop writing -
+  the writer functions will then return NULL.
+
+  @param jw The JsonWriter to use.
+  @param flush The handler to call when the buffer is full.
+  @param context Passed along to the handler.
+
+  \par Example
+  \code
+  bool sendJson(void* context, const char* data, int len)
+  {
+    int socket = (int)context;
+    return tcpWrite(socket, data, len) == len;
+  }
+
+  char buf[128];
+  JsonWriter jw;
+  jsonwriterInit(&jw, buf, sizeof(buf));
+  jsonwriterSetFlush(&jw, sendJson, (void*)socket);
+  jsonwriterArrayOpen(&jw);
+  for (i = 0; i < 1000; i++)
+    jsonwriterInt(&jw, readings[i]);
+  jsonwriterArrayClose(&jw);
+  jsonwriterFlush(&jw);
+  \endcode
 */
-char* jsonwriterObjectOpen(JsonWriter* jw)
+void jsonwriterSetFlush(JsonWriter* jw, JsonFlushHandler flush, void* context)
+{
+  jw->flush = flush;
+  jw->flushContext = context;
+}
+
+/**
+  Send whatever's in the buffer to the flush handler.
+  @param jw The JsonWriter to use.
+  @return True if the data was sent, or there was nothing to send.  False if the flush
+  handler failed, or there isn't one.
+*/
+bool jsonwriterFlush(JsonWriter* jw)
+{
+  int len = jw->p - jw->buffer;
+  if (!len)
+    return true;
+  if (!jw->flush || !jw->flush(jw->flushContext, jw->buffer, len))
+    return false;
+  jw->p = jw->buffer;
+  jw->remaining = jw->size;
+  return true;
+}
+
+/*
+  Make sure there's room to write len bytes.
+  Without a flush handler, nothing gets written unless it all fits.  With one, the
+  buffer is flushed first if need be, and jsonwriterPut() flushes as it goes.
+*/
+static bool jsonwriterRoom(JsonWriter* jw, int len)
 {
   if (!jw->p)
-    return 0;
-  int len = 1;
+    return false;
+  if (jw->remaining >= len)
+    return true;
+  return jw->flush && jsonwriterFlush(jw);
+}
+
+static bool jsonwriterPut(JsonWriter* jw, const char* data, int len)
+{
+  while (len) {
+    if (!jw->remaining && !jsonwriterFlush(jw))
+      return false;
+    int n = (len < jw->remaining) ? len : jw->remaining;
+    memcpy(jw->p, data, n);
+    jw->p += n;
+    jw->remaining -= n;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+/*
+  The separator that has to go before the next element, or 0 if none.
+*/
+static char jsonwriterSeparator(JsonWriter* jw)
+{
   switch (jw->steps[jw->depth]) {
-    case JSON_ARRAY_START:
-    case JSON_OBJ_START:
-    case JSON_START:
-      if (jw->remaining < len)
-        return NULL;
-      *jw->p = '{';
-      break;
     case JSON_OBJ_KEY:
     case JSON_IN_ARRAY:
-      len += 1; // for ,
-      if (jw->remaining < len)
-        return NULL;
-      memcpy(jw->p, ",{", len);
-      break;
+      return ',';
     case JSON_OBJ_VALUE:
-      len += 1; // for :
-      if (jw->remaining < len)
-        return NULL;
-      memcpy(jw->p, ":{", len);
-      break;
+      return ':';
+    default:
+      return 0;
   }
-  
-  if (++jw->depth > JSON_MAX_DEPTH)
+}
+
+/*
+  Whether a value (as opposed to a key) can go next.
+*/
+static bool jsonwriterValueAllowed(JsonWriter* jw)
+{
+  switch (jw->steps[jw->depth]) {
+    case JSON_ARRAY_START:
+    case JSON_IN_ARRAY:
+    case JSON_OBJ_VALUE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/*
+  Write a complete element - the separator, then len bytes of data.
+*/
+static char* jsonwriterElement(JsonWriter* jw, const char* data, int len)
+{
+  char sep = jsonwriterSeparator(jw);
+  if (!jsonwriterRoom(jw, len + (sep ? 1 : 0)))
+    return NULL;
+  if ((sep && !jsonwriterPut(jw, &sep, 1)) || !jsonwriterPut(jw, data, len))
     return NULL;
-  jw->steps[jw->depth] = JSON_OBJ_START;
-  jw->remaining -= len;
-  jw->p += len;
+  if (jw->remaining) // keep the buffer null terminated if there's room
+    *jw->p = 0;
+  jsonwriterAppendedAtom(jw);
+  return jw->p;
+}
+
+static char* jsonwriterOpen(JsonWriter* jw, char c, JsonWriterStep step)
+{
+  if (!jw->p || jw->depth + 1 >= JSON_MAX_DEPTH)
+    return NULL;
+  char sep = jsonwriterSeparator(jw);
+  if (!jsonwriterRoom(jw, sep ? 2 : 1))
+    return NULL;
+  if ((sep && !jsonwriterPut(jw, &sep, 1)) || !jsonwriterPut(jw, &c, 1))
+    return NULL;
+  if (jw->remaining)
+    *jw->p = 0;
+  jw->steps[++jw->depth] = step;
+  return jw->p;
+}
+
+static char* jsonwriterClose(JsonWriter* jw, char c)
+{
+  if (!jw->depth || !jsonwriterRoom(jw, 1) || !jsonwriterPut(jw, &c, 1))
+    return NULL;
+  if (jw->remaining)
+    *jw->p = 0;
+  jw->depth--;
+  jsonwriterAppendedAtom(jw);
   return jw->p;
 }
 
+/**
+  Open up a new JSON object.
+  This adds an opening '{' to the json string.
+  @param jw The JsonWriter being used.
+  @return A pointer to the location in the JSON buffer after this element has been added, or NULL if there was no room.
+*/
+char* jsonwriterObjectOpen(JsonWriter* jw)
+{
+  return jsonwriterOpen(jw, '{', JSON_OBJ_START);
+}
+
 /**
   Set the key for a JSON object.
   This is a convenience function that simply calls jsonwriterString().
@@ -195,13 +331,7 @@ char* jsonwriterObjectKey(JsonWriter* jw, const char *key)
 */
 char* jsonwriterObjectClose(JsonWriter* jw)
 {
-  if (jw->remaining < 1 || !jw->p )
-    return NULL;
-  *jw->p++ = '}';
-  jw->remaining--;
-  jw->depth--;
-  jsonwriterAppendedAtom(jw);
-  return jw->p;
+  return jsonwriterClose(jw, '}');
 }
 
 /**
@@ -212,37 +342,7 @@ char* jsonwriterObjectClose(JsonWriter* jw)
 */
 char* jsonwriterArrayOpen(JsonWriter* jw)
 {
-  if (!jw->p)
-    return 0;
-  int len = 1;
-  switch (jw->steps[jw->depth]) {
-    case JSON_ARRAY_START:
-    case JSON_OBJ_START:
-    case JSON_START:
-      if (jw->remaining < len)
-        return NULL;
-      *jw->p = '[';
-      break;
-    case JSON_OBJ_KEY:
-    case JSON_IN_ARRAY:
-      len += 1; // for ,
-      if (jw->remaining < len)
-        return NULL;
-      memcpy(jw->p, ",[", len);
-      break;
-    case JSON_OBJ_VALUE:
-      len += 1; // for :
-      if (jw->remaining < len)
-        return NULL;
-      memcpy(jw->p, ":[", len);
-      break;
-  }
-  if (++jw->depth > JSON_MAX_DEPTH)
-    return NULL;
-  jw->steps[jw->depth] = JSON_ARRAY_START;
-  jw->remaining -= len;
-  jw->p += len;
-  return jw->p;
+  return jsonwriterOpen(jw, '[', JSON_ARRAY_START);
 }
 
 /**
@@ -253,19 +353,40 @@ char* jsonwriterArrayOpen(JsonWriter* jw)
 */
 char* jsonwriterArrayClose(JsonWriter* jw)
 {
-  if (jw->remaining < 1 || !jw->p)
-    return NULL;
-  *jw->p++ = ']';
-  jw->remaining--;
-  jw->depth--;
-  jsonwriterAppendedAtom(jw);
-  return jw->p;
+  return jsonwriterClose(jw, ']');
+}
+
+// the escape for a character that can't go in a JSON string as is, or 0 if it can
+static int jsonwriterEscape(unsigned char c, char* esc)
+{
+  static const char hex[] = "0123456789abcdef";
+  char e;
+  switch (c) {
+    case '"': e = '"'; break;
+    case '\\': e = '\\'; break;
+    case '\b': e = 'b'; break;
+    case '\f': e = 'f'; break;
+    case '\n': e = 'n'; break;
+    case '\r': e = 'r'; break;
+    case '\t': e = 't'; break;
+    default:
+      if (c >= 0x20)
+        return 0;
+      memcpy(esc, "\\u00", 4);
+      esc[4] = hex[c >> 4];
+      esc[5] = hex[c & 0xF];
+      return 6;
+  }
+  esc[0] = '\\';
+  esc[1] = e;
+  return 2;
 }
 
 /**
   Add a string to the current JSON string.
   Depending on whether you've opened objects, arrays, or other inserted 
   other data, the approprate separating symbols will be added to the string.
+  Quotes, backslashes and control characters are escaped.
 
   @param jw The JsonWriter being used.
   @param string The string to be added.
@@ -273,41 +394,51 @@ char* jsonwriterArrayClose(JsonWriter* jw)
 */
 char* jsonwriterString(JsonWriter* jw, const char *string)
 {
-  if (!jw->p)
-    return 0;
-  int string_len = strlen(string) + 2 /* quotes */ + 1 /* null terminator*/;
-  // json doesn't actually need the null-terminator, but it's worth
-  // requiring so we can just use sprintf directly into the buffer
-
-  switch (jw->steps[jw->depth]) {
-    case JSON_ARRAY_START:
-    case JSON_OBJ_START:
-      if (jw->remaining < string_len)
-        return NULL;
-      string_len = sniprintf(jw->p, string_len, "\"%s\"", string);
-      break;
-    case JSON_OBJ_KEY:
-    case JSON_IN_ARRAY:
-      string_len += 1; // for ,
-      if (jw->remaining < string_len)
-        return NULL;
-      string_len = sniprintf(jw->p, string_len, ",\"%s\"", string);
-      break;
-    case JSON_OBJ_VALUE:
-      string_len += 1; // for :
-      if (jw->remaining < string_len)
-        return NULL;
-      string_len = sniprintf(jw->p, string_len, ":\"%s\"", string);
-      break;
-    default:
+  char esc[6];
+  const unsigned char* s;
+  int len = 2; // quotes
+  if (jw->steps[jw->depth] == JSON_START)
+    return NULL;
+  for (s = (const unsigned char*)string; *s; s++) {
+    int n = jsonwriterEscape(*s, esc);
+    len += n ? n : 1;
+  }
+  char sep = jsonwriterSeparator(jw);
+  if (!jsonwriterRoom(jw, len + (sep ? 1 : 0)))
+    return NULL;
+  if ((sep && !jsonwriterPut(jw, &sep, 1)) || !jsonwriterPut(jw, "\"", 1))
+    return NULL;
+  while (*string) {
+    const char* run = string;
+    int n = 0;
+    while (*string && !(n = jsonwriterEscape(*string, esc)))
+      string++;
+    if (!jsonwriterPut(jw, run, string - run))
       return NULL;
+    if (n) {
+      if (!jsonwriterPut(jw, esc, n))
+        return NULL;
+      string++;
+    }
   }
+  if (!jsonwriterPut(jw, "\"", 1))
+    return NULL;
+  if (jw->remaining)
+    *jw->p = 0;
   jsonwriterAppendedAtom(jw);
-  jw->remaining -= string_len;
-  jw->p += string_len;
   return jw->p;
 }
 
+// write the decimal digits of an unsigned value backwards from the end of buf
+static char* jsonwriterDigits(char* end, uint32_t value)
+{
+  do {
+    *--end = '0' + (value % 10);
+    value /= 10;
+  } while (value);
+  return end;
+}
+
 /**
   Add an int to a JSON string.
 
@@ -317,47 +448,116 @@ char* jsonwriterString(JsonWriter* jw, const char *string)
 */
 char* jsonwriterInt(JsonWriter* jw, int value)
 {
-  if (!jw->p)
-    return 0;
-  int int_as_str_len = 10 + 1 + 1; // largest 32-bit int is 10 digits long, and also leave room for a +/-
-  int int_len = 0;
-  switch (jw->steps[jw->depth]) {
-    case JSON_ARRAY_START:
-    {
-      char temp[int_as_str_len];
-      int_len = sniprintf(temp, int_as_str_len, "%d", value);
-      if (jw->remaining < int_len)
-        return NULL;
-      memcpy(jw->p, temp, int_len);
-      break;
-    }
-    case JSON_IN_ARRAY:
-    {
-      int_as_str_len += 1; // for ,
-      char temp[int_as_str_len];
-      int_len = sniprintf(temp, int_as_str_len, ",%d", value);
-      if (jw->remaining < int_len)
-        return NULL;
-      memcpy(jw->p, temp, int_len);
-      break;
-    }
-    case JSON_OBJ_VALUE:
-    {
-      int_as_str_len += 1; // for :
-      char temp[int_as_str_len];
-      int_len = sniprintf(temp, int_as_str_len, ":%d", value);
-      if (jw->remaining < int_len)
-        return NULL;
-      memcpy(jw->p, temp, int_len);
-      break;
+  char temp[12]; // largest 32-bit int is 10 digits long, and also leave room for a +/-
+  char* end = temp + sizeof(temp);
+  if (!jw->p || !jsonwriterValueAllowed(jw))
+    return NULL;
+  char* start = jsonwriterDigits(end, (value < 0) ? 0U - (uint32_t)value : (uint32_t)value);
+  if (value < 0)
+    *--start = '-';
+  return jsonwriterElement(jw, start, end - start);
+}
+
+#define JSON_FLOAT_WORDS 5 // enough for the biggest float, times 10^JSON_MAX_DECIMALS
+
+/**
+  Add a float to a JSON string.
+  The output is the same as printf's "%.*f" with \b decimals - rounded, not truncated, to
+  that many places after the decimal point - but without pulling printf in, and without
+  using any double math.  Since JSON has no way to write infinity or NaN, those come
+  out as null.
+
+  @param jw The JsonWriter being used.
+  @param value The float to be added.
+  @param decimals How many digits to write after the decimal point - 0 to \b JSON_MAX_DECIMALS (9).
+  @return A pointer to the JSON buffer after this element has been added, or NULL if there was no room.
+
+  \par Example
+  \code
+  jsonwriterObjectKey(&jw, "temperature");
+  jsonwriterFloat(&jw, 21.456, 2); // writes 21.46
+  \endcode
+*/
+char* jsonwriterFloat(JsonWriter* jw, float value, int decimals)
+{
+  static const uint32_t powersOf10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+  };
+  char temp[64];
+  char* end = temp + sizeof(temp);
+  char* p = end;
+  uint32_t bits, words[JSON_FLOAT_WORDS];
+  int i, digits, top;
+
+  if (!jw->p || !jsonwriterValueAllowed(jw))
+    return NULL;
+  if (decimals < 0)
+    decimals = 0;
+  else if (decimals > JSON_MAX_DECIMALS)
+    decimals = JSON_MAX_DECIMALS;
+
+  memcpy(&bits, &value, sizeof(bits));
+  int exponent = (bits >> 23) & 0xFF;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if (exponent == 0xFF) // infinity or NaN
+    return jsonwriterElement(jw, "null", 4);
+  if (exponent) {
+    mantissa |= 0x800000;
+    exponent -= 150; // value = mantissa * 2^exponent
+  }
+  else
+    exponent = -149; // denormal
+
+  // the value times 10^decimals, rounded to the nearest integer, as a multi-word number
+  uint64_t scaled = (uint64_t)mantissa * powersOf10[decimals]; // at most 54 bits
+  memset(words, 0, sizeof(words));
+  if (exponent >= 0) {
+    words[0] = (uint32_t)scaled;
+    words[1] = (uint32_t)(scaled >> 32);
+    while (exponent > 0) { // shift left a word, or less, at a time
+      int shift = (exponent > 31) ? 31 : exponent;
+      uint32_t carry = 0;
+      for (i = 0; i < JSON_FLOAT_WORDS; i++) {
+        uint32_t w = words[i];
+        words[i] = (w << shift) | carry;
+        carry = w >> (32 - shift);
+      }
+      exponent -= shift;
     }
-    default:
-      return NULL; // bogus state
   }
-  jsonwriterAppendedAtom(jw);
-  jw->remaining -= int_len;
-  jw->p += int_len;
-  return jw->p;
+  else if (exponent > -64) {
+    int shift = -exponent;
+    uint64_t whole = scaled >> shift;
+    uint64_t rest = scaled - (whole << shift);
+    uint64_t half = (uint64_t)1 << (shift - 1);
+    if (rest > half || (rest == half && (whole & 1))) // round half to even, like printf
+      whole++;
+    words[0] = (uint32_t)whole;
+    words[1] = (uint32_t)(whole >> 32);
+  }
+  // else it rounds to 0
+
+  // pull out the decimal digits, least significant first
+  top = JSON_FLOAT_WORDS;
+  digits = 0;
+  do {
+    uint32_t remainder = 0;
+    while (top > 0 && words[top - 1] == 0)
+      top--;
+    for (i = top - 1; i >= 0; i--) {
+      uint64_t n = ((uint64_t)remainder << 32) | words[i];
+      words[i] = (uint32_t)(n / 10);
+      remainder = (uint32_t)(n % 10);
+    }
+    *--p = '0' + remainder;
+    if (++digits == decimals)
+      *--p = '.';
+    while (top > 0 && words[top - 1] == 0)
+      top--;
+  } while (top > 0 || digits <= decimals);
+  if (bits & 0x80000000) // negative, including -0, like printf
+    *--p = '-';
+  return jsonwriterElement(jw, p, end - p);
 }
 
 /**
@@ -369,43 +569,9 @@ char* jsonwriterInt(JsonWriter* jw, int value)
 */
 char* jsonwriterBool(JsonWriter* jw, bool value)
 {
-  if (!jw->p)
-    return 0;
-  const char* boolval;
-  int bool_len;
-  if (value) {
-    boolval = "true";
-    bool_len = 4 + 1; // for null terminator
-  }
-  else {
-    boolval = "false";
-    bool_len = 5 + 1; // for null terminator
-  }
-  switch (jw->steps[jw->depth]) {
-    case JSON_ARRAY_START:
-      if (jw->remaining < bool_len)
-        return NULL;
-      bool_len = sniprintf(jw->p, bool_len, "%s", boolval);
-      break;
-    case JSON_IN_ARRAY:
-      bool_len += 1; // for ,
-      if (jw->remaining < bool_len)
-        return NULL;
-      bool_len = sniprintf(jw->p, bool_len, ",%s", boolval);
-      break;
-    case JSON_OBJ_VALUE:
-      bool_len += 1; // for :
-      if (jw->remaining < bool_len)
-        return NULL;
-      bool_len = sniprintf(jw->p, bool_len, ":%s", boolval);
-      break;
-    default:
-      return NULL; // bogus state
-  }
-  jsonwriterAppendedAtom(jw);
-  jw->remaining -= bool_len;
-  jw->p += bool_len;
-  return jw->p;
+  if (!jw->p || !jsonwriterValueAllowed(jw))
+    return NULL;
+  return value ? jsonwriterElement(jw, "true", 4) : jsonwriterElement(jw, "false", 5);
 }
 
 /*
@@ -435,29 +601,45 @@ void jsonwriterAppendedAtom(JsonWriter* jw)
  JsonDecode
 ****************************************************************************/
 
-typedef enum JsonReaderToken_t {
-  token_true,
-  token_false,
-  token_colon,
-  token_comma,
-  token_eof,
-  token_error,
-  token_left_brace,
-  token_left_bracket,
-  token_null,
-  token_right_brace,
-  token_right_bracket,
-  token_number,
-  token_maybe_negative,
-  token_string,
-  token_unknown
-} JsonReaderToken;
-
-static JsonReaderToken jsonreaderGetToken(char* text, int len);
+// the token that's partway through being read
+enum {
+  JSON_TOKEN_NONE,
+  JSON_TOKEN_STRING,
+  JSON_TOKEN_NUMBER,
+  JSON_TOKEN_LITERAL
+};
+
+// how far through a string
+enum {
+  JSON_STRING_CHARS,
+  JSON_STRING_ESCAPE,
+  JSON_STRING_HEX // + the number of hex digits read so far
+};
+
+// how far through a number
+enum {
+  JSON_NUMBER_SIGN,   // just the -
+  JSON_NUMBER_ZERO,   // a leading 0
+  JSON_NUMBER_INT,
+  JSON_NUMBER_DOT,
+  JSON_NUMBER_FRAC,
+  JSON_NUMBER_E,
+  JSON_NUMBER_ESIGN,
+  JSON_NUMBER_EXP
+};
+
+static const float jsonPowersOf10[] = {
+  1e0f,  1e1f,  1e2f,  1e3f,  1e4f,  1e5f,  1e6f,  1e7f,  1e8f,  1e9f,
+  1e10f, 1e11f, 1e12f, 1e13f, 1e14f, 1e15f, 1e16f, 1e17f, 1e18f, 1e19f,
+  1e20f, 1e21f, 1e22f, 1e23f, 1e24f, 1e25f, 1e26f, 1e27f, 1e28f, 1e29f,
+  1e30f, 1e31f, 1e32f, 1e33f, 1e34f, 1e35f, 1e36f, 1e37f, 1e38f
+};
+
+#define JSON_MAX_EXPONENT 38
 
 /**
   Initialize or reset a JsonReader.
-  Do this prior to making a call to jsonreaderGo().
+  Do this prior to reading each new document.
   @param jr The JsonReader to use.
   @param context (optional) An optional parameter that your code can use to
   pass around a known object within the callbacks.  Set it to 0 if you don't need it.
@@ -465,11 +647,10 @@ static JsonReaderToken jsonreaderGetToken(char* text, int len);
 */
 void jsonreaderInit(JsonReader* jr, void* context, bool resetHandlers)
 {
+  jr->state = JSON_READER_VALUE;
   jr->depth = 0;
-  jr->gotcomma = false;
+  jr->token = JSON_TOKEN_NONE;
   jr->context = context;
-  jr->p = 0;
-  jr->len = 0;
   if (resetHandlers) {
     jr->null_handler        = 0;
     jr->bool_handler        = 0;
@@ -484,194 +665,530 @@ void jsonreaderInit(JsonReader* jr, void* context, bool resetHandlers)
   }
 }
 
+/*
+  A value has been read - figure out what's allowed next.
+*/
+static bool jsonreaderValueDone(JsonReader* jr)
+{
+  jr->state = jr->depth ? JSON_READER_AFTER_VALUE : JSON_READER_DONE;
+  return true;
+}
+
+static bool jsonreaderOpen(JsonReader* jr, char c)
+{
+  if (jr->depth >= JSON_MAX_DEPTH)
+    return false;
+  jr->stack[jr->depth++] = c;
+  if (c == '{') {
+    jr->state = JSON_READER_OBJECT_START;
+    return !jr->start_obj_handler || jr->start_obj_handler(jr->context);
+  }
+  jr->state = JSON_READER_ARRAY_START;
+  return !jr->start_array_handler || jr->start_array_handler(jr->context);
+}
+
+static bool jsonreaderClose(JsonReader* jr, char c)
+{
+  if (!jr->depth || jr->stack[jr->depth - 1] != ((c == '}') ? '{' : '['))
+    return false;
+  jr->depth--;
+  if (c == '}') {
+    if (jr->end_obj_handler && !jr->end_obj_handler(jr->context))
+      return false;
+  }
+  else if (jr->end_array_handler && !jr->end_array_handler(jr->context))
+    return false;
+  return jsonreaderValueDone(jr);
+}
+
+static bool jsonreaderString(JsonReader* jr, const char* string, int len)
+{
+  jr->token = JSON_TOKEN_NONE;
+  if (jr->key) {
+    jr->state = JSON_READER_COLON;
+    return !jr->obj_key_handler || jr->obj_key_handler(jr->context, string, len);
+  }
+  if (jr->string_handler && !jr->string_handler(jr->context, string, len))
+    return false;
+  return jsonreaderValueDone(jr);
+}
+
+static bool jsonreaderBuffer(JsonReader* jr, const char* data, int len)
+{
+  if (jr->buflen + len > JSON_READER_STRING_MAX)
+    return false;
+  memcpy(jr->buf + jr->buflen, data, len);
+  jr->buflen += len;
+  return true;
+}
+
+static bool jsonreaderPutUtf8(JsonReader* jr, uint32_t c)
+{
+  char utf8[4];
+  int len;
+  if (c < 0x80) {
+    utf8[0] = c;
+    len = 1;
+  }
+  else if (c < 0x800) {
+    utf8[0] = 0xC0 | (c >> 6);
+    utf8[1] = 0x80 | (c & 0x3F);
+    len = 2;
+  }
+  else if (c < 0x10000) {
+    utf8[0] = 0xE0 | (c >> 12);
+    utf8[1] = 0x80 | ((c >> 6) & 0x3F);
+    utf8[2] = 0x80 | (c & 0x3F);
+    len = 3;
+  }
+  else {
+    utf8[0] = 0xF0 | (c >> 18);
+    utf8[1] = 0x80 | ((c >> 12) & 0x3F);
+    utf8[2] = 0x80 | ((c >> 6) & 0x3F);
+    utf8[3] = 0x80 | (c & 0x3F);
+    len = 4;
+  }
+  return jsonreaderBuffer(jr, utf8, len);
+}
+
+/*
+  The first half of a surrogate pair that didn't get its second half
+  becomes the Unicode replacement character.
+*/
+static bool jsonreaderFlushSurrogate(JsonReader* jr)
+{
+  if (!jr->surrogate)
+    return true;
+  jr->surrogate = 0;
+  return jsonreaderPutUtf8(jr, 0xFFFD);
+}
+
+static bool jsonreaderCodepoint(JsonReader* jr, uint32_t c)
+{
+  if (c >= 0xDC00 && c <= 0xDFFF && jr->surrogate) {
+    c = 0x10000 + ((jr->surrogate - 0xD800) << 10) + (c - 0xDC00);
+    jr->surrogate = 0;
+    return jsonreaderPutUtf8(jr, c);
+  }
+  if (!jsonreaderFlushSurrogate(jr))
+    return false;
+  if (c >= 0xD800 && c <= 0xDBFF) {
+    jr->surrogate = c; // wait and see if the other half comes next
+    return true;
+  }
+  if (c >= 0xDC00 && c <= 0xDFFF)
+    c = 0xFFFD;
+  return jsonreaderPutUtf8(jr, c);
+}
+
+static bool jsonreaderEscape(JsonReader* jr, char c)
+{
+  if (c == 'u') {
+    jr->sub = JSON_STRING_HEX;
+    jr->codepoint = 0;
+    return true;
+  }
+  switch (c) {
+    case '"': case '\\': case '/': break;
+    case 'b': c = '\b'; break;
+    case 'f': c = '\f'; break;
+    case 'n': c = '\n'; break;
+    case 'r': c = '\r'; break;
+    case 't': c = '\t'; break;
+    default: return false;
+  }
+  jr->sub = JSON_STRING_CHARS;
+  return jsonreaderFlushSurrogate(jr) && jsonreaderBuffer(jr, &c, 1);
+}
+
+static bool jsonreaderHexDigit(JsonReader* jr, char c)
+{
+  int v;
+  if (c >= '0' && c <= '9')
+    v = c - '0';
+  else if (c >= 'a' && c <= 'f')
+    v = c - 'a' + 10;
+  else if (c >= 'A' && c <= 'F')
+    v = c - 'A' + 10;
+  else
+    return false;
+  jr->codepoint = (jr->codepoint << 4) | v;
+  if (++jr->sub < JSON_STRING_HEX + 4)
+    return true;
+  jr->sub = JSON_STRING_CHARS;
+  return jsonreaderCodepoint(jr, jr->codepoint);
+}
+
+static void jsonreaderDigit(JsonReader* jr, char c, bool fraction)
+{
+  if (jr->mantissa <= (0xFFFFFFFFU - 9) / 10) {
+    jr->mantissa = (jr->mantissa * 10) + (c - '0');
+    if (fraction)
+      jr->exponent--;
+  }
+  else if (!fraction) // out of precision - just keep track of the magnitude
+    jr->exponent++;
+}
+
+/*
+  Move a number along by one character.
+  Returns false if the character isn't part of the number, which means the number is over.
+*/
+static bool jsonreaderNumberChar(JsonReader* jr, char c)
+{
+  bool digit = (c >= '0' && c <= '9');
+  switch (jr->sub) {
+    case JSON_NUMBER_SIGN:
+      if (!digit)
+        return false;
+      jsonreaderDigit(jr, c, false);
+      jr->sub = (c == '0') ? JSON_NUMBER_ZERO : JSON_NUMBER_INT;
+      return true;
+    case JSON_NUMBER_INT:
+      if (digit) {
+        jsonreaderDigit(jr, c, false);
+        return true;
+      }
+      // intentional fall-through
+    case JSON_NUMBER_ZERO:
+      if (c == '.')
+        jr->sub = JSON_NUMBER_DOT;
+      else if (c == 'e' || c == 'E')
+        jr->sub = JSON_NUMBER_E;
+      else
+        return false;
+      jr->isfloat = true;
+      return true;
+    case JSON_NUMBER_DOT:
+    case JSON_NUMBER_FRAC:
+      if (digit) {
+        jsonreaderDigit(jr, c, true);
+        jr->sub = JSON_NUMBER_FRAC;
+      }
+      else if (jr->sub == JSON_NUMBER_FRAC && (c == 'e' || c == 'E'))
+        jr->sub = JSON_NUMBER_E;
+      else
+        return false;
+      return true;
+    case JSON_NUMBER_E:
+      if (c == '+' || c == '-') {
+        jr->expNegative = (c == '-');
+        jr->sub = JSON_NUMBER_ESIGN;
+        return true;
+      }
+      // intentional fall-through
+    case JSON_NUMBER_ESIGN:
+    case JSON_NUMBER_EXP:
+      if (!digit)
+        return false;
+      if (jr->expValue < 10000)
+        jr->expValue = (jr->expValue * 10) + (c - '0');
+      jr->sub = JSON_NUMBER_EXP;
+      return true;
+  }
+  return false;
+}
+
+/*
+  A number is over - hand it to the int or float handler.
+*/
+static bool jsonreaderNumberEnd(JsonReader* jr)
+{
+  jr->token = JSON_TOKEN_NONE;
+  if (jr->sub != JSON_NUMBER_ZERO && jr->sub != JSON_NUMBER_INT &&
+      jr->sub != JSON_NUMBER_FRAC && jr->sub != JSON_NUMBER_EXP)
+    return false;
+
+  if (!jr->isfloat && !jr->exponent && jr->mantissa <= (jr->negative ? 0x80000000U : 0x7FFFFFFFU)) {
+    int value = jr->negative ? (int)(0U - jr->mantissa) : (int)jr->mantissa;
+    if (jr->int_handler && !jr->int_handler(jr->context, value))
+      return false;
+    return jsonreaderValueDone(jr);
+  }
+
+  int e = jr->exponent + (jr->expNegative ? -jr->expValue : jr->expValue);
+  float value = jr->mantissa;
+  if (value != 0) {
+    while (e > JSON_MAX_EXPONENT && value < 1e38f) {
+      value *= 1e38f;
+      e -= JSON_MAX_EXPONENT;
+    }
+    while (e < -JSON_MAX_EXPONENT && value > 0) {
+      value /= 1e38f;
+      e += JSON_MAX_EXPONENT;
+    }
+    if (e > JSON_MAX_EXPONENT)
+      e = JSON_MAX_EXPONENT;
+    else if (e < -JSON_MAX_EXPONENT)
+      e = -JSON_MAX_EXPONENT;
+    if (e > 0)
+      value *= jsonPowersOf10[e];
+    else if (e < 0)
+      value /= jsonPowersOf10[-e];
+  }
+  if (jr->negative)
+    value = -value;
+  if (jr->float_handler && !jr->float_handler(jr->context, value))
+    return false;
+  return jsonreaderValueDone(jr);
+}
+
+static bool jsonreaderLiteralEnd(JsonReader* jr)
+{
+  jr->token = JSON_TOKEN_NONE;
+  switch (jr->literal[0]) {
+    case 't':
+      if (jr->bool_handler && !jr->bool_handler(jr->context, true))
+        return false;
+      break;
+    case 'f':
+      if (jr->bool_handler && !jr->bool_handler(jr->context, false))
+        return false;
+      break;
+    default:
+      if (jr->null_handler && !jr->null_handler(jr->context))
+        return false;
+      break;
+  }
+  return jsonreaderValueDone(jr);
+}
+
+/*
+  Start reading a value, given its first character.
+*/
+static bool jsonreaderStartValue(JsonReader* jr, char c)
+{
+  switch (c) {
+    case '{':
+    case '[':
+      return jsonreaderOpen(jr, c);
+    case '"':
+      jr->token = JSON_TOKEN_STRING;
+      jr->sub = JSON_STRING_CHARS;
+      jr->key = false;
+      return true;
+    case 't': jr->literal = "true"; break;
+    case 'f': jr->literal = "false"; break;
+    case 'n': jr->literal = "null"; break;
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+      jr->token = JSON_TOKEN_NUMBER;
+      jr->sub = JSON_NUMBER_SIGN;
+      jr->negative = (c == '-');
+      jr->expNegative = false;
+      jr->isfloat = false;
+      jr->mantissa = 0;
+      jr->exponent = 0;
+      jr->expValue = 0;
+      return (c == '-') || jsonreaderNumberChar(jr, c);
+    default:
+      return false;
+  }
+  jr->token = JSON_TOKEN_LITERAL;
+  jr->sub = 1;
+  return true;
+}
+
+/*
+  Handle a character outside of any string, number or literal.
+*/
+static bool jsonreaderStructure(JsonReader* jr, char c)
+{
+  switch (jr->state) {
+    case JSON_READER_ARRAY_START:
+      if (c == ']')
+        return jsonreaderClose(jr, c);
+      // intentional fall-through
+    case JSON_READER_VALUE:
+      return jsonreaderStartValue(jr, c);
+    case JSON_READER_OBJECT_START:
+      if (c == '}')
+        return jsonreaderClose(jr, c);
+      // intentional fall-through
+    case JSON_READER_KEY:
+      if (c != '"')
+        return false;
+      jr->token = JSON_TOKEN_STRING;
+      jr->sub = JSON_STRING_CHARS;
+      jr->key = true;
+      return true;
+    case JSON_READER_COLON:
+      if (c != ':')
+        return false;
+      jr->state = JSON_READER_VALUE;
+      return true;
+    case JSON_READER_AFTER_VALUE:
+      if (c == ',') {
+        jr->state = (jr->stack[jr->depth - 1] == '{') ? JSON_READER_KEY : JSON_READER_VALUE;
+        return true;
+      }
+      if (c == '}' || c == ']')
+        return jsonreaderClose(jr, c);
+      return false;
+    default:
+      return false;
+  }
+}
+
 /**
-  Parse a JSON string.
-  While it's reading, handlers that have been registered will be called
-  with any relevant data.
+  Read the next piece of a JSON document.
+  The document can be split up any old way - pass in each piece as it arrives, straight from
+  tcpRead() for instance, and the reader picks up where it left off.  Handlers are called
+  as soon as each value is complete.  The data isn't modified.
+
+  Strings are passed to the string and key handlers as a pointer and a length, and are
+  not null terminated.  When a string arrives all in one piece with no escapes, the pointer
+  is straight into \b text.  Otherwise, the reader unescapes it into its own buffer, which
+  holds up to \b JSON_READER_STRING_MAX bytes (64 by default) - a longer one is an error.
+  Either way, the string is only valid until the handler returns.
+
+  Numbers without a fraction or exponent that fit in an int go to the int handler,
+  everything else goes to the float handler.
+
   @param jr The JsonReader to use.
-  @param text The JSON string to parse.
-  @param len The length of the JSON string.
-  @return True on a successful parse, false on failure.
+  @param text The next piece of the document.
+  @param len The length of \b text.
+  @return True if everything so far is fine, false if the JSON isn't valid or a handler
+  returned false.  Once it returns false, the rest of the document is rejected too.
 
   \par Example
   \code
-  // quotes are escaped since I'm writing it out manually
-  char jsonstr[] = "[{\"label\":\"value\",\"label2\":{\"nested\":234}}]";
   JsonReader jr;
-  jsonreaderInit(&jr, 0);
+  char buf[64];
+  int len;
+  jsonreaderInit(&jr, 0, true);
   jr.int_handler = myIntHandler;
-  jsonreaderGo(&jr, jsonstr, strlen(jsonstr));
-  // now we expect to be called back on any callbacks we registered.
+  while ((len = tcpRead(socket, buf, sizeof(buf))) > 0) {
+    if (!jsonreaderFeed(&jr, buf, len))
+      break;
+  }
+  bool ok = jsonreaderFinish(&jr);
   \endcode
 */
-bool jsonreaderGo(JsonReader* jr, char* text, int len)
-{
-  JsonReaderToken token;
-  jr->p = text;
-  jr->len = len;
-
-  while (jr->len) {
-    while (*jr->p == ' ') // eat white space
-      jr->p++;
-    token = jsonreaderGetToken( jr->p, jr->len);
-    switch (token) {
-      case token_true:
-        if (jr->bool_handler && !jr->bool_handler(jr->context, true))
-          return false;
-        jr->p += 4;
-        jr->len -= 4;
-        break;
-      case token_false:
-        if (jr->bool_handler && !jr->bool_handler(jr->context, false))
-          return false;
-        jr->p += 5;
-        jr->len -= 5;
-        break;
-      case token_null:
-        if (jr->null_handler && !jr->null_handler(jr->context))
-          return false;
-        jr->p += 4;
-        jr->len -= 4;
-        break;
-      case token_comma:
-        jr->gotcomma = true;
-        // intentional fall-through
-      case token_colon: // just get the next one      
-        jr->p++;
-        jr->len--;
-        break;
-      case token_left_bracket:
-        jr->steps[++jr->depth] = JSON_READER_OBJECT_START;
-        if (jr->start_obj_handler && !jr->start_obj_handler(jr->context))
-          return false;
-        jr->p++;
-        jr->len--;
-        break;
-      case token_right_bracket:
-        jr->depth--;
-        if (jr->end_obj_handler && !jr->end_obj_handler(jr->context))
-          return false;
-        jr->p++;
-        jr->len--;
-        break;
-      case token_left_brace:
-        jr->steps[++jr->depth] = JSON_READER_IN_ARRAY;
-        if (jr->start_array_handler && !jr->start_array_handler(jr->context))
-          return false;
-        jr->p++;
-        jr->len--;
-        break;
-      case token_right_brace:
-        jr->depth--;
-        if (jr->end_array_handler && !jr->end_array_handler(jr->context))
-          return false;
-        jr->p++;
-        jr->len--;
-        break;
-      case token_number:
-      {
-        const char* p = jr->p;
-        bool keepgoing = true;
-        bool gotdecimal = false;
-        do {
-          if (*p == '.') {
-            if (gotdecimal) // we only expect to get one decimal place in a number
-              return false;
-            gotdecimal = true;
+bool jsonreaderFeed(JsonReader* jr, const char* text, int len)
+{
+  const char* p = text;
+  const char* end = text + len;
+  const char* str = 0; // the start of a string that began in this piece and hasn't needed the buffer
+
+  if (jr->state == JSON_READER_ERROR)
+    return false;
+  while (p < end) {
+    switch (jr->token) {
+      case JSON_TOKEN_STRING:
+        if (jr->sub == JSON_STRING_CHARS) {
+          const char* run = p;
+          while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+            p++;
+          if (!str && p > run && !(jsonreaderFlushSurrogate(jr) && jsonreaderBuffer(jr, run, p - run)))
+            goto error;
+          if (p == end)
+            break;
+          if (*p == '"') {
+            bool ok = str ? jsonreaderString(jr, str, p - str)
+                          : jsonreaderFlushSurrogate(jr) && jsonreaderString(jr, jr->buf, jr->buflen);
             p++;
+            str = 0;
+            if (!ok)
+              goto error;
           }
-          else if (!isdigit((int)*p))
-            keepgoing = false;
-          else
+          else if (*p == '\\') { // escapes have to be unescaped into the buffer
+            if (str && !jsonreaderBuffer(jr, str, p - str))
+              goto error;
+            str = 0;
+            jr->sub = JSON_STRING_ESCAPE;
             p++;
-        } while (keepgoing);
-        int size = p - jr->p;
-        if (gotdecimal) {
-          if (jr->float_handler && !jr->float_handler(jr->context, atof(jr->p)))
-            return false;
+          }
+          else // control characters have to be escaped
+            goto error;
         }
-        else {
-          if (jr->int_handler && !jr->int_handler(jr->context, atoi(jr->p)))
-            return false;
+        else if (jr->sub == JSON_STRING_ESCAPE) {
+          if (!jsonreaderEscape(jr, *p++))
+            goto error;
         }
-        jr->p += size;
-        jr->len -= size;
+        else if (!jsonreaderHexDigit(jr, *p++))
+          goto error;
         break;
-      }
-      case token_string:
-      {
-        char* p = ++jr->p; // move past the opening "
-        jr->len--;
-        bool keepgoing = true;
-        while (keepgoing) {
-          if (*p == '\\') // we got an escape - skip the escape and the next character
-            p += 2;
-          else if (*p == '"') // we got the end of a string
-            keepgoing = false;
-          else
-            p++; // keep looking for the end of the string
-        }
-        int size = p - jr->p;
-        *p = 0; // replace the trailing " with a null to make a string
-
-        // figure out if this is a key or a normal string
-        bool objkey = false;
-        if (jr->steps[jr->depth] == JSON_READER_OBJECT_START) {
-            jr->steps[jr->depth] = JSON_READER_IN_OBJECT;
-          objkey = true;
-        }
-        if (jr->gotcomma && jr->steps[jr->depth] == JSON_READER_IN_OBJECT) {
-          jr->gotcomma = false;
-          objkey = true;
-        }
 
-        if (objkey) { // last one was a comma - next string has to be a key
-          if(jr->obj_key_handler && !jr->obj_key_handler(jr->context, jr->p, size))
-            return false;
-        }
-        else { // just a normal string
-          if (jr->string_handler && !jr->string_handler(jr->context, jr->p, size))
-            return false;
+      case JSON_TOKEN_NUMBER:
+        if (jsonreaderNumberChar(jr, *p))
+          p++;
+        else if (!jsonreaderNumberEnd(jr)) // the character after the number is looked at again below
+          goto error;
+        break;
+
+      case JSON_TOKEN_LITERAL:
+        if (*p++ != jr->literal[jr->sub++])
+          goto error;
+        if (!jr->literal[jr->sub] && !jsonreaderLiteralEnd(jr))
+          goto error;
+        break;
+
+      default: {
+        char c = *p++;
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+          break;
+        if (!jsonreaderStructure(jr, c))
+          goto error;
+        if (jr->token == JSON_TOKEN_STRING) {
+          str = p;
+          jr->buflen = 0;
+          jr->surrogate = 0;
         }
-        jr->p += (size+1); // account for the trailing "
-        jr->len -= (size+1);
         break;
       }
-      default:
-        return false;
     }
   }
+  // a string that's still going carries over in the buffer
+  if (str && !jsonreaderBuffer(jr, str, end - str))
+    goto error;
   return true;
+
+error:
+  jr->state = JSON_READER_ERROR;
+  return false;
 }
 
-/** @}
+/**
+  Finish reading a JSON document.
+  Call this once the last piece has been passed to jsonreaderFeed(), to check that the
+  document was complete.  If the whole document is just a number, this is when it gets
+  passed to its handler.
+  @param jr The JsonReader to use.
+  @return True if a whole, valid document was read, false otherwise.
 */
-
-// static
-JsonReaderToken jsonreaderGetToken(char* text, int len)
-{
-  if (len < 1) return token_unknown;
-  switch (text[0]) {
-    case ':': return token_colon;
-    case ',': return token_comma;
-    case '{': return token_left_bracket;
-    case '}': return token_right_bracket;
-    case '[': return token_left_brace;
-    case ']': return token_right_brace;
-    case '"': return token_string;
-    case '0': case '1': case '2': case '3': case '4': 
-    case '5': case '6': case '7': case '8': case '9':
-      return token_number;
-    case '-': return token_maybe_negative;
-    case 't': return strncmp(text, "true", 4) == 0 ? token_true : token_unknown;
-    case 'f': return strncmp(text, "false", 5) == 0 ? token_false : token_unknown;
-    case 'n': return strncmp(text, "null", 4) == 0 ? token_null : token_unknown;
-    case '\0': return token_eof;
-    default:  return token_unknown;
-  }
+bool jsonreaderFinish(JsonReader* jr)
+{
+  if (jr->token == JSON_TOKEN_NUMBER && jr->state != JSON_READER_ERROR && !jsonreaderNumberEnd(jr))
+    jr->state = JSON_READER_ERROR;
+  return jr->state == JSON_READER_DONE;
 }
 
+/**
+  Parse a JSON string that's all in one piece.
+  While it's reading, handlers that have been registered will be called
+  with any relevant data.  This is the same as a call to jsonreaderFeed() followed by
+  jsonreaderFinish().
+  @param jr The JsonReader to use.
+  @param text The JSON string to parse.
+  @param len The length of the JSON string.
+  @return True on a successful parse, false on failure.
 
+  \par Example
+  \code
+  // quotes are escaped since I'm writing it out manually
+  char jsonstr[] = "[{\"label\":\"value\",\"label2\":{\"nested\":234}}]";
+  JsonReader jr;
+  jsonreaderInit(&jr, 0, true);
+  jr.int_handler = myIntHandler;
+  jsonreaderGo(&jr, jsonstr, strlen(jsonstr));
+  // now we expect to be called back on any callbacks we registered.
+  \endcode
+*/
+bool jsonreaderGo(JsonReader* jr, const char* text, int len)
+{
+  return jsonreaderFeed(jr, text, len) && jsonreaderFinish(jr);
+}
 
-
-
+/** @}
+*/
@@ -24,6 +24,8 @@
 #define JSON_MAX_DEPTH 20
 #endif
 
+#define JSON_MAX_DECIMALS 9 /**< The most decimal places jsonwriterFloat() will write. */
+
 // state object for encoding
 typedef enum JsonWriterStep_t {
   JSON_START,
@@ -34,6 +36,12 @@ typedef enum JsonWriterStep_t {
   JSON_IN_ARRAY
 } JsonWriterStep;
 
+/**
+  Called by a JsonWriter when its buffer is full - see jsonwriterSetFlush().
+  Return true if the data was dealt with, or false to stop writing.
+*/
+typedef bool (*JsonFlushHandler)(void* context, const char* data, int len);
+
 /**
   The structure used to maintain the state of a JSON encode process.
   You'll need to have one of these for each JSON string you want to encode.
@@ -44,37 +52,63 @@ typedef struct JsonWriter_t {
   int depth;                            /**< The current depth of the encoder (how many elements have been opened). */
   char* p;                              /**< A pointer to the buffer to write into. */
   int remaining;                        /**< The number of bytes remaining in the buffer to write into. */
+  char* buffer;                         /**< The start of the buffer. */
+  int size;                             /**< The size of the buffer. */
+  JsonFlushHandler flush;               /**< Called when the buffer is full, if set. */
+  void* flushContext;                   /**< Passed to the flush handler. */
 } JsonWriter;
 
+#ifndef JSON_READER_STRING_MAX
+#define JSON_READER_STRING_MAX 64
+#endif
+
 // state object for decoding
-typedef enum JsonReaderStep_t {
-  JSON_READER_OBJECT_START,
-  JSON_READER_IN_OBJECT,
-  JSON_READER_IN_ARRAY
-} JsonReaderStep;
+typedef enum JsonReaderState_t {
+  JSON_READER_VALUE,        // expecting a value
+  JSON_READER_ARRAY_START,  // just after a [ - a value or ]
+  JSON_READER_OBJECT_START, // just after a { - a key or }
+  JSON_READER_KEY,          // just after a , in an object
+  JSON_READER_COLON,        // just after a key
+  JSON_READER_AFTER_VALUE,  // a , or the end of the object or array
+  JSON_READER_DONE,         // the whole document has been read
+  JSON_READER_ERROR
+} JsonReaderState;
 
 /**
   The structure used to maintain the state of a JSON decode process.
-  You'll need to have one of these for each JSON string you want to encode.
+  You'll need to have one of these for each JSON string you want to decode.
   The same variable can be reused after resetting it with a call to jsonreaderInit().
+  Apart from the context and the handlers, the fields are private.
  */
 typedef struct JsonReader_t {
-  JsonReaderStep steps[JSON_MAX_DEPTH];     /**< An array to keep track of each step of the decoder. */
+  JsonReaderState state;                    /**< Where the decoder is in the document. */
+  unsigned char stack[JSON_MAX_DEPTH];      /**< A { or [ for each element that's open. */
   int depth;                                /**< The current depth of the decoder (how many elements have been opened). */
-  bool gotcomma;                            /**< Used internally by the decoder. */
+  unsigned char token;                      /**< The string, number or literal that's partly read, if any. */
+  unsigned char sub;                        /**< How far through that token the decoder is. */
+  bool key;                                 /**< Whether the string being read is an object key. */
+  bool negative;                            /**< Whether the number being read had a leading - */
+  bool expNegative;                         /**< Whether its exponent had a leading - */
+  bool isfloat;                             /**< Whether it had a fraction or an exponent. */
+  uint32_t mantissa;                        /**< The digits of the number read so far. */
+  int exponent;                             /**< The power of ten they're scaled by, from the fraction. */
+  int expValue;                             /**< The exponent after the e. */
+  const char* literal;                      /**< The true, false or null being matched. */
+  uint16_t codepoint;                       /**< The \\u escape being read. */
+  uint16_t surrogate;                       /**< The first half of a \\u surrogate pair. */
+  int buflen;                               /**< How much of buf is in use. */
+  char buf[JSON_READER_STRING_MAX];         /**< Strings that are escaped, or split across reads. */
   void* context;                            /**< A pointer to the user context. */
-  char* p;                                  /**< A pointer to the data. */
-  int len;                                  /**< The current length. */
-  bool(*null_handler)(void*);                /**< Called when "null" is encountered. */
-  bool(*bool_handler)(void*, bool);          /**< Called when a boolean value is encountered. */
-  bool(*int_handler)(void*, int);            /**< Called when an int is encountered. */
-  bool(*float_handler)(void*, float);        /**< Called when a float is encountered. */
-  bool(*string_handler)(void*, char*, int);  /**< Called when a string value is encountered. */
-  bool(*start_obj_handler)(void*);           /**< Called when an object is opened - a { is encountered. */
-  bool(*obj_key_handler)(void*, char*, int); /**< Called when the key of an object is encountered. */
-  bool(*end_obj_handler)(void*);             /**< Called when an object is closed - a } is encountered. */
-  bool(*start_array_handler)(void*);         /**< Called when an array is opened - a [ is encountered. */
-  bool(*end_array_handler)(void*);           /**< Called when an object is closed - a ] is encountered. */
+  bool(*null_handler)(void*);                      /**< Called when "null" is encountered. */
+  bool(*bool_handler)(void*, bool);                /**< Called when a boolean value is encountered. */
+  bool(*int_handler)(void*, int);                  /**< Called when an int is encountered. */
+  bool(*float_handler)(void*, float);              /**< Called when a float is encountered. */
+  bool(*string_handler)(void*, const char*, int);  /**< Called when a string value is encountered. */
+  bool(*start_obj_handler)(void*);                 /**< Called when an object is opened - a { is encountered. */
+  bool(*obj_key_handler)(void*, const char*, int); /**< Called when the key of an object is encountered. */
+  bool(*end_obj_handler)(void*);                   /**< Called when an object is closed - a } is encountered. */
+  bool(*start_array_handler)(void*);               /**< Called when an array is opened - a [ is encountered. */
+  bool(*end_array_handler)(void*);                 /**< Called when an array is closed - a ] is encountered. */
 } JsonReader;
 
 #ifdef __cplusplus
@@ -90,10 +124,15 @@ char* jsonwriterArrayClose(JsonWriter* jw);
 char* jsonwriterString(JsonWriter* jw, const char *string);
 char* jsonwriterInt(JsonWriter* jw, int value);
 char* jsonwriterBool(JsonWriter* jw, bool value);
+char* jsonwriterFloat(JsonWriter* jw, float value, int decimals);
+void  jsonwriterSetFlush(JsonWriter* jw, JsonFlushHandler flush, void* context);
+bool  jsonwriterFlush(JsonWriter* jw);
 
 // reader
 void jsonreaderInit(JsonReader* jr, void* context, bool resetHandlers);
-bool jsonreaderGo(JsonReader* jr, char* text, int len);
+bool jsonreaderFeed(JsonReader* jr, const char* text, int len);
+bool jsonreaderFinish(JsonReader* jr);
+bool jsonreaderGo(JsonReader* jr, const char* text, int len);
 #ifdef __cplusplus
 }
 #endif
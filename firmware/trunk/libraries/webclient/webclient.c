@@ -26,12 +26,22 @@
 #include "network.h"
 #include "error.h"
 
-#ifndef WEBCLIENT_BUFFER_SIZE
-#define WEBCLIENT_BUFFER_SIZE 128
-#endif
+typedef struct WebClientBuffer_t {
+  char* data;
+  int size;
+  int length;
+} WebClientBuffer;
 
-static int webclientReadResponse(int s, char* buf, int size);
-static char webclientBuf[WEBCLIENT_BUFFER_SIZE];
+static bool webclientConnect(WebClient* c);
+static bool webclientSendRequest(WebClient* c, const char* method, const char* path,
+                                 const char* body, int bodylen, const char* headers[]);
+static int  webclientReadHeaders(WebClient* c, int* contentLength, bool* chunked);
+static bool webclientReadBody(WebClient* c, int status, int contentLength, bool chunked,
+                              WebClientBodyHandler onBody, void* context);
+static bool webclientCopyBody(const char* data, int length, void* context);
+static void webclientUse(const char* hostname, int port);
+
+static WebClient webclient; // for webclientGet() and webclientPost()
 
 /**
   \defgroup webclient Web Client
@@ -40,6 +50,44 @@ static char webclientBuf[WEBCLIENT_BUFFER_SIZE];
   The web client system allows the Make Controller to get/post data to a webserver.  This
   makes it straightforward to use the Make Controller as a source of data for your web apps.
 
+  \section keepalive Persistent Connections
+  Opening a TCP connection takes a few round trips, and a new connection starts out slowly, so
+  if you're sending data to the same server regularly it's much quicker to keep the connection open.
+  A WebClient does just that - it connects the first time you make a request, and keeps using the same
+  connection until the server closes it.  If the server has closed it in the meantime, the client
+  reconnects and tries the request again.
+
+  Requests never wait on DNS.  The host name is looked up with networkLookupHost() on every request, which
+  keeps it fresh in the DNS cache, and if the answer isn't in yet the client sticks with the address it
+  had last time.  The very first request to a name that isn't cached returns \b CONTROLLER_ERROR_NO_ADDRESS
+  straight away - the lookup carries on in the background, so try again shortly.
+
+  The request line and headers are collected and sent in a single write, along with the body if it fits.
+  The response body is handed to your callback a piece at a time as it arrives, so you can handle responses that
+  are bigger than any buffer you have room for.  Both chunked and Content-Length responses are handled.
+  \code
+  bool onBody(const char* data, int length, void* context)
+  {
+    // do something with this piece of the response
+    return true; // keep going
+  }
+
+  WebClient collector;
+  webclientInit(&collector, "192.168.0.10", 8080);
+
+  // then, every so often
+  char reading[16];
+  int len = siprintf(reading, "%d", analoginValue(0));
+  int status = webclientRequest(&collector, "POST", "/telemetry", reading, len, 0, onBody, 0);
+  if (status != 200) {
+    // something went wrong
+  }
+  \endcode
+  Each WebClient holds a socket open, so call webclientClose() once you're done with it.
+
+  webclientGet() and webclientPost() share a single WebClient, so consecutive requests to the same host and port reuse
+  its connection too.  They're not safe to use from more than one thread at a time - give each thread its own WebClient instead.
+
   \ingroup networking
   @{
 */
@@ -55,7 +103,7 @@ static char webclientBuf[WEBCLIENT_BUFFER_SIZE];
   @param response The buffer read the response back into.  
   @param maxresponse An integer specifying the size of the response buffer.
   @param headers (optional) An array of strings to be sent as headers - last element in the array must be 0.
-  @return the number of bytes received, or < 0 on error.
+  @return the number of bytes received, or < 0 on error - see \ref keepalive for \b CONTROLLER_ERROR_NO_ADDRESS.
 
   \b Example
   \code
@@ -67,34 +115,12 @@ static char webclientBuf[WEBCLIENT_BUFFER_SIZE];
 */
 int webclientGet(const char* hostname, const char* path, int port, char* response, int maxresponse, const char* headers[])
 {
-  int s = tcpOpen(networkGetHostByName(hostname), port);
-  if (s > -1) {
-    // construct the GET request
-    int len = sniprintf(webclientBuf, WEBCLIENT_BUFFER_SIZE, "GET %s HTTP/1.1\r\n%s%s%s",
-                                path,
-                                (hostname != NULL) ? "Host: " : "",
-                                (hostname != NULL) ? hostname : "",
-                                (hostname != NULL) ? "\r\n" : ""  );
-    tcpWrite(s, webclientBuf, len);
-
-    if (headers != NULL) {
-      for ( ; *headers != 0; headers++) {
-        tcpWrite(s, *headers, strlen(*headers));
-        tcpWrite(s, "\r\n", 2);
-      }
-    }
-    
-    if (tcpWrite(s, "\r\n", 2 ) < 0) { // all done with headers...just check our last write here...
-      tcpClose(s);
-      return -1;
-    }
-
-    // read the data into the given buffer until there's none left, or the passed in buffer is full
-    len = webclientReadResponse(s, response, maxresponse);
-    tcpClose(s);
-    return len;
-  }
-  return -1;
+  WebClientBuffer b = { response, maxresponse, 0 };
+  webclientUse(hostname, port);
+  int status = webclientRequest(&webclient, "GET", path, 0, 0, headers, webclientCopyBody, &b);
+  if (status < 0)
+    return (status == CONTROLLER_ERROR_NO_ADDRESS) ? status : -1;
+  return b.length;
 }
 
 /** 
@@ -108,7 +134,7 @@ int webclientGet(const char* hostname, const char* path, int port, char* respons
   @param data_length The number of bytes to write from \b data
   @param maxresponse How many bytes of the response to read back into \b data
   @param headers (optional) An array of strings to be sent as headers - last element in the array must be 0.
-  @return The number of bytes written, or -1 on failure.
+  @return The number of bytes written, or < 0 on failure - see \ref keepalive for \b CONTROLLER_ERROR_NO_ADDRESS.
 
   \b Example
   \code
@@ -121,95 +147,294 @@ int webclientGet(const char* hostname, const char* path, int port, char* respons
 */
 int webclientPost(const char* hostname, const char* path, int port, char* data, int data_length, int maxresponse, const char* headers[])
 {
-  int s = tcpOpen(networkGetHostByName(hostname), port);
-  if (s > -1) {
-    int len = sniprintf(webclientBuf, WEBCLIENT_BUFFER_SIZE,
-                                "POST %s HTTP/1.1\r\nContent-Length: %d\r\n%s%s%s", 
-                                path, data_length,
-                                (hostname != NULL) ? "Host: " : "",
-                                (hostname != NULL) ? hostname : "",
-                                (hostname != NULL) ? "\r\n" : "");
-    tcpWrite(s, webclientBuf, len);
-    
-    if (headers != NULL) {
-      for ( ; *headers != 0; headers++) {
-        tcpWrite(s, *headers, strlen(*headers));
-        tcpWrite(s, "\r\n", 2);
-      }
-    }
-    tcpWrite(s, "\r\n", 2); // all done with headers
+  // the body's all sent before the response comes back, so it's OK to read into the same buffer
+  WebClientBuffer b = { data, maxresponse, 0 };
+  webclientUse(hostname, port);
+  int status = webclientRequest(&webclient, "POST", path, data, data_length, headers, webclientCopyBody, &b);
+  if (status < 0)
+    return (status == CONTROLLER_ERROR_NO_ADDRESS) ? status : -1;
+  return b.length;
+}
+
+/*
+  Point the shared client used by webclientGet() and webclientPost() at a server,
+  closing its connection to the last one.  It starts out zeroed rather than set up -
+  a socket of 0 belongs to somebody else - so only close it once it's been used.
+*/
+static void webclientUse(const char* hostname, int port)
+{
+  if (webclient.port != 0) {
+    if (webclient.port == port && strcmp(webclient.host, hostname) == 0)
+      return;
+    webclientClose(&webclient);
+  }
+  webclientInit(&webclient, hostname, port);
+}
+
+/**
+  Set up a client for a particular server.
+  This doesn't connect yet - that happens with the first request.
+  @param c The client to set up.
+  @param hostname The name or address of the server.
+  @param port The port to connect on - standard http port is 80.
+*/
+void webclientInit(WebClient* c, const char* hostname, int port)
+{
+  strncpy(c->host, hostname, WEBCLIENT_HOST_MAX - 1);
+  c->host[WEBCLIENT_HOST_MAX - 1] = 0;
+  c->port = port;
+  c->socket = -1;
+  c->address = -1;
+  c->keepAlive = false;
+  c->requests = 0;
+  c->connections = 0;
+}
+
+/**
+  Make a request, reusing the client's connection if it's still open.
+  @param c The client.
+  @param method The HTTP method - "GET", "POST", "PUT" or "DELETE".
+  @param path The path on the server.
+  @param body (optional) The body of the request.
+  @param bodylen The length of the body.
+  @param headers (optional) An array of strings to be sent as headers - last element in the array must be 0.
+  @param onBody (optional) Called with each piece of the response body as it arrives.
+  @param context Passed to \b onBody.
+  @return The HTTP status from the server - 200 for OK - or < 0 on error.  If the host's address isn't
+  known yet, that's \b CONTROLLER_ERROR_NO_ADDRESS - see \ref keepalive.
+*/
+int webclientRequest(WebClient* c, const char* method, const char* path, const char* body, int bodylen,
+                     const char* headers[], WebClientBodyHandler onBody, void* context)
+{
+  int attempt;
+  int address = networkLookupHost(c->host); // every time, so the name gets refreshed before it expires
+  if (address != -1)
+    c->address = address;
 
-    // send the body...just check our last write here...
-    if (tcpWrite(s, data, data_length) <= 0) {
-      tcpClose(s);
+  for (attempt = 0; attempt < 2; attempt++) {
+    // if we're reusing a connection the server may have closed it since - if so, try once more on a new one
+    bool reused = (c->socket >= 0);
+    if (!reused && c->address == -1)
+      return CONTROLLER_ERROR_NO_ADDRESS;
+    if (!reused && !webclientConnect(c))
+      return -1;
+
+    int status = -1, contentLength = -1;
+    bool chunked = false;
+    if (webclientSendRequest(c, method, path, body, bodylen, headers))
+      status = webclientReadHeaders(c, &contentLength, &chunked);
+    if (status <= 0) {
+      webclientClose(c);
+      if (reused)
+        continue;
       return -1;
     }
-    
-    // read back the response
-    len = webclientReadResponse(s, data, maxresponse);
-    tcpClose(s);
-    return len;
+
+    c->requests++;
+    if (strcmp(method, "HEAD") == 0)
+      contentLength = 0;
+    if (!webclientReadBody(c, status, contentLength, chunked, onBody, context))
+      c->keepAlive = false;
+    if (!c->keepAlive)
+      webclientClose(c);
+    return status;
   }
   return -1;
 }
 
+/**
+  Close a client's connection.
+  The client can still be used - it will reconnect on the next request.
+  @param c The client.
+*/
+void webclientClose(WebClient* c)
+{
+  if (c->socket >= 0) {
+    tcpClose(c->socket);
+    c->socket = -1;
+  }
+}
+
 /** @}
 */
 
-int webclientReadResponse(int s, char* buf, int size)
+bool webclientConnect(WebClient* c)
 {
-  int len, bodylen = 0;
-  bool chunked = false;
-  
-  // read through the headers - figure out the content length scheme
-  while ((len = tcpReadLine(s, webclientBuf, WEBCLIENT_BUFFER_SIZE))) {
-    if (!strncasecmp(webclientBuf, "Content-Length", 14)) // check for content length
-      bodylen = atoi(&webclientBuf[16]);
-    else if (!strncasecmp(webclientBuf, "Transfer-Encoding: chunked", 26)) // check to see if we're chunked
-      chunked = true;
-    else if (strncmp(webclientBuf, "\r\n", 2) == 0) // final CRLF means end of headers
-      break;
+  c->socket = tcpOpen(c->address, c->port);
+  if (c->socket < 0)
+    return false;
+  tcpStreamInit(&c->stream, c->socket);
+  c->connections++;
+  return true;
+}
+
+/*
+  Add to the outgoing request, sending what we've got whenever the buffer fills up.
+*/
+static bool webclientAppend(WebClient* c, int* len, const char* data, int length)
+{
+  while (length > 0) {
+    int room = WEBCLIENT_BUFFER_SIZE - *len;
+    if (room == 0) {
+      if (tcpWrite(c->socket, c->buf, *len) != *len)
+        return false;
+      *len = 0;
+      room = WEBCLIENT_BUFFER_SIZE;
+    }
+    int n = (length < room) ? length : room;
+    memcpy(c->buf + *len, data, n);
+    *len += n;
+    data += n;
+    length -= n;
   }
+  return true;
+}
 
-  if (len <= 0)
-    return 0;
-  
-  int content_read = 0;
-  // read the actual response data into the caller's buffer, if there's any to grab
-  if (chunked) { // first see if it's chunked
-    int chunklen = 1;
-    while (chunklen != 0 && content_read < size) {
-      len = tcpReadLine(s, webclientBuf, WEBCLIENT_BUFFER_SIZE);
-      if (siscanf(webclientBuf, "%x", &chunklen) != 1) // the first part of the chunk should indicate the chunk's length (hex)
-        break;
-      if (chunklen == 0) // an empty chunk indicates the end of the transfer
-        break;
-      if (chunklen > (size - content_read)) // make sure we have enough room to read this chunk, based on what we've already read
-        chunklen = size - content_read;
-      content_read += tcpRead(s, buf, chunklen);
-      tcpReadLine(s, webclientBuf, WEBCLIENT_BUFFER_SIZE); // slurp out the remaining newlines
+#define WEBCLIENT_APPEND(s) webclientAppend(c, &len, s, strlen(s))
+
+bool webclientSendRequest(WebClient* c, const char* method, const char* path,
+                          const char* body, int bodylen, const char* headers[])
+{
+  int len = 0;
+  bool ok = WEBCLIENT_APPEND(method) && WEBCLIENT_APPEND(" ") && WEBCLIENT_APPEND(path) &&
+            WEBCLIENT_APPEND(" HTTP/1.1\r\nHost: ") && WEBCLIENT_APPEND(c->host) &&
+            WEBCLIENT_APPEND("\r\nConnection: keep-alive\r\n");
+  if (ok && (body != NULL || strcmp(method, "POST") == 0 || strcmp(method, "PUT") == 0)) {
+    char contentLength[32];
+    sniprintf(contentLength, sizeof(contentLength), "Content-Length: %d\r\n", bodylen);
+    ok = WEBCLIENT_APPEND(contentLength);
+  }
+  if (headers != NULL) {
+    for ( ; ok && *headers != 0; headers++)
+      ok = WEBCLIENT_APPEND(*headers) && WEBCLIENT_APPEND("\r\n");
+  }
+  ok = ok && WEBCLIENT_APPEND("\r\n"); // all done with headers
+
+  // send the body along with the headers if it fits, otherwise on its own
+  if (ok && body != NULL && bodylen > 0) {
+    if (bodylen <= WEBCLIENT_BUFFER_SIZE - len)
+      ok = webclientAppend(c, &len, body, bodylen);
+    else {
+      ok = (tcpWrite(c->socket, c->buf, len) == len);
+      len = 0;
+      ok = ok && (tcpWrite(c->socket, body, bodylen) == bodylen);
     }
   }
-  // otherwise see if we got a content length
-  else if (bodylen > 0) {
-    while ((len = tcpRead(s, buf, size - content_read))) {
-      content_read += len;
-      buf += len;
-      if (content_read >= bodylen)
-        break;
+  if (ok && len > 0)
+    ok = (tcpWrite(c->socket, c->buf, len) == len);
+  return ok;
+}
+
+/*
+  Read the status line and headers.
+  Returns the status code, or -1 if the connection closed before we got a response.
+*/
+int webclientReadHeaders(WebClient* c, int* contentLength, bool* chunked)
+{
+  int len, major = 0, minor = 0, status = -1;
+  bool fresh = true; // whether this read starts a new line, rather than the rest of a long one
+
+  len = tcpStreamReadLine(&c->stream, c->buf, WEBCLIENT_BUFFER_SIZE - 1);
+  if (len <= 0)
+    return -1;
+  c->buf[len] = 0;
+  if (siscanf(c->buf, "HTTP/%d.%d %d", &major, &minor, &status) != 3)
+    return -1;
+  c->keepAlive = (major == 1 && minor >= 1);
+  fresh = (c->buf[len - 1] == '\n');
+
+  while ((len = tcpStreamReadLine(&c->stream, c->buf, WEBCLIENT_BUFFER_SIZE - 1)) > 0) {
+    c->buf[len] = 0;
+    if (fresh) {
+      if (strncmp(c->buf, "\r\n", 2) == 0) // final CRLF means end of headers
+        return status;
+      if (!strncasecmp(c->buf, "Content-Length:", 15))
+        *contentLength = atoi(&c->buf[15]);
+      else if (!strncasecmp(c->buf, "Transfer-Encoding:", 18))
+        *chunked = (strstr(&c->buf[18], "chunked") != NULL);
+      else if (!strncasecmp(c->buf, "Connection:", 11)) {
+        if (strstr(&c->buf[11], "close"))
+          c->keepAlive = false;
+        else if (strstr(&c->buf[11], "eep-alive"))
+          c->keepAlive = true;
+      }
     }
+    fresh = (c->buf[len - 1] == '\n');
   }
-  // lastly, just try to read until we get cut off
-  else {
-    while (content_read < size) {
-      len = tcpRead(s, buf, size - content_read);
-      if (len <= 0)
-        break;
-      content_read += len;
-      buf += len;
+  return -1;
+}
+
+/*
+  Read length bytes of the body, passing them along to the handler a buffer at a time.
+*/
+static bool webclientDeliver(WebClient* c, int length, WebClientBodyHandler onBody, void* context)
+{
+  while (length > 0) {
+    int len = tcpStreamRead(&c->stream, c->buf, (length < WEBCLIENT_BUFFER_SIZE) ? length : WEBCLIENT_BUFFER_SIZE);
+    if (len <= 0)
+      return false;
+    if (onBody && !onBody(c->buf, len, context))
+      return false;
+    length -= len;
+  }
+  return true;
+}
+
+/*
+  Read the body, whichever way it's delimited.
+  Returns false if the connection can't be used for another request afterwards.
+*/
+bool webclientReadBody(WebClient* c, int status, int contentLength, bool chunked,
+                       WebClientBodyHandler onBody, void* context)
+{
+  int len;
+  if (status == 204 || status == 304 || (status >= 100 && status < 200))
+    return true; // never a body
+
+  if (chunked) {
+    while (true) {
+      // the first part of the chunk should indicate the chunk's length (hex)
+      if ((len = tcpStreamReadLine(&c->stream, c->buf, WEBCLIENT_BUFFER_SIZE - 1)) <= 0)
+        return false;
+      c->buf[len] = 0;
+      int chunklen = strtol(c->buf, NULL, 16);
+      if (chunklen <= 0)
+        break; // an empty chunk indicates the end of the transfer
+      if (!webclientDeliver(c, chunklen, onBody, context))
+        return false;
+      tcpStreamReadLine(&c->stream, c->buf, WEBCLIENT_BUFFER_SIZE); // slurp out the CRLF after the chunk
+    }
+    // skip any trailers, up to the final CRLF
+    while ((len = tcpStreamReadLine(&c->stream, c->buf, WEBCLIENT_BUFFER_SIZE)) > 0) {
+      if (len <= 2)
+        return true;
     }
+    return false;
   }
-  return content_read;
+
+  if (contentLength >= 0)
+    return webclientDeliver(c, contentLength, onBody, context);
+
+  // no length - the body goes until the server closes the connection
+  while ((len = tcpStreamRead(&c->stream, c->buf, WEBCLIENT_BUFFER_SIZE)) > 0) {
+    if (onBody && !onBody(c->buf, len, context))
+      break;
+  }
+  return false;
+}
+
+/*
+  Collect a response into a caller's buffer, for webclientGet() and webclientPost().
+*/
+bool webclientCopyBody(const char* data, int length, void* context)
+{
+  WebClientBuffer* b = context;
+  int room = b->size - b->length;
+  if (length > room)
+    length = room;
+  memcpy(b->data + b->length, data, length);
+  b->length += length;
+  return true; // read the rest anyway, so the connection can be reused
 }
 
 #endif // MAKE_CTRL_NETWORK
@@ -1,6 +1,6 @@
 /*********************************************************************************
 
- Copyright 2006-2009 MakingThings
+ Copyright 2006-2010 MakingThings
 
  Licensed under the Apache License, 
  Version 2.0 (the "License"); you may not use this file except in compliance 
@@ -19,10 +19,51 @@
 #define WEBCLIENT_H
 
 #include "tcpsocket.h"
+#include "tcpstream.h"
 
-int webclientGet(const char* hostname, const char* path, int port, char* response, int response_size, const char* headers[]);
-int webclientPost(const char* hostname, const char* path, int port, char* data, int data_length, int response_size, const char* headers[]);
+#ifndef WEBCLIENT_BUFFER_SIZE
+#define WEBCLIENT_BUFFER_SIZE 128
+#endif
 
+#ifndef WEBCLIENT_HOST_MAX
+#define WEBCLIENT_HOST_MAX 48
+#endif
 
+/**
+  Called with each piece of a response body as it arrives.
+  Return true to keep going, or false to stop reading the response - the connection is then closed.
+  \ingroup webclient
+*/
+typedef bool (*WebClientBodyHandler)(const char* data, int length, void* context);
+
+/**
+  A connection to a web server that can be used for several requests.
+  Set one up with webclientInit().
+  \ingroup webclient
+*/
+typedef struct WebClient_t {
+  char host[WEBCLIENT_HOST_MAX]; /**< the host to connect to. */
+  int port;                      /**< the port to connect on. */
+  int socket;                    /**< the open connection, or -1 if there isn't one. */
+  int address;                   /**< the host's address when it was last looked up, or -1. */
+  bool keepAlive;                /**< whether the server will take another request on this connection. */
+  uint32_t requests;             /**< requests made. */
+  uint32_t connections;          /**< connections opened to make them. */
+  TcpStream stream;
+  char buf[WEBCLIENT_BUFFER_SIZE];
+} WebClient;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int  webclientGet(const char* hostname, const char* path, int port, char* response, int response_size, const char* headers[]);
+int  webclientPost(const char* hostname, const char* path, int port, char* data, int data_length, int response_size, const char* headers[]);
+void webclientInit(WebClient* c, const char* hostname, int port);
+int  webclientRequest(WebClient* c, const char* method, const char* path, const char* body, int bodylen,
+                      const char* headers[], WebClientBodyHandler onBody, void* context);
+void webclientClose(WebClient* c);
+#ifdef __cplusplus
+}
+#endif
 
 #endif // WEBCLIENT_H
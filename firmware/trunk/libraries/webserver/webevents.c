@@ -0,0 +1,397 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License, 
+ Version 2.0 (the "License"); you may not use this file except in compliance 
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0 
+ 
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "config.h"
+#if defined(MAKE_CTRL_NETWORK) && defined(OSC)
+
+#include "webevents.h"
+#include "webserver.h"
+#include "core.h"
+#include "osc.h"
+#include <string.h>
+
+#ifndef WEBEVENTS_MAX_VALUES
+#define WEBEVENTS_MAX_VALUES 16
+#endif
+
+#ifndef WEBEVENTS_ADDRESS_MAX
+#define WEBEVENTS_ADDRESS_MAX 28
+#endif
+
+#ifndef WEBEVENTS_VALUE_MAX
+#define WEBEVENTS_VALUE_MAX 24
+#endif
+
+#ifndef WEBEVENTS_BUFFER_SIZE
+#define WEBEVENTS_BUFFER_SIZE 256
+#endif
+
+#ifndef WEBEVENTS_PERIOD
+#define WEBEVENTS_PERIOD 50
+#endif
+
+#ifndef WEBEVENTS_KEEPALIVE
+#define WEBEVENTS_KEEPALIVE 15000
+#endif
+
+#ifndef WEBEVENTS_STALL_TIMEOUT
+#define WEBEVENTS_STALL_TIMEOUT 5000
+#endif
+
+#ifndef WEBEVENTS_STACK_SIZE
+#define WEBEVENTS_STACK_SIZE 512
+#endif
+
+#if WEBEVENTS_MAX_SUBSCRIBERS > 8
+  #error "WEBEVENTS_MAX_SUBSCRIBERS can be at most 8, since each subscriber gets a bit in a uint8_t"
+#endif
+
+typedef struct WebEventValue_t {
+  char address[WEBEVENTS_ADDRESS_MAX];
+  char value[WEBEVENTS_VALUE_MAX];
+  uint8_t pending;  // a bit for each subscriber that hasn't been sent this value yet
+} WebEventValue;
+
+typedef struct WebEventSubscriber_t {
+  int socket;       // -1 when the slot is free
+  systime_t lastWrite;
+} WebEventSubscriber;
+
+typedef struct WebEvents_t {
+  Mutex lock;
+  Semaphore changed;
+  Thread* thd;
+  uint8_t subscribed;  // a bit for each subscriber slot in use
+  int valueCount;
+  WebEventValue values[WEBEVENTS_MAX_VALUES];
+  WebEventSubscriber subscribers[WEBEVENTS_MAX_SUBSCRIBERS];
+  WebEventStats stats;
+  char out[WEBEVENTS_BUFFER_SIZE];
+} WebEvents;
+
+static WebEvents webevents;
+static WORKING_AREA(webeventsWA, WEBEVENTS_STACK_SIZE);
+
+static bool webeventsHandler(int socket, HttpMethod method, char* path, char* body, int bodylen);
+
+static WebHandler webeventsWebHandler = {
+  .address = "/events",
+  .onRequest = webeventsHandler
+};
+
+/**
+  \defgroup webevents Web Events
+  Stream autosend data to web browsers.
+
+  Browsers can't listen for OSC over UDP, so a web page that shows live sensor values would otherwise
+  have to keep asking the web server for them, opening a new connection each time.  Instead, it can
+  open a single <a href="http://www.w3.org/TR/eventsource/">Server-Sent Events</a> stream, and the Make Controller
+  pushes each value to it whenever the autosend system sends it.  In the browser:
+  \code
+  var events = new EventSource("/events");
+  events.onmessage = function(e) {
+    var msg = e.data.split(" "); // ["/analogin/0/value", "512"]
+    // update the page...
+  };
+  \endcode
+
+  On the board, start the stream along with the web server:
+  \code
+  webeventsServe("/events");
+  webserverEnable(YES, 80);
+  oscAutosendEnable(YES);
+  \endcode
+  Each event is the OSC address followed by its values, separated by spaces.  Anything you've
+  set to autosend is streamed - \b /analogin/0/autosend 1, for example - whether or not there's also an
+  autosend destination for OSC.
+
+  \section Limits
+  Each browser on the stream holds a TCP connection open, so only \b WEBEVENTS_MAX_SUBSCRIBERS (2 by default) can
+  be connected at once - others get a 503 status.  The stream is served from its own thread, so it doesn't
+  tie up the web server's workers.
+
+  Rather than queueing up every update, the latest value for each address is kept (up to \b WEBEVENTS_MAX_VALUES of them)
+  and sent at most every \b WEBEVENTS_PERIOD milliseconds.  If a browser can't keep up, it simply gets the newest
+  value when it's ready, and if it hasn't taken anything for \b WEBEVENTS_STALL_TIMEOUT milliseconds, it's disconnected.
+  A comment line is sent every \b WEBEVENTS_KEEPALIVE milliseconds when there's nothing else to send, so
+  connections that have gone away are noticed.
+  \ingroup networking
+  @{
+*/
+
+/*
+  The small printf doesn't do floats.  Only cast to an int once the value is known to
+  fit - anything bigger goes out in exponent form instead.
+*/
+static int webeventsFormatFloat(char* buf, int size, float f)
+{
+  const char* sign = (f < 0) ? "-" : "";
+  int milli, exponent = 0;
+  if (f != f)
+    return sniprintf(buf, size, " nan");
+  if (f < 0)
+    f = -f;
+  if (f < 2000000.0f) { // f * 1000 fits in an int
+    milli = (int)(f * 1000 + 0.5f);
+    return sniprintf(buf, size, " %s%d.%03d", milli ? sign : "", milli / 1000, milli % 1000);
+  }
+  if (f - f != 0) // infinity
+    return sniprintf(buf, size, " %sinf", sign);
+  while (f >= 10.0f) {
+    f /= 10.0f;
+    exponent++;
+  }
+  milli = (int)(f * 1000 + 0.5f);
+  if (milli >= 10000) { // rounding carried into another digit
+    milli /= 10;
+    exponent++;
+  }
+  return sniprintf(buf, size, " %s%d.%03de%d", sign, milli / 1000, milli % 1000, exponent);
+}
+
+static void webeventsFormat(char* buf, int size, OscData* data, int datacount)
+{
+  int i, len = 0;
+  buf[0] = 0;
+  for (i = 0; i < datacount && len < size - 1; i++) {
+    char* p = buf + len;
+    int room = size - len;
+    switch (data[i].type) {
+      case INT:
+        len += sniprintf(p, room, " %d", data[i].value.i);
+        break;
+      case FLOAT:
+        len += webeventsFormatFloat(p, room, data[i].value.f);
+        break;
+      case STRING:
+        len += sniprintf(p, room, " %s", data[i].value.s);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/*
+  Called from the autosend thread for each message it sends.
+  Keep the newest value for each address, and flag it for each subscriber.
+*/
+static void webeventsListener(const char* address, OscData* data, int datacount)
+{
+  int i;
+  WebEventValue* v = 0;
+  if (webevents.subscribed == 0)
+    return;
+
+  chMtxLock(&webevents.lock);
+  for (i = 0; i < webevents.valueCount; i++) {
+    if (strcmp(webevents.values[i].address, address) == 0) {
+      v = &webevents.values[i];
+      break;
+    }
+  }
+  if (v == 0 && webevents.valueCount < WEBEVENTS_MAX_VALUES && strlen(address) < WEBEVENTS_ADDRESS_MAX) {
+    v = &webevents.values[webevents.valueCount++];
+    strcpy(v->address, address);
+    v->pending = 0;
+  }
+  if (v == 0)
+    webevents.stats.dropped++;
+  else {
+    if (v->pending)
+      webevents.stats.coalesced++;
+    webeventsFormat(v->value, sizeof(v->value), data, datacount);
+    v->pending = webevents.subscribed;
+  }
+  chMtxUnlock();
+  if (v)
+    chSemSignal(&webevents.changed);
+}
+
+static void webeventsUnsubscribe(int idx)
+{
+  int i;
+  uint8_t bit = (1 << idx);
+  chMtxLock(&webevents.lock);
+  tcpClose(webevents.subscribers[idx].socket);
+  webevents.subscribers[idx].socket = -1;
+  webevents.subscribed &= ~bit;
+  for (i = 0; i < webevents.valueCount; i++)
+    webevents.values[i].pending &= ~bit;
+  chMtxUnlock();
+}
+
+/*
+  Send a subscriber what's changed since it last heard from us.
+  Returns true if there's still more waiting for it.
+*/
+static bool webeventsPush(int idx)
+{
+  int i, len = 0;
+  bool more = false;
+  uint8_t bit = (1 << idx);
+  WebEventSubscriber* s = &webevents.subscribers[idx];
+  systime_t now = chTimeNow();
+
+  if (!tcpWriteReady(s->socket)) {
+    // not keeping up - the values stay pending, and get replaced with newer ones as they come in
+    if (now - s->lastWrite > MS2ST(WEBEVENTS_STALL_TIMEOUT)) {
+      webevents.stats.stalled++;
+      webeventsUnsubscribe(idx);
+      return false;
+    }
+    return true;
+  }
+
+  chMtxLock(&webevents.lock);
+  for (i = 0; i < webevents.valueCount; i++) {
+    WebEventValue* v = &webevents.values[i];
+    if (!(v->pending & bit))
+      continue;
+    int needed = strlen(v->address) + strlen(v->value) + 8; // "data: " and "\n\n"
+    if (len + needed >= WEBEVENTS_BUFFER_SIZE) {
+      more = true; // next time
+      break;
+    }
+    len += sniprintf(webevents.out + len, WEBEVENTS_BUFFER_SIZE - len, "data: %s%s\n\n", v->address, v->value);
+    v->pending &= ~bit;
+  }
+  chMtxUnlock();
+
+  if (len == 0 && now - s->lastWrite > MS2ST(WEBEVENTS_KEEPALIVE)) {
+    strcpy(webevents.out, ":\n\n"); // a comment, just to check the connection's still there
+    len = 3;
+  }
+  if (len > 0) {
+    if (tcpWrite(s->socket, webevents.out, len) != len) {
+      webeventsUnsubscribe(idx);
+      return false;
+    }
+    s->lastWrite = now;
+    webevents.stats.sent++;
+  }
+  return more;
+}
+
+static msg_t webeventsThread(void *arg)
+{
+  UNUSED(arg);
+  int i;
+  bool more = false;
+  while (!chThdShouldTerminate()) {
+    // if somebody's behind, check back soon - otherwise wait for something new
+    chSemWaitTimeout(&webevents.changed, MS2ST(more ? WEBEVENTS_PERIOD : WEBEVENTS_KEEPALIVE));
+    chSemReset(&webevents.changed, 0);
+    more = false;
+    for (i = 0; i < WEBEVENTS_MAX_SUBSCRIBERS; i++) {
+      if ((webevents.subscribed & (1 << i)) && webeventsPush(i))
+        more = true;
+    }
+    // gather up changes for a bit, rather than sending each one on its own
+    chThdSleepMilliseconds(WEBEVENTS_PERIOD);
+  }
+  return 0;
+}
+
+/**
+  Start serving an event stream.
+  This adds a handler to the web server, so call it before webserverEnable().
+  @param address The address to serve the stream at - "/events", for example.
+  @return True if the stream was started.
+*/
+bool webeventsServe(const char* address)
+{
+  int i;
+  if (webevents.thd != 0)
+    return false;
+  chMtxInit(&webevents.lock);
+  chSemInit(&webevents.changed, 0);
+  for (i = 0; i < WEBEVENTS_MAX_SUBSCRIBERS; i++)
+    webevents.subscribers[i].socket = -1;
+  if (address)
+    webeventsWebHandler.address = address;
+  webserverAddHandler(&webeventsWebHandler);
+  webevents.thd = chThdCreateStatic(webeventsWA, sizeof(webeventsWA), NORMALPRIO - 1, webeventsThread, NULL);
+  oscSetAutosendListener(webeventsListener);
+  return true;
+}
+
+/**
+  Read the event stream's counters.
+  @param stats The WebEventStats to fill in.
+*/
+void webeventsGetStats(WebEventStats* stats)
+{
+  int i;
+  chMtxLock(&webevents.lock);
+  *stats = webevents.stats;
+  stats->subscribers = 0;
+  for (i = 0; i < WEBEVENTS_MAX_SUBSCRIBERS; i++) {
+    if (webevents.subscribed & (1 << i))
+      stats->subscribers++;
+  }
+  chMtxUnlock();
+}
+
+/** @}
+*/
+
+bool webeventsHandler(int socket, HttpMethod method, char* path, char* body, int bodylen)
+{
+  UNUSED(path); UNUSED(body); UNUSED(bodylen);
+  int i, idx = -1;
+  if (method != HTTP_GET)
+    return false;
+
+  chMtxLock(&webevents.lock);
+  for (i = 0; i < WEBEVENTS_MAX_SUBSCRIBERS; i++) {
+    if (webevents.subscribers[i].socket < 0) {
+      idx = i;
+      break;
+    }
+  }
+  if (idx < 0) {
+    webevents.stats.rejected++;
+    chMtxUnlock();
+    static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+    tcpWrite(socket, busy, sizeof(busy) - 1);
+    webserverLengthSent(socket);
+    return true;
+  }
+  webevents.subscribers[idx].socket = socket; // reserve it while we send the headers
+  chMtxUnlock();
+
+  static const char headers[] = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                                "Cache-Control: no-cache\r\n\r\nretry: 2000\n\n";
+  if (tcpWrite(socket, headers, sizeof(headers) - 1) != sizeof(headers) - 1) {
+    webevents.subscribers[idx].socket = -1;
+    return true; // the web server will close it
+  }
+  webserverDetach(socket);
+
+  // start them off with the latest of everything
+  chMtxLock(&webevents.lock);
+  webevents.subscribers[idx].lastWrite = chTimeNow();
+  webevents.subscribed |= (1 << idx);
+  for (i = 0; i < webevents.valueCount; i++)
+    webevents.values[i].pending |= (1 << idx);
+  chMtxUnlock();
+  chSemSignal(&webevents.changed);
+  return true;
+}
+
+#endif // MAKE_CTRL_NETWORK && OSC
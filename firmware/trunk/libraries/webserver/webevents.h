@@ -0,0 +1,49 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License, 
+ Version 2.0 (the "License"); you may not use this file except in compliance 
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0 
+ 
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef WEB_EVENTS_H
+#define WEB_EVENTS_H
+
+#include "types.h"
+
+#ifndef WEBEVENTS_MAX_SUBSCRIBERS
+#define WEBEVENTS_MAX_SUBSCRIBERS 2
+#endif
+
+/**
+  Counters for the event stream, from webeventsGetStats().
+  \ingroup webevents
+*/
+typedef struct {
+  int subscribers;      /**< browsers currently connected. */
+  uint32_t sent;        /**< writes made to subscribers. */
+  uint32_t coalesced;   /**< updates replaced by a newer value before a subscriber got them. */
+  uint32_t dropped;     /**< updates lost because there was no room to track them. */
+  uint32_t rejected;    /**< connections turned away because there were already enough subscribers. */
+  uint32_t stalled;     /**< subscribers disconnected for not keeping up. */
+} WebEventStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+bool webeventsServe(const char* address);
+void webeventsGetStats(WebEventStats* stats);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEB_EVENTS_H
@@ -0,0 +1,178 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License, 
+ Version 2.0 (the "License"); you may not use this file except in compliance 
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0 
+ 
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#include "config.h"
+#ifdef MAKE_CTRL_NETWORK
+
+#include "webfiles.h"
+#include "webserver.h"
+#include "core.h"
+#include "lwipopts.h"
+#include <string.h>
+
+#ifndef WEBFILES_WRITE_SIZE
+#define WEBFILES_WRITE_SIZE TCP_MSS
+#endif
+
+#ifndef WEBFILES_INDEX
+#define WEBFILES_INDEX "/index.html"
+#endif
+
+static bool webfilesHandler(int socket, HttpMethod method, char* path, char* body, int bodylen);
+
+static struct {
+  const WebFile* files;
+  int count;
+} webfiles;
+
+static WebHandler webfilesWebHandler = {
+  .address = "/",
+  .onRequest = webfilesHandler
+};
+
+/**
+  \defgroup webfiles Web Files
+  Serve static files - HTML, scripts, stylesheets, images - from flash.
+
+  Rather than building pages with tcpWrite() calls in a handler, you can put your pages in a folder
+  and turn it into a C file with the \b mkwebfiles.py tool in tools/webfiles:
+  \verbatim python mkwebfiles.py mysite webfiles_data.c \endverbatim
+  Add the generated file to your project.  Each file is gzipped ahead of time (unless that wouldn't make it any smaller)
+  and tagged with an ETag, so browsers only download it again when it has actually changed.  The whole
+  thing lives in flash, so it doesn't use any RAM.
+
+  Then pass the table to webfilesServe() along with the web server:
+  \code
+  extern const WebFile webfilesData[];
+  extern const int webfilesDataCount;
+
+  webfilesServe(webfilesData, webfilesDataCount);
+  webserverEnable(YES, 80);
+  \endcode
+  Any request for a path in the table is answered with the file.  A request for a folder gets its \b index.html.
+  Anything else is passed on to your other handlers, so you can mix files with dynamic pages.
+
+  Files are sent with \b Content-Encoding: gzip.  If a request comes with an \b If-None-Match header
+  that matches the file's ETag, a 304 Not Modified is sent instead, with no body.  Files are written
+  \b WEBFILES_WRITE_SIZE bytes at a time - one TCP segment (\b TCP_MSS) by default.
+  \ingroup networking
+  @{
+*/
+
+/**
+  Serve a table of files with the web server.
+  @param files The files, as generated by mkwebfiles.py.
+  @param count The number of files in the table.
+*/
+void webfilesServe(const WebFile* files, int count)
+{
+  bool added = (webfiles.files != 0);
+  webfiles.files = files;
+  webfiles.count = count;
+  if (!added)
+    webserverAddHandler(&webfilesWebHandler);
+}
+
+/**
+  Look up a file by its path.
+  @param path The path to look for - "/index.html", for example.  Anything after a '?' is ignored.
+  @return The file, or 0 if there's no such file.
+*/
+const WebFile* webfilesFind(const char* path)
+{
+  int i, len = strcspn(path, "?#");
+  for (i = 0; i < webfiles.count; i++) {
+    const WebFile* f = &webfiles.files[i];
+    if (strncmp(f->path, path, len) == 0 && f->path[len] == 0)
+      return f;
+  }
+  // a folder - try its index
+  if (len > 0 && path[len - 1] == '/') {
+    int indexlen = strlen(WEBFILES_INDEX);
+    for (i = 0; i < webfiles.count; i++) {
+      const char* p = webfiles.files[i].path;
+      int plen = strlen(p);
+      if (plen == (len - 1) + indexlen && strncmp(p, path, len - 1) == 0 && strcmp(p + len - 1, WEBFILES_INDEX) == 0)
+        return &webfiles.files[i];
+    }
+  }
+  return 0;
+}
+
+/**
+  Send a file in response to a request.
+  You can use this from your own handler if you want to decide which file to send.
+  @param socket The socket passed to your handler.
+  @param file The file to send.
+  @return True if the file was sent.
+*/
+bool webfilesSend(int socket, const WebFile* file)
+{
+  char headers[192];
+  int len;
+
+  if (strcmp(webserverIfNoneMatch(socket), file->etag) == 0) {
+    // they've already got it
+    len = sniprintf(headers, sizeof(headers), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n\r\n", file->etag);
+    tcpWrite(socket, headers, len);
+    webserverLengthSent(socket);
+    return true;
+  }
+
+  if (file->gzipped && !webserverAcceptsGzip(socket)) {
+    static const char notAcceptable[] = "HTTP/1.1 406 Not Acceptable\r\nContent-Length: 0\r\n\r\n";
+    tcpWrite(socket, notAcceptable, sizeof(notAcceptable) - 1);
+    webserverLengthSent(socket);
+    return true;
+  }
+
+  // all the headers in one write
+  len = sniprintf(headers, sizeof(headers),
+                  "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %d\r\n%sETag: %s\r\nCache-Control: no-cache\r\n\r\n",
+                  file->contentType, (int)file->length,
+                  file->gzipped ? "Content-Encoding: gzip\r\n" : "",
+                  file->etag);
+  if (tcpWrite(socket, headers, len) != len)
+    return true;
+  webserverLengthSent(socket);
+
+  const uint8_t* p = file->data;
+  uint32_t remaining = file->length;
+  while (remaining > 0) {
+    int chunk = (remaining > WEBFILES_WRITE_SIZE) ? WEBFILES_WRITE_SIZE : remaining;
+    if (tcpWrite(socket, (const char*)p, chunk) != chunk)
+      break;
+    p += chunk;
+    remaining -= chunk;
+  }
+  return true;
+}
+
+/** @}
+*/
+
+bool webfilesHandler(int socket, HttpMethod method, char* path, char* body, int bodylen)
+{
+  UNUSED(body);
+  UNUSED(bodylen);
+  if (method != HTTP_GET)
+    return false;
+  const WebFile* file = webfilesFind(path);
+  return file ? webfilesSend(socket, file) : false;
+}
+
+#endif // MAKE_CTRL_NETWORK
@@ -0,0 +1,46 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License, 
+ Version 2.0 (the "License"); you may not use this file except in compliance 
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0 
+ 
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+#ifndef WEB_FILES_H
+#define WEB_FILES_H
+
+#include "types.h"
+
+/**
+  A file to be served by the web server, as generated by mkwebfiles.py.
+  \ingroup webfiles
+*/
+typedef struct WebFile_t {
+  const char* path;         /**< The address the file is served at - "/index.html", for example. */
+  const char* contentType;  /**< Its MIME type. */
+  const char* etag;         /**< Its ETag, including quotes. */
+  const uint8_t* data;      /**< The file's contents, as stored in flash. */
+  uint32_t length;          /**< The number of bytes at data. */
+  bool gzipped;             /**< Whether data is gzip compressed. */
+} WebFile;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void webfilesServe(const WebFile* files, int count);
+const WebFile* webfilesFind(const char* path);
+bool webfilesSend(int socket, const WebFile* file);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEB_FILES_H
@@ -26,29 +26,88 @@
 #include <ctype.h>
 
 #ifndef WEBSERVER_STACK_SIZE
+#ifdef OSC
+#define WEBSERVER_STACK_SIZE 1024 // the board state handler calls OSC handlers from the workers
+#else
 #define WEBSERVER_STACK_SIZE 512
 #endif
+#endif
+
+#ifndef WEBSERVER_ACCEPT_STACK_SIZE
+#define WEBSERVER_ACCEPT_STACK_SIZE 256
+#endif
+
+#ifndef WEBSERVER_WORKERS
+#define WEBSERVER_WORKERS 2
+#endif
+
+#ifndef WEBSERVER_ACCEPT_QUEUE
+#define WEBSERVER_ACCEPT_QUEUE 4
+#endif
+
+#ifndef WEBSERVER_KEEPALIVE_TIMEOUT
+#define WEBSERVER_KEEPALIVE_TIMEOUT 5000
+#endif
+
+#ifndef WEBSERVER_KEEPALIVE_MAX
+#define WEBSERVER_KEEPALIVE_MAX 20
+#endif
 
 #ifndef REQUEST_SIZE_MAX
 #define REQUEST_SIZE_MAX 256
 #endif
 
-static WORKING_AREA(webserverWA, WEBSERVER_STACK_SIZE);
+#ifndef WEBSERVER_BUFFERS
+#define WEBSERVER_BUFFERS (WEBSERVER_WORKERS * 2) // each connection being served needs 2
+#endif
+
+#ifndef WEBSERVER_ETAG_MAX
+#define WEBSERVER_ETAG_MAX 24
+#endif
+
+static WORKING_AREA(webserverWA, WEBSERVER_ACCEPT_STACK_SIZE);
+static WORKING_AREA(webserverWorkerWA[WEBSERVER_WORKERS], WEBSERVER_STACK_SIZE);
 static msg_t webServerLoop(void *arg);
+static msg_t webserverWorker(void *arg);
+
+typedef struct WebWorker_t {
+  Thread* thd;
+  int socket;
+  bool keepAlive;   // the client would like the connection kept open
+  bool lengthSet;   // the response said how long it is, so the connection can stay open
+  bool acceptsGzip;
+  bool detached;    // a handler has taken the connection over
+  char etag[WEBSERVER_ETAG_MAX]; // from If-None-Match
+  TcpStream stream;
+  char* request;    // the request line - from webserverBuffers while a connection is being served
+  char* buf;        // headers and body - from webserverBuffers too
+} WebWorker;
 
 typedef struct WebServer_t {
   Thread* thd;
+  int server;
   uint32_t hits;
+  uint32_t connections;
+  uint32_t rejected;
+  int active;
+  uint32_t latencyTotal;
+  uint32_t latencyMax;
   int port;
-  char buf[REQUEST_SIZE_MAX];
   WebHandler* handlers;
+  Mailbox queue;
+  msg_t queueBuf[WEBSERVER_ACCEPT_QUEUE];
+  WebWorker workers[WEBSERVER_WORKERS];
 } WebServer;
 
 static WebServer webserver;
+POOL_DECL(webserverBuffers, "web-request", REQUEST_SIZE_MAX, WEBSERVER_BUFFERS);
 
-static void webserverProcessRequest(int socket);
-static char* webserverGetRequestAddress(int socket, char* request, int length, HttpMethod* method);
-static int webserverGetBody(int socket, char* requestBuffer, int maxSize);
+static void webserverServe(WebWorker* w);
+static bool webserverProcessRequest(WebWorker* w);
+static char* webserverGetRequestAddress(WebWorker* w, HttpMethod* method);
+static int webserverGetBody(WebWorker* w);
+static bool webserverGetBuffers(WebWorker* w);
+static void webserverFreeBuffers(WebWorker* w);
 
 /**
   \defgroup webserver Web Server
@@ -97,10 +156,43 @@ static int webserverGetBody(int socket, char* requestBuffer, int maxSize);
   // when a request comes in that starts with /simple, handlerFunction() will be called
   \endcode
 
+  \section keepalive Keep-Alive
+  Browsers like to reuse a connection for several requests, rather than opening a new one each time.
+  That only works if they can tell where one response ends, so if you know how long your response
+  will be, send its length with webserverSetContentLength() and the connection will be kept open
+  for the next request.  Otherwise, the connection is closed once your handler returns, same as always.
+  \code
+  bool handlerFunction(int socket, HttpMethod method, char* path, char* body, int bodylen)
+  {
+    const char* msg = "hi there";
+    webserverSetStatusOK(socket);
+    webserverSetContentLength(socket, strlen(msg));
+    tcpWrite(socket, "Content-Type: " HTTP_CONTENT_PLAIN, strlen("Content-Type: " HTTP_CONTENT_PLAIN));
+    tcpWrite(socket, msg, strlen(msg));
+    return true;
+  }
+  \endcode
+  A kept-alive connection is closed if no new request arrives within \b WEBSERVER_KEEPALIVE_TIMEOUT
+  milliseconds (5000 by default), or after \b WEBSERVER_KEEPALIVE_MAX requests (20 by default).
+  Keep-alive needs \b LWIP_SO_RCVTIMEO turned on in lwipopts.h, which it is by default.
+
   \section Configuration
-  The web server runs as its own thread.  If you find that you need to change the stack size
-  for the web server thread, you can define \b WEBSERVER_STACK_SIZE in your config.h.  The
-  default value is 512.
+  The web server handles requests with a small pool of worker threads - \b WEBSERVER_WORKERS of them
+  (2 by default) - so one slow client doesn't hold everyone else up.  A separate thread accepts new connections
+  and queues them up for the workers.  If more than \b WEBSERVER_ACCEPT_QUEUE connections (4 by default)
+  are waiting, new ones are turned away with a 503 status.
+
+  Each worker has its own stack.  The buffers a request is read into come from a \ref pool of
+  \b WEBSERVER_BUFFERS blocks of \b REQUEST_SIZE_MAX bytes (by default, the 2 each worker needs) and are only held
+  while a connection is being served - if there aren't any left, the connection is turned away with a 503 status.
+  Check how many get used with \b /system/memory.  If you find that you need to change the stack size
+  for the worker threads, you can define \b WEBSERVER_STACK_SIZE in your config.h.  The
+  default value is 512, or 1024 when OSC is part of your build, since \ref webstate calls OSC handlers
+  from the workers.  Remember each connection uses one of lwIP's netconns, so \b MEMP_NUM_NETCONN
+  needs room for the workers as well as your other sockets.
+
+  Request counts and timing are available via webserverHits(), webserverActive() and webserverLatency(),
+  or over OSC - see \ref WebServerOSC.
   \ingroup networking
   @{
 */
@@ -117,16 +209,35 @@ static int webserverGetBody(int socket, char* requestBuffer, int maxSize);
 */
 bool webserverEnable(bool on, int port)
 {
+  int i;
   if (on && webserver.thd == 0) {
     webserver.hits = 0;
     webserver.port = port;
-    webserver.thd = chThdCreateStatic(webserverWA, sizeof(webserverWA), NORMALPRIO, webServerLoop, &webserver.port);
+    webserver.server = tcpserverOpen(port);
+    if (webserver.server < 0)
+      return false;
+    chMBInit(&webserver.queue, webserver.queueBuf, WEBSERVER_ACCEPT_QUEUE);
+    for (i = 0; i < WEBSERVER_WORKERS; i++) {
+      webserver.workers[i].socket = -1;
+      webserver.workers[i].thd = chThdCreateStatic(webserverWorkerWA[i], sizeof(webserverWorkerWA[i]),
+                                                   NORMALPRIO, webserverWorker, &webserver.workers[i]);
+    }
+    webserver.thd = chThdCreateStatic(webserverWA, sizeof(webserverWA), NORMALPRIO, webServerLoop, &webserver.server);
     return true;
   }
-  else if (webserver.thd != 0) {
+  else if (!on && webserver.thd != 0) {
     chThdTerminate(webserver.thd);
+    tcpserverClose(webserver.server); // kick the accept thread out of tcpserverAccept()
     chThdWait(webserver.thd);
     webserver.thd = 0;
+    for (i = 0; i < WEBSERVER_WORKERS; i++) {
+      chThdTerminate(webserver.workers[i].thd);
+      chThdWait(webserver.workers[i].thd);
+    }
+    // close anything that never made it to a worker
+    msg_t msg;
+    while (chMBFetch(&webserver.queue, &msg, TIME_IMMEDIATE) == RDY_OK)
+      tcpClose((int)msg);
     return true;
   }
   return false;
@@ -150,69 +261,323 @@ void webserverAddHandler(WebHandler* handler)
   }
 }
 
+static WebWorker* webserverWorkerFor(int socket)
+{
+  int i;
+  for (i = 0; i < WEBSERVER_WORKERS; i++) {
+    if (webserver.workers[i].socket == socket)
+      return &webserver.workers[i];
+  }
+  return 0;
+}
+
+static const char* webserverReason(int code)
+{
+  switch (code) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default:  return "";
+  }
+}
+
+/**
+  Send an HTTP OK status.
+  Call this from your handler before writing anything else.
+  @param socket The socket passed to your handler.
+*/
+void webserverSetStatusOK(int socket)
+{
+  webserverSetStatusCode(socket, 200);
+}
+
+/**
+  Send an HTTP status.
+  Call this from your handler before writing anything else.
+  @param socket The socket passed to your handler.
+  @param code The status code - 404, for example.
+*/
+void webserverSetStatusCode(int socket, int code)
+{
+  char status[48];
+  int len = sniprintf(status, sizeof(status), "HTTP/1.1 %d %s\r\n", code, webserverReason(code));
+  tcpWrite(socket, status, len);
+}
+
+/**
+  Send the length of your response.
+  Call this after setting the status and before the blank line that ends your headers.
+  Once the client knows how long the response is, the connection can be kept open for its next request.
+  @param socket The socket passed to your handler.
+  @param length The number of bytes in the response body.
+*/
+void webserverSetContentLength(int socket, int length)
+{
+  char header[32];
+  int len = sniprintf(header, sizeof(header), "Content-Length: %d\r\n", length);
+  tcpWrite(socket, header, len);
+  webserverLengthSent(socket);
+}
+
+/**
+  Let the web server know you've sent a Content-Length header yourself.
+  Use this if you're building your own headers rather than using webserverSetContentLength(), so
+  the connection can still be kept open for the client's next request.
+  @param socket The socket passed to your handler.
+*/
+void webserverLengthSent(int socket)
+{
+  WebWorker* w = webserverWorkerFor(socket);
+  if (w)
+    w->lengthSet = true;
+}
+
+/**
+  Take over a connection.
+  Normally the web server closes the connection (or waits for the next request on it) once your
+  handler returns.  If you'd like to keep writing to it after that - streaming updates to a browser, for
+  example - call this from your handler and the socket is yours.  Be sure to tcpClose() it when you're done.
+  @param socket The socket passed to your handler.
+*/
+void webserverDetach(int socket)
+{
+  WebWorker* w = webserverWorkerFor(socket);
+  if (w)
+    w->detached = true;
+}
+
+/**
+  Check whether the client can take a gzipped response.
+  @param socket The socket passed to your handler.
+  @return True if the request's Accept-Encoding includes gzip.
+*/
+bool webserverAcceptsGzip(int socket)
+{
+  WebWorker* w = webserverWorkerFor(socket);
+  return w ? w->acceptsGzip : false;
+}
+
+/**
+  The ETag from the request's If-None-Match header.
+  If it matches what you'd send, you can answer with a 304 status and no body.
+  @param socket The socket passed to your handler.
+  @return The ETag, including its quotes, or an empty string if there wasn't one.
+*/
+const char* webserverIfNoneMatch(int socket)
+{
+  WebWorker* w = webserverWorkerFor(socket);
+  return w ? w->etag : "";
+}
+
+/**
+  The number of requests handled since the web server was enabled.
+  @return The number of requests.
+*/
+int webserverHits()
+{
+  return webserver.hits;
+}
+
+/**
+  The number of connections currently being served.
+  @return The number of open connections.
+*/
+int webserverActive()
+{
+  return webserver.active;
+}
+
+/**
+  The average time taken to handle a request, in milliseconds.
+  This is measured from when the request line arrives to when the handler returns.
+  @param max (optional) Set to the longest time taken to handle a request.
+  @return The average time in milliseconds.
+*/
+int webserverLatency(int* max)
+{
+  if (max)
+    *max = webserver.latencyMax;
+  return (webserver.hits > 0) ? webserver.latencyTotal / webserver.hits : 0;
+}
+
 /** @}
 */
 
 /*
-  Wait for new connections (making sure we're listening on the right port)
-  and then dispatch them to processRequest()
+  Wait for new connections and queue them up for the workers.
+  If the queue's full, turn them away rather than letting them pile up.
 */
 msg_t webServerLoop(void *arg)
 {
-  int client, serv = tcpserverOpen(*(int*)arg);
+  int client, serv = *(int*)arg;
 
   while (!chThdShouldTerminate()) {
     // Block waiting for connection
     if ((client = tcpserverAccept(serv)) >= 0) {
-      webserverProcessRequest(client);
-      tcpClose(client);
-      webserver.hits++;
+      webserver.connections++;
+      if (chMBPost(&webserver.queue, (msg_t)client, TIME_IMMEDIATE) != RDY_OK) {
+        webserverSetStatusCode(client, 503);
+        tcpWrite(client, "\r\n", 2);
+        tcpClose(client);
+        chSysLock();
+        webserver.rejected++;
+        chSysUnlock();
+      }
     }
   }
   return 0;
 }
 
+/*
+  Grab the buffers a connection needs to be served, or neither of them.
+*/
+static bool webserverGetBuffers(WebWorker* w)
+{
+  w->request = poolAlloc(&webserverBuffers);
+  w->buf = poolAlloc(&webserverBuffers);
+  if (w->request != 0 && w->buf != 0)
+    return true;
+  webserverFreeBuffers(w);
+  return false;
+}
+
+static void webserverFreeBuffers(WebWorker* w)
+{
+  if (w->request != 0)
+    poolFree(&webserverBuffers, w->request);
+  if (w->buf != 0)
+    poolFree(&webserverBuffers, w->buf);
+  w->request = w->buf = 0;
+}
+
+/*
+  Pick up connections from the queue and serve them until they're done.
+*/
+msg_t webserverWorker(void *arg)
+{
+  WebWorker* w = arg;
+  msg_t msg;
+
+  while (!chThdShouldTerminate()) {
+    // wake up every so often to check whether we've been asked to stop
+    if (chMBFetch(&webserver.queue, &msg, MS2ST(500)) == RDY_OK) {
+      w->socket = (int)msg;
+      w->detached = false;
+      if (!webserverGetBuffers(w)) {
+        webserverSetStatusCode(w->socket, 503);
+        tcpWrite(w->socket, "\r\n", 2);
+        tcpClose(w->socket);
+        w->socket = -1;
+        chSysLock();
+        webserver.rejected++;
+        chSysUnlock();
+        continue;
+      }
+      tcpStreamInit(&w->stream, w->socket);
+      chSysLock();
+      webserver.active++;
+      chSysUnlock();
+      webserverServe(w);
+      chSysLock();
+      webserver.active--;
+      chSysUnlock();
+      if (!w->detached)
+        tcpClose(w->socket);
+      w->socket = -1;
+      webserverFreeBuffers(w);
+    }
+  }
+  return 0;
+}
+
+/*
+  Handle requests on a connection for as long as the client wants to keep it open,
+  and the responses allow it.
+*/
+void webserverServe(WebWorker* w)
+{
+  int requests = 0;
+  tcpSetReadTimeout(w->socket, WEBSERVER_KEEPALIVE_TIMEOUT);
+  while (webserverProcessRequest(w)) {
+    if (w->detached || !w->keepAlive || !w->lengthSet || ++requests >= WEBSERVER_KEEPALIVE_MAX || chThdShouldTerminate())
+      break;
+  }
+}
+
 /*
   A new request has come in - loop through our registered handlers until
   one of them indicates it has responded to it.
+  Returns false if no request arrived.
 */
-void webserverProcessRequest(int socket)
+bool webserverProcessRequest(WebWorker* w)
 {
   bool responded = false;
-  HttpMethod method = 0;
+  HttpMethod method = HTTP_GET;
   WebHandler* h = webserver.handlers;
-  char* path = webserverGetRequestAddress(socket, webserver.buf, sizeof(webserver.buf), &method);
+  char* path = webserverGetRequestAddress(w, &method);
+  if (path == NULL)
+    return false;
+
+  systime_t start = chTimeNow();
+  w->lengthSet = false;
+  w->acceptsGzip = false;
+  w->etag[0] = 0;
+  // read the rest of the headers, so the next request on this connection starts in the right place
+  int bodylen = webserverGetBody(w);
+  if (bodylen < 0)
+    return false;
 
   while (h != NULL && responded == false) {
     if (strncmp(h->address, path, strlen(h->address)) == 0) {
       // if appropriate, get pointers to the request body
-      if (method == HTTP_POST || method == HTTP_PUT) {
-        int requestlen = webserverGetBody(socket, webserver.buf, sizeof(webserver.buf));
-        responded = h->onRequest(socket, method, path, webserver.buf, requestlen);
-      }
-      else {
-        responded = h->onRequest(socket, method, path, 0, 0);
-      }
+      if (method == HTTP_POST || method == HTTP_PUT)
+        responded = h->onRequest(w->socket, method, path, w->buf, bodylen);
+      else
+        responded = h->onRequest(w->socket, method, path, 0, 0);
     }
     h = h->next;
   }
+
+  uint32_t latency = ((chTimeNow() - start) * 1000) / CH_FREQUENCY;
+  chSysLock();
+  webserver.hits++;
+  webserver.latencyTotal += latency;
+  if (latency > webserver.latencyMax)
+    webserver.latencyMax = latency;
+  chSysUnlock();
+  return true;
 }
 
 /*
   Extract the HTTP method for this request, and then return a pointer to the beginning
   of the URL path
 */
-char* webserverGetRequestAddress(int socket, char* buf, int len, HttpMethod* method)
+char* webserverGetRequestAddress(WebWorker* w, HttpMethod* method)
 {
-  int reqlen = tcpReadLine(socket, buf, len);
-  char* request = buf;
+  int reqlen = tcpStreamReadLine(&w->stream, w->request, REQUEST_SIZE_MAX - 1);
+  if (reqlen <= 0)
+    return NULL;
+  w->request[reqlen] = 0;
+
+  char* request = w->request;
   char* end = request + reqlen;
   char* address = NULL;
 
+  // HTTP/1.1 clients keep the connection open unless they say otherwise
+  w->keepAlive = (strstr(request, "HTTP/1.1") != NULL);
+
   // Skip any initial spaces
   while (isspace((int)*request))
     request++;
-  if (request > end) // make sure we didn't go too far
+  if (request >= end) // make sure we didn't go too far
     return NULL;
 
   if (strncmp("GET", request, 3) == 0)
@@ -232,7 +597,7 @@ char* webserverGetRequestAddress(int socket, char* buf, int len, HttpMethod* met
   while (isspace((int)*request))
     request++;
 
-  if (request > end)
+  if (request >= end)
     return address;
 
   address = request;
@@ -244,44 +609,517 @@ char* webserverGetRequestAddress(int socket, char* buf, int len, HttpMethod* met
   return address;
 }
 
-int webserverGetBody(int socket, char* requestBuffer, int maxSize)
+/*
+  Read the rest of the headers, and then the body into the worker's buffer.
+  Returns the length of the body, or -1 if the connection went away.
+*/
+int webserverGetBody(WebWorker* w)
 {
   // keep reading lines of the HTTP header until we get CRLF which signifies the end of the
-  // header.  If we see the contentlength along the way, keep that.
+  // header.  If we see the content length or connection preference along the way, keep them.
   int bufferLength, contentLength = 0;
-  while ((bufferLength = tcpReadLine(socket, requestBuffer, maxSize))) {
-    if (strncmp(requestBuffer, "\r\n", 2) == 0)
+  while ((bufferLength = tcpStreamReadLine(&w->stream, w->buf, REQUEST_SIZE_MAX - 1)) > 0) {
+    w->buf[bufferLength] = 0;
+    if (strncmp(w->buf, "\r\n", 2) == 0)
       break;
-    if (strncasecmp(requestBuffer, "Content-Length", 14) == 0)
-      contentLength = atoi(&requestBuffer[15]);
+    if (strncasecmp(w->buf, "Content-Length:", 15) == 0)
+      contentLength = atoi(&w->buf[15]);
+    else if (strncasecmp(w->buf, "Connection:", 11) == 0) {
+      char* value = &w->buf[11];
+      while (isspace((int)*value))
+        value++;
+      if (strncasecmp(value, "close", 5) == 0)
+        w->keepAlive = false;
+      else if (strncasecmp(value, "keep-alive", 10) == 0)
+        w->keepAlive = true;
+    }
+    else if (strncasecmp(w->buf, "Accept-Encoding:", 16) == 0)
+      w->acceptsGzip = (strstr(&w->buf[16], "gzip") != NULL);
+    else if (strncasecmp(w->buf, "If-None-Match:", 14) == 0) {
+      char* value = &w->buf[14];
+      while (isspace((int)*value))
+        value++;
+      int len = strcspn(value, "\r\n");
+      if (len < WEBSERVER_ETAG_MAX) {
+        memcpy(w->etag, value, len);
+        w->etag[len] = 0;
+      }
+    }
   }
-  
+  if (bufferLength <= 0)
+    return -1;
+
   // now we should be down to the HTTP POST data
   // if there's any data, get up into it
   int bufferRead = 0;
-  if (contentLength > 0 && bufferLength > 0) {
-    int lengthToRead = tcpAvailable(socket);
-    if (lengthToRead < 0)
-      return -1;
-    if (lengthToRead > maxSize)
-      lengthToRead = maxSize - 1;
-    char *rbp = requestBuffer;
-    // read all that the socket has to offer...may come in chunks, so keep going until there's none left
-    while ((bufferLength = tcpRead(socket, rbp, lengthToRead))) {
-      bufferRead += bufferLength;
-      rbp += bufferLength;
-      lengthToRead -= bufferLength;
-      if (bufferRead >= contentLength)
+  if (contentLength > REQUEST_SIZE_MAX - 1) {
+    // we can't read all of it, so the next request wouldn't start where it should
+    contentLength = REQUEST_SIZE_MAX - 1;
+    w->keepAlive = false;
+  }
+  if (contentLength > 0)
+    bufferRead = tcpStreamReadExactly(&w->stream, w->buf, contentLength);
+  w->buf[bufferRead] = 0; // null-terminate the request
+  return bufferRead;
+}
+
+#ifdef OSC
+
+#include "json.h"
+
+#ifndef WEBSERVER_STATE_ADDRESS_MAX
+#define WEBSERVER_STATE_ADDRESS_MAX 48
+#endif
+
+#ifndef WEBSERVER_STATE_MAX_VALUES
+#define WEBSERVER_STATE_MAX_VALUES 8
+#endif
+
+#ifndef WEBSERVER_STATE_STRINGS
+#define WEBSERVER_STATE_STRINGS 64
+#endif
+
+#ifndef WEBSERVER_STATE_DECIMALS
+#define WEBSERVER_STATE_DECIMALS 3
+#endif
+
+typedef struct WebStateWrite_t {
+  bool apply;     // false while checking the body over, true once it's being acted on
+  bool open;      // inside the top level object
+  bool inArray;
+  char address[WEBSERVER_STATE_ADDRESS_MAX];
+  OscData data[WEBSERVER_STATE_MAX_VALUES];
+  int count;
+  char strings[WEBSERVER_STATE_STRINGS]; // string values, null-terminated for the OSC handlers
+  int stringsUsed;
+  int set;
+  int unknown;
+} WebStateWrite;
+
+static bool webserverStateHandler(int socket, HttpMethod method, char* path, char* body, int bodylen);
+
+static WebHandler webserverStateWebHandler = {
+  .address = "/state",
+  .onRequest = webserverStateHandler
+};
+
+/**
+  \defgroup webstate Web Server - Board State
+  Read and set everything on the board with a single web request.
+
+  Reading properties one OSC message at a time is fine for a few of them, but a dashboard that
+  shows the whole board would need dozens of round trips.  Instead, it can ask the web server for all of it at once.
+  Start serving the board's state along with the web server:
+  \code
+  webserverServeState("/state");
+  webserverEnable(YES, 80);
+  \endcode
+
+  \section Reading
+  A GET request reads every property in your \b oscRoot - just as if each one had been sent an OSC message
+  with no arguments - and sends back one JSON object, with each reply's OSC address as a key.  Properties with a
+  single value are sent as that value, and those with several are sent as an array:
+  \code
+  GET /state
+  {"/appled/0/value":1,"/appled/1/value":0,...,"/system/name":"Make Controller Kit",...,"/network/stats/link":[1024,998,0,0,0],...}
+  \endcode
+  Add an OSC address to only read part of the tree:
+  \code
+  GET /state/appled
+  {"/appled/0/value":1,"/appled/1/value":0,"/appled/2/value":0,"/appled/3/value":1}
+  \endcode
+  Floats are sent with \b WEBSERVER_STATE_DECIMALS decimal places (3 by default).  Replies that contain
+  blobs are left out, and properties that only reply with blobs, like \b /datalog/dump, skip the work of
+  reading them.  If a property replies more than once, like \b /network/stats/memp, its address
+  shows up once for each reply.
+
+  \section Setting
+  A PUT or POST request takes a JSON object in the same form, and sends each value to its address, just as if it
+  had arrived as an OSC message.  Arrays are sent as a message with several arguments, and OSC patterns
+  work as keys, so
+  \code
+  PUT /state
+  {"/appled/[0-3]/value":0,"/system/autosend-interval":20,"/digitalout/{4,5}/value":1}
+  \endcode
+  turns off all the LEDs, changes the autosend interval and turns on digital outs 4 and 5.  The response says how many
+  addresses were set, and how many didn't match anything:
+  \code
+  {"set":3,"unknown":0}
+  \endcode
+  The body is checked over before anything is set, so if it isn't valid JSON you get a 400 status and nothing changes.
+  Values can't be nested any deeper than an array, and each can have at most \b WEBSERVER_STATE_MAX_VALUES
+  arguments (8 by default).  The body has to fit into the web server's request buffer - \b REQUEST_SIZE_MAX
+  bytes (256 by default) - so split big changes across a few requests.
+
+  \section Configuration
+  The OSC handlers are called from the web server's worker threads, so when OSC is part of your build their
+  stacks default to 1024 bytes rather than 512.  If your own handlers need more, define \b WEBSERVER_STACK_SIZE
+  in your config.h.  The \ref json library needs to be part of your build.
+  \ingroup networking
+  @{
+*/
+
+/**
+  Start serving the board's state.
+  This adds a handler to the web server, so call it before webserverEnable().
+  @param address The address to serve the state at - "/state", for example.
+*/
+void webserverServeState(const char* address)
+{
+  if (address)
+    webserverStateWebHandler.address = address;
+  webserverAddHandler(&webserverStateWebHandler);
+}
+
+/** @}
+*/
+
+static bool webserverStateFlush(void* context, const char* data, int len)
+{
+  return tcpWrite(*(int*)context, data, len) == len;
+}
+
+/*
+  Called by oscQuery() for each reply - add it to the document.
+*/
+static void webserverStateReply(void* context, const char* address, OscData* data, int datacount)
+{
+  JsonWriter* jw = context;
+  int i;
+  if (datacount == 0)
+    return;
+  for (i = 0; i < datacount; i++) {
+    if (data[i].type == BLOB) // no good way to show these
+      return;
+  }
+  jsonwriterObjectKey(jw, address);
+  if (datacount > 1)
+    jsonwriterArrayOpen(jw);
+  for (i = 0; i < datacount; i++) {
+    switch (data[i].type) {
+      case INT:
+        jsonwriterInt(jw, data[i].value.i);
+        break;
+      case FLOAT:
+        jsonwriterFloat(jw, data[i].value.f, WEBSERVER_STATE_DECIMALS);
+        break;
+      case STRING:
+        jsonwriterString(jw, data[i].value.s);
+        break;
+      default:
         break;
     }
-    requestBuffer[bufferRead] = 0; // null-terminate the request
   }
-  return bufferRead;
+  if (datacount > 1)
+    jsonwriterArrayClose(jw);
 }
 
-#endif // MAKE_CTRL_NETWORK
+static bool webserverStateRead(int socket, const char* address)
+{
+  WebWorker* w = webserverWorkerFor(socket);
+  JsonWriter jw;
+  if (w == 0)
+    return false;
 
+  webserverSetStatusOK(socket);
+  tcpWrite(socket, "Content-Type: " HTTP_CONTENT_JSON, strlen("Content-Type: " HTTP_CONTENT_JSON));
+  // the request has been read, so its buffer can hold the response as it's built up
+  jsonwriterInit(&jw, w->buf, REQUEST_SIZE_MAX);
+  jsonwriterSetFlush(&jw, webserverStateFlush, &socket);
+  jsonwriterObjectOpen(&jw);
+  oscQuery(address, webserverStateReply, &jw);
+  jsonwriterObjectClose(&jw);
+  jsonwriterFlush(&jw);
+  return true;
+}
 
+/*
+  The JSON reader's handlers for a PUT or POST - each key is an address,
+  and each value (or array of them) gets sent to it.
+*/
 
+static bool webserverStateSet(WebStateWrite* s)
+{
+  if (s->apply) {
+    if (oscDispatch(s->address, s->data, s->count))
+      s->set++;
+    else
+      s->unknown++;
+  }
+  return true;
+}
 
+static OscData* webserverStateNext(WebStateWrite* s)
+{
+  if (!s->open || s->count >= WEBSERVER_STATE_MAX_VALUES)
+    return 0;
+  return &s->data[s->count++];
+}
+
+static bool webserverStateValueDone(WebStateWrite* s)
+{
+  return s->inArray ? true : webserverStateSet(s);
+}
+
+static bool webserverStateKey(void* context, const char* key, int len)
+{
+  WebStateWrite* s = context;
+  if (len >= WEBSERVER_STATE_ADDRESS_MAX)
+    return false;
+  memcpy(s->address, key, len);
+  s->address[len] = 0;
+  s->count = 0;
+  s->stringsUsed = 0;
+  return true;
+}
+
+static bool webserverStateInt(void* context, int value)
+{
+  WebStateWrite* s = context;
+  OscData* d = webserverStateNext(s);
+  if (d == 0)
+    return false;
+  d->type = INT;
+  d->value.i = value;
+  return webserverStateValueDone(s);
+}
+
+static bool webserverStateBool(void* context, bool value)
+{
+  return webserverStateInt(context, value ? 1 : 0);
+}
+
+static bool webserverStateFloat(void* context, float value)
+{
+  WebStateWrite* s = context;
+  OscData* d = webserverStateNext(s);
+  if (d == 0)
+    return false;
+  d->type = FLOAT;
+  d->value.f = value;
+  return webserverStateValueDone(s);
+}
 
+static bool webserverStateString(void* context, const char* string, int len)
+{
+  WebStateWrite* s = context;
+  OscData* d = webserverStateNext(s);
+  if (d == 0 || s->stringsUsed + len + 1 > WEBSERVER_STATE_STRINGS)
+    return false;
+  // the reader's strings aren't terminated, and only last as long as this call
+  d->type = STRING;
+  d->value.s = s->strings + s->stringsUsed;
+  memcpy(d->value.s, string, len);
+  d->value.s[len] = 0;
+  s->stringsUsed += len + 1;
+  return webserverStateValueDone(s);
+}
+
+static bool webserverStateNull(void* context)
+{
+  WebStateWrite* s = context;
+  return s->open && !s->inArray; // nothing to set
+}
+
+static bool webserverStateObjectOpen(void* context)
+{
+  WebStateWrite* s = context;
+  if (s->open) // only the top level
+    return false;
+  s->open = true;
+  return true;
+}
+
+static bool webserverStateObjectClose(void* context)
+{
+  WebStateWrite* s = context;
+  s->open = false;
+  return true;
+}
+
+static bool webserverStateArrayOpen(void* context)
+{
+  WebStateWrite* s = context;
+  if (!s->open || s->inArray)
+    return false;
+  s->inArray = true;
+  return true;
+}
+
+static bool webserverStateArrayClose(void* context)
+{
+  WebStateWrite* s = context;
+  s->inArray = false;
+  return webserverStateSet(s);
+}
+
+static bool webserverStateParse(WebStateWrite* s, const char* body, int bodylen)
+{
+  JsonReader jr;
+  jsonreaderInit(&jr, s, true);
+  jr.null_handler = webserverStateNull;
+  jr.bool_handler = webserverStateBool;
+  jr.int_handler = webserverStateInt;
+  jr.float_handler = webserverStateFloat;
+  jr.string_handler = webserverStateString;
+  jr.start_obj_handler = webserverStateObjectOpen;
+  jr.obj_key_handler = webserverStateKey;
+  jr.end_obj_handler = webserverStateObjectClose;
+  jr.start_array_handler = webserverStateArrayOpen;
+  jr.end_array_handler = webserverStateArrayClose;
+  return jsonreaderGo(&jr, body, bodylen);
+}
+
+static bool webserverStateWrite(int socket, const char* body, int bodylen)
+{
+  WebStateWrite s;
+  char response[32];
+  JsonWriter jw;
+
+  s.apply = s.open = s.inArray = false;
+  s.set = s.unknown = 0;
+  if (bodylen == 0 || !webserverStateParse(&s, body, bodylen)) {
+    webserverSetStatusCode(socket, 400);
+    webserverSetContentLength(socket, 0);
+    tcpWrite(socket, "\r\n", 2);
+    return true;
+  }
+  // it all checks out, so go for real this time
+  s.apply = true;
+  webserverStateParse(&s, body, bodylen);
+
+  jsonwriterInit(&jw, response, sizeof(response));
+  jsonwriterObjectOpen(&jw);
+  jsonwriterObjectKey(&jw, "set");
+  jsonwriterInt(&jw, s.set);
+  jsonwriterObjectKey(&jw, "unknown");
+  jsonwriterInt(&jw, s.unknown);
+  jsonwriterObjectClose(&jw);
+  int len = jw.p - response;
+
+  webserverSetStatusOK(socket);
+  webserverSetContentLength(socket, len);
+  tcpWrite(socket, "Content-Type: " HTTP_CONTENT_JSON, strlen("Content-Type: " HTTP_CONTENT_JSON));
+  tcpWrite(socket, response, len);
+  return true;
+}
+
+bool webserverStateHandler(int socket, HttpMethod method, char* path, char* body, int bodylen)
+{
+  char* address = path + strlen(webserverStateWebHandler.address);
+  char* query = strchr(address, '?');
+  if (query)
+    *query = 0;
+  if (*address != 0 && *address != '/') // "/stateful" or some such - not for us
+    return false;
+
+  if (method == HTTP_GET)
+    return webserverStateRead(socket, address);
+  if (method == HTTP_PUT || method == HTTP_POST)
+    return webserverStateWrite(socket, body, bodylen);
+  return false;
+}
+
+/** \defgroup WebServerOSC Web Server - OSC
+  Check on the web server via OSC.
+  \ingroup OSC
+
+  \section devices Devices
+  There's only one web server, so a device index is not used in OSC messages to it.
+
+  \section properties Properties
+  The web server has the following properties:
+  - hits
+  - active
+  - connections
+  - rejected
+  - latency
+  - maxlatency
+
+  \par Hits
+  The \b hits property is the number of requests handled since the web server was enabled.
+  It's read-only - to read it, send
+  \verbatim /webserver/hits \endverbatim
+
+  \par Active
+  The \b active property is the number of connections currently being served.  It's read-only.
+
+  \par Connections
+  The \b connections property is the number of connections accepted, including any that were rejected.
+  It's read-only.
+
+  \par Rejected
+  The \b rejected property is the number of connections turned away because the accept queue was full, or there
+  weren't any request buffers left to serve them with.  It's read-only.
+
+  \par Latency
+  The \b latency property is the average time to handle a request, in milliseconds, and
+  \b maxlatency is the longest.  Both are read-only.
+*/
+
+static void webserverStatOsc(OscChannel ch, char* address, int value, int datalen)
+{
+  if (datalen == 0) {
+    OscData d = { .type = INT, .value.i = value };
+    oscCreateMessage(ch, address, &d, 1);
+  }
+}
+
+static void webserverHitsOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  webserverStatOsc(ch, address, webserver.hits, datalen);
+}
+
+static void webserverActiveOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  webserverStatOsc(ch, address, webserver.active, datalen);
+}
+
+static void webserverConnectionsOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  webserverStatOsc(ch, address, webserver.connections, datalen);
+}
+
+static void webserverRejectedOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  webserverStatOsc(ch, address, webserver.rejected, datalen);
+}
+
+static void webserverLatencyOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  webserverStatOsc(ch, address, webserverLatency(0), datalen);
+}
+
+static void webserverMaxLatencyOsc(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(idx); UNUSED(d);
+  webserverStatOsc(ch, address, webserver.latencyMax, datalen);
+}
+
+static const OscNode webserverHitsNode = { .name = "hits", .handler = webserverHitsOsc };
+static const OscNode webserverActiveNode = { .name = "active", .handler = webserverActiveOsc };
+static const OscNode webserverConnectionsNode = { .name = "connections", .handler = webserverConnectionsOsc };
+static const OscNode webserverRejectedNode = { .name = "rejected", .handler = webserverRejectedOsc };
+static const OscNode webserverLatencyNode = { .name = "latency", .handler = webserverLatencyOsc };
+static const OscNode webserverMaxLatencyNode = { .name = "maxlatency", .handler = webserverMaxLatencyOsc };
+
+const OscNode webserverOsc = {
+  .name = "webserver",
+  .children = {
+    &webserverHitsNode,
+    &webserverActiveNode,
+    &webserverConnectionsNode,
+    &webserverRejectedNode,
+    &webserverLatencyNode,
+    &webserverMaxLatencyNode, 0
+  }
+};
+
+#endif // OSC
+
+#endif // MAKE_CTRL_NETWORK
@@ -57,9 +57,25 @@ bool webserverEnable(bool on, int port);
 void webserverAddHandler(WebHandler* handler);
 void webserverSetStatusOK(int socket);
 void webserverSetStatusCode(int socket, int code);
+void webserverSetContentLength(int socket, int length);
+void webserverLengthSent(int socket);
+void webserverDetach(int socket);
+bool webserverAcceptsGzip(int socket);
+const char* webserverIfNoneMatch(int socket);
+int  webserverHits(void);
+int  webserverActive(void);
+int  webserverLatency(int* max);
+#ifdef OSC
+void webserverServeState(const char* address);
+#endif
 #ifdef __cplusplus
 }
 #endif
 
+#ifdef OSC
+#include "osc.h"
+extern const OscNode webserverOsc;
+#endif
+
 #endif  // WEB_SERVER_H
 
@@ -20,16 +20,41 @@
 #include <stdio.h>
 #include "string.h"
 #include "xbee.h"
-#include "serial.h"
+#include "mtserial.h"
 #include "error.h"
 
 static bool xbeeGetIOValues(XBeePacket* packet, int *inputs);
+static int xbeeFrameLength(XBeePacket* packet, int datalength);
+static int xbeeWriteFrame(XBeePacket* packet, int datalength);
+static void xbeeTxHandleStatus(XBeePacket* packet);
 #define XBEE_OSC_RX_TIMEOUT 500
 
 #ifndef XBEE_SERIAL
-#define XBEE_SERIAL 0
+#define XBEE_SERIAL Serial0
 #endif
 
+#ifndef XBEE_TX_WRITE_TIMEOUT
+#define XBEE_TX_WRITE_TIMEOUT 100
+#endif
+
+// one outstanding transmission, waiting on its TX status packet
+typedef struct {
+  uint8_t frameID;    // 0 if this slot is free
+  systime_t sent;
+  XBeeTxStatusHandler handler;
+  void* context;
+} XBeeTxSlot;
+
+typedef struct {
+  Mutex lock;
+  uint8_t nextFrameID;
+  int inflight;
+  XBeeTxSlot slots[XBEE_TX_MAX_INFLIGHT];
+  uint8_t frame[XBEE_MAX_PACKET_SIZE + 4]; // start byte, 2 length bytes, payload, checksum
+} XBeeTx;
+
+static XBeeTx xbeeTx;
+
 #ifdef OSC
 typedef struct {
   XBeePacket currentPkt;
@@ -100,9 +125,14 @@ static XBeeDriver xbee;
 */
 void xbeeInit()
 {
+  chMtxInit(&xbeeTx.lock);
+  xbeeTx.nextFrameID = 1;
+  xbeeTx.inflight = 0;
+  memset(xbeeTx.slots, 0, sizeof(xbeeTx.slots));
+
   // Configure the serial port
   serialDisable(XBEE_SERIAL);
-  serialEnable(XBEE_SERIAL, 9600, 8, 0, 1, 0);
+  serialEnable(XBEE_SERIAL, 9600);
   
   // if( state ) 
   // { 
@@ -160,8 +190,8 @@ int xbeeGetPacket(XBeePacket* packet, int timeout)
   int time = chTimeNow();
   do {
     while (serialAvailable(XBEE_SERIAL)) {
-      int newChar = serialGet(XBEE_SERIAL);
-      if (newChar == -1)
+      uint8_t newChar;
+      if (serialRead(XBEE_SERIAL, (char*)&newChar, 1, TIME_IMMEDIATE) != 1)
         break;
   
       switch (packet->rxState) {
@@ -191,8 +221,11 @@ int xbeeGetPacket(XBeePacket* packet, int timeout)
         case XBEE_PACKET_RX_CRC:
           packet->crc += newChar;
           packet->rxState = XBEE_PACKET_RX_START;
-          if (packet->crc == 0xFF)
+          if (packet->crc == 0xFF) {
+            if (packet->apiId == XBEE_TXSTATUS)
+              xbeeTxHandleStatus(packet);
             return 1;
+          }
           else {
             xbeeResetPacket(packet);
             return 0;
@@ -202,6 +235,7 @@ int xbeeGetPacket(XBeePacket* packet, int timeout)
     if (timeout > 0 )
       chThdSleepMilliseconds(1);
   } while ((chTimeNow() - time) < timeout);
+  xbeeTxPoll();
   return 0;
 }
 
@@ -226,32 +260,182 @@ int xbeeGetPacket(XBeePacket* packet, int timeout)
 */
 int xbeeSendPacket(XBeePacket* packet, int datalength)
 {
-  serialPut(XBEE_SERIAL, XBEE_PACKET_STARTBYTE);
+  chMtxLock(&xbeeTx.lock);
+  int rv = xbeeWriteFrame(packet, datalength);
+  chMtxUnlock();
+  return rv;
+}
+
+/**
+  Send an XBee packet without waiting for it to be acknowledged.
+  A frame ID is allocated for the packet and it's tracked until the module reports a
+  TX status for it, or until \b XBEE_TX_TIMEOUT milliseconds pass.  Either way, \b handler is
+  called once with the final status - one of the \ref XBeeTxStatus values.
+
+  Up to \b XBEE_TX_MAX_INFLIGHT packets can be outstanding at once, which lets you stream
+  to several remote modules without waiting on each one in turn.  Status packets are picked up
+  as they arrive in xbeeGetPacket(), so keep calling that from your receive loop.  You can
+  still see the status packets there yourself, if you prefer to handle them that way.
+
+  Any frame ID already in the packet is replaced.  This works for TX16, TX64 and AT command packets.
+  @param packet The XBeePacket to send.
+  @param datalength The length of the actual data being sent (not including headers, options, etc.)
+  @param handler The function to call with the TX status of this packet, or 0 for none.
+  @param context A pointer passed back to \b handler.
+  @return The frame ID allocated for this packet, or a negative number if there are already
+  \b XBEE_TX_MAX_INFLIGHT packets outstanding or the write failed.
+
+  \par Example
+  \code
+  void onStatus(uint8_t frameID, int status, void* context)
+  {
+    if (status != XBEE_TX_OK) {
+      // resend, or let somebody know
+    }
+  }
+
+  XBeePacket txPacket;
+  uint8_t data[] = "ABC";
+  xbeeCreateTX16Packet(&txPacket, 0, 0x1234, 0, data, 3);
+  xbeeTxSend(&txPacket, 3, onStatus, 0);
+  \endcode
+*/
+int xbeeTxSend(XBeePacket* packet, int datalength, XBeeTxStatusHandler handler, void* context)
+{
+  int i, rv;
+  XBeeTxSlot* slot = 0;
+
+  xbeeTxPoll();
+  chMtxLock(&xbeeTx.lock);
+  for (i = 0; i < XBEE_TX_MAX_INFLIGHT; i++) {
+    if (xbeeTx.slots[i].frameID == 0) {
+      slot = &xbeeTx.slots[i];
+      break;
+    }
+  }
+  if (!slot) {
+    chMtxUnlock();
+    return CONTROLLER_ERROR_NO_SPACE;
+  }
+
+  // frame ID 0 tells the module not to send a status, so skip it
+  uint8_t frameID = xbeeTx.nextFrameID;
+  if (++xbeeTx.nextFrameID == 0)
+    xbeeTx.nextFrameID = 1;
+  packet->payload[0] = frameID; // the frame ID is the first field of every TX/AT packet
+
+  rv = xbeeWriteFrame(packet, datalength);
+  if (rv == CONTROLLER_OK) {
+    slot->frameID = frameID;
+    slot->sent = chTimeNow();
+    slot->handler = handler;
+    slot->context = context;
+    xbeeTx.inflight++;
+    rv = frameID;
+  }
+  chMtxUnlock();
+  return rv;
+}
+
+/**
+  The number of packets sent with xbeeTxSend() that are still waiting on a TX status.
+  @return The number of outstanding packets.
+*/
+int xbeeTxInFlight()
+{
+  return xbeeTx.inflight;
+}
+
+/**
+  Expire any outstanding packets that have waited longer than \b XBEE_TX_TIMEOUT.
+  Their handlers are called with a status of \b XBEE_TX_TIMED_OUT.  This is called for you from
+  xbeeGetPacket() and xbeeTxSend(), so you usually won't need to call it yourself.
+*/
+void xbeeTxPoll()
+{
+  int i;
+  systime_t now = chTimeNow();
+  chMtxLock(&xbeeTx.lock);
+  for (i = 0; i < XBEE_TX_MAX_INFLIGHT; i++) {
+    XBeeTxSlot* slot = &xbeeTx.slots[i];
+    if (slot->frameID && (now - slot->sent) >= MS2ST(XBEE_TX_TIMEOUT)) {
+      XBeeTxSlot expired = *slot;
+      slot->frameID = 0;
+      xbeeTx.inflight--;
+      chMtxUnlock(); // don't hold the lock while the handler runs - it may want to resend
+      if (expired.handler)
+        expired.handler(expired.frameID, XBEE_TX_TIMED_OUT, expired.context);
+      chMtxLock(&xbeeTx.lock);
+    }
+  }
+  chMtxUnlock();
+}
+
+/*
+  Match an incoming TX status packet against the outstanding packets.
+*/
+static void xbeeTxHandleStatus(XBeePacket* packet)
+{
+  int i;
+  XBeeTxSlot done = { 0, 0, 0, 0 };
+  chMtxLock(&xbeeTx.lock);
+  for (i = 0; i < XBEE_TX_MAX_INFLIGHT; i++) {
+    if (xbeeTx.slots[i].frameID && xbeeTx.slots[i].frameID == packet->txStatus.frameID) {
+      done = xbeeTx.slots[i];
+      xbeeTx.slots[i].frameID = 0;
+      xbeeTx.inflight--;
+      break;
+    }
+  }
+  chMtxUnlock();
+  if (done.frameID && done.handler)
+    done.handler(done.frameID, packet->txStatus.status, done.context);
+}
+
+/*
+  The number of bytes between the length field and the checksum for this packet.
+*/
+static int xbeeFrameLength(XBeePacket* packet, int datalength)
+{
   switch (packet->apiId) {
     case XBEE_TX64: //account for apiId, frameId, 8 bytes destination, and options
-      datalength += 11;
-      break;
+      return datalength + 11;
     case XBEE_TX16: //account for apiId, frameId, 2 bytes destination, and options
-      datalength += 5; 
-      break;
+      return datalength + 5;
     case XBEE_ATCOMMAND: // length = API ID + Frame ID, + AT Command (+ Parameter Value)
-      datalength = (datalength > 0) ? 8 : 4; // if we're writing, there are 4 bytes of data, otherwise, just the length above
-      break;
+      return (datalength > 0) ? 8 : 4; // if we're writing, there are 4 bytes of data, otherwise, just the length above
     default:
-      datalength = 0;
-      break;
+      return 0;
   }
+}
+
+/*
+  Assemble the whole frame in xbeeTx.frame and hand it to the serial driver in one write.
+  Call with xbeeTx.lock held.
+*/
+static int xbeeWriteFrame(XBeePacket* packet, int datalength)
+{
+  int length = xbeeFrameLength(packet, datalength);
+  if (length > XBEE_MAX_PACKET_SIZE)
+    return CONTROLLER_ERROR_INSUFFICIENT_RESOURCES;
 
-  serialPut(XBEE_SERIAL, (datalength >> 8) & 0xFF); // send the most significant bit
-  serialPut(XBEE_SERIAL, datalength & 0xFF); // then the LSB
-  packet->crc = 0; // just in case it hasn't been initialized.
+  uint8_t* f = xbeeTx.frame;
   uint8_t* p = (uint8_t*)packet;
-  while (datalength--) {
-    serialPut(XBEE_SERIAL, *p);
-    packet->crc += *p++;
+  uint8_t crc = 0;
+  int i;
+  *f++ = XBEE_PACKET_STARTBYTE;
+  *f++ = (length >> 8) & 0xFF; // send the most significant byte
+  *f++ = length & 0xFF; // then the LSB
+  for (i = 0; i < length; i++) {
+    crc += *p;
+    *f++ = *p++;
   }
-  //uint8 test = 0xFF - packet->crc;
-  serialPut(XBEE_SERIAL, 0xFF - packet->crc);
+  *f++ = 0xFF - crc;
+  packet->crc = crc;
+
+  int total = f - xbeeTx.frame;
+  if (serialWrite(XBEE_SERIAL, (char const*)xbeeTx.frame, total, XBEE_TX_WRITE_TIMEOUT) != total)
+    return CONTROLLER_ERROR_WRITE_FAILED;
   return CONTROLLER_OK;
 }
 
@@ -297,13 +481,13 @@ void xbeeConfigSetPacketApiMode(bool enabled)
   if (enabled) {
     char buf[10];
     int len = siprintf(buf, "+++"); // enter command mode
-    serialPut(XBEE_SERIAL, buf, len, 0 );
+    serialWrite(XBEE_SERIAL, buf, len, XBEE_TX_WRITE_TIMEOUT);
     chThdSleepMilliseconds(1025); // have to wait one second after +++ to actually get set to receive in AT mode
     len = siprintf(buf, "ATAP1,CN\r"); // turn API mode on, and leave command mode
-    serialPut(XBEE_SERIAL, buf, len, 0);
+    serialWrite(XBEE_SERIAL, buf, len, XBEE_TX_WRITE_TIMEOUT);
     chThdSleepMilliseconds(50);
     while (serialAvailable(XBEE_SERIAL) > 0)
-      (void)serialGet(XBEE_SERIAL); // rip the OKs out of there
+      (void)serialGet(XBEE_SERIAL, TIME_IMMEDIATE); // rip the OKs out of there
   }
   else {
     XBeePacket xbp;
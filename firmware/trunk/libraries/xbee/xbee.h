@@ -34,6 +34,14 @@
 #define XBEE_INPUTS 15 // counts analog and digital ins separately
 #define XBEE_MAX_PACKET_SIZE 100
 
+// transmit engine
+#ifndef XBEE_TX_MAX_INFLIGHT
+#define XBEE_TX_MAX_INFLIGHT 8    // packets that can be waiting on a TX status at once
+#endif
+#ifndef XBEE_TX_TIMEOUT
+#define XBEE_TX_TIMEOUT 1000      // milliseconds to wait for a TX status before giving up
+#endif
+
 // xbee io options
 #define XBEE_IO_DISABLED 0
 #define XBEE_IO_ANALOGIN 2
@@ -173,6 +181,18 @@ enum XBeeApiId {
   XBEE_IO16 = 0x83                /**< An incoming IO packet with a 16-bit address. */
 };
 
+/**
+  The status delivered to an XBeeTxStatusHandler.
+  The first four come straight from the module's TX status packet.
+*/
+enum XBeeTxStatus {
+  XBEE_TX_OK = 0,           /**< The packet was sent and acknowledged. */
+  XBEE_TX_NO_ACK = 1,       /**< The packet was sent but no acknowledgement came back. */
+  XBEE_TX_CCA_FAILURE = 2,  /**< The channel was never clear to send on. */
+  XBEE_TX_PURGED = 3,       /**< The module dropped the packet. */
+  XBEE_TX_TIMED_OUT = 0xFF  /**< No TX status arrived within \b XBEE_TX_TIMEOUT. */
+};
+
 /** @}
 */
 
@@ -222,6 +242,12 @@ int xbeeGetPacket(XBeePacket* packet, int timeout);
 int xbeeSendPacket(XBeePacket* packet, int datalength);
 void xbeeResetPacket(XBeePacket* packet);
 
+// pipelined transmit
+typedef void (*XBeeTxStatusHandler)(uint8_t frameID, int status, void* context);
+int  xbeeTxSend(XBeePacket* packet, int datalength, XBeeTxStatusHandler handler, void* context);
+int  xbeeTxInFlight(void);
+void xbeeTxPoll(void);
+
 // packet creators and unpackers
 bool xbeeCreateTX16Packet(XBeePacket* xbp, uint8_t frameID, uint16_t destination, uint8_t options, uint8_t* data, uint8_t datalength );
 bool xbeeCreateTX64Packet(XBeePacket* xbp, uint8_t frameID, uint64_t destination, uint8_t options, uint8_t* data, uint8_t datalength );
@@ -0,0 +1,38 @@
+/*
+	config.h - Select which features & hardware you're using.
+  MakingThings
+*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define FIRMWARE_NAME          "Net Bench"
+#define FIRMWARE_MAJOR_VERSION 2
+#define FIRMWARE_MINOR_VERSION 0
+#define FIRMWARE_BUILD_NUMBER  0
+
+//----------------------------------------------------------------
+//  Comment out the systems that you don't want to include in your build.
+//----------------------------------------------------------------
+#define MAKE_CTRL_USB     // enable the USB system
+#define MAKE_CTRL_NETWORK // enable the Ethernet system
+#define OSC               // enable the OSC system
+
+//  The version of the MAKE Controller Board you're using.
+#define CONTROLLER_VERSION  100    // valid options: 50, 90, 95, 100, 200
+
+//  The version of the MAKE Application Board you're using.
+#define APPBOARD_VERSION  100    // valid options: 50, 90, 95, 100, 200
+
+//----------------------------------------------------------------
+//  Benchmark settings - see netbench.c
+//----------------------------------------------------------------
+#define NETBENCH_PORT 5001        // TCP sink, then TCP source, UDP echo and UDP flood on the next 3
+
+// the network settings under test - try a run with each
+//#define LWIP_PROFILE_HTTP       // bigger TCP window and send buffer, see lwipopts.h
+//#define LWIP_EMAC_ZEROCOPY 1    // hand EMAC buffers straight to lwIP
+
+#define OSC_MAX_MSG_OUT 1400      // so /network/stats fits in one reply
+
+#endif // CONFIG_H
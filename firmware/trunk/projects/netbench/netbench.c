@@ -0,0 +1,262 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Network throughput benchmark.
+
+  Runs four services, built on the same tcpserver, tcpsocket and udpsocket calls as
+  everything else, for the netbench tool in tools/netbench to measure:
+  - TCP sink, on NETBENCH_PORT (5001 by default): reads and throws away whatever the
+    client sends.  Once the client is done sending, it replies with how many bytes
+    arrived and how many milliseconds that took, as two 32 bit ints.
+  - TCP source, on NETBENCH_PORT + 1: the client sends the number of bytes it would
+    like, as a 32 bit int, and gets that many back as fast as the board can send them.
+  - UDP echo, on NETBENCH_PORT + 2: sends every datagram straight back where it came from.
+  - UDP flood, on NETBENCH_PORT + 3: the client sends the number of datagrams it would
+    like, their size and how many a second (0 for as fast as possible), as three 32 bit
+    ints.  Each datagram starts with its sequence number and the total.  At the end come
+    a few copies of a summary - a sequence number of 0xFFFFFFFF, the number sent, and the
+    number the board couldn't send because it ran out of memory.
+  All ints are big endian.
+
+  OSC over UDP is on too, so /network/stats, /system/threads and /system/memory can be
+  read between runs to see where packets are being dropped - in the EMAC, in lwIP's pools,
+  or in the benchmark itself.  Try the settings in config.h one at a time to see how
+  much each is worth.
+*/
+
+#include "core.h"
+#include "osc.h"
+
+#ifndef NETBENCH_PORT
+#define NETBENCH_PORT 5001
+#endif
+
+#ifndef NETBENCH_STACK_SIZE
+#define NETBENCH_STACK_SIZE 640
+#endif
+
+#ifndef NETBENCH_TCP_CHUNK
+#define NETBENCH_TCP_CHUNK 1460 // one full TCP segment on Ethernet
+#endif
+
+#ifndef NETBENCH_SUMMARIES
+#define NETBENCH_SUMMARIES 3 // copies of the flood summary, in case one gets lost
+#endif
+
+#define NETBENCH_UDP_MAX 1472 // the biggest datagram that fits in an Ethernet frame
+#define NETBENCH_SUMMARY 0xFFFFFFFF
+
+typedef struct NetBench_t {
+  char sinkBuf[NETBENCH_TCP_CHUNK];
+  char sourceBuf[NETBENCH_TCP_CHUNK];
+  char echoBuf[NETBENCH_UDP_MAX];
+  char floodBuf[NETBENCH_UDP_MAX];
+} NetBench;
+
+static NetBench bench;
+
+static WORKING_AREA(waSinkThd, NETBENCH_STACK_SIZE);
+static WORKING_AREA(waSourceThd, NETBENCH_STACK_SIZE);
+static WORKING_AREA(waEchoThd, NETBENCH_STACK_SIZE);
+static WORKING_AREA(waFloodThd, NETBENCH_STACK_SIZE);
+
+const OscNode oscRoot = {
+  .children = {
+    &systemOsc,
+    &networkOsc,
+    0
+  }
+};
+
+static void netbenchPutInt(char* buf, uint32_t value)
+{
+  buf[0] = value >> 24;
+  buf[1] = value >> 16;
+  buf[2] = value >> 8;
+  buf[3] = value;
+}
+
+static uint32_t netbenchGetInt(const char* buf)
+{
+  const uint8_t* b = (const uint8_t*)buf;
+  return (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+static bool netbenchReadExactly(int sock, char* buf, int length)
+{
+  int got = 0, n;
+  while (got < length) {
+    if ((n = tcpRead(sock, buf + got, length - got)) <= 0)
+      return false;
+    got += n;
+  }
+  return true;
+}
+
+static int netbenchListen(int port)
+{
+  int server;
+  while ((server = tcpserverOpen(port)) < 0)
+    sleep(500);
+  return server;
+}
+
+/*
+  TCP sink - count what arrives until the client closes its side.
+*/
+static msg_t netbenchSink(void* arg)
+{
+  UNUSED(arg);
+  int server = netbenchListen(NETBENCH_PORT);
+  while (!chThdShouldTerminate()) {
+    int client = tcpserverAccept(server);
+    if (client < 0)
+      continue;
+    uint32_t bytes = 0;
+    systime_t start = 0;
+    int n;
+    tcpSetReadTimeout(client, 5000);
+    while ((n = tcpRead(client, bench.sinkBuf, sizeof(bench.sinkBuf))) > 0) {
+      if (bytes == 0)
+        start = chTimeNow();
+      bytes += n;
+    }
+    uint32_t ms = ((chTimeNow() - start) * 1000) / CH_FREQUENCY;
+    char reply[8];
+    netbenchPutInt(reply, bytes);
+    netbenchPutInt(reply + 4, ms);
+    tcpWrite(client, reply, sizeof(reply));
+    tcpClose(client);
+  }
+  return 0;
+}
+
+/*
+  TCP source - send as many bytes as the client asks for.
+*/
+static msg_t netbenchSource(void* arg)
+{
+  UNUSED(arg);
+  int i, server = netbenchListen(NETBENCH_PORT + 1);
+  for (i = 0; i < NETBENCH_TCP_CHUNK; i++)
+    bench.sourceBuf[i] = i;
+  while (!chThdShouldTerminate()) {
+    int client = tcpserverAccept(server);
+    if (client < 0)
+      continue;
+    char request[4];
+    tcpSetReadTimeout(client, 5000);
+    if (netbenchReadExactly(client, request, sizeof(request))) {
+      uint32_t remaining = netbenchGetInt(request);
+      while (remaining > 0) {
+        int n = tcpWrite(client, bench.sourceBuf, MIN(remaining, sizeof(bench.sourceBuf)));
+        if (n <= 0)
+          break;
+        remaining -= n;
+      }
+    }
+    tcpClose(client);
+  }
+  return 0;
+}
+
+/*
+  UDP echo - straight back where it came from.
+*/
+static msg_t netbenchEcho(void* arg)
+{
+  UNUSED(arg);
+  int sock;
+  while ((sock = udpOpen()) < 0)
+    sleep(500);
+  udpBind(sock, NETBENCH_PORT + 2);
+  while (!chThdShouldTerminate()) {
+    int address, port;
+    int n = udpRead(sock, bench.echoBuf, sizeof(bench.echoBuf), &address, &port);
+    if (n > 0)
+      udpWrite(sock, bench.echoBuf, n, address, port);
+  }
+  return 0;
+}
+
+/*
+  UDP flood - as many datagrams as the client asks for, paced if it asked for a rate.
+*/
+static msg_t netbenchFlood(void* arg)
+{
+  UNUSED(arg);
+  int sock;
+  while ((sock = udpOpen()) < 0)
+    sleep(500);
+  udpBind(sock, NETBENCH_PORT + 3);
+  memset(bench.floodBuf, 0, sizeof(bench.floodBuf));
+  while (!chThdShouldTerminate()) {
+    int address, port;
+    char request[12];
+    if (udpRead(sock, request, sizeof(request), &address, &port) != sizeof(request))
+      continue;
+    uint32_t i, count = netbenchGetInt(request);
+    uint32_t size = netbenchGetInt(request + 4);
+    uint32_t rate = netbenchGetInt(request + 8);
+    uint32_t failed = 0;
+    size = MAX(MIN(size, NETBENCH_UDP_MAX), 12);
+    systime_t start = chTimeNow();
+    for (i = 0; i < count; i++) {
+      if (rate > 0) {
+        systime_t due = start + (systime_t)(((uint64_t)i * CH_FREQUENCY) / rate);
+        systime_t now = chTimeNow();
+        if ((int32_t)(due - now) > 0)
+          chThdSleep(due - now);
+      }
+      netbenchPutInt(bench.floodBuf, i);
+      netbenchPutInt(bench.floodBuf + 4, count);
+      if (udpWrite(sock, bench.floodBuf, size, address, port) != (int)size)
+        failed++;
+    }
+    for (i = 0; i < NETBENCH_SUMMARIES; i++) {
+      char summary[12];
+      netbenchPutInt(summary, NETBENCH_SUMMARY);
+      netbenchPutInt(summary + 4, count - failed);
+      netbenchPutInt(summary + 8, failed);
+      sleep(10); // let the last of the flood get out ahead of it
+      udpWrite(sock, summary, sizeof(summary), address, port);
+    }
+  }
+  return 0;
+}
+
+void setup()
+{
+  usbserialInit();
+  oscUsbEnable(YES);
+  networkInit();
+  oscUdpEnable(YES);
+
+  chThdCreateStatic(waSinkThd, sizeof(waSinkThd), NORMALPRIO, netbenchSink, NULL);
+  chThdCreateStatic(waSourceThd, sizeof(waSourceThd), NORMALPRIO, netbenchSource, NULL);
+  chThdCreateStatic(waEchoThd, sizeof(waEchoThd), NORMALPRIO, netbenchEcho, NULL);
+  chThdCreateStatic(waFloodThd, sizeof(waFloodThd), NORMALPRIO, netbenchFlood, NULL);
+}
+
+void loop()
+{
+  ledSetValue(ON);
+  sleep(10);
+  ledSetValue(OFF);
+  sleep(990);
+}
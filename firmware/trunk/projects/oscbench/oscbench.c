@@ -0,0 +1,344 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  OSC dispatch benchmark.
+
+  Builds a made up OSC namespace of a given depth and width, feeds packets to it
+  through oscReceivePacket() just as if they'd come in over USB or UDP, and times
+  each one on a free-running timer counter.  The results go out over USB as plain
+  text - open the board's serial port in a terminal, and press return to run every
+  shape in the sweep, or type a depth and width (like "4 16") to run just that one.
+
+  The namespace hangs off /bench.  Each level has "width" nodes named n0, n1 and so
+  on - the last one has the next level below it, and the rest are empty.  The
+  deepest level is all handlers.  So /bench/n3/n3/n3 is the one address that
+  reaches a handler in a 3 deep, 4 wide namespace, and getting there means looking
+  at every node along the way.  For each shape it times:
+  - exact:   that address, with an int
+  - pattern: the same with a * at every level, so every empty node gets searched too
+  - miss:    an address that's only wrong at the last level
+  - bundle:  OSCBENCH_BUNDLE exact messages in a bundle, timed per message
+
+  Replies are dropped (the packets come in on no channel) and the handlers just count
+  calls, so what's left is the cost of parsing and dispatching.  The timer runs at half
+  the processor clock, so everything's reported in processor cycles.  Interrupts still
+  happen while it runs, so the minimum is the number to watch between builds - the
+  average and maximum show what the rest of the system adds.
+*/
+
+#include "core.h"
+#include "osc.h"
+#include <stdio.h>
+
+#ifndef OSCBENCH_MESSAGES
+#define OSCBENCH_MESSAGES 1000
+#endif
+
+#ifndef OSCBENCH_BUNDLE
+#define OSCBENCH_BUNDLE 4
+#endif
+
+#ifndef OSCBENCH_MAX_WIDTH
+#define OSCBENCH_MAX_WIDTH 32
+#endif
+
+#ifndef OSCBENCH_MAX_DEPTH
+#define OSCBENCH_MAX_DEPTH 8
+#endif
+
+#ifndef OSCBENCH_ARENA
+#define OSCBENCH_ARENA 8192 // bytes for the namespace's nodes
+#endif
+
+#ifndef OSCBENCH_TIMER
+#define OSCBENCH_TIMER 1 // 0 is used by the Timer and 2 by the FastTimer
+#endif
+
+#define OSCBENCH_PACKET_MAX 512
+
+#if OSCBENCH_TIMER == 0
+#define OSCBENCH_TC AT91C_BASE_TC0
+#define OSCBENCH_TC_ID AT91C_ID_TC0
+#elif OSCBENCH_TIMER == 1
+#define OSCBENCH_TC AT91C_BASE_TC1
+#define OSCBENCH_TC_ID AT91C_ID_TC1
+#else
+#define OSCBENCH_TC AT91C_BASE_TC2
+#define OSCBENCH_TC_ID AT91C_ID_TC2
+#endif
+
+static const uint8_t oscbenchDepths[] = { 1, 2, 4, 8 };
+static const uint8_t oscbenchWidths[] = { 1, 4, 16, 32 };
+
+typedef struct OscBenchResult_t {
+  uint32_t total;
+  uint32_t min;
+  uint32_t max;
+  uint32_t calls;
+} OscBenchResult;
+
+typedef struct OscBench_t {
+  volatile uint32_t calls;
+  uint32_t overhead;    // timer ticks for just reading the timer twice
+  uint8_t* arenaEnd;
+  char names[OSCBENCH_MAX_WIDTH][4];
+  char packet[OSCBENCH_PACKET_MAX];
+  char work[OSCBENCH_PACKET_MAX];
+  char line[80];
+} OscBench;
+
+static OscBench bench;
+static uint32_t benchArena[OSCBENCH_ARENA / 4];
+
+// the namespace is built at runtime, so /bench lives at the start of the arena
+const OscNode oscRoot = {
+  .children = {
+    (const OscNode*)benchArena,
+    0
+  }
+};
+
+static void oscbenchHandler(OscChannel ch, char* address, int idx, OscData d[], int datalen)
+{
+  UNUSED(ch); UNUSED(address); UNUSED(idx); UNUSED(d); UNUSED(datalen);
+  bench.calls++;
+}
+
+static void oscbenchPrint(const char* line)
+{
+  usbserialWrite(line, strlen(line));
+}
+
+/*
+  The namespace
+*/
+
+static OscNode* oscbenchNewNode(const char* name, int children)
+{
+  int size = sizeof(OscNode) + (children + 1) * sizeof(OscNode*);
+  OscNode* node = (OscNode*)bench.arenaEnd;
+  if (bench.arenaEnd + size > (uint8_t*)benchArena + sizeof(benchArena))
+    return 0;
+  bench.arenaEnd += (size + 3) & ~3;
+  memset(node, 0, size);
+  node->name = name;
+  return node;
+}
+
+static bool oscbenchBuild(int depth, int width)
+{
+  int level, i;
+  bench.arenaEnd = (uint8_t*)benchArena;
+  OscNode* parent = oscbenchNewNode("bench", width);
+  if (parent == 0)
+    return false;
+  for (level = 1; level <= depth; level++) {
+    OscNode* next = 0;
+    for (i = 0; i < width; i++) {
+      bool spine = (level < depth && i == width - 1);
+      OscNode* node = oscbenchNewNode(bench.names[i], spine ? width : 0);
+      if (node == 0)
+        return false;
+      if (level == depth)
+        node->handler = oscbenchHandler;
+      parent->children[i] = node;
+      if (spine)
+        next = node;
+    }
+    parent = next;
+  }
+  return true;
+}
+
+/*
+  The packets
+*/
+
+static char* oscbenchString(char* buf, const char* s)
+{
+  int len = strlen(s);
+  memcpy(buf, s, len);
+  do {
+    buf[len++] = 0;
+  } while (len & 3);
+  return buf + len;
+}
+
+static char* oscbenchInt(char* buf, int value)
+{
+  *buf++ = value >> 24;
+  *buf++ = value >> 16;
+  *buf++ = value >> 8;
+  *buf++ = value;
+  return buf;
+}
+
+// /bench/<last>/<last>.../<end> with an int
+static int oscbenchMessage(char* buf, int depth, const char* last, const char* end)
+{
+  char address[8 + (OSCBENCH_MAX_DEPTH * 5)];
+  int level, len = siprintf(address, "/bench");
+  for (level = 1; level < depth; level++)
+    len += siprintf(address + len, "/%s", last);
+  siprintf(address + len, "/%s", end);
+  char* p = oscbenchString(buf, address);
+  p = oscbenchString(p, ",i");
+  p = oscbenchInt(p, 1);
+  return p - buf;
+}
+
+static int oscbenchBundle(char* buf, int depth, const char* last)
+{
+  int i;
+  char* p = oscbenchString(buf, "#bundle");
+  p = oscbenchInt(p, 0); // timetag
+  p = oscbenchInt(p, 1);
+  for (i = 0; i < OSCBENCH_BUNDLE; i++) {
+    int len = oscbenchMessage(p + 4, depth, last, last);
+    p = oscbenchInt(p, len) + len;
+  }
+  return p - buf;
+}
+
+/*
+  The timing
+*/
+
+static void oscbenchTimerInit()
+{
+  AT91C_BASE_PMC->PMC_PCER = 1 << OSCBENCH_TC_ID;
+  OSCBENCH_TC->TC_IDR = 0xFF;
+  OSCBENCH_TC->TC_CMR = AT91C_TC_CLKS_TIMER_DIV1_CLOCK; // MCK/2, and just count
+  OSCBENCH_TC->TC_CCR = AT91C_TC_CLKEN | AT91C_TC_SWTRG;
+
+  int i;
+  bench.overhead = 0xFFFF;
+  for (i = 0; i < 16; i++) {
+    uint16_t start = OSCBENCH_TC->TC_CV;
+    uint16_t ticks = OSCBENCH_TC->TC_CV - start;
+    bench.overhead = MIN(bench.overhead, ticks);
+  }
+}
+
+/*
+  The counter is only 16 bits, so anything longer than about 2.7 ms gets lost -
+  nothing here should come close.
+*/
+static void oscbenchRun(OscBenchResult* r, int len, int messages)
+{
+  int i;
+  r->total = r->max = 0;
+  r->min = 0xFFFFFFFF;
+  bench.calls = 0;
+  for (i = 0; i < OSCBENCH_MESSAGES; i += messages) {
+    memcpy(bench.work, bench.packet, len); // it gets taken apart as it's parsed
+    uint16_t start = OSCBENCH_TC->TC_CV;
+    oscReceivePacket(NONE, bench.work, len);
+    uint16_t ticks = OSCBENCH_TC->TC_CV - start;
+    uint32_t cycles = (ticks > bench.overhead) ? (ticks - bench.overhead) * 2 : 0; // the counter runs at MCK/2
+    r->total += cycles;
+    r->min = MIN(r->min, cycles);
+    r->max = MAX(r->max, cycles);
+  }
+  r->calls = bench.calls;
+  // per message
+  int runs = (OSCBENCH_MESSAGES + messages - 1) / messages;
+  r->total /= (runs * messages);
+  r->min /= messages;
+  r->max /= messages;
+}
+
+static void oscbenchReport(int depth, int width, const char* name, OscBenchResult* r)
+{
+  sniprintf(bench.line, sizeof(bench.line), "%d %d %-7s %6lu %6lu %6lu %5lu %6lu\r\n",
+    depth, width, name, r->min, r->total, r->max, r->total / (MCK / 1000000), r->calls);
+  oscbenchPrint(bench.line);
+}
+
+static void oscbenchShape(int depth, int width)
+{
+  OscBenchResult r;
+  const char* last;
+  if (depth < 1 || depth > OSCBENCH_MAX_DEPTH || width < 1 || width > OSCBENCH_MAX_WIDTH) {
+    sniprintf(bench.line, sizeof(bench.line), "# depth goes up to %d, and width to %d\r\n",
+      OSCBENCH_MAX_DEPTH, OSCBENCH_MAX_WIDTH);
+    oscbenchPrint(bench.line);
+    return;
+  }
+  if (!oscbenchBuild(depth, width)) {
+    sniprintf(bench.line, sizeof(bench.line), "# %d deep by %d wide doesn't fit in OSCBENCH_ARENA\r\n", depth, width);
+    oscbenchPrint(bench.line);
+    return;
+  }
+
+  last = bench.names[width - 1];
+  oscbenchRun(&r, oscbenchMessage(bench.packet, depth, last, last), 1);
+  oscbenchReport(depth, width, "exact", &r);
+  oscbenchRun(&r, oscbenchMessage(bench.packet, depth, "*", "*"), 1);
+  oscbenchReport(depth, width, "pattern", &r);
+  oscbenchRun(&r, oscbenchMessage(bench.packet, depth, last, "none"), 1);
+  oscbenchReport(depth, width, "miss", &r);
+  oscbenchRun(&r, oscbenchBundle(bench.packet, depth, last), OSCBENCH_BUNDLE);
+  oscbenchReport(depth, width, "bundle", &r);
+}
+
+static void oscbenchSweep(int depth, int width)
+{
+  unsigned int d, w;
+  oscbenchPrint("# depth width case min avg max avg-us calls (cycles per message)\r\n");
+  if (depth > 0) {
+    oscbenchShape(depth, width);
+    return;
+  }
+  for (d = 0; d < sizeof(oscbenchDepths); d++) {
+    for (w = 0; w < sizeof(oscbenchWidths); w++)
+      oscbenchShape(oscbenchDepths[d], oscbenchWidths[w]);
+  }
+}
+
+void setup()
+{
+  int i;
+  for (i = 0; i < OSCBENCH_MAX_WIDTH; i++)
+    siprintf(bench.names[i], "n%d", i);
+  oscbenchTimerInit();
+  usbserialInit();
+}
+
+void loop()
+{
+  int len = 0, depth = 0, width = 0;
+  char c;
+  while (!usbserialIsActive())
+    sleep(100);
+
+  // wait for a line - empty for the whole sweep, or "depth width"
+  while ((c = usbserialGet()) != '\r' && c != '\n') {
+    if (c != 0 && len < (int)sizeof(bench.line) - 1)
+      bench.line[len++] = c;
+    else if (c == 0)
+      sleep(100); // not connected any more
+  }
+  bench.line[len] = 0;
+  if (len > 0)
+    siscanf(bench.line, "%d %d", &depth, &width);
+
+  ledSetValue(ON);
+  oscbenchSweep(depth, width);
+  ledSetValue(OFF);
+}
@@ -0,0 +1,268 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side check of the AES library against the NIST test vectors, and a
+  benchmark of per-packet encryption with aesEncrypt() versus a reused AesContext.
+
+  The vectors are from FIPS-197 appendix C (single blocks) and NIST SP 800-38A
+  appendix F (CBC and CTR).  Each CBC and CTR vector is also run split at every
+  byte offset (every block offset for CBC) to check that the context picks up
+  where it left off.
+
+  Build and run from this directory:
+    cc -O2 -I../../libraries/aes -o aestest aestest.c ../../libraries/aes/aes.c
+    ./aestest
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "aes.h"
+
+static int failures;
+
+static void unhex(const char* hex, unsigned char* out)
+{
+  while (*hex) {
+    sscanf(hex, "%2hhx", out++);
+    hex += 2;
+  }
+}
+
+static void check(const char* name, const unsigned char* got, const unsigned char* expected, int len)
+{
+  if (memcmp(got, expected, len) != 0) {
+    printf("FAIL %s\n", name);
+    failures++;
+  }
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char* sp800Plain =
+  "6bc1bee22e409f96e93d7e117393172a" "ae2d8a571e03ac9c9eb76fac45af8e51"
+  "30c81c46a35ce411e5fbc1191a0a52ef" "f69f2445df4f9b17ad2b417be66c3710";
+
+typedef struct {
+  const char* name;
+  int keybits;
+  const char* key;
+  const char* iv;
+  const char* cipher;
+} ModeVector;
+
+static const ModeVector cbcVectors[] = {
+  { "F.2.1 CBC-AES128", 128, "2b7e151628aed2a6abf7158809cf4f3c", "000102030405060708090a0b0c0d0e0f",
+    "7649abac8119b246cee98e9b12e9197d" "5086cb9b507219ee95db113a917678b2"
+    "73bed6b8e3c1743b7116e69e22229516" "3ff1caa1681fac09120eca307586e1a7" },
+  { "F.2.3 CBC-AES192", 192, "8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b", "000102030405060708090a0b0c0d0e0f",
+    "4f021db243bc633d7178183a9fa071e8" "b4d9ada9ad7dedf4e5e738763f69145a"
+    "571b242012fb7ae07fa9baac3df102e0" "08b0e27988598881d920a9e64f5615cd" },
+  { "F.2.5 CBC-AES256", 256, "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4", "000102030405060708090a0b0c0d0e0f",
+    "f58c4c04d6e5f1ba779eabfb5f7bfbd6" "9cfc4e967edb808d679f777bc6702c7d"
+    "39f23369a9d9bacfa530e26304231461" "b2eb05e2c39be9fcda6c19078c6a9d1b" },
+};
+
+static const ModeVector ctrVectors[] = {
+  { "F.5.1 CTR-AES128", 128, "2b7e151628aed2a6abf7158809cf4f3c", "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+    "874d6191b620e3261bef6864990db6ce" "9806f66b7970fdff8617187bb9fffdff"
+    "5ae4df3edbd5d35e5b4f09020db03eab" "1e031dda2fbe03d1792170a0f3009cee" },
+  { "F.5.3 CTR-AES192", 192, "8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b", "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+    "1abc932417521ca24f2b0459fe7e6e0b" "090339ec0aa6faefd5ccc2c6f4ce8e94"
+    "1e36b26bd1ebc670d1bd1d665620abf7" "4f78a7f6d29809585a97daec58c6b050" },
+  { "F.5.5 CTR-AES256", 256, "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4", "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+    "601ec313775789a5b7a7f504bbf3d228" "f443e3ca4d62b59aca84e990cacaf5c5"
+    "2b0930daa23de94ce87017ba2d84988d" "dfc9c58db67aada613c2dd08457941a6" },
+};
+
+#define NVECTORS(v) (int)(sizeof(v) / sizeof(v[0]))
+
+static void testBlocks(void)
+{
+  static const struct { const char* name; int keybits; const char* key; const char* cipher; } v[] = {
+    { "C.1 AES-128", 128, "000102030405060708090a0b0c0d0e0f", "69c4e0d86a7b0430d8cdb78070b4c55a" },
+    { "C.2 AES-192", 192, "000102030405060708090a0b0c0d0e0f1011121314151617", "dda97ca4864cdfe06eaf70a0ec0d7191" },
+    { "C.3 AES-256", 256, "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", "8ea2b7ca516745bfeafc49904b496089" },
+  };
+  unsigned char key[32], plain[16], cipher[16], buf[16];
+  AesContext enc, dec;
+  int i;
+  unhex("00112233445566778899aabbccddeeff", plain);
+  for (i = 0; i < NVECTORS(v); i++) {
+    unhex(v[i].key, key);
+    unhex(v[i].cipher, cipher);
+    aesInit(&enc, key, v[i].keybits, AES_ENCRYPT);
+    aesInit(&dec, key, v[i].keybits, AES_DECRYPT);
+    aesEncryptBlock(&enc, plain, buf);
+    check(v[i].name, buf, cipher, 16);
+    aesDecryptBlock(&dec, buf, buf); // in place
+    check(v[i].name, buf, plain, 16);
+  }
+}
+
+static void testCbc(void)
+{
+  unsigned char key[32], iv[16], plain[64], cipher[64], buf[64];
+  AesContext enc, dec;
+  int i, split;
+  unhex(sp800Plain, plain);
+  for (i = 0; i < NVECTORS(cbcVectors); i++) {
+    const ModeVector* v = &cbcVectors[i];
+    unhex(v->key, key);
+    unhex(v->iv, iv);
+    unhex(v->cipher, cipher);
+    aesInit(&enc, key, v->keybits, AES_ENCRYPT);
+    aesInit(&dec, key, v->keybits, AES_DECRYPT);
+    for (split = 0; split <= 64; split += 16) {
+      memcpy(buf, plain, 64);
+      aesSetIV(&enc, iv);
+      aesCbcEncrypt(&enc, buf, split);
+      aesCbcEncrypt(&enc, buf + split, 64 - split);
+      check(v->name, buf, cipher, 64);
+      aesSetIV(&dec, iv);
+      aesCbcDecrypt(&dec, buf, split);
+      aesCbcDecrypt(&dec, buf + split, 64 - split);
+      check(v->name, buf, plain, 64);
+    }
+    if (aesCbcEncrypt(&enc, buf, 15) != -1 || aesCbcDecrypt(&enc, buf, 16) != -1) {
+      printf("FAIL %s bad arguments accepted\n", v->name);
+      failures++;
+    }
+  }
+}
+
+static void testCtr(void)
+{
+  unsigned char key[32], iv[16], plain[64], cipher[64], buf[64];
+  AesContext ctx;
+  int i, a, b;
+  unhex(sp800Plain, plain);
+  for (i = 0; i < NVECTORS(ctrVectors); i++) {
+    const ModeVector* v = &ctrVectors[i];
+    unhex(v->key, key);
+    unhex(v->iv, iv);
+    unhex(v->cipher, cipher);
+    aesInit(&ctx, key, v->keybits, AES_ENCRYPT);
+    for (a = 0; a <= 64; a++) {
+      for (b = a; b <= 64; b++) { // three pieces: [0,a) [a,b) [b,64)
+        memcpy(buf, plain, 64);
+        aesSetIV(&ctx, iv);
+        aesCtr(&ctx, buf, a);
+        aesCtr(&ctx, buf + a, b - a);
+        aesCtr(&ctx, buf + b, 64 - b);
+        check(v->name, buf, cipher, 64);
+      }
+    }
+    aesSetIV(&ctx, iv);
+    aesCtr(&ctx, buf, 64);
+    check(v->name, buf, plain, 64);
+  }
+
+  // the counter carries across all 16 bytes
+  unsigned char wrap[16], next[16], ks[32];
+  memset(wrap, 0xff, 16);
+  memset(next, 0, 16);
+  aesInit(&ctx, key, 128, AES_ENCRYPT);
+  aesSetIV(&ctx, wrap);
+  memset(ks, 0, 32);
+  aesCtr(&ctx, ks, 32);
+  aesEncryptBlock(&ctx, next, buf);
+  check("CTR counter wrap", ks + 16, buf, 16);
+}
+
+static void testLegacy(void)
+{
+  unsigned char plaintext[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  unsigned char secret[] = "A SECRET PASSWORD";
+  unsigned char cipherbuf[64], plainbuf[64];
+  int written = aesEncrypt(cipherbuf, sizeof(cipherbuf), plaintext, 26, secret);
+  written = aesDecrypt(plainbuf, sizeof(plainbuf), cipherbuf, written, secret);
+  if (written != 26 || memcmp(plainbuf, plaintext, 26) != 0) {
+    printf("FAIL aesEncrypt/aesDecrypt round trip\n");
+    failures++;
+  }
+}
+
+#define PACKET_SIZE 64
+#define BENCH_PACKETS 200000
+
+static void bench(void)
+{
+  unsigned char secret[] = "A SECRET PASSWORD";
+  unsigned char iv[16] = { 0 };
+  unsigned char packet[PACKET_SIZE], out[PACKET_SIZE + 16];
+  AesContext ctx;
+  volatile unsigned char sink = 0;
+  double start, t;
+  int i;
+  memset(packet, 0x5a, sizeof(packet));
+
+  printf("\n%d byte packets, %d of them:\n", PACKET_SIZE, BENCH_PACKETS);
+  start = now();
+  for (i = 0; i < BENCH_PACKETS; i++) {
+    aesEncrypt(out, sizeof(out), packet, PACKET_SIZE - 1, secret); // ECB with padding, key schedule every call
+    sink ^= out[0];
+  }
+  t = now() - start;
+  printf("  aesEncrypt     %8.0f packets/s  %6.1f MB/s\n", BENCH_PACKETS / t, BENCH_PACKETS * (double)PACKET_SIZE / t / 1e6);
+
+  start = now();
+  for (i = 0; i < BENCH_PACKETS; i++) {
+    aesInit(&ctx, secret, 128, AES_ENCRYPT); // what it costs to set the key every time
+    sink ^= ctx.rk[0];
+  }
+  t = now() - start;
+  printf("  aesInit        %8.0f keys/s\n", BENCH_PACKETS / t);
+
+  aesInit(&ctx, secret, 128, AES_ENCRYPT);
+  start = now();
+  for (i = 0; i < BENCH_PACKETS; i++) {
+    iv[15] = (unsigned char)i;
+    aesSetIV(&ctx, iv);
+    aesCbcEncrypt(&ctx, packet, PACKET_SIZE);
+  }
+  t = now() - start;
+  printf("  aesCbcEncrypt  %8.0f packets/s  %6.1f MB/s\n", BENCH_PACKETS / t, BENCH_PACKETS * (double)PACKET_SIZE / t / 1e6);
+
+  start = now();
+  for (i = 0; i < BENCH_PACKETS; i++) {
+    iv[15] = (unsigned char)i;
+    aesSetIV(&ctx, iv);
+    aesCtr(&ctx, packet, PACKET_SIZE);
+  }
+  t = now() - start;
+  printf("  aesCtr         %8.0f packets/s  %6.1f MB/s\n", BENCH_PACKETS / t, BENCH_PACKETS * (double)PACKET_SIZE / t / 1e6);
+  sink ^= packet[0];
+}
+
+int main(void)
+{
+  testBlocks();
+  testCbc();
+  testCtr();
+  testLegacy();
+  printf("%s\n", failures ? "FAILED" : "all vectors pass");
+  if (!failures)
+    bench();
+  return failures ? 1 : 0;
+}
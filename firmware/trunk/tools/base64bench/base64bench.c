@@ -0,0 +1,249 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side check and benchmark of the base 64 library: base64Encode() and
+  base64Decode() versus the streaming Base64Encoder and Base64Decoder, and all of
+  them versus the code as it was before, kept in base64old.c.
+
+  First checks that the new versions agree with the old ones, and the streaming versions
+  with the whole-buffer ones, for every length up to a few hundred bytes fed in random
+  sized chunks, and that they reject bad input.  Then times each over a 4 kB buffer,
+  taking the best of several tries.  Results are in bytes per cycle where the host has a
+  cycle counter (x86), and bytes per nanosecond otherwise, along with how many times
+  faster each is than the old code.
+  The ARM7 on the board has no cache or branch predictor to speak of, so expect the
+  ratios to carry over better than the absolute numbers.
+
+  Build and run from this directory:
+    cc -O2 -I../../core/makingthings -I../../libraries/base64 -o base64bench base64bench.c base64old.c ../../libraries/base64/base64.c
+    ./base64bench
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "base64.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define UNIT "byte/cycle"
+static double ticks(void) { return (double)__rdtsc(); }
+#else
+#define UNIT "byte/ns"
+static double ticks(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+#endif
+
+// the code as it was, from base64old.c
+bool base64DecodeOld(char* dest, int* dest_size, const char* src, int src_size);
+int  base64EncodeOld(char* dest, int dest_size, const char* src, int src_size);
+
+#define MAX_CHECK 300
+#define BENCH_SIZE 4096
+#define BENCH_ROUNDS 400
+#define BENCH_TRIES 10
+
+static int failures;
+
+static void fail(const char* what, int len)
+{
+  printf("FAIL %s (length %d)\n", what, len);
+  failures++;
+}
+
+// encode src a random sized chunk at a time
+static int streamEncode(char* dest, const char* src, int len)
+{
+  Base64Encoder enc;
+  int out = 0, pos = 0;
+  base64EncoderInit(&enc);
+  while (pos < len) {
+    int n = 1 + rand() % 7;
+    if (n > len - pos)
+      n = len - pos;
+    out += base64EncoderWrite(&enc, dest + out, src + pos, n);
+    pos += n;
+  }
+  return out + base64EncoderFinish(&enc, dest + out);
+}
+
+static int streamDecode(char* dest, const char* src, int len)
+{
+  Base64Decoder dec;
+  int out = 0, pos = 0, n;
+  base64DecoderInit(&dec);
+  while (pos < len) {
+    int chunk = 1 + rand() % 9;
+    if (chunk > len - pos)
+      chunk = len - pos;
+    if ((n = base64DecoderWrite(&dec, dest + out, src + pos, chunk)) < 0)
+      return -1;
+    out += n;
+    pos += chunk;
+  }
+  if ((n = base64DecoderFinish(&dec, dest + out)) < 0)
+    return -1;
+  return out + n;
+}
+
+static void check(void)
+{
+  static char data[MAX_CHECK], whole[BASE64_ENCODED_SIZE(MAX_CHECK) + 1], streamed[BASE64_ENCODED_SIZE(MAX_CHECK)];
+  static char spaced[2 * BASE64_ENCODED_SIZE(MAX_CHECK)], decoded[MAX_CHECK + 3];
+  static char old[BASE64_ENCODED_SIZE(MAX_CHECK) + 1];
+  int len, i;
+  for (len = 0; len < MAX_CHECK; len++) {
+    for (i = 0; i < len; i++)
+      data[i] = rand();
+    int wlen = base64Encode(whole, sizeof(whole), data, len);
+    int slen = streamEncode(streamed, data, len);
+    if (wlen != slen || memcmp(whole, streamed, wlen))
+      fail("encoder differs from base64Encode", len);
+    int olen = base64EncodeOld(old, sizeof(old), data, len);
+    if (wlen != olen || memcmp(whole, old, wlen))
+      fail("base64Encode differs from the old code", len);
+
+    int dlen = sizeof(decoded);
+    if (!base64Decode(decoded, &dlen, whole, wlen) || dlen != len || memcmp(decoded, data, len))
+      fail("base64Decode round trip", len);
+    dlen = sizeof(decoded);
+    if (!base64DecodeOld(decoded, &dlen, whole, wlen) || dlen != len || memcmp(decoded, data, len))
+      fail("old base64Decode round trip", len);
+    if (streamDecode(decoded, whole, wlen) != len || memcmp(decoded, data, len))
+      fail("decoder round trip", len);
+
+    // line breaks every so often, like a MIME body
+    int plen = 0;
+    for (i = 0; i < wlen; i++) {
+      spaced[plen++] = whole[i];
+      if (i % 19 == 18)
+        spaced[plen++] = (i & 1) ? '\n' : ' ';
+    }
+    if (streamDecode(decoded, spaced, plen) != len || memcmp(decoded, data, len))
+      fail("decoder with whitespace", len);
+
+    // and with the padding left off
+    while (wlen && whole[wlen - 1] == '=')
+      wlen--;
+    if (streamDecode(decoded, whole, wlen) != len || memcmp(decoded, data, len))
+      fail("decoder without padding", len);
+  }
+
+  static const char* bad[] = { "A", "A===", "AB=C", "ABC=D", "ABCD=", "AB===", "AB==C", "AB*D", "AB\x80" "D" };
+  for (i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+    if (streamDecode(decoded, bad[i], strlen(bad[i])) >= 0)
+      fail(bad[i], strlen(bad[i]));
+  }
+}
+
+// prints the rate, and how it compares to the old code's if there is one
+static double report(const char* name, int bytes, double elapsed, double old)
+{
+  double rate = bytes * (double)BENCH_ROUNDS / elapsed;
+  if (old > 0)
+    printf("  %-22s %6.3f " UNIT "  %5.2fx\n", name, rate, rate / old);
+  else
+    printf("  %-22s %6.3f " UNIT "\n", name, rate);
+  return rate;
+}
+
+// time BENCH_ROUNDS runs of the code, BENCH_TRIES times over, keeping the quickest - the host
+// has other things going on, and one slow try would swamp the difference being measured
+#define BENCH(elapsed, ...)                             \
+  do {                                                  \
+    int try_, round_;                                   \
+    for (try_ = 0; try_ < BENCH_TRIES; try_++) {        \
+      double start_ = ticks();                          \
+      for (round_ = 0; round_ < BENCH_ROUNDS; round_++) \
+        { __VA_ARGS__; }                                \
+      double took_ = ticks() - start_;                  \
+      if (try_ == 0 || took_ < elapsed)                 \
+        elapsed = took_;                                \
+    }                                                   \
+  } while (0)
+
+static void bench(void)
+{
+  static char data[BENCH_SIZE], text[BASE64_ENCODED_SIZE(BENCH_SIZE) + 1], out[BENCH_SIZE + 3];
+  volatile int sink = 0;
+  double elapsed = 0, oldEncode, oldDecode;
+  int i, tlen;
+  for (i = 0; i < BENCH_SIZE; i++)
+    data[i] = rand();
+  tlen = base64Encode(text, sizeof(text), data, BENCH_SIZE);
+
+  printf("\n%d bytes, best of %d tries of %d rounds:\n", BENCH_SIZE, BENCH_TRIES, BENCH_ROUNDS);
+  BENCH(elapsed, sink += base64EncodeOld(text, sizeof(text), data, BENCH_SIZE));
+  oldEncode = report("old base64Encode", BENCH_SIZE, elapsed, 0);
+
+  BENCH(elapsed, sink += base64Encode(text, sizeof(text), data, BENCH_SIZE));
+  report("base64Encode", BENCH_SIZE, elapsed, oldEncode);
+
+  BENCH(elapsed, {
+    Base64Encoder enc;
+    base64EncoderInit(&enc);
+    int n = base64EncoderWrite(&enc, text, data, BENCH_SIZE);
+    sink += n + base64EncoderFinish(&enc, text + n);
+  });
+  report("Base64Encoder", BENCH_SIZE, elapsed, oldEncode);
+
+  BENCH(elapsed, {
+    int dlen = sizeof(out);
+    sink += base64DecodeOld(out, &dlen, text, tlen);
+  });
+  oldDecode = report("old base64Decode", BENCH_SIZE, elapsed, 0);
+
+  BENCH(elapsed, {
+    int dlen = sizeof(out);
+    sink += base64Decode(out, &dlen, text, tlen);
+  });
+  report("base64Decode", BENCH_SIZE, elapsed, oldDecode);
+
+  BENCH(elapsed, {
+    Base64Decoder dec;
+    base64DecoderInit(&dec);
+    int n = base64DecoderWrite(&dec, out, text, tlen);
+    sink += n + base64DecoderFinish(&dec, out + n);
+  });
+  report("Base64Decoder", BENCH_SIZE, elapsed, oldDecode);
+
+  BENCH(elapsed, { // a 64 byte buffer at a time, like a socket read
+    Base64Decoder dec;
+    int pos, n = 0;
+    base64DecoderInit(&dec);
+    for (pos = 0; pos < tlen; pos += 64)
+      n += base64DecoderWrite(&dec, out + n, text + pos, (tlen - pos < 64) ? tlen - pos : 64);
+    sink += n + base64DecoderFinish(&dec, out + n);
+  });
+  report("Base64Decoder, 64 byte", BENCH_SIZE, elapsed, oldDecode);
+}
+
+int main(void)
+{
+  srand(1);
+  check();
+  printf("%s\n", failures ? "FAILED" : "all checks pass");
+  if (!failures)
+    bench();
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,5 @@
+// host build of the network code for headerbench - just turn the network on
+#ifndef CONFIG_H
+#define CONFIG_H
+#define MAKE_CTRL_NETWORK
+#endif
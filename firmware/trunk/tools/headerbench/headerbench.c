@@ -0,0 +1,140 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side benchmark of HTTP header parsing: tcpReadLine() versus TcpStream.
+
+  tcpRead() is replaced with a fake socket that hands out a canned request, so the
+  only thing measured is how the readers use it.  On the board, each tcpRead() is an
+  lwip_recvfrom() with a round trip through the tcpip thread, so the call count is
+  the number that matters - host time is shown for reference.
+
+  Build and run from this directory:
+    cc -O2 -I. -I../../core/makingthings -o headerbench headerbench.c ../../core/makingthings/tcpstream.c
+    ./headerbench
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "tcpsocket.h"
+#include "tcpstream.h"
+
+static const char request[] =
+  "GET /index.html HTTP/1.1\r\n"
+  "Host: 192.168.0.200\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:3.6) Gecko/20100101 Firefox/3.6\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Language: en-us,en;q=0.5\r\n"
+  "Accept-Encoding: gzip,deflate\r\n"
+  "Accept-Charset: ISO-8859-1,utf-8;q=0.7,*;q=0.7\r\n"
+  "Keep-Alive: 115\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n";
+
+#define SEGMENT_SIZE 536 // a typical TCP MSS - the most one read can return
+
+static int position;
+static unsigned long reads;
+
+int tcpRead(int socket, char* data, int length)
+{
+  (void)socket;
+  int remaining = (int)sizeof(request) - 1 - position;
+  if (length > remaining)
+    length = remaining;
+  if (length > SEGMENT_SIZE)
+    length = SEGMENT_SIZE;
+  memcpy(data, request + position, length);
+  position += length;
+  reads++;
+  return length;
+}
+
+int tcpAvailable(int socket)
+{
+  (void)socket;
+  return (int)sizeof(request) - 1 - position;
+}
+
+// tcpReadLine() from tcpsocket.c
+static int byteReadLine(int socket, char* data, int length)
+{
+  int readLength;
+  int lineLength = -1;
+  data--;
+
+  do {
+    data++;
+    lineLength++;
+    readLength = tcpRead(socket, data, 1);
+  } while ((readLength == 1) && (lineLength < length - 1) && (*data != '\n'));
+
+  if (readLength == 1)
+    lineLength++;
+
+  return lineLength;
+}
+
+static int parseBytewise(void)
+{
+  char line[128];
+  int len, lines = 0;
+  position = 0;
+  while ((len = byteReadLine(0, line, sizeof(line))) > 0) {
+    lines++;
+    if (strncmp(line, "\r\n", 2) == 0)
+      break;
+  }
+  return lines;
+}
+
+static int parseStream(void)
+{
+  char line[128];
+  int len, lines = 0;
+  TcpStream stream;
+  position = 0;
+  tcpStreamInit(&stream, 0);
+  while ((len = tcpStreamReadLine(&stream, line, sizeof(line))) > 0) {
+    lines++;
+    if (strncmp(line, "\r\n", 2) == 0)
+      break;
+  }
+  return lines;
+}
+
+static void run(const char* name, int (*parse)(void), int iterations)
+{
+  int i, lines = 0;
+  reads = 0;
+  clock_t start = clock();
+  for (i = 0; i < iterations; i++)
+    lines = parse();
+  double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+  printf("%-10s %3d lines  %6lu reads/request  %8.3f us/request\n",
+         name, lines, reads / iterations, ms * 1000.0 / iterations);
+}
+
+int main(void)
+{
+  int iterations = 100000;
+  printf("request: %d bytes, TCP_STREAM_BUFFER_SIZE %d\n", (int)sizeof(request) - 1, TCP_STREAM_BUFFER_SIZE);
+  run("bytewise", parseBytewise, iterations);
+  run("tcpstream", parseStream, iterations);
+  return 0;
+}
@@ -0,0 +1,624 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side tests for the JSON library.
+
+  The writer is checked byte for byte against a simple reference serializer built on
+  snprintf, over a few thousand random documents, writing each one into a buffer big
+  enough for all of it and then again through buffers of every size from 1 to 64 bytes
+  with a flush handler.  jsonwriterFloat() is checked against "%.*f" for a spread of
+  random floats at every precision.  Everything written is also read back.
+
+  The reader is run over a small conformance corpus - documents it has to accept,
+  modelled on the y_ and n_ cases of Nicolas Seriot's JSONTestSuite, plus documents it
+  has to reject.  Every handler call is logged as text.  Each document is read whole,
+  then split in two at every byte offset, then fed one byte at a time, and every run
+  has to produce exactly the same log and the same verdict.  Some of the logs are also
+  checked against what they should be.
+
+  Build and run from this directory:
+    cc -O2 -I../../core/makingthings -I../../libraries/json -o jsontest jsontest.c ../../libraries/json/json.c -lm
+    ./jsontest
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <math.h>
+#include "json.h"
+
+static int failures;
+
+/****************************************************************************
+ Reader
+****************************************************************************/
+
+typedef struct {
+  char text[4096];
+  int len;
+} Log;
+
+static void logAppend(Log* log, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(log->text + log->len, sizeof(log->text) - log->len, fmt, args);
+  va_end(args);
+  if (n > 0 && log->len + n < (int)sizeof(log->text))
+    log->len += n;
+}
+
+static void logSlice(Log* log, char kind, const char* s, int len)
+{
+  int i;
+  logAppend(log, "%c\"", kind);
+  for (i = 0; i < len; i++) {
+    unsigned char c = s[i];
+    if (c < 0x20 || c >= 0x7F || c == '"' || c == '\\')
+      logAppend(log, "\\x%02x", c);
+    else
+      logAppend(log, "%c", c);
+  }
+  logAppend(log, "\" ");
+}
+
+static bool onNull(void* ctx) { logAppend(ctx, "null "); return true; }
+static bool onBool(void* ctx, bool v) { logAppend(ctx, v ? "true " : "false "); return true; }
+static bool onInt(void* ctx, int v) { logAppend(ctx, "i%d ", v); return true; }
+static bool onFloat(void* ctx, float v) { logAppend(ctx, "f%.6g ", v); return true; }
+static bool onString(void* ctx, const char* s, int len) { logSlice(ctx, 's', s, len); return true; }
+static bool onKey(void* ctx, const char* s, int len) { logSlice(ctx, 'k', s, len); return true; }
+static bool onObjStart(void* ctx) { logAppend(ctx, "{ "); return true; }
+static bool onObjEnd(void* ctx) { logAppend(ctx, "} "); return true; }
+static bool onArrayStart(void* ctx) { logAppend(ctx, "[ "); return true; }
+static bool onArrayEnd(void* ctx) { logAppend(ctx, "] "); return true; }
+
+// read a document in pieces no bigger than chunk, after an initial piece of split bytes
+static bool readDoc(const char* doc, int len, int split, int chunk, Log* log)
+{
+  JsonReader jr;
+  int pos = 0;
+  bool ok = true;
+  log->len = 0;
+  log->text[0] = 0;
+  jsonreaderInit(&jr, log, true);
+  jr.null_handler = onNull;
+  jr.bool_handler = onBool;
+  jr.int_handler = onInt;
+  jr.float_handler = onFloat;
+  jr.string_handler = onString;
+  jr.obj_key_handler = onKey;
+  jr.start_obj_handler = onObjStart;
+  jr.end_obj_handler = onObjEnd;
+  jr.start_array_handler = onArrayStart;
+  jr.end_array_handler = onArrayEnd;
+
+  if (split > 0) {
+    // a private copy, so a reader that hangs on to pointers past the handler call gets caught
+    char* piece = malloc(split);
+    memcpy(piece, doc, split);
+    ok = jsonreaderFeed(&jr, piece, split);
+    memset(piece, '#', split);
+    free(piece);
+    pos = split;
+  }
+  while (ok && pos < len) {
+    int n = (len - pos < chunk) ? len - pos : chunk;
+    char* piece = malloc(n);
+    memcpy(piece, doc + pos, n);
+    ok = jsonreaderFeed(&jr, piece, n);
+    memset(piece, '#', n);
+    free(piece);
+    pos += n;
+  }
+  return ok && jsonreaderFinish(&jr);
+}
+
+typedef struct {
+  const char* doc;
+  int len;          // 0 for strlen(doc)
+  const char* log;  // what the handlers should see, or 0 to not check
+} Case;
+
+#define L(s) s, sizeof(s) - 1 // for documents with embedded nulls
+
+static const Case accept[] = {
+  { "[]", 0, "[ ] " },
+  { "{}", 0, "{ } " },
+  { " [ ] ", 0, "[ ] " },
+  { "\t\r\n[\n1\r,\t2 ]\n", 0, "[ i1 i2 ] " },
+  { "[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]", 0, 0 }, // JSON_MAX_DEPTH deep
+  { "{\"a\":{\"b\":{\"c\":[{}]}}}", 0, "{ k\"a\" { k\"b\" { k\"c\" [ { } ] } } } " },
+  { "[{\"label\":\"value\",\"label2\":{\"nested\":234}}]", 0,
+    "[ { k\"label\" s\"value\" k\"label2\" { k\"nested\" i234 } } ] " },
+  { "{\"a\":1,\"a\":2}", 0, "{ k\"a\" i1 k\"a\" i2 } " },
+  { "{\"\":0}", 0, "{ k\"\" i0 } " },
+  { "[true,false,null]", 0, "[ true false null ] " },
+  { "true", 0, "true " },
+  { "null", 0, "null " },
+  { " false ", 0, "false " },
+  { "\"top\"", 0, "s\"top\" " },
+  // numbers
+  { "0", 0, "i0 " },
+  { "-0", 0, "i0 " },
+  { "123", 0, "i123 " },
+  { "[-1]", 0, "[ i-1 ] " },
+  { "[2147483647,-2147483648]", 0, "[ i2147483647 i-2147483648 ] " },
+  { "[2147483648]", 0, "[ f2.14748e+09 ] " },
+  { "[4294967296]", 0, "[ f4.29497e+09 ] " },
+  { "[123456789012345678901234567890]", 0, "[ f1.23457e+29 ] " },
+  { "[1.5]", 0, "[ f1.5 ] " },
+  { "[-0.25]", 0, "[ f-0.25 ] " },
+  { "[0.0]", 0, "[ f0 ] " },
+  { "[-0.0]", 0, "[ f-0 ] " },
+  { "[1E2]", 0, "[ f100 ] " },
+  { "[1e+2]", 0, "[ f100 ] " },
+  { "[1e-2]", 0, "[ f0.01 ] " },
+  { "[1.5e3]", 0, "[ f1500 ] " },
+  { "[-1.25E-3]", 0, "[ f-0.00125 ] " },
+  { "[0e0]", 0, "[ f0 ] " },
+  { "[0.000001]", 0, "[ f1e-06 ] " },
+  { "[3.402823e38]", 0, "[ f3.40282e+38 ] " },
+  { "[1.17549435e-38]", 0, "[ f1.17549e-38 ] " },
+  { "[1e-40]", 0, "[ f9.99995e-41 ] " }, // as close as a denormal float gets
+  { "[1e39]", 0, "[ finf ] " },
+  { "[1e-400]", 0, "[ f0 ] " },
+  { "[123e-2]", 0, "[ f1.23 ] " },
+  { "[0.123456789012345678901]", 0, "[ f0.123457 ] " },
+  { "[1,2.0,3e0]", 0, "[ i1 f2 f3 ] " },
+  { "{\"n\":-12.5e1}", 0, "{ k\"n\" f-125 } " },
+  // strings
+  { "[\"\"]", 0, "[ s\"\" ] " },
+  { "[\"a b c\"]", 0, "[ s\"a b c\" ] " },
+  { "[\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"]", 0, "[ s\"\\x22\\x5c/\\x08\\x0c\\x0a\\x0d\\x09\" ] " },
+  { "[\"\\u0041\\u00e9\\u20AC\"]", 0, "[ s\"A\\xc3\\xa9\\xe2\\x82\\xac\" ] " },
+  { "[\"\\u0000\"]", 0, "[ s\"\\x00\" ] " },
+  { "[\"\\uD834\\uDD1E\"]", 0, "[ s\"\\xf0\\x9d\\x84\\x9e\" ] " },          // a surrogate pair
+  { "[\"\\uD800\"]", 0, "[ s\"\\xef\\xbf\\xbd\" ] " },                     // lone halves become U+FFFD
+  { "[\"\\uDC00x\"]", 0, "[ s\"\\xef\\xbf\\xbdx\" ] " },
+  { "[\"\\uD800\\n\"]", 0, "[ s\"\\xef\\xbf\\xbd\\x0a\" ] " },
+  { "[\"\\uD800\\uD800\\uDC00\"]", 0, "[ s\"\\xef\\xbf\\xbd\\xf0\\x90\\x80\\x80\" ] " },
+  { "[\"\xc3\xa9\xe2\x82\xac\"]", 0, "[ s\"\\xc3\\xa9\\xe2\\x82\\xac\" ] " },  // raw UTF-8 passes through
+  { "[\"\x7f\"]", 0, "[ s\"\\x7f\" ] " },
+  { "{\"k\\u0065y\":\"v\"}", 0, "{ k\"key\" s\"v\" } " },
+  { "[\"0123456789012345678901234567890123456789012345678901234567890123\"]", 0, 0 }, // exactly JSON_READER_STRING_MAX
+  { "{\"config\":{\"ip\":\"192.168.0.200\",\"dhcp\":true,\"ports\":[10000,10000],\"gain\":0.75}}", 0,
+    "{ k\"config\" { k\"ip\" s\"192.168.0.200\" k\"dhcp\" true k\"ports\" [ i10000 i10000 ] k\"gain\" f0.75 } } " },
+};
+
+static const Case reject[] = {
+  { "", 0, 0 },
+  { " ", 0, 0 },
+  { "[", 0, 0 },
+  { "]", 0, 0 },
+  { "{", 0, 0 },
+  { "[1", 0, 0 },
+  { "[1,", 0, 0 },
+  { "[1,]", 0, 0 },
+  { "[,1]", 0, 0 },
+  { "[1 2]", 0, 0 },
+  { "[1]]", 0, 0 },
+  { "[1][2]", 0, 0 },
+  { "[}", 0, 0 },
+  { "{]", 0, 0 },
+  { "{\"a\"}", 0, 0 },
+  { "{\"a\":}", 0, 0 },
+  { "{\"a\" 1}", 0, 0 },
+  { "{\"a\":1,}", 0, 0 },
+  { "{1:1}", 0, 0 },
+  { "{\"a\":1 \"b\":2}", 0, 0 },
+  { "{'a':1}", 0, 0 },
+  { "[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]", 0, 0 }, // one deeper than JSON_MAX_DEPTH
+  { "[tru]", 0, 0 },
+  { "[True]", 0, 0 },
+  { "[nul]", 0, 0 },
+  { "[falsey]", 0, 0 },
+  { "tru", 0, 0 },
+  { "nulll", 0, 0 },
+  { "1 2", 0, 0 },
+  { "[-]", 0, 0 },
+  { "-", 0, 0 },
+  { "[01]", 0, 0 },
+  { "[-01]", 0, 0 },
+  { "[+1]", 0, 0 },
+  { "[.5]", 0, 0 },
+  { "[1.]", 0, 0 },
+  { "[1.e2]", 0, 0 },
+  { "[1e]", 0, 0 },
+  { "[1e+]", 0, 0 },
+  { "[1E-]", 0, 0 },
+  { "[1.5.5]", 0, 0 },
+  { "[0x10]", 0, 0 },
+  { "[Infinity]", 0, 0 },
+  { "[NaN]", 0, 0 },
+  { "[1e2e3]", 0, 0 },
+  { "[- 1]", 0, 0 },
+  { "\"abc", 0, 0 },
+  { "[\"abc]", 0, 0 },
+  { "[\"\\x\"]", 0, 0 },
+  { "[\"\\u12\"]", 0, 0 },
+  { "[\"\\u12G4\"]", 0, 0 },
+  { "[\"\\\"]", 0, 0 },
+  { "[\"a\tb\"]", 0, 0 },  // raw control characters
+  { "[\"a\nb\"]", 0, 0 },
+  { L("[\"a\0b\"]"), 0 },
+  { "['single']", 0, 0 },
+  { "[\"01234567890123456789012345678901234567890123456789012345678901234\\n\"]", 0, 0 }, // escaped, too long for the buffer
+  { "[1]x", 0, 0 },
+  { "[1]\"\"", 0, 0 },
+  { L("[1]\0"), 0 },
+  { "{\"a\":1}}", 0, 0 },
+  { "[/* comment */]", 0, 0 },
+};
+
+#define NCASES(c) (int)(sizeof(c) / sizeof(c[0]))
+
+static void testReader(void)
+{
+  static Log whole, piece;
+  int i, split, runs = 0;
+  for (i = 0; i < NCASES(accept) + NCASES(reject); i++) {
+    bool shouldAccept = i < NCASES(accept);
+    const Case* c = shouldAccept ? &accept[i] : &reject[i - NCASES(accept)];
+    int len = c->len ? c->len : (int)strlen(c->doc);
+
+    bool ok = readDoc(c->doc, len, 0, len ? len : 1, &whole);
+    if (ok != shouldAccept) {
+      printf("FAIL %s %s\n", shouldAccept ? "rejected" : "accepted", c->doc);
+      failures++;
+      continue;
+    }
+    if (c->log && strcmp(whole.text, c->log)) {
+      printf("FAIL %s\n  got      %s\n  expected %s\n", c->doc, whole.text, c->log);
+      failures++;
+      continue;
+    }
+    // every split point, and one byte at a time
+    for (split = 0; split <= len + 1; split++) {
+      bool bytewise = (split == len + 1);
+      ok = bytewise ? readDoc(c->doc, len, 0, 1, &piece) : readDoc(c->doc, len, split, len ? len : 1, &piece);
+      runs++;
+      if (ok != shouldAccept || (ok && strcmp(piece.text, whole.text))) {
+        printf("FAIL %s split %s\n  got      %s\n  expected %s\n", c->doc, bytewise ? "bytewise" : "", piece.text, whole.text);
+        if (!bytewise)
+          printf("  at %d\n", split);
+        failures++;
+        break;
+      }
+    }
+  }
+  printf("reader: %d documents, %d runs\n", NCASES(accept) + NCASES(reject), runs);
+}
+
+// a handler returning false stops the reader, and it stays stopped
+static bool stopAtTwo(void* ctx, int v) { (void)ctx; return v != 2; }
+
+static void testAbort(void)
+{
+  JsonReader jr;
+  jsonreaderInit(&jr, 0, true);
+  jr.int_handler = stopAtTwo;
+  if (jsonreaderFeed(&jr, "[1,2,", 5) || jsonreaderFeed(&jr, "3]", 2) || jsonreaderFinish(&jr)) {
+    printf("FAIL handler abort\n");
+    failures++;
+  }
+  // and can be reused after jsonreaderInit()
+  jsonreaderInit(&jr, 0, false);
+  if (!jsonreaderGo(&jr, "[1]", 3)) {
+    printf("FAIL reuse after jsonreaderInit\n");
+    failures++;
+  }
+}
+
+// an unescaped string that arrives in one piece is handed over without copying
+static const char* zeroCopyDoc = "{\"key\":\"some value\"}";
+static bool zeroCopyPointed;
+static bool onZeroCopyString(void* ctx, const char* s, int len)
+{
+  (void)ctx;
+  zeroCopyPointed = (s == zeroCopyDoc + 8 && len == 10);
+  return true;
+}
+
+static void testZeroCopy(void)
+{
+  JsonReader jr;
+  jsonreaderInit(&jr, 0, true);
+  jr.string_handler = onZeroCopyString;
+  if (!jsonreaderGo(&jr, zeroCopyDoc, strlen(zeroCopyDoc)) || !zeroCopyPointed) {
+    printf("FAIL string not passed in place\n");
+    failures++;
+  }
+}
+
+/****************************************************************************
+ Writer
+****************************************************************************/
+
+// a random document, as a tree
+typedef enum { V_NULL, V_BOOL, V_INT, V_FLOAT, V_STRING, V_ARRAY, V_OBJECT } ValueType;
+
+typedef struct Value {
+  ValueType type;
+  int i;
+  float f;
+  int decimals;
+  char s[24];
+  int count;
+  struct Value* children[6];
+  char keys[6][12];
+} Value;
+
+static float randomFloat(void)
+{
+  switch (rand() % 4) {
+    case 0: return (rand() % 20001 - 10000) / 100.0f; // sensor-ish values
+    case 1: return (float)rand() / RAND_MAX;
+    case 2: { uint32_t bits = ((uint32_t)rand() << 16) ^ rand(); float f; memcpy(&f, &bits, 4); return f; } // anything at all
+    default: return (rand() % 2001 - 1000) / 8.0f; // exact binary fractions, to hit the rounding ties
+  }
+}
+
+static void randomString(char* s, int max)
+{
+  static const char chars[] = "abcXYZ019 _-/.\\\"\t\n\x01\x1f\x7f\xc3\xa9";
+  int len = rand() % max, i;
+  for (i = 0; i < len; i++)
+    s[i] = chars[rand() % (sizeof(chars) - 1)];
+  s[len] = 0;
+}
+
+static Value* randomValue(int depth)
+{
+  Value* v = calloc(1, sizeof(Value));
+  int i;
+  v->type = (depth < 4) ? rand() % 7 : rand() % 5;
+  switch (v->type) {
+    case V_BOOL: v->i = rand() & 1; break;
+    case V_INT: v->i = (rand() % 3 == 0) ? (int)(((uint32_t)rand() << 16) ^ rand()) : rand() % 2000 - 1000; break;
+    case V_FLOAT: v->f = randomFloat(); v->decimals = rand() % (JSON_MAX_DECIMALS + 1); break;
+    case V_STRING: randomString(v->s, sizeof(v->s)); break;
+    case V_ARRAY:
+    case V_OBJECT:
+      v->count = rand() % 7;
+      for (i = 0; i < v->count; i++) {
+        v->children[i] = randomValue(depth + 1);
+        randomString(v->keys[i], sizeof(v->keys[i]));
+      }
+      break;
+    default: break;
+  }
+  return v;
+}
+
+static void freeValue(Value* v)
+{
+  int i;
+  for (i = 0; i < v->count; i++)
+    freeValue(v->children[i]);
+  free(v);
+}
+
+// the reference serializer
+static void refString(Log* out, const char* s)
+{
+  logAppend(out, "\"");
+  for (; *s; s++) {
+    unsigned char c = *s;
+    switch (c) {
+      case '"': logAppend(out, "\\\""); break;
+      case '\\': logAppend(out, "\\\\"); break;
+      case '\b': logAppend(out, "\\b"); break;
+      case '\f': logAppend(out, "\\f"); break;
+      case '\n': logAppend(out, "\\n"); break;
+      case '\r': logAppend(out, "\\r"); break;
+      case '\t': logAppend(out, "\\t"); break;
+      default:
+        if (c < 0x20)
+          logAppend(out, "\\u%04x", c);
+        else
+          logAppend(out, "%c", c);
+    }
+  }
+  logAppend(out, "\"");
+}
+
+static void refFloat(Log* out, float f, int decimals)
+{
+  if (isinf(f) || isnan(f))
+    logAppend(out, "null");
+  else
+    logAppend(out, "%.*f", decimals, f);
+}
+
+static void refSerialize(Log* out, const Value* v)
+{
+  int i;
+  switch (v->type) {
+    case V_NULL: logAppend(out, "null"); break;
+    case V_BOOL: logAppend(out, v->i ? "true" : "false"); break;
+    case V_INT: logAppend(out, "%d", v->i); break;
+    case V_FLOAT: refFloat(out, v->f, v->decimals); break;
+    case V_STRING: refString(out, v->s); break;
+    case V_ARRAY:
+    case V_OBJECT:
+      logAppend(out, v->type == V_ARRAY ? "[" : "{");
+      for (i = 0; i < v->count; i++) {
+        if (i)
+          logAppend(out, ",");
+        if (v->type == V_OBJECT) {
+          refString(out, v->keys[i]);
+          logAppend(out, ":");
+        }
+        refSerialize(out, v->children[i]);
+      }
+      logAppend(out, v->type == V_ARRAY ? "]" : "}");
+      break;
+  }
+}
+
+// JsonWriter has no null - an empty array stands in for it at the top level
+static bool writeValue(JsonWriter* jw, const Value* v)
+{
+  int i;
+  switch (v->type) {
+    case V_NULL: return jsonwriterArrayOpen(jw) && jsonwriterArrayClose(jw);
+    case V_BOOL: return jsonwriterBool(jw, v->i) != NULL;
+    case V_INT: return jsonwriterInt(jw, v->i) != NULL;
+    case V_FLOAT: return jsonwriterFloat(jw, v->f, v->decimals) != NULL;
+    case V_STRING: return jsonwriterString(jw, v->s) != NULL;
+    case V_ARRAY:
+    case V_OBJECT:
+      if (!(v->type == V_ARRAY ? jsonwriterArrayOpen(jw) : jsonwriterObjectOpen(jw)))
+        return false;
+      for (i = 0; i < v->count; i++) {
+        if (v->type == V_OBJECT && !jsonwriterObjectKey(jw, v->keys[i]))
+          return false;
+        if (!writeValue(jw, v->children[i]))
+          return false;
+      }
+      return (v->type == V_ARRAY ? jsonwriterArrayClose(jw) : jsonwriterObjectClose(jw)) != NULL;
+  }
+  return false;
+}
+
+static void fixNulls(Value* v)
+{
+  int i;
+  if (v->type == V_NULL)
+    v->type = V_ARRAY;
+  for (i = 0; i < v->count; i++)
+    fixNulls(v->children[i]);
+}
+
+static bool collect(void* ctx, const char* data, int len)
+{
+  Log* out = ctx;
+  if (out->len + len >= (int)sizeof(out->text))
+    return false;
+  memcpy(out->text + out->len, data, len);
+  out->len += len;
+  out->text[out->len] = 0;
+  return true;
+}
+
+static void testWriter(void)
+{
+  static Log expected, streamed, readback;
+  static char big[sizeof(expected.text)];
+  int n, size, documents = 0;
+  for (n = 0; n < 3000; n++) {
+    Value* v = randomValue(0);
+    if (v->type != V_ARRAY && v->type != V_OBJECT) { // the writer starts with an object or array
+      Value* wrap = calloc(1, sizeof(Value));
+      wrap->type = V_ARRAY;
+      wrap->count = 1;
+      wrap->children[0] = v;
+      v = wrap;
+    }
+    fixNulls(v);
+    expected.len = 0;
+    refSerialize(&expected, v);
+    if (expected.len >= (int)sizeof(expected.text) - 1) { // too big to check
+      freeValue(v);
+      continue;
+    }
+    documents++;
+
+    JsonWriter jw;
+    jsonwriterInit(&jw, big, sizeof(big));
+    if (!writeValue(&jw, v) || jw.p - big != expected.len || memcmp(big, expected.text, expected.len)) {
+      printf("FAIL writer\n  got      %.*s\n  expected %s\n", (int)(jw.p - big), big, expected.text);
+      failures++;
+      freeValue(v);
+      break;
+    }
+    for (size = 1; size <= 64; size++) {
+      char small[64];
+      streamed.len = 0;
+      jsonwriterInit(&jw, small, size);
+      jsonwriterSetFlush(&jw, collect, &streamed);
+      if (!writeValue(&jw, v) || !jsonwriterFlush(&jw) || streamed.len != expected.len || memcmp(streamed.text, expected.text, expected.len)) {
+        printf("FAIL streaming writer, %d byte buffer\n  got      %.*s\n  expected %s\n", size, streamed.len, streamed.text, expected.text);
+        failures++;
+        break;
+      }
+    }
+    if (!readDoc(expected.text, expected.len, expected.len / 2, expected.len, &readback)) {
+      printf("FAIL reading back %s\n", expected.text);
+      failures++;
+    }
+    freeValue(v);
+  }
+
+  // without a flush handler, an element that doesn't fit isn't written at all
+  char tiny[8];
+  JsonWriter jw;
+  jsonwriterInit(&jw, tiny, sizeof(tiny));
+  if (!jsonwriterArrayOpen(&jw) || !jsonwriterInt(&jw, 1234) || jsonwriterString(&jw, "toolong") ||
+      jw.p - tiny != 5 || memcmp(tiny, "[1234", 5) || !jsonwriterArrayClose(&jw) || strcmp(tiny, "[1234]")) {
+    printf("FAIL writer overflow\n");
+    failures++;
+  }
+  printf("writer: %d documents\n", documents);
+}
+
+static void testFloats(void)
+{
+  static const float specials[] = {
+    0.0f, -0.0f, 0.5f, 1.5f, 2.5f, 0.125f, 0.375f, -0.125f, 1e-10f, 1.17549435e-38f, 1e-45f,
+    16777216.0f, 16777217.0f, 1e10f, 3.4028235e38f, -3.4028235e38f, 123.456f, 0.1f, 0.3f, 999.9995f
+  };
+  char buf[128], ref[128];
+  int i, d, checked = 0;
+  for (i = 0; i < 200000; i++) {
+    float f = (i < (int)(sizeof(specials) / sizeof(specials[0]))) ? specials[i] : randomFloat();
+    for (d = 0; d <= JSON_MAX_DECIMALS; d++) {
+      JsonWriter jw;
+      jsonwriterInit(&jw, buf, sizeof(buf));
+      jsonwriterArrayOpen(&jw);
+      jsonwriterFloat(&jw, f, d);
+      *jw.p = 0;
+      int len = snprintf(ref, sizeof(ref), "[");
+      if (isinf(f) || isnan(f))
+        snprintf(ref + len, sizeof(ref) - len, "null");
+      else
+        snprintf(ref + len, sizeof(ref) - len, "%.*f", d, f);
+      checked++;
+      if (strcmp(buf, ref)) {
+        printf("FAIL float %a at %d decimals\n  got      %s\n  expected %s\n", f, d, buf + 1, ref + 1);
+        failures++;
+        return;
+      }
+    }
+  }
+  printf("floats: %d checked\n", checked);
+}
+
+int main(void)
+{
+  testWriter();
+  testFloats();
+  testReader();
+  testAbort();
+  testZeroCopy();
+  printf("%s\n", failures ? "FAILED" : "all tests pass");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,351 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side TCP and UDP throughput test, for the netbench project in projects/netbench.
+
+  tcp-sink    sends to the board for -t seconds, and reports the rate both ends saw.
+  tcp-source  asks the board for -b bytes, and reports how fast they came in.
+  udp-echo    sends -n datagrams of -s bytes with up to -w in flight, and reports
+              loss and round trip percentiles.
+  udp-flood   asks the board for -n datagrams of -s bytes at -r a second (0 for as
+              fast as it can), and reports loss, reordering and the rate they came in.
+
+  Use a direct cable, or a tap interface bridged to the board's port, so nothing else
+  on the network gets in the way.  -I ties the socket to one interface (this needs root),
+  which makes sure the traffic goes the way you think when there's more than one route
+  to the board.  Read /network/stats from the board before and after a run to see whether
+  any losses were in the EMAC or in lwIP.
+
+  Build and run from this directory:
+    cc -O2 -o netbench netbench.c
+    ./netbench tcp-sink 192.168.0.200
+    ./netbench -b 4000000 tcp-source 192.168.0.200
+    ./netbench -n 10000 -s 64 -w 4 udp-echo 192.168.0.200
+    ./netbench -n 10000 -s 1472 -r 500 -I eth1 udp-flood 192.168.0.200
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define MAX_WINDOW 64
+#define UDP_MAX 1472
+#define SUMMARY 0xFFFFFFFF
+
+enum { TCP_SINK, TCP_SOURCE, UDP_ECHO, UDP_FLOOD }; // same order as the board's ports
+
+static const char* modes[] = { "tcp-sink", "tcp-source", "udp-echo", "udp-flood" };
+
+static struct sockaddr_in board;
+static const char* iface;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void putInt(char* buf, uint32_t value)
+{
+  buf[0] = value >> 24;
+  buf[1] = value >> 16;
+  buf[2] = value >> 8;
+  buf[3] = value;
+}
+
+static uint32_t getInt(const char* buf)
+{
+  const uint8_t* b = (const uint8_t*)buf;
+  return ((uint32_t)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+static int compare(const void* a, const void* b)
+{
+  double d = *(const double*)a - *(const double*)b;
+  return (d > 0) - (d < 0);
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: netbench [-p port] [-t secs] [-b bytes] [-n count] [-s size] [-r rate] [-w window] [-I iface] mode board\n");
+  fprintf(stderr, "  mode is one of tcp-sink, tcp-source, udp-echo or udp-flood\n");
+  exit(1);
+}
+
+static void fail(const char* what)
+{
+  perror(what);
+  exit(1);
+}
+
+// a socket to the board's port for this mode, with a receive timeout
+static int boardSocket(int type, int mode, double timeout)
+{
+  int sock = socket(AF_INET, type, 0);
+  if (sock < 0)
+    fail("socket");
+#ifdef SO_BINDTODEVICE
+  if (iface && setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, iface, strlen(iface) + 1) < 0)
+    fail(iface);
+#endif
+  struct timeval tv = { (int)timeout, (int)((timeout - (int)timeout) * 1e6) };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in to = board;
+  to.sin_port = htons(ntohs(board.sin_port) + mode);
+  if (connect(sock, (struct sockaddr*)&to, sizeof(to)) < 0)
+    fail("connect");
+  return sock;
+}
+
+static void printRate(const char* who, double bytes, double secs)
+{
+  printf("%s: %.0f bytes in %.3f s, %.3f Mbit/s\n", who, bytes, secs, secs > 0 ? bytes * 8 / secs / 1e6 : 0);
+}
+
+static void tcpSink(double secs, int size)
+{
+  int sock = boardSocket(SOCK_STREAM, TCP_SINK, 10);
+  char* buf = calloc(1, size);
+  double sent = 0, start = now();
+  while (now() - start < secs) {
+    int n = send(sock, buf, size, 0);
+    if (n < 0)
+      fail("send");
+    sent += n;
+  }
+  shutdown(sock, SHUT_WR);
+
+  char reply[8];
+  int got = 0, n;
+  while (got < (int)sizeof(reply) && (n = recv(sock, reply + got, sizeof(reply) - got, 0)) > 0)
+    got += n;
+  double elapsed = now() - start;
+  printRate("host sent", sent, elapsed);
+  if (got == sizeof(reply))
+    printRate("board got", getInt(reply), getInt(reply + 4) / 1000.0);
+  else
+    printf("board didn't report what it got\n");
+  free(buf);
+  close(sock);
+}
+
+static void tcpSource(uint32_t bytes)
+{
+  int sock = boardSocket(SOCK_STREAM, TCP_SOURCE, 10);
+  char request[4], buf[16384];
+  putInt(request, bytes);
+  double start = now(), first = 0;
+  if (send(sock, request, sizeof(request), 0) != sizeof(request))
+    fail("send");
+  double got = 0;
+  int n;
+  while ((n = recv(sock, buf, sizeof(buf), 0)) > 0) {
+    if (got == 0)
+      first = now();
+    got += n;
+  }
+  double end = now();
+  printRate("host got", got, end - start);
+  if (got > 0)
+    printf("first byte after %.1f ms\n", (first - start) * 1e3);
+  if (got < bytes)
+    printf("%.0f bytes short\n", bytes - got);
+  close(sock);
+}
+
+static void udpEcho(int count, int size, int window)
+{
+  int sock = boardSocket(SOCK_DGRAM, UDP_ECHO, 0.2); // anything slower than this counts as lost
+  char msg[UDP_MAX], reply[UDP_MAX];
+  double* sentAt = malloc(count * sizeof(double));
+  double* rtt = malloc(count * sizeof(double));
+  char* state = calloc(count, 1); // 0 in flight, 1 back, 2 given up on
+  int sent = 0, received = 0, lost = 0, late = 0, inflight = 0, i;
+  memset(msg, 0, sizeof(msg));
+
+  double start = now();
+  while (received + lost < count) {
+    while (inflight < window && sent < count) {
+      putInt(msg, sent);
+      sentAt[sent] = now();
+      if (send(sock, msg, size, 0) < 0)
+        fail("send");
+      sent++;
+      inflight++;
+    }
+    int got = recv(sock, reply, sizeof(reply), 0);
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      for (i = 0; i < sent; i++) { // give up on everything in flight and start over
+        if (state[i] == 0) {
+          state[i] = 2;
+          lost++;
+        }
+      }
+      inflight = 0;
+      continue;
+    }
+    if (got < 4)
+      continue;
+    uint32_t seq = getInt(reply);
+    if (seq >= (uint32_t)sent)
+      continue;
+    if (state[seq] != 0) {
+      late++;
+      continue;
+    }
+    state[seq] = 1;
+    rtt[received++] = (now() - sentAt[seq]) * 1e6;
+    inflight--;
+  }
+  double elapsed = now() - start;
+
+  printf("udp-echo, %d bytes, window %d\n", size, window);
+  printf("sent %d, received %d, lost %d (%.2f%%), late %d\n", sent, received, lost, lost * 100.0 / sent, late);
+  printf("%.0f replies/s, %.3f Mbit/s each way\n", received / elapsed, received * size * 8 / elapsed / 1e6);
+  if (received > 0) {
+    qsort(rtt, received, sizeof(double), compare);
+    printf("round trip us: min %.0f  p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+      rtt[0], rtt[received / 2], rtt[received * 9 / 10], rtt[received * 99 / 100], rtt[received - 1]);
+  }
+  free(sentAt);
+  free(rtt);
+  free(state);
+  close(sock);
+}
+
+static void udpFlood(int count, int size, int rate)
+{
+  int sock = boardSocket(SOCK_DGRAM, UDP_FLOOD, 0.5); // half a second of quiet means it's done
+  int rcvbuf = 4 << 20; // so the host isn't the one dropping packets
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  char request[12], buf[UDP_MAX];
+  putInt(request, count);
+  putInt(request + 4, size);
+  putInt(request + 8, rate);
+  char* seen = calloc(count, 1);
+  int received = 0, reordered = 0, duplicates = 0, summary = 0, highest = -1;
+  uint32_t boardSent = 0, boardFailed = 0;
+  double bytes = 0, first = 0, last = 0;
+
+  if (send(sock, request, sizeof(request), 0) < 0)
+    fail("send");
+  double start = now();
+  while (!summary) {
+    int got = recv(sock, buf, sizeof(buf), 0);
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (received > 0 || now() - start > 2)
+        break;
+      continue;
+    }
+    if (got < 12)
+      continue;
+    uint32_t seq = getInt(buf);
+    if (seq == SUMMARY) {
+      boardSent = getInt(buf + 4);
+      boardFailed = getInt(buf + 8);
+      summary = 1;
+      continue;
+    }
+    if (seq >= (uint32_t)count)
+      continue;
+    if (seen[seq]) {
+      duplicates++;
+      continue;
+    }
+    seen[seq] = 1;
+    if ((int)seq < highest)
+      reordered++;
+    else
+      highest = seq;
+    last = now();
+    if (received++ == 0)
+      first = last;
+    bytes += got;
+  }
+
+  int lost = count - received;
+  double elapsed = last - first;
+  printf("udp-flood, %d bytes, %s\n", size, rate ? "paced" : "as fast as possible");
+  if (rate)
+    printf("asked for %d/s\n", rate);
+  printf("received %d of %d, lost %d (%.2f%%), out of order %d, duplicates %d\n",
+    received, count, lost, lost * 100.0 / count, reordered, duplicates);
+  if (summary)
+    printf("board sent %u, couldn't send %u\n", boardSent, boardFailed);
+  else
+    printf("board didn't report what it sent\n");
+  if (received > 1)
+    printf("%.0f packets/s, %.3f Mbit/s\n", (received - 1) / elapsed, bytes * 8 / elapsed / 1e6);
+  free(seen);
+  close(sock);
+}
+
+int main(int argc, char** argv)
+{
+  int port = 5001, count = 1000, size = 0, rate = 0, window = 1, mode, opt;
+  double secs = 10;
+  uint32_t bytes = 1000000;
+  while ((opt = getopt(argc, argv, "p:t:b:n:s:r:w:I:")) != -1) {
+    switch (opt) {
+      case 'p': port = atoi(optarg); break;
+      case 't': secs = atof(optarg); break;
+      case 'b': bytes = strtoul(optarg, 0, 0); break;
+      case 'n': count = atoi(optarg); break;
+      case 's': size = atoi(optarg); break;
+      case 'r': rate = atoi(optarg); break;
+      case 'w': window = atoi(optarg); break;
+      case 'I': iface = optarg; break;
+      default: usage();
+    }
+  }
+  if (optind != argc - 2 || count < 1 || window < 1 || window > MAX_WINDOW || size < 0 || rate < 0)
+    usage();
+  for (mode = 0; mode < 4; mode++) {
+    if (strcmp(argv[optind], modes[mode]) == 0)
+      break;
+  }
+  board.sin_family = AF_INET;
+  board.sin_port = htons(port);
+  if (mode == 4 || inet_pton(AF_INET, argv[optind + 1], &board.sin_addr) != 1)
+    usage();
+
+  switch (mode) {
+    case TCP_SINK:
+      tcpSink(secs, size ? size : 16384);
+      break;
+    case TCP_SOURCE:
+      tcpSource(bytes);
+      break;
+    case UDP_ECHO:
+      udpEcho(count, size ? (size < 4 ? 4 : size > UDP_MAX ? UDP_MAX : size) : 64, window);
+      break;
+    case UDP_FLOOD:
+      udpFlood(count, size ? (size < 12 ? 12 : size > UDP_MAX ? UDP_MAX : size) : UDP_MAX, rate);
+      break;
+  }
+  return 0;
+}
@@ -0,0 +1,153 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side OSC over UDP round trip and throughput test.
+
+  Sends an OSC query (with no arguments, so the board replies with the value) and
+  times each reply.  With a window of 1 it's a ping - one query in flight at a time,
+  which gives the latency of the dispatch path.  A bigger window keeps that many
+  queries in flight, which gives the packets per second the board can sustain.
+  Run it once against firmware built normally and once with OSC_UDP_RAW defined
+  in config.h to compare the socket and raw paths.
+
+  The board sends replies to the OSC reply port (10000 by default), so that's the
+  port this listens on.
+
+  Build and run from this directory:
+    cc -O2 -o oscping oscping.c
+    ./oscping -n 5000 192.168.0.200
+    ./oscping -n 20000 -w 8 192.168.0.200
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define MAX_WINDOW 64
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int pad4(int n)
+{
+  return (n + 4) & ~3; // room for at least one terminating null
+}
+
+// a message with just an address and an empty typetag
+static int oscQuery(char* buf, const char* address)
+{
+  int len = pad4(strlen(address));
+  memset(buf, 0, len + 4);
+  strcpy(buf, address);
+  buf[len] = ',';
+  return len + 4;
+}
+
+static int compare(const void* a, const void* b)
+{
+  double d = *(const double*)a - *(const double*)b;
+  return (d > 0) - (d < 0);
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: oscping [-p port] [-r replyport] [-n count] [-w window] [-a address] board\n");
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  int port = 10000, replyPort = 10000, count = 1000, window = 1, opt;
+  const char* address = "/system/name";
+  while ((opt = getopt(argc, argv, "p:r:n:w:a:")) != -1) {
+    switch (opt) {
+      case 'p': port = atoi(optarg); break;
+      case 'r': replyPort = atoi(optarg); break;
+      case 'n': count = atoi(optarg); break;
+      case 'w': window = atoi(optarg); break;
+      case 'a': address = optarg; break;
+      default: usage();
+    }
+  }
+  if (optind != argc - 1 || count < 1 || window < 1 || window > MAX_WINDOW)
+    usage();
+
+  struct sockaddr_in board = { .sin_family = AF_INET, .sin_port = htons(port) };
+  if (inet_pton(AF_INET, argv[optind], &board.sin_addr) != 1)
+    usage();
+  struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = htons(replyPort), .sin_addr.s_addr = INADDR_ANY };
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0 || bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0) {
+    perror("oscping");
+    return 1;
+  }
+  struct timeval tv = { 0, 200000 }; // anything slower than this counts as lost
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  char msg[256], reply[1024];
+  int msglen = oscQuery(msg, address);
+  double* rtt = malloc(count * sizeof(double));
+  double sentAt[MAX_WINDOW]; // queries in flight, oldest first - replies come back in order
+  int sent = 0, received = 0, lost = 0, inflight = 0;
+
+  double start = now();
+  while (received + lost < count) {
+    while (inflight < window && sent < count) {
+      if (sendto(sock, msg, msglen, 0, (struct sockaddr*)&board, sizeof(board)) < 0) {
+        perror("oscping");
+        return 1;
+      }
+      sentAt[inflight++] = now();
+      sent++;
+    }
+    int got = recv(sock, reply, sizeof(reply), 0);
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      lost += inflight; // give up on everything in flight and start over
+      inflight = 0;
+      continue;
+    }
+    if (got <= 0)
+      continue;
+    rtt[received++] = (now() - sentAt[0]) * 1e6;
+    memmove(sentAt, sentAt + 1, --inflight * sizeof(double));
+  }
+  double elapsed = now() - start;
+
+  printf("%s -> %s:%d, window %d\n", address, argv[optind], port, window);
+  printf("sent %d, received %d, lost %d\n", sent, received, lost);
+  printf("%.0f replies/s\n", received / elapsed);
+  if (received > 0) {
+    qsort(rtt, received, sizeof(double), compare);
+    printf("round trip us: min %.0f  p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+      rtt[0], rtt[received / 2], rtt[received * 9 / 10], rtt[received * 99 / 100], rtt[received - 1]);
+  }
+  free(rtt);
+  close(sock);
+  return 0;
+}
@@ -0,0 +1,354 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side trace dump - pulls the event trace off the board and writes it out in
+  Chrome's trace event format, to load into about:tracing (or ui.perfetto.dev).
+
+  The board needs MAKE_CTRL_TRACE defined in its config.h.  This sends /system/trace
+  and collects the replies until the board goes quiet, then writes one track per
+  thread, plus one for interrupts.  Spans show up as bars, instant events as ticks,
+  and the argument of each event is shown when you click on it.
+
+  The board can be on USB - give the path of its serial device - or on the network -
+  give its IP address.  Over the network, replies go to the OSC reply port
+  (10000 by default), so that's the port this listens on.
+
+  Build and run from this directory:
+    cc -O2 -o tracedump tracedump.c
+    ./tracedump -o trace.json /dev/ttyACM0
+    ./tracedump -c -o trace.json 192.168.0.200
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define MAX_PACKET 2048
+#define MAX_ENTRIES 65536
+#define MAX_THREADS 64
+#define QUIET_MS 500 // how long the board has to be quiet before we're done
+
+// must match trace.h on the board
+#define TRACE_END 0x8000
+#define TRACE_INSTANT 0x4000
+#define TRACE_USER 0x100
+
+typedef struct {
+  uint32_t seq;
+  uint32_t time;
+  uint16_t event;
+  uint16_t arg;
+  uint32_t thread;
+} Entry;
+
+static Entry entries[MAX_ENTRIES];
+static int entryCount;
+static uint32_t clockRate;
+
+// SLIP framing, as used by the board's USB serial port
+#define SLIP_END 0xC0
+#define SLIP_ESC 0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+static int fd = -1, isUdp;
+static struct sockaddr_in board;
+
+static void fail(const char* what)
+{
+  perror(what);
+  exit(1);
+}
+
+static int pad4(int n)
+{
+  return (n + 4) & ~3; // room for at least one terminating null
+}
+
+// /system/trace with no arguments, or with a single int
+static int oscTraceMessage(uint8_t* buf, int withInt, int value)
+{
+  const char* address = "/system/trace";
+  int len = pad4(strlen(address));
+  memset(buf, 0, len + 8);
+  strcpy((char*)buf, address);
+  buf[len] = ',';
+  if (!withInt)
+    return len + 4;
+  buf[len + 1] = 'i';
+  uint32_t v = htonl(value);
+  memcpy(buf + len + 4, &v, 4);
+  return len + 8;
+}
+
+static void sendPacket(const uint8_t* data, int len)
+{
+  if (isUdp) {
+    if (sendto(fd, data, len, 0, (struct sockaddr*)&board, sizeof(board)) < 0)
+      fail("tracedump");
+    return;
+  }
+  uint8_t buf[MAX_PACKET * 2 + 2];
+  int i, n = 0;
+  buf[n++] = SLIP_END;
+  for (i = 0; i < len; i++) {
+    if (data[i] == SLIP_END) { buf[n++] = SLIP_ESC; buf[n++] = SLIP_ESC_END; }
+    else if (data[i] == SLIP_ESC) { buf[n++] = SLIP_ESC; buf[n++] = SLIP_ESC_ESC; }
+    else buf[n++] = data[i];
+  }
+  buf[n++] = SLIP_END;
+  if (write(fd, buf, n) != n)
+    fail("tracedump");
+}
+
+// the next packet, or -1 once nothing has come in for QUIET_MS
+static int receivePacket(uint8_t* packet)
+{
+  static uint8_t raw[512];
+  static int rawLen, rawPos;
+  struct pollfd p = { .fd = fd, .events = POLLIN };
+  if (isUdp) {
+    if (poll(&p, 1, QUIET_MS) <= 0)
+      return -1;
+    return recv(fd, packet, MAX_PACKET, 0);
+  }
+  int len = 0, escaped = 0;
+  for (;;) {
+    if (rawPos == rawLen) {
+      if (poll(&p, 1, QUIET_MS) <= 0)
+        return -1;
+      rawLen = read(fd, raw, sizeof(raw));
+      rawPos = 0;
+      if (rawLen <= 0)
+        fail("tracedump");
+    }
+    uint8_t c = raw[rawPos++];
+    if (c == SLIP_END) {
+      if (len > 0)
+        return len;
+      continue;
+    }
+    if (escaped) {
+      c = (c == SLIP_ESC_END) ? SLIP_END : (c == SLIP_ESC_ESC) ? SLIP_ESC : c;
+      escaped = 0;
+    }
+    else if (c == SLIP_ESC) {
+      escaped = 1;
+      continue;
+    }
+    if (len < MAX_PACKET)
+      packet[len++] = c;
+  }
+}
+
+static uint32_t readInt(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// little endian, the same as the board
+static uint32_t readLE32(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// one message - keep it if it's a trace reply
+static void parseMessage(const uint8_t* msg, int len)
+{
+  int addrlen = strnlen((const char*)msg, len);
+  if (addrlen == len || strcmp((const char*)msg, "/system/trace") != 0)
+    return;
+  int pos = pad4(addrlen);
+  if (pos + 8 > len || memcmp(msg + pos, ",iib", 4) != 0)
+    return;
+  pos += 8;
+  if (pos + 12 > len)
+    return;
+  uint32_t seq = readInt(msg + pos);
+  clockRate = readInt(msg + pos + 4);
+  int bloblen = readInt(msg + pos + 8);
+  const uint8_t* p = msg + pos + 12;
+  if (bloblen < 0 || p + bloblen > msg + len)
+    return;
+  for (; bloblen >= 12 && entryCount < MAX_ENTRIES; bloblen -= 12, p += 12) {
+    Entry* e = &entries[entryCount++];
+    e->seq = seq++;
+    e->time = readLE32(p);
+    e->event = p[4] | (p[5] << 8);
+    e->arg = p[6] | (p[7] << 8);
+    e->thread = readLE32(p + 8);
+  }
+}
+
+static void parsePacket(const uint8_t* data, int len)
+{
+  if (len < 16 || memcmp(data, "#bundle", 8) != 0) {
+    parseMessage(data, len);
+    return;
+  }
+  int pos = 16; // "#bundle" and the timetag
+  while (pos + 4 <= len) {
+    int size = readInt(data + pos);
+    pos += 4;
+    if (size <= 0 || pos + size > len)
+      break;
+    parseMessage(data + pos, size);
+    pos += size;
+  }
+}
+
+static const char* eventName(int id, char* buf)
+{
+  static const char* names[] = { 0, "osc dispatch", "usb write", "usb wakeup", "fasttimer", "pin interrupt" };
+  if (id > 0 && id < (int)(sizeof(names) / sizeof(names[0])))
+    return names[id];
+  if (id >= TRACE_USER)
+    sprintf(buf, "user %d", id - TRACE_USER);
+  else
+    sprintf(buf, "event %d", id);
+  return buf;
+}
+
+static int compareSeq(const void* a, const void* b)
+{
+  int32_t d = ((const Entry*)a)->seq - ((const Entry*)b)->seq;
+  return (d > 0) - (d < 0);
+}
+
+static void writeTrace(FILE* out)
+{
+  uint32_t threads[MAX_THREADS];
+  int i, j, threadCount = 0;
+  uint64_t time = 0;
+  char name[32];
+
+  fprintf(out, "{\"traceEvents\":[\n");
+  fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"interrupts\"}}");
+  for (i = 0; i < entryCount; i++) {
+    Entry* e = &entries[i];
+    // the board's clock is 32 bits - add up the differences to get past it wrapping
+    if (i > 0)
+      time += (uint32_t)(e->time - entries[i - 1].time);
+    for (j = 0; j < threadCount && threads[j] != e->thread; j++)
+      ;
+    if (j == threadCount && e->thread != 0 && threadCount < MAX_THREADS) {
+      threads[threadCount++] = e->thread;
+      fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread 0x%08x\"}}",
+        e->thread, e->thread);
+    }
+    const char* phase = (e->event & TRACE_END) ? "E" : (e->event & TRACE_INSTANT) ? "i" : "B";
+    fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%s\",%s\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%u,\"seq\":%u}}",
+      eventName(e->event & ~(TRACE_END | TRACE_INSTANT), name), phase, (*phase == 'i') ? "\"s\":\"t\"," : "",
+      time * 1e6 / clockRate, e->thread, e->arg, e->seq);
+  }
+  fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+static void openSerial(const char* path)
+{
+  struct termios tio;
+  fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+    fail(path);
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  tcflush(fd, TCIOFLUSH);
+}
+
+static void openUdp(const char* address, int port, int replyPort)
+{
+  board.sin_family = AF_INET;
+  board.sin_port = htons(port);
+  if (inet_pton(AF_INET, address, &board.sin_addr) != 1) {
+    fprintf(stderr, "tracedump: %s isn't a serial device or an IP address\n", address);
+    exit(1);
+  }
+  struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = htons(replyPort), .sin_addr.s_addr = INADDR_ANY };
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0 || bind(fd, (struct sockaddr*)&local, sizeof(local)) < 0)
+    fail("tracedump");
+  isUdp = 1;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: tracedump [-o file] [-c] [-p port] [-r replyport] device|board\n");
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  int port = 10000, replyPort = 10000, clear = 0, opt;
+  const char* outPath = "trace.json";
+  while ((opt = getopt(argc, argv, "o:cp:r:")) != -1) {
+    switch (opt) {
+      case 'o': outPath = optarg; break;
+      case 'c': clear = 1; break;
+      case 'p': port = atoi(optarg); break;
+      case 'r': replyPort = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if (optind != argc - 1)
+    usage();
+
+  if (argv[optind][0] == '/')
+    openSerial(argv[optind]);
+  else
+    openUdp(argv[optind], port, replyPort);
+
+  uint8_t packet[MAX_PACKET];
+  int len = oscTraceMessage(packet, 0, 0);
+  sendPacket(packet, len);
+  while ((len = receivePacket(packet)) >= 0)
+    parsePacket(packet, len);
+  if (clear) {
+    len = oscTraceMessage(packet, 1, 0);
+    sendPacket(packet, len);
+  }
+
+  if (entryCount == 0 || clockRate == 0) {
+    fprintf(stderr, "tracedump: no trace from the board - is MAKE_CTRL_TRACE defined in its config.h?\n");
+    return 1;
+  }
+  // the replies come in order, but don't count on it
+  qsort(entries, entryCount, sizeof(Entry), compareSeq);
+  FILE* out = fopen(outPath, "w");
+  if (out == NULL)
+    fail(outPath);
+  writeTrace(out);
+  fclose(out);
+
+  uint64_t span = 0;
+  int i;
+  for (i = 1; i < entryCount; i++)
+    span += (uint32_t)(entries[i].time - entries[i - 1].time);
+  printf("%d events (#%u to #%u) over %.3f ms -> %s\n", entryCount, entries[0].seq,
+    entries[entryCount - 1].seq, span * 1e3 / clockRate, outPath);
+  return 0;
+}
@@ -0,0 +1,250 @@
+/*********************************************************************************
+
+ Copyright 2006-2010 MakingThings
+
+ Licensed under the Apache License,
+ Version 2.0 (the "License"); you may not use this file except in compliance
+ with the License. You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software distributed
+ under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ CONDITIONS OF ANY KIND, either express or implied. See the License for
+ the specific language governing permissions and limitations under the License.
+
+*********************************************************************************/
+
+/*
+  Host-side UDP flood test - how many packets per second the board can take in.
+
+  Blasts OSC messages at an address nothing on the board answers to, so every packet
+  goes all the way through the EMAC, lwIP and the OSC parser but nothing comes back
+  to slow things down.  Before and after the flood it reads /network/stats (the board
+  needs LWIP_STATS, which is on by default) and reports how many of the packets the
+  EMAC, lwIP and UDP layers actually saw, and how many they dropped.  Step the rate up
+  until drops show up to find the ceiling.  Run it once against firmware built normally
+  and once with LWIP_EMAC_ZEROCOPY defined in config.h to compare the two receive paths.
+
+  Replies go to the OSC reply port (10000 by default), so that's the port this listens on.
+
+  Build and run from this directory:
+    cc -O2 -o udpflood udpflood.c
+    ./udpflood -n 20000 -r 2000 192.168.0.200
+    ./udpflood -n 50000 -r 0 -s 512 192.168.0.200
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define MAX_PACKET 1472
+
+enum { XMIT, RECV, DROP, MEMERR, ERR, NCOUNTERS };
+
+typedef struct {
+  long link[NCOUNTERS];
+  long ip[NCOUNTERS];
+  long udp[NCOUNTERS];
+  long emac[3];         // rov rre fcse
+  long zerocopy[4];     // rx rxchained tx txcopied
+  int haveZerocopy;
+} Stats;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int pad4(int n)
+{
+  return (n + 4) & ~3; // room for at least one terminating null
+}
+
+static int oscQuery(char* buf, const char* address)
+{
+  int len = pad4(strlen(address));
+  memset(buf, 0, len + 4);
+  strcpy(buf, address);
+  buf[len] = ',';
+  return len + 4;
+}
+
+// an address nothing answers to, with a blob to pad it out to the size asked for
+static int oscFloodMessage(char* buf, int size)
+{
+  int len = oscQuery(buf, "/udpflood");
+  buf[len - 3] = 'b';
+  int blob = size - len - 4;
+  if (blob < 0)
+    blob = 0;
+  blob &= ~3;
+  uint32_t n = htonl(blob);
+  memcpy(buf + len, &n, 4);
+  memset(buf + len + 4, 0xA5, blob);
+  return len + 4 + blob;
+}
+
+static void readInts(const char* types, const char* args, const char* end, long* out, int max)
+{
+  int i = 0;
+  for (types++; *types && i < max && args + 4 <= end; types++, args += 4) {
+    if (*types != 'i')
+      return;
+    uint32_t v;
+    memcpy(&v, args, 4);
+    out[i++] = (long)(uint32_t)ntohl(v);
+  }
+}
+
+static void parseMessage(const char* msg, int len, Stats* s)
+{
+  const char* end = msg + len;
+  int addrlen = pad4(strnlen(msg, len));
+  if (addrlen >= len || msg[addrlen] != ',')
+    return;
+  const char* types = msg + addrlen;
+  const char* args = types + pad4(strnlen(types, end - types));
+  if (!strcmp(msg, "/network/stats/link"))
+    readInts(types, args, end, s->link, NCOUNTERS);
+  else if (!strcmp(msg, "/network/stats/ip"))
+    readInts(types, args, end, s->ip, NCOUNTERS);
+  else if (!strcmp(msg, "/network/stats/udp"))
+    readInts(types, args, end, s->udp, NCOUNTERS);
+  else if (!strcmp(msg, "/network/stats/emac"))
+    readInts(types, args, end, s->emac, 3);
+  else if (!strcmp(msg, "/network/stats/zerocopy")) {
+    readInts(types, args, end, s->zerocopy, 4);
+    s->haveZerocopy = 1;
+  }
+}
+
+static void parsePacket(const char* p, int len, Stats* s)
+{
+  if (len >= 16 && !memcmp(p, "#bundle", 8)) {
+    const char* end = p + len;
+    for (p += 16; p + 4 <= end; ) {
+      uint32_t size;
+      memcpy(&size, p, 4);
+      size = ntohl(size);
+      p += 4;
+      if (size > (uint32_t)(end - p))
+        return;
+      parsePacket(p, size, s);
+      p += size;
+    }
+  }
+  else
+    parseMessage(p, len, s);
+}
+
+// the stats can arrive as several bundles, so keep reading until things go quiet
+static int readStats(int sock, struct sockaddr_in* board, Stats* s)
+{
+  char msg[64], reply[2048];
+  int msglen = oscQuery(msg, "/network/stats");
+  memset(s, 0, sizeof(*s));
+  if (sendto(sock, msg, msglen, 0, (struct sockaddr*)board, sizeof(*board)) < 0)
+    return -1;
+  int packets = 0, got;
+  while ((got = recv(sock, reply, sizeof(reply), 0)) > 0) {
+    parsePacket(reply, got, s);
+    packets++;
+  }
+  return packets ? 0 : -1;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: udpflood [-p port] [-l replyport] [-n count] [-r rate] [-s size] board\n"
+                  "  rate is packets/s, 0 sends as fast as the host can\n");
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  int port = 10000, replyPort = 10000, count = 10000, rate = 1000, size = 64, opt;
+  while ((opt = getopt(argc, argv, "p:l:n:r:s:")) != -1) {
+    switch (opt) {
+      case 'p': port = atoi(optarg); break;
+      case 'l': replyPort = atoi(optarg); break;
+      case 'n': count = atoi(optarg); break;
+      case 'r': rate = atoi(optarg); break;
+      case 's': size = atoi(optarg); break;
+      default: usage();
+    }
+  }
+  if (optind != argc - 1 || count < 1 || rate < 0 || size < 16 || size > MAX_PACKET)
+    usage();
+
+  struct sockaddr_in board = { .sin_family = AF_INET, .sin_port = htons(port) };
+  if (inet_pton(AF_INET, argv[optind], &board.sin_addr) != 1)
+    usage();
+  struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = htons(replyPort), .sin_addr.s_addr = INADDR_ANY };
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0 || bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0) {
+    perror("udpflood");
+    return 1;
+  }
+  struct timeval tv = { 0, 300000 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  Stats before, after;
+  if (readStats(sock, &board, &before) < 0) {
+    fprintf(stderr, "udpflood: no reply to /network/stats - is the board there, with LWIP_STATS on?\n");
+    return 1;
+  }
+
+  char msg[MAX_PACKET];
+  int msglen = oscFloodMessage(msg, size);
+  int sent = 0;
+  double start = now(), interval = rate ? 1.0 / rate : 0;
+  while (sent < count) {
+    if (interval) {
+      double due = start + sent * interval;
+      while (now() < due)
+        ;
+    }
+    if (sendto(sock, msg, msglen, 0, (struct sockaddr*)&board, sizeof(board)) < 0) {
+      if (errno == ENOBUFS || errno == EAGAIN)
+        continue;
+      perror("udpflood");
+      return 1;
+    }
+    sent++;
+  }
+  double elapsed = now() - start;
+
+  usleep(500000); // let the board drain its queues before asking
+  if (readStats(sock, &board, &after) < 0) {
+    fprintf(stderr, "udpflood: no reply to /network/stats after the flood\n");
+    return 1;
+  }
+
+  // the board's counters are 16 bits, so differences are taken mod 65536
+#define DELTA(f) ((after.f - before.f) & 0xFFFF)
+  long udpRecv = DELTA(udp[RECV]) - 1; // less the stats query itself
+  printf("%d packets of %d bytes -> %s:%d in %.2fs, %.0f packets/s offered\n",
+    sent, msglen, argv[optind], port, elapsed, sent / elapsed);
+  printf("link: recv %ld  drop %ld  memerr %ld\n", DELTA(link[RECV]), DELTA(link[DROP]), DELTA(link[MEMERR]));
+  printf("ip:   recv %ld  drop %ld\n", DELTA(ip[RECV]), DELTA(ip[DROP]));
+  printf("udp:  recv %ld  drop %ld\n", udpRecv, DELTA(udp[DROP]));
+  printf("emac: overrun %ld  no buffer %ld  fcs %ld\n",
+    after.emac[0] - before.emac[0], after.emac[1] - before.emac[1], after.emac[2] - before.emac[2]);
+  if (after.haveZerocopy)
+    printf("zerocopy: rx %ld  rxchained %ld\n",
+      after.zerocopy[0] - before.zerocopy[0], after.zerocopy[1] - before.zerocopy[1]);
+  printf("%.0f packets/s received, %.1f%% lost\n",
+    udpRecv / elapsed, sent ? 100.0 * (sent - udpRecv) / sent : 0);
+  return 0;
+}
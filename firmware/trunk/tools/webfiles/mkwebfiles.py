@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+#
+# Copyright 2006-2010 MakingThings
+#
+# Licensed under the Apache License,
+# Version 2.0 (the "License"); you may not use this file except in compliance
+# with the License. You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software distributed
+# under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+# CONDITIONS OF ANY KIND, either express or implied. See the License for
+# the specific language governing permissions and limitations under the License.
+
+"""
+Turn a folder of web files into a C table for the webfiles library.
+
+  python mkwebfiles.py <folder> <output.c> [table name]
+
+Each file is gzipped, unless that doesn't make it smaller (images, usually), and
+given an ETag from the CRC of what's stored.  The table is named webfilesData by
+default, with its length in webfilesDataCount:
+
+  extern const WebFile webfilesData[];
+  extern const int webfilesDataCount;
+  webfilesServe(webfilesData, webfilesDataCount);
+"""
+
+import gzip
+import io
+import os
+import sys
+import zlib
+
+CONTENT_TYPES = {
+  '.html': 'text/html',
+  '.htm':  'text/html',
+  '.css':  'text/css',
+  '.js':   'application/javascript',
+  '.json': 'application/json',
+  '.txt':  'text/plain',
+  '.xml':  'text/xml',
+  '.svg':  'image/svg+xml',
+  '.png':  'image/png',
+  '.jpg':  'image/jpeg',
+  '.jpeg': 'image/jpeg',
+  '.gif':  'image/gif',
+  '.ico':  'image/x-icon',
+}
+
+def compress(data):
+  buf = io.BytesIO()
+  # a fixed mtime keeps the output - and so the ETag - the same from build to build
+  with gzip.GzipFile(filename='', mode='wb', compresslevel=9, fileobj=buf, mtime=0) as f:
+    f.write(data)
+  return buf.getvalue()
+
+def c_bytes(data):
+  lines = []
+  for i in range(0, len(data), 16):
+    lines.append('  ' + ', '.join('0x%02x' % b for b in bytearray(data[i:i + 16])) + ',')
+  return '\n'.join(lines)
+
+def main(argv):
+  if len(argv) < 3:
+    sys.stderr.write(__doc__)
+    return 1
+  root, output = argv[1], argv[2]
+  table = argv[3] if len(argv) > 3 else 'webfilesData'
+
+  files = []
+  for dirpath, dirnames, filenames in os.walk(root):
+    dirnames.sort()
+    for name in sorted(filenames):
+      if name.startswith('.'):
+        continue
+      path = os.path.join(dirpath, name)
+      url = '/' + os.path.relpath(path, root).replace(os.sep, '/')
+      with open(path, 'rb') as f:
+        raw = f.read()
+      packed = compress(raw)
+      gzipped = len(packed) < len(raw)
+      data = packed if gzipped else raw
+      ext = os.path.splitext(name)[1].lower()
+      files.append({
+        'url': url,
+        'type': CONTENT_TYPES.get(ext, 'application/octet-stream'),
+        'etag': '%08x' % (zlib.crc32(data) & 0xffffffff),
+        'data': data,
+        'gzipped': gzipped,
+        'raw': len(raw),
+      })
+
+  out = []
+  out.append('// Generated by mkwebfiles.py from %s - do not edit.' % os.path.basename(os.path.normpath(root)))
+  out.append('')
+  out.append('#include "webfiles.h"')
+  out.append('')
+  for i, f in enumerate(files):
+    out.append('// %s - %d bytes, %d stored' % (f['url'], f['raw'], len(f['data'])))
+    out.append('static const uint8_t %s_%d[] = {' % (table, i))
+    out.append(c_bytes(f['data']))
+    out.append('};')
+    out.append('')
+  out.append('const WebFile %s[] = {' % table)
+  for i, f in enumerate(files):
+    out.append('  { "%s", "%s", "\\"%s\\"", %s_%d, %d, %s },' %
+               (f['url'], f['type'], f['etag'], table, i, len(f['data']), 'true' if f['gzipped'] else 'false'))
+  out.append('};')
+  out.append('')
+  out.append('const int %sCount = %d;' % (table, len(files)))
+  out.append('')
+
+  with open(output, 'w') as f:
+    f.write('\n'.join(out))
+
+  raw = sum(f['raw'] for f in files)
+  stored = sum(len(f['data']) for f in files)
+  print('%d files, %d bytes packed into %d' % (len(files), raw, stored))
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))